@@ -80,15 +80,40 @@ char* dpinternal_build_gemini_count_tokens_json_payload_with_cjson(const dp_requ
     return json_string; 
 }
 
+// Marks object as an Anthropic prompt cache breakpoint
+static void dpinternal_add_cache_control(cJSON* object, dp_cache_control_t cache_control) {
+    if (cache_control == DP_CACHE_CONTROL_NONE) return;
+    cJSON* cache_obj = cJSON_CreateObject();
+    if (!cache_obj) return;
+    cJSON_AddStringToObject(cache_obj, "type", "ephemeral");
+    if (cache_control == DP_CACHE_CONTROL_EPHEMERAL_1H) cJSON_AddStringToObject(cache_obj, "ttl", "1h");
+    cJSON_AddItemToObject(object, "cache_control", cache_obj);
+}
+
+// Anthropic takes the system prompt as a string, or as text blocks when it
+// carries a cache breakpoint
+static void dpinternal_add_anthropic_system(cJSON* root, const dp_request_config_t* request_config) {
+    if (!request_config->system_prompt || strlen(request_config->system_prompt) == 0) return;
+    if (request_config->system_prompt_cache_control == DP_CACHE_CONTROL_NONE) {
+        cJSON_AddStringToObject(root, "system", request_config->system_prompt);
+        return;
+    }
+    cJSON* system_array = cJSON_AddArrayToObject(root, "system");
+    cJSON* block = cJSON_CreateObject();
+    if (!system_array || !block) { cJSON_Delete(block); return; }
+    cJSON_AddStringToObject(block, "type", "text");
+    cJSON_AddStringToObject(block, "text", request_config->system_prompt);
+    dpinternal_add_cache_control(block, request_config->system_prompt_cache_control);
+    cJSON_AddItemToArray(system_array, block);
+}
+
 char* dpinternal_build_anthropic_count_tokens_json_payload_with_cjson(const dp_request_config_t* request_config) {
     cJSON *root = cJSON_CreateObject();
     if (!root) return NULL;
 
     cJSON_AddStringToObject(root, "model", request_config->model);
 
-    if (request_config->system_prompt && strlen(request_config->system_prompt) > 0) {
-        cJSON_AddStringToObject(root, "system", request_config->system_prompt);
-    }
+    dpinternal_add_anthropic_system(root, request_config);
 
     cJSON *messages_array = cJSON_AddArrayToObject(root, "messages");
     if (!messages_array) { cJSON_Delete(root); return NULL; }
@@ -103,7 +128,7 @@ char* dpinternal_build_anthropic_count_tokens_json_payload_with_cjson(const dp_r
         const char* role_str = (msg->role == DP_ROLE_ASSISTANT) ? "assistant" : "user";
         cJSON_AddStringToObject(msg_obj, "role", role_str);
 
-        if (msg->num_parts == 1 && msg->parts[0].type == DP_CONTENT_PART_TEXT) {
+        if (msg->num_parts == 1 && msg->parts[0].type == DP_CONTENT_PART_TEXT && msg->parts[0].cache_control == DP_CACHE_CONTROL_NONE) {
             cJSON_AddStringToObject(msg_obj, "content", msg->parts[0].text);
         } else {
             cJSON *content_array_for_anthropic = cJSON_CreateArray();
@@ -147,6 +172,7 @@ char* dpinternal_build_anthropic_count_tokens_json_payload_with_cjson(const dp_r
                     cJSON_AddStringToObject(part_obj, "type", "text");
                     cJSON_AddStringToObject(part_obj, "text", temp_text);
                 }
+                dpinternal_add_cache_control(part_obj, part->cache_control);
                 cJSON_AddItemToArray(content_array_for_anthropic, part_obj);
             }
             cJSON_AddItemToObject(msg_obj, "content", content_array_for_anthropic);
@@ -160,7 +186,7 @@ char* dpinternal_build_anthropic_count_tokens_json_payload_with_cjson(const dp_r
 }
 
 
-char* dpinternal_build_openai_json_payload_with_cjson(const dp_request_config_t* request_config, const dp_context_t* context) {
+char* dpinternal_build_openai_json_payload_with_cjson(const dp_request_config_t* request_config, dp_token_param_type_t token_param_type) {
     cJSON *root = cJSON_CreateObject();
     if (!root) return NULL;
 
@@ -168,7 +194,7 @@ char* dpinternal_build_openai_json_payload_with_cjson(const dp_request_config_t*
     if (request_config->reasoning_effort) cJSON_AddStringToObject(root, "reasoning_effort", request_config->reasoning_effort);
     if (request_config->temperature >= 0.0) cJSON_AddNumberToObject(root, "temperature", request_config->temperature);
     if (request_config->max_tokens > 0) {
-        const char* token_param = (context->token_param_preference == DP_TOKEN_PARAM_MAX_COMPLETION_TOKENS) 
+        const char* token_param = (token_param_type == DP_TOKEN_PARAM_MAX_COMPLETION_TOKENS) 
                                   ? "max_completion_tokens" : "max_tokens";
         cJSON_AddNumberToObject(root, token_param, request_config->max_tokens);
     }
@@ -368,11 +394,16 @@ char* dpinternal_build_openai_json_payload_with_cjson(const dp_request_config_t*
     return json_string; 
 }
 
-char* dpinternal_build_gemini_json_payload_with_cjson(const dp_request_config_t* request_config) {
+// Builds the system instruction, tools and contents of a Gemini request, the
+// part a cachedContents resource can hold. With cached_content set, the system
+// instruction and tools live in that resource and are left out here.
+cJSON* dpinternal_build_gemini_contents_with_cjson(const dp_request_config_t* request_config) {
     cJSON *root = cJSON_CreateObject();
     if (!root) return NULL;
 
-    if (request_config->system_prompt && strlen(request_config->system_prompt) > 0) {
+    if (request_config->cached_content) {
+        if (!cJSON_AddStringToObject(root, "cachedContent", request_config->cached_content)) { cJSON_Delete(root); return NULL; }
+    } else if (request_config->system_prompt && strlen(request_config->system_prompt) > 0) {
         cJSON* sys_instruction = cJSON_AddObjectToObject(root, "system_instruction");
         if (!sys_instruction) { cJSON_Delete(root); return NULL; }
         cJSON* sys_parts_array = cJSON_AddArrayToObject(sys_instruction, "parts");
@@ -383,7 +414,7 @@ char* dpinternal_build_gemini_json_payload_with_cjson(const dp_request_config_t*
         cJSON_AddItemToArray(sys_parts_array, sys_part_obj);
     }
 
-    if (request_config->tools && request_config->num_tools > 0) {
+    if (!request_config->cached_content && request_config->tools && request_config->num_tools > 0) {
         cJSON* tools_array = cJSON_AddArrayToObject(root, "tools");
         cJSON* func_decls_wrapper = cJSON_CreateObject();
         cJSON* func_decls = cJSON_AddArrayToObject(func_decls_wrapper, "function_declarations");
@@ -496,6 +527,12 @@ char* dpinternal_build_gemini_json_payload_with_cjson(const dp_request_config_t*
         }
         cJSON_AddItemToArray(contents_array, content_obj);
     }
+    return root;
+}
+
+char* dpinternal_build_gemini_json_payload_with_cjson(const dp_request_config_t* request_config) {
+    cJSON *root = dpinternal_build_gemini_contents_with_cjson(request_config);
+    if (!root) return NULL;
 
     cJSON *gen_config = cJSON_AddObjectToObject(root, "generationConfig");
     if (!gen_config) { cJSON_Delete(root); return NULL; }
@@ -541,9 +578,7 @@ char* dpinternal_build_anthropic_json_payload_with_cjson(const dp_request_config
         cJSON_AddItemToObject(root, "thinking", thinking_obj);
     }
 
-    if (request_config->system_prompt && strlen(request_config->system_prompt) > 0) {
-        cJSON_AddStringToObject(root, "system", request_config->system_prompt);
-    }
+    dpinternal_add_anthropic_system(root, request_config);
 
     if (request_config->tools && request_config->num_tools > 0) {
         cJSON* tools_array = cJSON_AddArrayToObject(root, "tools");
@@ -557,6 +592,7 @@ char* dpinternal_build_anthropic_json_payload_with_cjson(const dp_request_config
                      cJSON_AddItemToObject(tool_obj, "input_schema", params);
                  }
             }
+            if (i == request_config->num_tools - 1) dpinternal_add_cache_control(tool_obj, request_config->tools_cache_control);
             cJSON_AddItemToArray(tools_array, tool_obj);
         }
 
@@ -644,6 +680,7 @@ char* dpinternal_build_anthropic_json_payload_with_cjson(const dp_request_config
                 cJSON_AddStringToObject(part_obj, "thinking", part->thinking.thinking);
                 cJSON_AddStringToObject(part_obj, "signature", part->thinking.signature);
             }
+            dpinternal_add_cache_control(part_obj, part->cache_control);
             cJSON_AddItemToArray(content_array_for_anthropic, part_obj);
         }
         cJSON_AddItemToObject(msg_obj, "content", content_array_for_anthropic);
@@ -715,54 +752,43 @@ bool dpinternal_is_token_parameter_error(const char* error_response, long http_s
              strstr(error_response, "unknown") != NULL));
 }
 
-// Helper function to perform OpenAI request with automatic token parameter fallback
-CURLcode dpinternal_perform_openai_request_with_fallback(CURL* curl, dp_context_t* context, 
-                                                                const dp_request_config_t* request_config,
-                                                                memory_struct_t* chunk_mem,
-                                                                long* http_status_code) {
-    char* json_payload_str = dpinternal_build_openai_json_payload_with_cjson(request_config, context);
-    if (!json_payload_str) {
-        return CURLE_OUT_OF_MEMORY;
-    }
-    
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_payload_str);
-    CURLcode res = curl_easy_perform(curl);
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, http_status_code);
-    
-    // Check if we need to retry with fallback parameter
-    if (res == CURLE_OK && *http_status_code == 400 && 
-        context->token_param_preference == DP_TOKEN_PARAM_MAX_COMPLETION_TOKENS &&
-        dpinternal_is_token_parameter_error(chunk_mem->memory, *http_status_code)) {
-        
-        // Switch to legacy parameter and retry
-        context->token_param_preference = DP_TOKEN_PARAM_MAX_TOKENS;
-        free(json_payload_str);
-        
-        // Reset response buffer for retry
-        if (chunk_mem->memory) {
-            free(chunk_mem->memory);
-            chunk_mem->memory = NULL;
-            chunk_mem->size = 0;
-        }
-        
-        // Build new payload with legacy parameter
-        json_payload_str = dpinternal_build_openai_json_payload_with_cjson(request_config, context);
-        if (!json_payload_str) {
-            return CURLE_OUT_OF_MEMORY;
-        }
-        
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_payload_str);
-        res = curl_easy_perform(curl);
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, http_status_code);
-    }
-    
-    free(json_payload_str);
-    return res;
-}
 
+static void dpinternal_usage_field(const cJSON* object, const char* name, long* out) {
+    const cJSON* item = cJSON_GetObjectItemCaseSensitive(object, name);
+    if (cJSON_IsNumber(item) && item->valuedouble > 0) *out = (long)item->valuedouble;
+}
 
+// Merges the usage object of a response or stream event into usage. Streams
+// report it piecemeal (Anthropic: input in message_start, output in
+// message_delta), so only counts present in root overwrite.
+void dpinternal_parse_usage(dp_provider_type_t provider, const cJSON* root, dp_usage_t* usage) {
+    if (!root || !usage) return;
+    if (provider == DP_PROVIDER_GOOGLE_GEMINI) {
+        const cJSON* metadata = cJSON_GetObjectItemCaseSensitive(root, "usageMetadata");
+        dpinternal_usage_field(metadata, "promptTokenCount", &usage->input_tokens);
+        dpinternal_usage_field(metadata, "candidatesTokenCount", &usage->output_tokens);
+        dpinternal_usage_field(metadata, "cachedContentTokenCount", &usage->cache_read_input_tokens);
+        return;
+    }
+    const cJSON* object = cJSON_GetObjectItemCaseSensitive(root, "usage");
+    if (!object && provider == DP_PROVIDER_ANTHROPIC) {
+        object = cJSON_GetObjectItemCaseSensitive(cJSON_GetObjectItemCaseSensitive(root, "message"), "usage");
+    }
+    if (!cJSON_IsObject(object)) return;
+    if (provider == DP_PROVIDER_ANTHROPIC) {
+        dpinternal_usage_field(object, "input_tokens", &usage->input_tokens);
+        dpinternal_usage_field(object, "output_tokens", &usage->output_tokens);
+        dpinternal_usage_field(object, "cache_creation_input_tokens", &usage->cache_creation_input_tokens);
+        dpinternal_usage_field(object, "cache_read_input_tokens", &usage->cache_read_input_tokens);
+    } else {
+        dpinternal_usage_field(object, "prompt_tokens", &usage->input_tokens);
+        dpinternal_usage_field(object, "completion_tokens", &usage->output_tokens);
+        dpinternal_usage_field(cJSON_GetObjectItemCaseSensitive(object, "prompt_tokens_details"), "cached_tokens",
+                               &usage->cache_read_input_tokens);
+    }
+}
 
-bool dpinternal_parse_response_content(const dp_context_t* context, const char* json_response_str, dp_response_part_t** parts_out, size_t* num_parts_out, char** finish_reason_out) {
+bool dpinternal_parse_response_content(const dp_context_t* context, const char* json_response_str, dp_response_part_t** parts_out, size_t* num_parts_out, char** finish_reason_out, dp_usage_t* usage_out) {
     if (finish_reason_out) *finish_reason_out = NULL;
     if (parts_out) *parts_out = NULL;
     if (num_parts_out) *num_parts_out = 0;
@@ -936,64 +962,13 @@ bool dpinternal_parse_response_content(const dp_context_t* context, const char*
         }
     }
 
+    dpinternal_parse_usage(provider, root, usage_out);
     cJSON_Delete(root);
     *parts_out = parts;
     *num_parts_out = num_parts;
     return true;
 }
 
-CURLcode dpinternal_perform_openai_streaming_request_with_fallback(CURL* curl, dp_context_t* context, 
-                                                                        const dp_request_config_t* request_config,
-                                                                        stream_processor_t* processor,
-                                                                        long* http_status_code) {
-    char* json_payload_str = dpinternal_build_openai_json_payload_with_cjson(request_config, context);
-    if (!json_payload_str) {
-        return CURLE_OUT_OF_MEMORY;
-    }
-    
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_payload_str);
-    CURLcode res = curl_easy_perform(curl);
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, http_status_code);
-    
-    // Check if we need to retry with fallback parameter
-    if (res == CURLE_OK && *http_status_code == 400 && 
-        context->token_param_preference == DP_TOKEN_PARAM_MAX_COMPLETION_TOKENS &&
-        processor->accumulated_error_during_stream && 
-        dpinternal_is_token_parameter_error(processor->accumulated_error_during_stream, *http_status_code)) {
-        
-        // Switch to legacy parameter and retry
-        context->token_param_preference = DP_TOKEN_PARAM_MAX_TOKENS;
-        free(json_payload_str);
-        
-        // Reset response buffer for retry
-        if (processor->accumulated_error_during_stream) {
-            free(processor->accumulated_error_during_stream);
-            processor->accumulated_error_during_stream = NULL;
-        }
-        
-        // Build new payload with legacy parameter
-        json_payload_str = dpinternal_build_openai_json_payload_with_cjson(request_config, context);
-        if (!json_payload_str) {
-            return CURLE_OUT_OF_MEMORY;
-        }
-        
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_payload_str);
-        res = curl_easy_perform(curl);
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, http_status_code);
-    }
-    
-    free(json_payload_str);
-    return res;
-}
-
-
-
-
-
-
-
-
-
 
 void dp_free_image_generation_response(dp_image_generation_response_t* response) {
     if (!response) return;
@@ -1030,52 +1005,4 @@ void dp_free_response_content(dp_response_t* response) {
     memset(response, 0, sizeof(dp_response_t)); 
 }
 
-CURLcode dpinternal_perform_openai_detailed_streaming_request_with_fallback(CURL* curl, dp_context_t* context, 
-                                                                        const dp_request_config_t* request_config,
-                                                                        anthropic_stream_processor_t* processor,
-                                                                        long* http_status_code) {
-    char* json_payload_str = dpinternal_build_openai_json_payload_with_cjson(request_config, context);
-    if (!json_payload_str) {
-        return CURLE_OUT_OF_MEMORY;
-    }
-    
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_payload_str);
-    CURLcode res = curl_easy_perform(curl);
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, http_status_code);
-    
-    // Check if we need to retry with fallback parameter
-    if (res == CURLE_OK && *http_status_code == 400 && 
-        context->token_param_preference == DP_TOKEN_PARAM_MAX_COMPLETION_TOKENS &&
-        processor->accumulated_error_during_stream && 
-        dpinternal_is_token_parameter_error(processor->accumulated_error_during_stream, *http_status_code)) {
-        
-        // Switch to legacy parameter and retry
-        context->token_param_preference = DP_TOKEN_PARAM_MAX_TOKENS;
-        free(json_payload_str);
-        
-        // Reset response buffer for retry
-        if (processor->accumulated_error_during_stream) {
-            free(processor->accumulated_error_during_stream);
-            processor->accumulated_error_during_stream = NULL;
-        }
-        
-        // Build new payload with legacy parameter
-        json_payload_str = dpinternal_build_openai_json_payload_with_cjson(request_config, context);
-        if (!json_payload_str) {
-            return CURLE_OUT_OF_MEMORY;
-        }
-        
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_payload_str);
-        res = curl_easy_perform(curl);
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, http_status_code);
-    }
-    
-    free(json_payload_str);
-    return res;
-}
-
-
-
-
-
 
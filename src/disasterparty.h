@@ -3,6 +3,7 @@
 
 #include <stddef.h> 
 #include <stdbool.h> 
+#include <stdint.h>
 
 // Forward declaration for libcurl and cJSON
 typedef void CURL;
@@ -75,6 +76,17 @@ typedef enum {
     DP_TOKEN_PARAM_MAX_TOKENS              // Legacy parameter (fallback)
 } dp_token_param_type_t; 
 
+/**
+ * @brief Anthropic prompt caching breakpoint. The request prefix up to and
+ * including a marked block is cached by the provider and read back at a
+ * discount by later requests that repeat it. Other providers ignore it.
+ */
+typedef enum {
+    DP_CACHE_CONTROL_NONE = 0,
+    DP_CACHE_CONTROL_EPHEMERAL,     // Default lifetime (5 minutes, refreshed on each hit)
+    DP_CACHE_CONTROL_EPHEMERAL_1H   // One-hour lifetime
+} dp_cache_control_t;
+
 typedef struct {
     char* name;
     char* description;
@@ -122,6 +134,7 @@ typedef struct {
         char* thinking;
         char* signature;
     } thinking;
+    dp_cache_control_t cache_control;  // Cache breakpoint after this part (Anthropic)
 } dp_content_part_t; 
 
 typedef struct {
@@ -130,6 +143,17 @@ typedef struct {
     size_t num_parts;
 } dp_message_t; 
 
+/**
+ * @brief Time limits for one request, in milliseconds. 0 leaves a limit unset
+ * (or inherited from dp_set_default_deadlines()).
+ */
+typedef struct {
+    long total_ms;          // Whole request, all retries and rate-limit queueing included: connect, send and the complete body or stream
+    long connect_ms;        // TCP connect plus TLS handshake
+    long first_byte_ms;     // From the start of the request until the first body byte arrives
+    long stream_idle_ms;    // Longest gap allowed between received chunks once the body has started
+} dp_deadlines_t;
+
 typedef struct {
     const char* model;
     dp_message_t* messages;
@@ -150,6 +174,10 @@ typedef struct {
         int budget_tokens;
     } thinking;
     const char* reasoning_effort;
+    dp_deadlines_t deadlines;
+    dp_cache_control_t system_prompt_cache_control;  // Cache breakpoint after the system prompt (Anthropic)
+    dp_cache_control_t tools_cache_control;          // Cache breakpoint after the last tool definition (Anthropic)
+    const char* cached_content;     // Gemini: name from dp_create_cached_content(); its system prompt, tools and contents precede messages
 } dp_request_config_t; 
 
 typedef struct {
@@ -166,14 +194,198 @@ typedef struct {
     } thinking;
 } dp_response_part_t; 
 
+/**
+ * @brief Transport-level details of a finished request.
+ */
+typedef struct {
+    long http_version;          // Negotiated protocol: 11 (HTTP/1.1), 20 (HTTP/2), 30 (HTTP/3), 0 if unknown
+    long num_connects;          // New connections opened for this request (0 = reused)
+    size_t stall_count;         // Receive gaps longer than the context's stall threshold
+    long stall_ms_total;        // Time spent in those gaps
+    long longest_stall_ms;
+    uint64_t body_bytes_wire;   // Response body bytes as received, before content decoding
+    uint64_t body_bytes_decoded;// Response body bytes after gzip/deflate/brotli/zstd decoding
+} dp_transport_stats_t;
+
+/**
+ * @brief Token usage the provider reported for a request; 0 where it
+ * reported none (e.g. OpenAI-compatible streams). Anthropic counts cached
+ * prompt tokens only in the cache fields; OpenAI and Gemini also include
+ * cache reads in input_tokens.
+ */
+typedef struct {
+    long input_tokens;
+    long output_tokens;
+    long cache_creation_input_tokens;   // Prompt tokens written to the provider's prompt cache
+    long cache_read_input_tokens;       // Prompt tokens read from the provider's prompt cache
+} dp_usage_t;
+
+/**
+ * @brief Broad cause of a failed request, so callers can react without parsing error_message.
+ */
+typedef enum {
+    DP_ERROR_NONE = 0,
+    DP_ERROR_TRANSPORT,     // Connection, TLS or protocol failure
+    DP_ERROR_API,           // The provider answered with an error status or error event
+    DP_ERROR_DEADLINE,      // A dp_deadlines_t limit was exceeded; see deadline_missed
+    DP_ERROR_CANCELLED,     // Cancelled before completion (e.g. engine destroyed)
+    DP_ERROR_OTHER,         // Invalid arguments, allocation or response parsing failure
+    DP_ERROR_RATE_LIMITED,  // Not sent: the context's dp_rate_limiter_t had no capacity (see dp_set_rate_limiter())
+    DP_ERROR_CIRCUIT_OPEN   // Not sent: the context's circuit breaker is open (see dp_set_circuit_breaker())
+} dp_error_class_t;
+
+typedef enum {
+    DP_DEADLINE_NONE = 0,
+    DP_DEADLINE_TOTAL,
+    DP_DEADLINE_CONNECT,
+    DP_DEADLINE_FIRST_BYTE,
+    DP_DEADLINE_STREAM_IDLE
+} dp_deadline_kind_t;
+
 typedef struct {
     dp_response_part_t* parts; 
     size_t num_parts;          
     char* error_message;        
     long http_status_code;      
     char* finish_reason;      
+    dp_transport_stats_t transport;
+    dp_error_class_t error_class;
+    dp_deadline_kind_t deadline_missed;   // Which limit was exceeded when error_class is DP_ERROR_DEADLINE
+    int attempts;                         // HTTP attempts made, including retries (see dp_set_retry_policy()) and the max_tokens re-send; 0 if served from cache
+    dp_usage_t usage;
 } dp_response_t; 
 
+/**
+ * @brief Automatic retry of transient failures (HTTP 408, 425, 429, 500, 502,
+ * 503, 504, 529, dropped connections, connect and first-byte deadline misses).
+ */
+typedef struct {
+    int max_attempts;       // Tries per request including the first; 1 or less disables retrying
+    long base_delay_ms;     // Backoff ceiling before the first retry; doubles on each further retry
+    long max_delay_ms;      // Cap on any one wait; a longer Retry-After or rate-limit reset is not waited for
+    double budget_ratio;    // Retry tokens earned per request; bounds retries to this share of traffic
+    int budget_burst;       // Tokens that can accumulate, and the starting balance; 0 disables the budget
+} dp_retry_policy_t;
+
+/**
+ * @brief Hedging of non-streaming completions: if the first attempt has not
+ * received response headers after a delay, a duplicate is sent and whichever
+ * succeeds first is used; the other is cancelled.
+ */
+typedef struct {
+    long delay_ms;          // Fixed hedge delay; also used until enough latencies are learned. 0 = none
+    double percentile;      // If > 0, hedge at this percentile (e.g. 95) of recently observed time to headers
+    long min_delay_ms;      // Floor for the learned delay
+} dp_hedge_policy_t;
+
+/**
+ * @brief Client-side quotas for a dp_rate_limiter_t, each a token bucket that
+ * holds one minute's worth and refills continuously. 0 = unlimited.
+ */
+typedef struct {
+    long requests_per_minute;
+    long input_tokens_per_minute;
+    long output_tokens_per_minute;
+} dp_rate_limits_t;
+
+/**
+ * @brief What a blocking call does when its context's rate limiter is out of
+ * capacity. Engine and batch requests always queue until there is capacity.
+ * Either way, time spent queued counts towards the request's total deadline,
+ * and a request whose capacity would come after it fails with
+ * DP_ERROR_RATE_LIMITED.
+ */
+typedef enum {
+    DP_RATE_LIMIT_WAIT = 0,     // Sleep until there is capacity (bounded by the total deadline, if any)
+    DP_RATE_LIMIT_FAIL_FAST     // Fail at once with DP_ERROR_RATE_LIMITED
+} dp_rate_limit_mode_t;
+
+/**
+ * @brief Circuit breaker for a context's endpoint. It opens after too many
+ * failed attempts (connection failures, HTTP 408, 425, 5xx and 529, connect,
+ * first-byte and idle deadline misses), fails requests fast while open, and
+ * lets probe requests through one at a time after open_ms to decide whether
+ * to close again. Other errors count as successes: the endpoint answered.
+ */
+typedef struct {
+    int failure_threshold;  // Consecutive failures that open the breaker; 0 = not used
+    double failure_ratio;   // Failed share of the last `window` attempts that opens it, 0..1; 0 = not used
+    int window;             // Attempts the ratio is taken over, at most 256 (0 = 20)
+    long open_ms;           // Time spent failing fast before a probe is let through (0 = 30000)
+    int success_threshold;  // Consecutive successful probes that close it again (0 = 1)
+} dp_circuit_breaker_policy_t;
+
+typedef enum {
+    DP_CIRCUIT_CLOSED = 0,  // Requests flow normally
+    DP_CIRCUIT_OPEN,        // Requests fail with DP_ERROR_CIRCUIT_OPEN
+    DP_CIRCUIT_HALF_OPEN    // One probe request at a time; the rest fail fast
+} dp_circuit_state_t;
+
+/**
+ * @brief A snapshot of a context's circuit breaker, see dp_get_circuit_breaker_stats().
+ */
+typedef struct {
+    dp_circuit_state_t state;
+    int consecutive_failures;
+    double failure_ratio;           // Over the attempts currently in the window
+    long open_remaining_ms;         // While open: time until a probe is let through
+    uint64_t times_opened;          // Transitions to open, including failed probes
+    uint64_t rejected;              // Requests failed fast without being sent
+} dp_circuit_breaker_stats_t;
+
+/**
+ * @brief Cumulative counters for a context, see dp_get_request_stats().
+ */
+typedef struct {
+    uint64_t requests;              // Requests started (first attempts only)
+    uint64_t retries;               // Further attempts made after a retryable failure
+    uint64_t retries_denied;        // Retryable failures not retried because the budget was empty
+    uint64_t hedges;                // Duplicate requests sent by the hedging policy
+    uint64_t hedge_wins;            // Hedges that succeeded before the original request
+    uint64_t body_bytes_wire;       // Response body bytes received, compressed as sent
+    uint64_t body_bytes_decoded;    // The same bodies after content decoding
+    uint64_t coalesced;             // Requests answered by an identical one in flight (DP_FEATURE_SINGLE_FLIGHT)
+} dp_request_stats_t;
+
+/**
+ * @brief Settings for dp_response_cache_create(). Zero-initialize for an
+ * in-memory cache with the defaults.
+ */
+typedef struct {
+    size_t max_memory_bytes;    // Budget of the in-memory LRU tier (0 = 64 MiB)
+    long ttl_ms;                // Lifetime of a stored response (0 = until evicted)
+    const char* disk_path;      // Append-only file for the persistent tier; NULL = memory only
+    size_t max_disk_bytes;      // File size that triggers compaction (0 = 1 GiB)
+    bool any_temperature;       // Also cache requests whose temperature is not 0
+} dp_response_cache_options_t;
+
+/**
+ * @brief Counters of a response cache, see dp_response_cache_get_stats().
+ */
+typedef struct {
+    uint64_t memory_hits;
+    uint64_t disk_hits;             // Found on disk only, then promoted to memory
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t evictions;             // Dropped from memory to stay within max_memory_bytes
+    uint64_t expirations;           // Found but past their ttl_ms
+    size_t memory_entries;
+    size_t memory_bytes;
+    size_t disk_entries;            // Live records in the file
+    size_t disk_bytes;              // File size, including superseded records
+} dp_response_cache_stats_t;
+
+/**
+ * @brief Process-wide settings for dp_global_init(). Zero-initialize for the
+ * defaults.
+ */
+typedef struct {
+    const char* ca_bundle_path;     // PEM bundle trusted by every context; NULL = libcurl's built-in bundle
+    long ca_cache_seconds;          // Reuse a parsed CA store this long (0 = 24 hours, -1 = never)
+    bool disable_session_reuse;     // Full TLS handshake on every new connection
+    bool disable_alpn;              // Do not send ALPN; TLS connections stay on HTTP/1.1
+} dp_global_options_t;
+
 typedef struct {
     char* model_id;         
     char* display_name;     
@@ -201,6 +413,19 @@ typedef struct {
     char* error_message;
 } dp_file_t;
 
+/**
+ * @brief A Gemini cachedContents resource: a system prompt, tools and leading
+ * contents stored by the provider for reuse through dp_request_config_t.cached_content.
+ */
+typedef struct {
+    char* name;                 // "cachedContents/<id>"
+    char* model;                // "models/<model>"
+    char* expire_time;          // RFC 3339 timestamp
+    long total_token_count;     // Tokens the resource holds
+    long http_status_code;
+    char* error_message;
+} dp_cached_content_t;
+
 typedef struct {
     char* url;
     char* base64_json;
@@ -267,13 +492,46 @@ typedef int (*dp_anthropic_stream_callback_t)(const dp_anthropic_stream_event_t*
                                               void* user_data,
                                               const char* error_during_stream);  // Claude API callback (maintains "anthropic" naming for backwards compatibility)
 
+/**
+ * @brief Opaque per-provider client state.
+ *
+ * A context may be shared by any number of threads issuing requests at once.
+ * Finish configuring it (dp_set_share(), dp_set_ca_bundle(),
+ * dp_set_unix_socket(), dp_set_resolve(), dp_set_default_deadlines(),
+ * dp_set_retry_policy(), dp_set_hedge_policy(), dp_set_rate_limiter(),
+ * dp_set_circuit_breaker(), dp_set_response_cache())
+ * before the first request; dp_enable_advanced_features(),
+ * dp_set_stall_threshold(), dp_set_max_stream_event_size(),
+ * dp_set_connection_pool_limits() and dp_context_warmup() may be called at any time. dp_destroy_context() must not race with requests on the same
+ * context.
+ */
 typedef struct dp_context_s dp_context_t; 
 
+/**
+ * @brief Opaque cache of DNS results, TLS sessions and connections that can be
+ * shared by several contexts. See dp_share_create().
+ */
+typedef struct dp_share_s dp_share_t;
+
+/**
+ * @brief Opaque client-side rate limiter that can be shared by several
+ * contexts using the same quota. See dp_rate_limiter_create().
+ */
+typedef struct dp_rate_limiter_s dp_rate_limiter_t;
+
+/**
+ * @brief Opaque cache of completion responses that can be shared by several
+ * contexts. See dp_response_cache_create().
+ */
+typedef struct dp_response_cache_s dp_response_cache_t;
+
 /**
  * @brief Advanced feature flags that can be enabled.
  */
 typedef enum {
     DP_FEATURE_THINKING = 1,
+    DP_FEATURE_HTTP2 = 2,       // Negotiate HTTP/2 so engine requests to one host share connections
+    DP_FEATURE_SINGLE_FLIGHT = 3,   // Identical concurrent blocking requests share one transfer
     // Future features can be added here
 } dp_feature_t;
 
@@ -287,6 +545,29 @@ typedef enum {
  */
 void dp_enable_advanced_features(dp_context_t* context, ...);
 
+/**
+ * @brief Initializes libcurl and the library's TLS settings for the process.
+ *
+ * Call once at start-up, before any other thread uses the library. Without it
+ * libcurl initializes lazily inside the first request. The CA bundle path is
+ * resolved and checked once; afterwards each pooled handle keeps the parsed
+ * CA store, so new connections neither read nor parse the bundle again. The
+ * bundle replaces libcurl's CA directory while caching is on. Contexts with
+ * dp_set_ca_bundle() keep their own bundle. Calls nest: only the first
+ * call's options take effect and each needs a matching dp_global_cleanup().
+ *
+ * @param options Settings to use; NULL for the defaults.
+ * @return 0 on success, -1 if an option is invalid, the CA bundle cannot be
+ *         read or libcurl fails to initialize.
+ */
+int dp_global_init(const dp_global_options_t* options);
+
+/**
+ * @brief Undoes one dp_global_init(). The last call releases libcurl's global
+ * state; no context or engine may be in use by then.
+ */
+void dp_global_cleanup(void);
+
 dp_context_t* dp_init_context(dp_provider_type_t provider, 
                               const char* api_key,
                               const char* api_base_url);
@@ -299,6 +580,257 @@ dp_context_t* dp_init_context_with_app_info(dp_provider_type_t provider,
 
 void dp_destroy_context(dp_context_t* context);
 
+/**
+ * @brief Configures the context's pool of reusable connections.
+ *
+ * Each context keeps finished cURL handles (and their kept-alive connections)
+ * for reuse by later requests. The pool is safe to use from several threads;
+ * each thread also keeps its most recently released handle outside the limit
+ * below, so a thread issuing sequential requests skips the pool lock.
+ *
+ * @param max_idle_handles Maximum number of idle handles kept (0 disables pooling).
+ * @param max_idle_seconds Idle handles/connections older than this are discarded (0 = no limit).
+ * @param max_lifetime_seconds Connections are not reused past this age (0 = no limit).
+ * @return 0 on success, -1 on invalid arguments or allocation failure.
+ */
+int dp_set_connection_pool_limits(dp_context_t* context,
+                                  size_t max_idle_handles,
+                                  long max_idle_seconds,
+                                  long max_lifetime_seconds);
+
+/**
+ * @brief Opens up to num_connections kept-alive connections to the provider
+ * before they are needed, so the first requests after start-up skip DNS, TCP
+ * and TLS setup. Each connection is opened in parallel by a HEAD request to
+ * the model list endpoint and parked in the context's pool; at most the
+ * pool's max_idle_handles are kept. Blocking calls on any thread pick them
+ * up; engines and batches keep connections of their own. Safe to call while
+ * other threads use the context.
+ *
+ * @return Milliseconds the warm-up took, or -1 if context is NULL,
+ *         num_connections is 0, pooling is disabled or no connection could be
+ *         opened.
+ */
+long dp_context_warmup(dp_context_t* context, size_t num_connections);
+
+/**
+ * @brief Repeats dp_context_warmup() every interval_seconds on a background
+ * thread, so parked connections are used before the server or the pool's
+ * max_idle_seconds retires them. Pick an interval below both. Calling again
+ * replaces the schedule; dp_destroy_context() stops the thread. Must not be
+ * called concurrently with itself.
+ *
+ * @param interval_seconds Seconds between refreshes; 0 stops refreshing.
+ * @return 0 on success, -1 on invalid arguments or if the thread cannot be started.
+ */
+int dp_set_warmup_refresh(dp_context_t* context, size_t num_connections, long interval_seconds);
+
+/**
+ * @brief Sets how long a response may go without receiving data, once the
+ * first byte has arrived, before the gap is counted as a stall in
+ * dp_response_t.transport. Defaults to 200 ms.
+ *
+ * @return 0 on success, -1 if context is NULL or threshold_ms is not positive.
+ */
+int dp_set_stall_threshold(dp_context_t* context, long threshold_ms);
+
+/**
+ * @brief Sets the largest Server-Sent Event a stream may carry. A stream whose
+ * event grows past max_bytes is aborted with an error (DP_ERROR_API) instead
+ * of buffering without bound. Defaults to 16 MiB; applies to requests started
+ * afterwards.
+ *
+ * @return 0 on success, -1 if context is NULL or max_bytes is 0.
+ */
+int dp_set_max_stream_event_size(dp_context_t* context, size_t max_bytes);
+
+/**
+ * @brief Verifies servers against the PEM CA bundle at ca_bundle_path instead
+ * of libcurl's default (NULL restores the default). Useful for gateways with a
+ * private CA. Call before the context is used for any request.
+ *
+ * @return 0 on success, -1 if context is NULL or on allocation failure.
+ */
+int dp_set_ca_bundle(dp_context_t* context, const char* ca_bundle_path);
+
+/**
+ * @brief Sends every request of the context over the Unix domain socket at
+ * socket_path, such as a local egress proxy, instead of a TCP connection to
+ * the base URL's host (NULL restores TCP). The URL, Host header and TLS
+ * server name are unchanged. Call before the context is used for any request.
+ *
+ * @return 0 on success, -1 if context is NULL, the path is empty or too long
+ *         for a socket address, or on allocation failure.
+ */
+int dp_set_unix_socket(dp_context_t* context, const char* socket_path);
+
+/**
+ * @brief Pins host names to addresses for every request of the context,
+ * bypassing DNS while keeping the URL, Host header and TLS server name.
+ * Entries use libcurl's CURLOPT_RESOLVE form, "host:port:address[,address]",
+ * e.g. "api.openai.com:443:127.0.0.1" for a sidecar. Calling again replaces
+ * the list; no entries clears it. Call before the context is used for any
+ * request.
+ *
+ * @return 0 on success, -1 if context is NULL, an entry is NULL or malformed,
+ *         or on allocation failure.
+ */
+int dp_set_resolve(dp_context_t* context, const char* const* entries, size_t num_entries);
+
+/**
+ * @brief Sets deadlines applied to every request on the context, including
+ * model listing, token counting, file upload and image generation. A non-zero
+ * field in dp_request_config_t.deadlines overrides the matching default. Call
+ * before the context is used for any request.
+ *
+ * @param deadlines Limits to copy; NULL clears all defaults.
+ * @return 0 on success, -1 if context is NULL or any limit is negative.
+ */
+int dp_set_default_deadlines(dp_context_t* context, const dp_deadlines_t* deadlines);
+
+/**
+ * @brief Enables automatic retries for completions, streams (until the first
+ * byte reaches the callback), model listing and token counting. Waits use
+ * exponential backoff with full jitter unless the provider sent Retry-After or
+ * a rate-limit reset header. Retries are disabled by default. Call before the
+ * context is used for any request.
+ *
+ * @param policy Policy to copy; NULL disables retrying.
+ * @return 0 on success, -1 if context is NULL or the policy has negative values.
+ */
+int dp_set_retry_policy(dp_context_t* context, const dp_retry_policy_t* policy);
+
+/**
+ * @brief Enables hedged requests for dp_perform_completion(). Streams and
+ * engine requests are not hedged. Hedging is disabled by default. Call before
+ * the context is used for any request.
+ *
+ * @param policy Policy to copy; NULL disables hedging.
+ * @return 0 on success, -1 if context is NULL, a value is negative or the
+ *         percentile is above 100.
+ */
+int dp_set_hedge_policy(dp_context_t* context, const dp_hedge_policy_t* policy);
+
+/**
+ * @brief Enables a circuit breaker for completions, streams, engine and batch
+ * requests on the context. While it is open, requests fail at once with
+ * DP_ERROR_CIRCUIT_OPEN and retries stop. Disabled by default. Call before the
+ * context is used for any request.
+ *
+ * @param policy Policy to copy; NULL disables the breaker.
+ * @return 0 on success, -1 if context is NULL, a value is negative, the ratio
+ *         is above 1, the window is above 256 or neither threshold is set.
+ */
+int dp_set_circuit_breaker(dp_context_t* context, const dp_circuit_breaker_policy_t* policy);
+
+/**
+ * @brief Copies the state of the context's circuit breaker into stats_out. A
+ * breaker whose open time has elapsed is reported as half-open.
+ *
+ * @return 0 on success, -1 if either argument is NULL.
+ */
+int dp_get_circuit_breaker_stats(dp_context_t* context, dp_circuit_breaker_stats_t* stats_out);
+
+/**
+ * @brief Copies the context's cumulative request counters into stats_out.
+ *
+ * @return 0 on success, -1 if either argument is NULL.
+ */
+int dp_get_request_stats(const dp_context_t* context, dp_request_stats_t* stats_out);
+
+/**
+ * @brief Creates a cache of DNS results, TLS sessions and connections that
+ * can be attached to many contexts with dp_set_share().
+ * @return A new share, or NULL on failure.
+ */
+dp_share_t* dp_share_create(void);
+
+/**
+ * @brief Releases the caller's reference to a share. Contexts that still use
+ * it keep it alive until they are destroyed.
+ */
+void dp_share_destroy(dp_share_t* share);
+
+/**
+ * @brief Attaches a share to a context (NULL detaches). Call right after
+ * initialization, before the context is used for any request.
+ * @return 0 on success, -1 if context is NULL.
+ */
+int dp_set_share(dp_context_t* context, dp_share_t* share);
+
+/**
+ * @brief Creates a rate limiter with full buckets.
+ * @return A new limiter, or NULL if limits is NULL, a limit is negative or
+ *         allocation fails.
+ */
+dp_rate_limiter_t* dp_rate_limiter_create(const dp_rate_limits_t* limits);
+
+/**
+ * @brief Releases the caller's reference to a limiter. Contexts that still
+ * use it keep it alive until they are destroyed.
+ */
+void dp_rate_limiter_destroy(dp_rate_limiter_t* limiter);
+
+/**
+ * @brief Charges every completion on the context to limiter (NULL detaches):
+ * one request plus an estimate of its input tokens (from the message text)
+ * and output tokens (max_tokens) before it is sent, corrected from the
+ * reported usage afterwards. Call before the context is used for any request.
+ * @return 0 on success, -1 if context is NULL.
+ */
+int dp_set_rate_limiter(dp_context_t* context, dp_rate_limiter_t* limiter, dp_rate_limit_mode_t mode);
+
+/**
+ * @brief Charges one request and the given token estimates to limiter
+ * directly. A cost larger than a bucket waits for the bucket to be full and
+ * leaves it in debt.
+ * @param wait Sleep until there is capacity; otherwise charge nothing if
+ *             there is none.
+ * @return 0 once charged, the milliseconds until there will be capacity when
+ *         wait is false, or -1 if limiter is NULL or an estimate is negative.
+ */
+long dp_rate_limiter_acquire(dp_rate_limiter_t* limiter, long input_tokens, long output_tokens, bool wait);
+
+/**
+ * @brief Corrects a charge made with dp_rate_limiter_acquire() once the actual
+ * usage is known: the difference is returned to, or taken from, the buckets.
+ */
+void dp_rate_limiter_settle(dp_rate_limiter_t* limiter,
+                            long estimated_input_tokens, long estimated_output_tokens,
+                            long actual_input_tokens, long actual_output_tokens);
+
+/**
+ * @brief Creates a response cache. With a disk_path, the file is created if
+ * missing, its records are indexed and it is locked against other caches
+ * until the cache is destroyed.
+ * @param options Settings; NULL for an in-memory cache with the defaults.
+ * @return A new cache, or NULL if ttl_ms is negative, the file is locked,
+ *         not a cache file or cannot be opened, or allocation fails.
+ */
+dp_response_cache_t* dp_response_cache_create(const dp_response_cache_options_t* options);
+
+/**
+ * @brief Releases the caller's reference to a cache. Contexts that still use
+ * it keep it alive until they are destroyed.
+ */
+void dp_response_cache_destroy(dp_response_cache_t* cache);
+
+/**
+ * @brief Answers blocking completions and streams on the context from cache
+ * (NULL detaches) when the same provider endpoint, model and payload were
+ * answered successfully before. Only requests with temperature 0 are cached
+ * unless the cache allows any temperature. Call before the context is used
+ * for any request.
+ * @return 0 on success, -1 if context is NULL.
+ */
+int dp_set_response_cache(dp_context_t* context, dp_response_cache_t* cache);
+
+/**
+ * @brief Copies the cache's counters into stats_out.
+ * @return 0 on success, -1 if either argument is NULL.
+ */
+int dp_response_cache_get_stats(dp_response_cache_t* cache, dp_response_cache_stats_t* stats_out);
+
 int dp_perform_completion(dp_context_t* context,
                           const dp_request_config_t* request_config,
                           dp_response_t* response);
@@ -327,6 +859,173 @@ int dp_perform_anthropic_streaming_completion(dp_context_t* context,
                                               void* user_data,
                                               dp_response_t* response);  // Claude API streaming (maintains "anthropic" naming for backwards compatibility)
 
+/**
+ * @brief Asynchronous engine that drives many completions from one thread.
+ * See dp_engine_create().
+ */
+typedef struct dp_engine_s dp_engine_t;
+
+/**
+ * @brief Called once when a submitted request finishes. status is 0 on
+ * success and -1 on failure, exactly as the blocking call would return.
+ */
+typedef void (*dp_completion_callback_t)(dp_response_t* response, int status, void* user_data);
+
+// Socket interest reported to dp_engine_socket_callback_t
+#define DP_ENGINE_POLL_IN      1
+#define DP_ENGINE_POLL_OUT     2
+#define DP_ENGINE_POLL_REMOVE  4
+
+// Readiness passed to dp_engine_socket_action()
+#define DP_ENGINE_EVENT_IN     1
+#define DP_ENGINE_EVENT_OUT    2
+#define DP_ENGINE_EVENT_ERR    4
+#define DP_ENGINE_SOCKET_TIMEOUT (-1)
+
+typedef int (*dp_engine_socket_callback_t)(int fd, int what, void* user_data);
+typedef int (*dp_engine_timer_callback_t)(long timeout_ms, void* user_data);
+
+dp_engine_t* dp_engine_create(void);
+void dp_engine_destroy(dp_engine_t* engine);
+
+/**
+ * @brief Queues a non-streaming completion. request_config and response must
+ * stay valid until on_done has been called.
+ */
+int dp_submit_completion(dp_engine_t* engine,
+                         dp_context_t* context,
+                         const dp_request_config_t* request_config,
+                         dp_response_t* response,
+                         dp_completion_callback_t on_done,
+                         void* user_data);
+
+/**
+ * @brief Queues a streaming completion. callback receives tokens and on_done
+ * the final status; both get user_data.
+ */
+int dp_submit_streaming_completion(dp_engine_t* engine,
+                                   dp_context_t* context,
+                                   const dp_request_config_t* request_config,
+                                   dp_stream_callback_t callback,
+                                   dp_response_t* response,
+                                   dp_completion_callback_t on_done,
+                                   void* user_data);
+
+/**
+ * @brief Makes progress on all requests, waiting up to timeout_ms for
+ * activity. Stores the number of unfinished requests in in_flight_out.
+ */
+int dp_engine_perform(dp_engine_t* engine, int timeout_ms, size_t* in_flight_out);
+
+/**
+ * @brief Hands socket and timer management to an external event loop
+ * (epoll, libuv, ...). Set before submitting requests, then drive the engine
+ * with dp_engine_socket_action() instead of dp_engine_perform().
+ */
+int dp_engine_set_event_hooks(dp_engine_t* engine,
+                              dp_engine_socket_callback_t socket_callback,
+                              dp_engine_timer_callback_t timer_callback,
+                              void* user_data);
+
+/**
+ * @brief Reports readiness on fd (DP_ENGINE_EVENT_* mask), or a timer expiry
+ * when fd is DP_ENGINE_SOCKET_TIMEOUT.
+ */
+int dp_engine_socket_action(dp_engine_t* engine, int fd, int events, size_t* in_flight_out);
+
+/**
+ * @brief Caps the connections the engine opens to any one host (0 = no
+ * limit). With DP_FEATURE_HTTP2, additional requests multiplex as streams
+ * over these connections instead of opening new ones.
+ */
+int dp_engine_set_max_host_connections(dp_engine_t* engine, long max_connections);
+
+/**
+ * @brief Per-item callback for dp_perform_completions_batch(); index is the
+ * position of the item in the configs and responses arrays.
+ */
+typedef void (*dp_batch_item_callback_t)(size_t index, dp_response_t* response, int status, void* user_data);
+
+/**
+ * @brief Runs n non-streaming completions with at most max_concurrency in
+ * flight (0 selects a default) and blocks until all have finished.
+ * responses must have room for n entries. Returns 0 if every item succeeded.
+ */
+int dp_perform_completions_batch(dp_context_t* context,
+                                 const dp_request_config_t* configs,
+                                 size_t n,
+                                 size_t max_concurrency,
+                                 dp_response_t* responses,
+                                 dp_batch_item_callback_t on_item,
+                                 void* user_data);
+
+/**
+ * @brief Routes requests across several contexts (providers, regions or
+ * keys), preferring backends with low observed latency, few errors and little
+ * load, and failing over when one errors. Safe to use from many threads at
+ * once. See dp_router_create().
+ */
+typedef struct dp_router_s dp_router_t;
+
+/**
+ * @brief Maps a requested model name to the name a backend knows it by.
+ * requested NULL matches any model.
+ */
+typedef struct {
+    const char* requested;
+    const char* model;
+} dp_model_mapping_t;
+
+typedef struct {
+    dp_context_t* context;              // Not owned; must outlive the router
+    double weight;                      // Relative share of traffic (0 = 1.0)
+    const dp_model_mapping_t* models;   // First match wins; with mappings, unmatched models are not sent here
+    size_t num_models;                  // 0 = send every model unchanged
+} dp_router_backend_t;
+
+typedef struct {
+    double latency_ms;      // EWMA of completion time (time to first token when streaming); 0 before the first success
+    double error_rate;      // EWMA of failed attempts, 0..1
+    long in_flight;
+    uint64_t requests;      // Attempts sent to this backend, including failovers
+    uint64_t failures;
+} dp_router_backend_stats_t;
+
+/**
+ * @brief Creates a router over n backends. The backends array and mappings
+ * are copied; the contexts are not.
+ * @return A new router, or NULL on invalid arguments or allocation failure.
+ */
+dp_router_t* dp_router_create(const dp_router_backend_t* backends, size_t n);
+void dp_router_destroy(dp_router_t* router);
+
+/**
+ * @brief Same as the single-context calls, on a backend the router picks.
+ * A failed attempt moves on to another backend unless the caller cancelled
+ * or a stream already delivered output; the response is the last attempt's.
+ */
+int dp_router_perform_completion(dp_router_t* router,
+                                 const dp_request_config_t* request_config,
+                                 dp_response_t* response);
+
+int dp_router_perform_streaming_completion(dp_router_t* router,
+                                           const dp_request_config_t* request_config,
+                                           dp_stream_callback_t callback,
+                                           void* user_data,
+                                           dp_response_t* response);
+
+int dp_router_perform_detailed_streaming_completion(dp_router_t* router,
+                                                    const dp_request_config_t* request_config,
+                                                    dp_anthropic_stream_callback_t callback,
+                                                    void* user_data,
+                                                    dp_response_t* response);
+
+/**
+ * @brief Copies the router's view of backend index into stats_out.
+ * @return 0 on success, -1 if index is out of range.
+ */
+int dp_router_get_backend_stats(dp_router_t* router, size_t index, dp_router_backend_stats_t* stats_out);
+
 int dp_list_models(dp_context_t* context, dp_model_list_t** model_list_out);
 
 int dp_count_tokens(dp_context_t* context,
@@ -357,6 +1056,24 @@ int dp_deserialize_messages_from_file(const char* path, dp_message_t** messages_
 int dp_upload_file(dp_context_t* context, const char* file_path, const char* mime_type, dp_file_t** file_out);
 void dp_free_file(dp_file_t* file);
 
+/**
+ * @brief Stores the model, system prompt, tools, tool choice and messages of
+ * request_config as a Gemini cachedContents resource. Later requests name it
+ * in dp_request_config_t.cached_content instead of resending that content.
+ * @param ttl_seconds Lifetime; 0 leaves the provider default (one hour).
+ * @param cached_content_out Receives the resource, or the error; free with dp_free_cached_content().
+ * @return 0 on success, -1 on failure or for other providers.
+ */
+int dp_create_cached_content(dp_context_t* context, const dp_request_config_t* request_config, long ttl_seconds,
+                             dp_cached_content_t** cached_content_out);
+
+/**
+ * @brief Deletes a Gemini cachedContents resource before it expires.
+ * @return 0 on success, -1 on failure.
+ */
+int dp_delete_cached_content(dp_context_t* context, const char* name);
+void dp_free_cached_content(dp_cached_content_t* cached_content);
+
 int dp_generate_image(dp_context_t* context, const dp_image_generation_config_t* config, dp_image_generation_response_t* response);
 void dp_free_image_generation_response(dp_image_generation_response_t* response);
 
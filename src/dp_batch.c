@@ -0,0 +1,132 @@
+#define _GNU_SOURCE
+#include "disasterparty.h"
+#include "dp_private.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Batch completions: an engine runs a sliding window of requests. Each
+// finished request submits the next pending item, so at most max_concurrency
+// transfers are in flight and connections are reused across items through
+// the engine's connection cache. The engine's multi handle comes from the
+// context's pool, so later batches reuse those connections too.
+
+typedef struct {
+    dp_engine_t* engine;
+    dp_context_t* context;
+    const dp_request_config_t* configs;
+    dp_response_t* responses;
+    size_t n;
+    size_t next;      // Next item to submit
+    size_t failures;
+    dp_batch_item_callback_t on_item;
+    void* user_data;
+} dp_batch_t;
+
+typedef struct {
+    dp_batch_t* batch;
+    size_t index;
+} dp_batch_item_t;
+
+static void dpinternal_batch_submit_next(dp_batch_t* batch);
+
+static void dpinternal_batch_item_done(dp_batch_t* batch, size_t index, int status) {
+    if (status != 0) batch->failures++;
+    if (batch->on_item) batch->on_item(index, &batch->responses[index], status, batch->user_data);
+}
+
+// Reports an item that never reached the engine.
+static void dpinternal_batch_fail_item(dp_batch_t* batch, size_t index, const char* message) {
+    dp_response_t* response = &batch->responses[index];
+    memset(response, 0, sizeof(*response));
+    response->error_message = dpinternal_strdup(message);
+    response->error_class = DP_ERROR_OTHER;
+    dpinternal_batch_item_done(batch, index, -1);
+}
+
+static void dpinternal_batch_on_done(dp_response_t* response, int status, void* user_data) {
+    (void)response;
+    dp_batch_item_t* item = (dp_batch_item_t*)user_data;
+    dp_batch_t* batch = item->batch;
+    size_t index = item->index;
+    free(item);
+    dpinternal_batch_item_done(batch, index, status);
+    dpinternal_batch_submit_next(batch);
+}
+
+// Submits the next pending item. Items that cannot even be queued (invalid
+// config, allocation failure) are reported right away and the next one is tried.
+static void dpinternal_batch_submit_next(dp_batch_t* batch) {
+    while (batch->next < batch->n) {
+        size_t index = batch->next++;
+        dp_response_t* response = &batch->responses[index];
+        dp_batch_item_t* item = malloc(sizeof(dp_batch_item_t));
+        if (!item) {
+            dpinternal_batch_fail_item(batch, index, "Failed to allocate batch item.");
+            continue;
+        }
+        item->batch = batch;
+        item->index = index;
+        memset(response, 0, sizeof(*response));
+        if (dp_submit_completion(batch->engine, batch->context, &batch->configs[index], response,
+                                 dpinternal_batch_on_done, item) == 0) {
+            return;
+        }
+        free(item);
+        dpinternal_batch_item_done(batch, index, -1);
+    }
+}
+
+int dp_perform_completions_batch(dp_context_t* context,
+                                 const dp_request_config_t* configs,
+                                 size_t n,
+                                 size_t max_concurrency,
+                                 dp_response_t* responses,
+                                 dp_batch_item_callback_t on_item,
+                                 void* user_data) {
+    if (!context || (n > 0 && (!configs || !responses))) {
+        return -1;
+    }
+    if (n == 0) return 0;
+    if (max_concurrency == 0) max_concurrency = DP_BATCH_DEFAULT_MAX_CONCURRENCY;
+
+    dp_batch_t batch = {
+        .context = context,
+        .configs = configs,
+        .responses = responses,
+        .n = n,
+        .on_item = on_item,
+        .user_data = user_data
+    };
+    batch.engine = dpinternal_engine_create_pooled(context);
+    if (!batch.engine) {
+        for (size_t i = 0; i < n; ++i) {
+            dpinternal_batch_fail_item(&batch, i, "Failed to create engine for batch.");
+        }
+        return -1;
+    }
+
+    for (size_t i = 0; i < max_concurrency && batch.next < n; ++i) {
+        dpinternal_batch_submit_next(&batch);
+    }
+
+    size_t in_flight = 0;
+    do {
+        if (dp_engine_perform(batch.engine, DP_BATCH_POLL_TIMEOUT_MS, &in_flight) != 0) {
+            // Do not hand a failed multi handle to the next batch
+            batch.engine->multi_pool = NULL;
+            break;
+        }
+    } while (in_flight > 0);
+
+    // Only reached with requests outstanding if the multi interface failed. Items
+    // not yet submitted fail here; those in flight are cancelled (and reported)
+    // by dp_engine_destroy(), and nothing new is submitted from their callbacks.
+    size_t pending = batch.next;
+    batch.next = n;
+    for (size_t i = pending; i < n; ++i) {
+        dpinternal_batch_fail_item(&batch, i, "Batch engine failed before the item was started.");
+    }
+    dp_engine_destroy(batch.engine);
+
+    return batch.failures == 0 ? 0 : -1;
+}
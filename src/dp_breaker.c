@@ -0,0 +1,193 @@
+#define _GNU_SOURCE
+#include "disasterparty.h"
+#include "dp_private.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Circuit breaker per context. Closed, it counts failed attempts in a row and
+// over a sliding window of recent attempts; crossing either threshold opens
+// it. Open, requests fail before they are sent, so an outage costs callers
+// nothing instead of a connect timeout or a 5xx each. Once open_ms has passed
+// it is half-open: one probe at a time is let through, and success_threshold
+// successful probes in a row close it while a failed probe opens it again.
+
+bool dpinternal_breaker_init(dp_breaker_t* breaker) {
+    memset(breaker, 0, sizeof(*breaker));
+    return pthread_mutex_init(&breaker->lock, NULL) == 0;
+}
+
+void dpinternal_breaker_destroy(dp_breaker_t* breaker) {
+    pthread_mutex_destroy(&breaker->lock);
+}
+
+// Call with the lock held
+static void dpinternal_breaker_reset_counts(dp_breaker_t* breaker) {
+    breaker->consecutive_failures = 0;
+    breaker->outcome_next = 0;
+    breaker->outcome_count = 0;
+    breaker->window_failures = 0;
+    breaker->probe_in_flight = false;
+    breaker->probe_successes = 0;
+}
+
+// Call with the lock held
+static void dpinternal_breaker_open(dp_breaker_t* breaker, uint64_t now) {
+    breaker->state = DP_CIRCUIT_OPEN;
+    breaker->opened_at_ms = now;
+    breaker->times_opened++;
+    dpinternal_breaker_reset_counts(breaker);
+}
+
+// Moves an open breaker whose time is up to half-open. Call with the lock held.
+static void dpinternal_breaker_advance(dp_breaker_t* breaker, uint64_t now) {
+    if (breaker->state == DP_CIRCUIT_OPEN && now - breaker->opened_at_ms >= (uint64_t)breaker->policy.open_ms) {
+        breaker->state = DP_CIRCUIT_HALF_OPEN;
+        breaker->probe_in_flight = false;
+        breaker->probe_successes = 0;
+    }
+}
+
+int dp_set_circuit_breaker(dp_context_t* context, const dp_circuit_breaker_policy_t* policy) {
+    if (!context) return -1;
+    dp_breaker_t* breaker = &context->breaker;
+    if (policy && (policy->failure_threshold < 0 || policy->failure_ratio < 0 || policy->failure_ratio > 1 ||
+                   policy->window < 0 || policy->window > DP_BREAKER_MAX_WINDOW || policy->open_ms < 0 ||
+                   policy->success_threshold < 0 ||
+                   (policy->failure_threshold == 0 && policy->failure_ratio == 0))) {
+        return -1;
+    }
+    pthread_mutex_lock(&breaker->lock);
+    breaker->enabled = policy != NULL;
+    memset(&breaker->policy, 0, sizeof(breaker->policy));
+    if (policy) {
+        breaker->policy = *policy;
+        if (breaker->policy.window == 0) breaker->policy.window = DP_BREAKER_DEFAULT_WINDOW;
+        if (breaker->policy.open_ms == 0) breaker->policy.open_ms = DP_BREAKER_DEFAULT_OPEN_MS;
+        if (breaker->policy.success_threshold == 0) breaker->policy.success_threshold = 1;
+    }
+    breaker->state = DP_CIRCUIT_CLOSED;
+    dpinternal_breaker_reset_counts(breaker);
+    pthread_mutex_unlock(&breaker->lock);
+    return 0;
+}
+
+int dp_get_circuit_breaker_stats(dp_context_t* context, dp_circuit_breaker_stats_t* stats_out) {
+    if (!context || !stats_out) return -1;
+    memset(stats_out, 0, sizeof(*stats_out));
+    dp_breaker_t* breaker = &context->breaker;
+    pthread_mutex_lock(&breaker->lock);
+    uint64_t now = dpinternal_monotonic_ms();
+    if (breaker->enabled) dpinternal_breaker_advance(breaker, now);
+    stats_out->state = breaker->state;
+    stats_out->consecutive_failures = breaker->consecutive_failures;
+    if (breaker->outcome_count > 0) stats_out->failure_ratio = (double)breaker->window_failures / breaker->outcome_count;
+    if (breaker->state == DP_CIRCUIT_OPEN) {
+        stats_out->open_remaining_ms = (long)(breaker->opened_at_ms + (uint64_t)breaker->policy.open_ms - now);
+    }
+    stats_out->times_opened = breaker->times_opened;
+    stats_out->rejected = breaker->rejected;
+    pthread_mutex_unlock(&breaker->lock);
+    return 0;
+}
+
+// Lets a transfer through, as a probe if the breaker is half-open, or fails
+// its response with DP_ERROR_CIRCUIT_OPEN and returns -1.
+int dpinternal_breaker_admit(dp_transfer_t* t) {
+    dp_breaker_t* breaker = &t->context->breaker;
+    if (!breaker->enabled) return 0;
+    pthread_mutex_lock(&breaker->lock);
+    uint64_t now = dpinternal_monotonic_ms();
+    dpinternal_breaker_advance(breaker, now);
+    long open_remaining_ms = -1;
+    if (breaker->state == DP_CIRCUIT_OPEN) {
+        open_remaining_ms = (long)(breaker->opened_at_ms + (uint64_t)breaker->policy.open_ms - now);
+    } else if (breaker->state == DP_CIRCUIT_HALF_OPEN) {
+        if (breaker->probe_in_flight) {
+            open_remaining_ms = 0;
+        } else {
+            breaker->probe_in_flight = true;
+            t->breaker_probe = true;
+        }
+    }
+    if (open_remaining_ms >= 0) breaker->rejected++;
+    pthread_mutex_unlock(&breaker->lock);
+
+    if (open_remaining_ms < 0) return 0;
+    if (open_remaining_ms > 0) {
+        dpinternal_safe_asprintf(&t->response->error_message,
+                                 "Circuit breaker open after repeated failures; the next probe is allowed in %ld ms.", open_remaining_ms);
+    } else {
+        t->response->error_message = dpinternal_strdup("Circuit breaker half-open; a probe request is already in flight.");
+    }
+    t->response->error_class = DP_ERROR_CIRCUIT_OPEN;
+    return -1;
+}
+
+// Whether a finished attempt says something is wrong with the endpoint. Rate
+// limiting (429) is about the caller's quota, not the endpoint's health.
+static bool dpinternal_breaker_is_failure(CURLcode res, const dp_response_t* response) {
+    if (!response->error_message) return false;
+    if (response->error_class == DP_ERROR_API && response->http_status_code == 429) return false;
+    return dpinternal_retry_is_transient(res, response->http_status_code, response->error_class, response->deadline_missed);
+}
+
+// Counts a finished attempt
+void dpinternal_breaker_record(dp_transfer_t* t, CURLcode res) {
+    dp_breaker_t* breaker = &t->context->breaker;
+    if (!breaker->enabled) return;
+    bool failed = dpinternal_breaker_is_failure(res, t->response);
+    const dp_circuit_breaker_policy_t* policy = &breaker->policy;
+    pthread_mutex_lock(&breaker->lock);
+    uint64_t now = dpinternal_monotonic_ms();
+    if (t->breaker_probe) {
+        t->breaker_probe = false;
+        breaker->probe_in_flight = false;
+        if (breaker->state == DP_CIRCUIT_HALF_OPEN) {
+            if (failed) {
+                dpinternal_breaker_open(breaker, now);
+            } else if (++breaker->probe_successes >= policy->success_threshold) {
+                breaker->state = DP_CIRCUIT_CLOSED;
+                dpinternal_breaker_reset_counts(breaker);
+            }
+        }
+    } else if (breaker->state == DP_CIRCUIT_CLOSED) {
+        // Attempts still in flight when the breaker opened are not counted
+        breaker->consecutive_failures = failed ? breaker->consecutive_failures + 1 : 0;
+        if (breaker->outcome_count == policy->window) {
+            if (breaker->outcomes[breaker->outcome_next]) breaker->window_failures--;
+        } else {
+            breaker->outcome_count++;
+        }
+        breaker->outcomes[breaker->outcome_next] = failed;
+        if (failed) breaker->window_failures++;
+        breaker->outcome_next = (breaker->outcome_next + 1) % policy->window;
+
+        if ((policy->failure_threshold > 0 && breaker->consecutive_failures >= policy->failure_threshold) ||
+            (policy->failure_ratio > 0 && breaker->outcome_count == policy->window &&
+             breaker->window_failures >= policy->failure_ratio * policy->window)) {
+            dpinternal_breaker_open(breaker, now);
+        }
+    }
+    pthread_mutex_unlock(&breaker->lock);
+}
+
+// Retrying against an endpoint the breaker has given up on would defeat it
+bool dpinternal_breaker_allows_retry(dp_context_t* context) {
+    dp_breaker_t* breaker = &context->breaker;
+    if (!breaker->enabled) return true;
+    pthread_mutex_lock(&breaker->lock);
+    bool closed = breaker->state == DP_CIRCUIT_CLOSED;
+    pthread_mutex_unlock(&breaker->lock);
+    return closed;
+}
+
+// Frees the probe slot of a transfer that ended without a verdict (refused by
+// the rate limiter, cancelled), so the next request can probe instead.
+void dpinternal_breaker_abandon(dp_transfer_t* t) {
+    if (!t->breaker_probe) return;
+    t->breaker_probe = false;
+    dp_breaker_t* breaker = &t->context->breaker;
+    pthread_mutex_lock(&breaker->lock);
+    breaker->probe_in_flight = false;
+    pthread_mutex_unlock(&breaker->lock);
+}
@@ -0,0 +1,908 @@
+#define _GNU_SOURCE
+#include "disasterparty.h"
+#include "dp_private.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// Response cache. A request is keyed on its kind, provider endpoint, model and
+// built JSON payload, the same bytes that would be sent. Successful responses
+// are stored as JSON holding the response fields and, for streams, every
+// callback the caller received, so a hit replays the stream through the
+// caller's own callback.
+//
+// The memory tier is a hash table with an LRU list, bounded by the bytes its
+// entries hold. The optional disk tier is an append-only file of checksummed
+// records, mapped read-only and indexed by a second hash table; a newer record
+// for a key supersedes older ones. When the file would outgrow max_disk_bytes,
+// the live records are rewritten to a new file, oldest dropped first until it
+// is at most half full, which is renamed over the old one. Expiry times are
+// wall-clock so that they hold across processes.
+
+#define DP_CACHE_DEFAULT_MEMORY_BYTES ((size_t)64 << 20)
+#define DP_CACHE_DEFAULT_DISK_BYTES ((size_t)1 << 30)
+#define DP_CACHE_RECORD_MAGIC 0x43525044u   // "DPRC"
+#define DP_CACHE_MIN_BUCKETS 64
+
+static const char dp_cache_file_magic[8] = { 'D', 'P', 'C', 'A', 'C', 'H', 'E', '1' };
+
+// On-disk record header, followed by the key, the value and padding to 8 bytes
+typedef struct {
+    uint32_t magic;
+    uint32_t key_length;
+    uint32_t value_length;
+    uint32_t checksum;          // Low half of the hash of key and value
+    int64_t expires_at_ms;      // Wall clock; 0 = never
+    uint64_t hash;              // Of the key
+} dp_cache_record_t;
+
+typedef struct dp_cache_entry_s {
+    struct dp_cache_entry_s* bucket_next;
+    struct dp_cache_entry_s* lru_prev;      // Memory tier, most recently used first
+    struct dp_cache_entry_s* lru_next;
+    uint64_t hash;
+    int64_t expires_at_ms;
+    size_t key_length;
+    size_t value_length;
+    char* key;                              // Memory tier: owned copies
+    char* value;
+    size_t offset;                          // Disk tier: the record's offset in the file
+} dp_cache_entry_t;
+
+typedef struct {
+    dp_cache_entry_t** buckets;
+    size_t num_buckets;                     // A power of two
+    size_t count;
+} dp_cache_table_t;
+
+struct dp_response_cache_s {
+    pthread_mutex_t lock;                   // Guards everything below
+    int refcount;                           // One for the creator plus one per attached context
+    size_t max_memory_bytes;
+    long ttl_ms;
+    bool any_temperature;
+    dp_cache_table_t memory;
+    dp_cache_entry_t* lru_head;
+    dp_cache_entry_t* lru_tail;
+    size_t memory_bytes;
+    char* disk_path;                        // NULL without a disk tier
+    int fd;                                 // Holds an exclusive flock() on the file
+    size_t max_disk_bytes;
+    size_t disk_length;                     // File size; records are appended here
+    char* map;                              // Read-only mapping of the whole file and room to grow
+    size_t map_length;                      // At least disk_length
+    dp_cache_table_t disk;
+    dp_response_cache_stats_t stats;        // Counters; sizes are filled in when read
+};
+
+// Stream callbacks delivered by a transfer that missed the cache
+typedef struct dp_cache_recording_s {
+    cJSON* events;
+    bool incomplete;                        // Stopped early, failed, or not fully recorded
+    dp_stream_callback_t callback;          // The wrapped callback and its data
+    dp_detailed_stream_callback_t detailed_callback;
+    void* user_data;
+} dp_cache_recording_t;
+
+static int64_t dpinternal_cache_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool dpinternal_cache_expired(const dp_cache_entry_t* entry, int64_t now) {
+    return entry->expires_at_ms != 0 && entry->expires_at_ms <= now;
+}
+
+static size_t dpinternal_cache_record_length(size_t key_length, size_t value_length) {
+    return (sizeof(dp_cache_record_t) + key_length + value_length + 7) & ~(size_t)7;
+}
+
+static uint32_t dpinternal_cache_checksum(const char* key, size_t key_length, const char* value, size_t value_length) {
+    return (uint32_t)dpinternal_hash_bytes(dpinternal_hash_bytes(DP_HASH_SEED, key, key_length), value, value_length);
+}
+
+// Memory entries own their key and value; disk entries point into the mapping
+static const char* dpinternal_cache_entry_key(const dp_response_cache_t* cache, const dp_cache_entry_t* entry) {
+    return entry->key ? entry->key : cache->map + entry->offset + sizeof(dp_cache_record_t);
+}
+
+static const char* dpinternal_cache_entry_value(const dp_response_cache_t* cache, const dp_cache_entry_t* entry) {
+    return entry->value ? entry->value : cache->map + entry->offset + sizeof(dp_cache_record_t) + entry->key_length;
+}
+
+static char* dpinternal_cache_copy(const char* data, size_t length) {
+    char* copy = malloc(length + 1);
+    if (!copy) return NULL;
+    memcpy(copy, data, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+// --- Hash tables ---
+
+static bool dpinternal_cache_table_init(dp_cache_table_t* table) {
+    table->buckets = calloc(DP_CACHE_MIN_BUCKETS, sizeof(dp_cache_entry_t*));
+    table->num_buckets = table->buckets ? DP_CACHE_MIN_BUCKETS : 0;
+    table->count = 0;
+    return table->buckets != NULL;
+}
+
+static dp_cache_entry_t* dpinternal_cache_table_find(const dp_response_cache_t* cache, const dp_cache_table_t* table,
+                                                     uint64_t hash, const char* key, size_t key_length) {
+    if (table->num_buckets == 0) return NULL;
+    for (dp_cache_entry_t* entry = table->buckets[hash & (table->num_buckets - 1)]; entry; entry = entry->bucket_next) {
+        if (entry->hash == hash && entry->key_length == key_length &&
+            memcmp(dpinternal_cache_entry_key(cache, entry), key, key_length) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Growing is best effort: without memory for more buckets the chains get longer
+static void dpinternal_cache_table_insert(dp_cache_table_t* table, dp_cache_entry_t* entry) {
+    if (table->count >= table->num_buckets) {
+        size_t num_buckets = table->num_buckets * 2;
+        dp_cache_entry_t** buckets = calloc(num_buckets, sizeof(dp_cache_entry_t*));
+        if (buckets) {
+            for (size_t i = 0; i < table->num_buckets; ++i) {
+                dp_cache_entry_t* moved = table->buckets[i];
+                while (moved) {
+                    dp_cache_entry_t* next = moved->bucket_next;
+                    size_t bucket = moved->hash & (num_buckets - 1);
+                    moved->bucket_next = buckets[bucket];
+                    buckets[bucket] = moved;
+                    moved = next;
+                }
+            }
+            free(table->buckets);
+            table->buckets = buckets;
+            table->num_buckets = num_buckets;
+        }
+    }
+    size_t bucket = entry->hash & (table->num_buckets - 1);
+    entry->bucket_next = table->buckets[bucket];
+    table->buckets[bucket] = entry;
+    table->count++;
+}
+
+static void dpinternal_cache_table_remove(dp_cache_table_t* table, dp_cache_entry_t* entry) {
+    for (dp_cache_entry_t** link = &table->buckets[entry->hash & (table->num_buckets - 1)]; *link; link = &(*link)->bucket_next) {
+        if (*link == entry) {
+            *link = entry->bucket_next;
+            table->count--;
+            return;
+        }
+    }
+}
+
+static void dpinternal_cache_table_free(dp_cache_table_t* table) {
+    for (size_t i = 0; i < table->num_buckets; ++i) {
+        dp_cache_entry_t* entry = table->buckets[i];
+        while (entry) {
+            dp_cache_entry_t* next = entry->bucket_next;
+            free(entry->key);
+            free(entry->value);
+            free(entry);
+            entry = next;
+        }
+    }
+    free(table->buckets);
+    table->buckets = NULL;
+    table->num_buckets = 0;
+    table->count = 0;
+}
+
+// --- Memory tier; call with the lock held ---
+
+static size_t dpinternal_cache_memory_cost(size_t key_length, size_t value_length) {
+    return sizeof(dp_cache_entry_t) + key_length + value_length;
+}
+
+static void dpinternal_cache_lru_unlink(dp_response_cache_t* cache, dp_cache_entry_t* entry) {
+    if (entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next; else cache->lru_head = entry->lru_next;
+    if (entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev; else cache->lru_tail = entry->lru_prev;
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void dpinternal_cache_lru_push(dp_response_cache_t* cache, dp_cache_entry_t* entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head) cache->lru_head->lru_prev = entry; else cache->lru_tail = entry;
+    cache->lru_head = entry;
+}
+
+static void dpinternal_cache_memory_remove(dp_response_cache_t* cache, dp_cache_entry_t* entry) {
+    dpinternal_cache_table_remove(&cache->memory, entry);
+    dpinternal_cache_lru_unlink(cache, entry);
+    cache->memory_bytes -= dpinternal_cache_memory_cost(entry->key_length, entry->value_length);
+    free(entry->key);
+    free(entry->value);
+    free(entry);
+}
+
+// Copies a response into the memory tier, evicting the least recently used
+// entries to stay within the budget. A response larger than the whole budget
+// is not kept.
+static void dpinternal_cache_memory_put(dp_response_cache_t* cache, uint64_t hash, const char* key, size_t key_length,
+                                        const char* value, size_t value_length, int64_t expires_at_ms) {
+    dp_cache_entry_t* old = dpinternal_cache_table_find(cache, &cache->memory, hash, key, key_length);
+    if (old) dpinternal_cache_memory_remove(cache, old);
+    size_t cost = dpinternal_cache_memory_cost(key_length, value_length);
+    if (cost > cache->max_memory_bytes) return;
+
+    dp_cache_entry_t* entry = calloc(1, sizeof(dp_cache_entry_t));
+    if (entry) {
+        entry->key = dpinternal_cache_copy(key, key_length);
+        entry->value = dpinternal_cache_copy(value, value_length);
+    }
+    if (!entry || !entry->key || !entry->value) {
+        if (entry) {
+            free(entry->key);
+            free(entry->value);
+        }
+        free(entry);
+        return;
+    }
+    entry->hash = hash;
+    entry->expires_at_ms = expires_at_ms;
+    entry->key_length = key_length;
+    entry->value_length = value_length;
+    dpinternal_cache_table_insert(&cache->memory, entry);
+    dpinternal_cache_lru_push(cache, entry);
+    cache->memory_bytes += cost;
+    while (cache->memory_bytes > cache->max_memory_bytes) {
+        dpinternal_cache_memory_remove(cache, cache->lru_tail);
+        cache->stats.evictions++;
+    }
+}
+
+// --- Disk tier; call with the lock held ---
+
+// Drops the disk tier; the cache goes on in memory
+static void dpinternal_cache_disk_close(dp_response_cache_t* cache) {
+    dpinternal_cache_table_free(&cache->disk);
+    if (cache->map) munmap(cache->map, cache->map_length);
+    cache->map = NULL;
+    cache->map_length = 0;
+    if (cache->fd >= 0) close(cache->fd);   // Also releases the lock
+    cache->fd = -1;
+    free(cache->disk_path);
+    cache->disk_path = NULL;
+}
+
+// A mapping length twice base, but no more than max_disk_bytes and no less
+// than the file.
+static size_t dpinternal_cache_map_target(const dp_response_cache_t* cache, size_t base) {
+    size_t length = base * 2;
+    if (length > cache->max_disk_bytes) length = cache->max_disk_bytes;
+    return length < cache->disk_length ? cache->disk_length : length;
+}
+
+// Maps the file afresh, as after opening or compacting it. The mapping may
+// reach past the end of the file; only bytes below disk_length are read, and
+// records appended with pwrite() show up in it through the page cache.
+static bool dpinternal_cache_remap(dp_response_cache_t* cache) {
+    if (cache->map) munmap(cache->map, cache->map_length);
+    cache->map = NULL;
+    size_t length = dpinternal_cache_map_target(cache, cache->disk_length);
+    cache->map_length = 0;
+    void* map = mmap(NULL, length, PROT_READ, MAP_SHARED, cache->fd, 0);
+    if (map == MAP_FAILED) return false;
+    cache->map = map;
+    cache->map_length = length;
+    return true;
+}
+
+// Makes the mapping cover disk_length after an append. Growing it
+// geometrically means most appends need no new mapping at all.
+static bool dpinternal_cache_map_grow(dp_response_cache_t* cache) {
+    if (cache->map && cache->disk_length <= cache->map_length) return true;
+#ifdef MREMAP_MAYMOVE
+    if (cache->map) {
+        size_t length = dpinternal_cache_map_target(cache, cache->map_length);
+        void* map = mremap(cache->map, cache->map_length, length, MREMAP_MAYMOVE);
+        if (map == MAP_FAILED) return false;
+        cache->map = map;
+        cache->map_length = length;
+        return true;
+    }
+#endif
+    return dpinternal_cache_remap(cache);
+}
+
+static bool dpinternal_cache_write_all(int fd, const char* data, size_t length, size_t offset) {
+    while (length > 0) {
+        ssize_t written = pwrite(fd, data, length, (off_t)offset);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        length -= (size_t)written;
+        offset += (size_t)written;
+    }
+    return true;
+}
+
+// Points the index at a mapped record, superseding an older record of the same key
+static void dpinternal_cache_disk_index(dp_response_cache_t* cache, const dp_cache_record_t* record, size_t offset) {
+    const char* key = cache->map + offset + sizeof(dp_cache_record_t);
+    dp_cache_entry_t* entry = dpinternal_cache_table_find(cache, &cache->disk, record->hash, key, record->key_length);
+    if (!entry) {
+        entry = calloc(1, sizeof(dp_cache_entry_t));
+        if (!entry) return;
+        entry->hash = record->hash;
+        entry->key_length = record->key_length;
+        dpinternal_cache_table_insert(&cache->disk, entry);
+    }
+    entry->offset = offset;
+    entry->value_length = record->value_length;
+    entry->expires_at_ms = record->expires_at_ms;
+}
+
+// Indexes the records of a freshly mapped file. A record cut short or damaged
+// by a crash ends the valid part, and the file is truncated there so that new
+// records follow valid ones.
+static bool dpinternal_cache_disk_load(dp_response_cache_t* cache) {
+    size_t offset = sizeof(dp_cache_file_magic);
+    while (offset + sizeof(dp_cache_record_t) <= cache->disk_length) {
+        dp_cache_record_t record;
+        memcpy(&record, cache->map + offset, sizeof(record));
+        size_t available = cache->disk_length - offset - sizeof(record);
+        if (record.magic != DP_CACHE_RECORD_MAGIC || record.key_length > available ||
+            record.value_length > available - record.key_length ||
+            offset + dpinternal_cache_record_length(record.key_length, record.value_length) > cache->disk_length) {
+            break;
+        }
+        const char* key = cache->map + offset + sizeof(record);
+        if (dpinternal_cache_checksum(key, record.key_length, key + record.key_length, record.value_length) != record.checksum ||
+            dpinternal_hash_bytes(DP_HASH_SEED, key, record.key_length) != record.hash) {
+            break;
+        }
+        dpinternal_cache_disk_index(cache, &record, offset);
+        offset += dpinternal_cache_record_length(record.key_length, record.value_length);
+    }
+    if (offset == cache->disk_length) return true;
+    if (ftruncate(cache->fd, (off_t)offset) != 0) return false;
+    cache->disk_length = offset;
+    return true;
+}
+
+static bool dpinternal_cache_disk_open(dp_response_cache_t* cache) {
+    cache->fd = open(cache->disk_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (cache->fd < 0 || flock(cache->fd, LOCK_EX | LOCK_NB) != 0) return false;
+    struct stat st;
+    if (fstat(cache->fd, &st) != 0) return false;
+    cache->disk_length = (size_t)st.st_size;
+    if (cache->disk_length == 0) {
+        if (!dpinternal_cache_write_all(cache->fd, dp_cache_file_magic, sizeof(dp_cache_file_magic), 0)) return false;
+        cache->disk_length = sizeof(dp_cache_file_magic);
+    }
+    // Anything else at the path is left alone
+    if (cache->disk_length < sizeof(dp_cache_file_magic) || !dpinternal_cache_remap(cache) ||
+        memcmp(cache->map, dp_cache_file_magic, sizeof(dp_cache_file_magic)) != 0) {
+        return false;
+    }
+    return dpinternal_cache_disk_load(cache);
+}
+
+static int dpinternal_cache_compare_offsets(const void* a, const void* b) {
+    size_t x = (*(dp_cache_entry_t* const*)a)->offset;
+    size_t y = (*(dp_cache_entry_t* const*)b)->offset;
+    return x < y ? -1 : x > y;
+}
+
+// Rewrites the live records to a new file, dropping expired ones and then the
+// oldest until half of max_disk_bytes holds them and the incoming record, and
+// renames it over the old file. On failure the old file stays in use.
+static void dpinternal_cache_disk_compact(dp_response_cache_t* cache, size_t incoming) {
+    size_t count = cache->disk.count;
+    dp_cache_entry_t** entries = malloc((count ? count : 1) * sizeof(dp_cache_entry_t*));
+    bool* keep = calloc(count ? count : 1, sizeof(bool));
+    size_t* offsets = malloc((count ? count : 1) * sizeof(size_t));
+    char* compact_path = NULL;
+    dpinternal_safe_asprintf(&compact_path, "%s.compact", cache->disk_path);
+    if (!entries || !keep || !offsets || !compact_path) {
+        free(entries);
+        free(keep);
+        free(offsets);
+        free(compact_path);
+        return;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < cache->disk.num_buckets; ++i) {
+        for (dp_cache_entry_t* entry = cache->disk.buckets[i]; entry; entry = entry->bucket_next) entries[n++] = entry;
+    }
+    qsort(entries, n, sizeof(dp_cache_entry_t*), dpinternal_cache_compare_offsets);
+
+    int64_t now = dpinternal_cache_now_ms();
+    size_t budget = cache->max_disk_bytes / 2;
+    size_t total = sizeof(dp_cache_file_magic) + incoming;
+    for (size_t i = n; i-- > 0;) {
+        if (dpinternal_cache_expired(entries[i], now)) continue;
+        size_t length = dpinternal_cache_record_length(entries[i]->key_length, entries[i]->value_length);
+        if (total + length > budget) break;
+        total += length;
+        keep[i] = true;
+    }
+
+    int fd = open(compact_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    bool ok = fd >= 0 && flock(fd, LOCK_EX | LOCK_NB) == 0 &&
+              dpinternal_cache_write_all(fd, dp_cache_file_magic, sizeof(dp_cache_file_magic), 0);
+    size_t length = sizeof(dp_cache_file_magic);
+    for (size_t i = 0; ok && i < n; ++i) {
+        if (!keep[i]) continue;
+        size_t record_length = dpinternal_cache_record_length(entries[i]->key_length, entries[i]->value_length);
+        ok = dpinternal_cache_write_all(fd, cache->map + entries[i]->offset, record_length, length);
+        offsets[i] = length;
+        length += record_length;
+    }
+    if (ok) ok = rename(compact_path, cache->disk_path) == 0;
+    if (!ok) {
+        if (fd >= 0) close(fd);
+        unlink(compact_path);
+    } else {
+        close(cache->fd);
+        cache->fd = fd;
+        cache->disk_length = length;
+        for (size_t i = 0; i < n; ++i) {
+            if (keep[i]) {
+                entries[i]->offset = offsets[i];
+            } else {
+                dpinternal_cache_table_remove(&cache->disk, entries[i]);
+                free(entries[i]);
+            }
+        }
+        if (!dpinternal_cache_remap(cache)) dpinternal_cache_disk_close(cache);
+    }
+    free(entries);
+    free(keep);
+    free(offsets);
+    free(compact_path);
+}
+
+// Appends a record to the file and indexes it
+static void dpinternal_cache_disk_put(dp_response_cache_t* cache, uint64_t hash, const char* key, size_t key_length,
+                                      const char* value, size_t value_length, int64_t expires_at_ms) {
+    if (key_length > UINT32_MAX || value_length > UINT32_MAX) return;
+    size_t length = dpinternal_cache_record_length(key_length, value_length);
+    if (cache->disk_length + length > cache->max_disk_bytes) {
+        dpinternal_cache_disk_compact(cache, length);
+        if (!cache->disk_path || cache->disk_length + length > cache->max_disk_bytes) return;
+    }
+    char* buffer = calloc(1, length);
+    if (!buffer) return;
+    dp_cache_record_t record = {
+        .magic = DP_CACHE_RECORD_MAGIC,
+        .key_length = (uint32_t)key_length,
+        .value_length = (uint32_t)value_length,
+        .checksum = dpinternal_cache_checksum(key, key_length, value, value_length),
+        .expires_at_ms = expires_at_ms,
+        .hash = hash
+    };
+    memcpy(buffer, &record, sizeof(record));
+    memcpy(buffer + sizeof(record), key, key_length);
+    memcpy(buffer + sizeof(record) + key_length, value, value_length);
+    bool written = dpinternal_cache_write_all(cache->fd, buffer, length, cache->disk_length);
+    free(buffer);
+    if (!written) {
+        // A partial record would hide every record appended after it
+        if (ftruncate(cache->fd, (off_t)cache->disk_length) != 0) dpinternal_cache_disk_close(cache);
+        return;
+    }
+    size_t offset = cache->disk_length;
+    cache->disk_length += length;
+    if (!dpinternal_cache_map_grow(cache)) {
+        dpinternal_cache_disk_close(cache);
+        return;
+    }
+    dpinternal_cache_disk_index(cache, &record, offset);
+}
+
+// --- Public API ---
+
+static void dpinternal_cache_free(dp_response_cache_t* cache) {
+    dpinternal_cache_disk_close(cache);
+    dpinternal_cache_table_free(&cache->memory);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+dp_response_cache_t* dp_response_cache_create(const dp_response_cache_options_t* options) {
+    dp_response_cache_options_t defaults = {0};
+    if (!options) options = &defaults;
+    if (options->ttl_ms < 0) return NULL;
+    dp_response_cache_t* cache = calloc(1, sizeof(dp_response_cache_t));
+    if (!cache) return NULL;
+    cache->fd = -1;
+    if (pthread_mutex_init(&cache->lock, NULL) != 0) {
+        free(cache);
+        return NULL;
+    }
+    cache->refcount = 1;
+    cache->max_memory_bytes = options->max_memory_bytes ? options->max_memory_bytes : DP_CACHE_DEFAULT_MEMORY_BYTES;
+    cache->max_disk_bytes = options->max_disk_bytes ? options->max_disk_bytes : DP_CACHE_DEFAULT_DISK_BYTES;
+    cache->ttl_ms = options->ttl_ms;
+    cache->any_temperature = options->any_temperature;
+    bool ok = dpinternal_cache_table_init(&cache->memory);
+    if (ok && options->disk_path) {
+        cache->disk_path = dpinternal_strdup(options->disk_path);
+        ok = cache->disk_path && dpinternal_cache_table_init(&cache->disk) && dpinternal_cache_disk_open(cache);
+    }
+    if (!ok) {
+        dpinternal_cache_free(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+dp_response_cache_t* dpinternal_response_cache_retain(dp_response_cache_t* cache) {
+    pthread_mutex_lock(&cache->lock);
+    cache->refcount++;
+    pthread_mutex_unlock(&cache->lock);
+    return cache;
+}
+
+void dpinternal_response_cache_release(dp_response_cache_t* cache) {
+    if (!cache) return;
+    pthread_mutex_lock(&cache->lock);
+    int remaining = --cache->refcount;
+    pthread_mutex_unlock(&cache->lock);
+    if (remaining > 0) return;
+    dpinternal_cache_free(cache);
+}
+
+void dp_response_cache_destroy(dp_response_cache_t* cache) {
+    // Contexts still using the cache keep it alive until they are destroyed.
+    dpinternal_response_cache_release(cache);
+}
+
+int dp_set_response_cache(dp_context_t* context, dp_response_cache_t* cache) {
+    if (!context) return -1;
+    if (cache) dpinternal_response_cache_retain(cache);
+    dpinternal_response_cache_release(context->response_cache);
+    context->response_cache = cache;
+    return 0;
+}
+
+int dp_response_cache_get_stats(dp_response_cache_t* cache, dp_response_cache_stats_t* stats_out) {
+    if (!cache || !stats_out) return -1;
+    pthread_mutex_lock(&cache->lock);
+    *stats_out = cache->stats;
+    stats_out->memory_entries = cache->memory.count;
+    stats_out->memory_bytes = cache->memory_bytes;
+    stats_out->disk_entries = cache->disk.count;
+    stats_out->disk_bytes = cache->disk_path ? cache->disk_length : 0;
+    pthread_mutex_unlock(&cache->lock);
+    return 0;
+}
+
+// Returns a copy of a live value, or NULL on a miss. Disk hits are promoted
+// to the memory tier.
+static char* dpinternal_cache_get(dp_response_cache_t* cache, const char* key, size_t key_length) {
+    uint64_t hash = dpinternal_hash_bytes(DP_HASH_SEED, key, key_length);
+    char* value = NULL;
+    bool expired = false;
+    pthread_mutex_lock(&cache->lock);
+    int64_t now = dpinternal_cache_now_ms();
+    dp_cache_entry_t* entry = dpinternal_cache_table_find(cache, &cache->memory, hash, key, key_length);
+    if (entry && dpinternal_cache_expired(entry, now)) {
+        dpinternal_cache_memory_remove(cache, entry);
+        entry = NULL;
+        expired = true;
+    }
+    if (entry) {
+        dpinternal_cache_lru_unlink(cache, entry);
+        dpinternal_cache_lru_push(cache, entry);
+        value = dpinternal_cache_copy(entry->value, entry->value_length);
+        if (value) cache->stats.memory_hits++;
+    } else if (cache->disk_path) {
+        entry = dpinternal_cache_table_find(cache, &cache->disk, hash, key, key_length);
+        if (entry && dpinternal_cache_expired(entry, now)) {
+            dpinternal_cache_table_remove(&cache->disk, entry);
+            free(entry);
+            entry = NULL;
+            expired = true;
+        }
+        if (entry) {
+            const char* stored = dpinternal_cache_entry_value(cache, entry);
+            value = dpinternal_cache_copy(stored, entry->value_length);
+            if (value) {
+                cache->stats.disk_hits++;
+                dpinternal_cache_memory_put(cache, hash, key, key_length, stored, entry->value_length, entry->expires_at_ms);
+            }
+        }
+    }
+    if (!value) {
+        cache->stats.misses++;
+        if (expired) cache->stats.expirations++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return value;
+}
+
+static void dpinternal_cache_put(dp_response_cache_t* cache, const char* key, size_t key_length, const char* value, size_t value_length) {
+    uint64_t hash = dpinternal_hash_bytes(DP_HASH_SEED, key, key_length);
+    pthread_mutex_lock(&cache->lock);
+    int64_t expires_at_ms = cache->ttl_ms > 0 ? dpinternal_cache_now_ms() + cache->ttl_ms : 0;
+    dpinternal_cache_memory_put(cache, hash, key, key_length, value, value_length, expires_at_ms);
+    if (cache->disk_path) dpinternal_cache_disk_put(cache, hash, key, key_length, value, value_length, expires_at_ms);
+    cache->stats.stores++;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// --- Transfers ---
+
+static dp_response_cache_t* dpinternal_cache_for(const dp_transfer_t* t) {
+    dp_response_cache_t* cache = t->context->response_cache;
+    if (!cache || (!cache->any_temperature && t->request_config->temperature != 0.0)) return NULL;
+    return cache;
+}
+
+// Everything that selects the answer: kind, provider endpoint (without the
+// Gemini key), model and payload
+static char* dpinternal_cache_key(const dp_transfer_t* t, size_t* length_out) {
+    const dp_context_t* context = t->context;
+    const char* endpoint = context->provider == DP_PROVIDER_GOOGLE_GEMINI ? context->model_url_prefix : context->completions_url;
+    char* key = NULL;
+    int length = dpinternal_safe_asprintf(&key, "%d\n%d\n%s\n%s\n%s", (int)t->kind, (int)context->provider,
+                                          endpoint ? endpoint : "", t->request_config->model ? t->request_config->model : "",
+                                          t->json_payload);
+    if (length < 0) return NULL;
+    *length_out = (size_t)length;
+    return key;
+}
+
+static bool dpinternal_cache_add_string(cJSON* object, const char* name, const char* value) {
+    return !value || cJSON_AddStringToObject(object, name, value) != NULL;
+}
+
+// Serializes a successful response and takes ownership of the recorded events
+static char* dpinternal_cache_serialize(const dp_response_t* response, cJSON* events) {
+    cJSON* root = cJSON_CreateObject();
+    if (!root) {
+        cJSON_Delete(events);
+        return NULL;
+    }
+    bool ok = !events || cJSON_AddItemToObject(root, "events", events);
+    if (!ok) cJSON_Delete(events);
+    ok = ok && cJSON_AddNumberToObject(root, "status", (double)response->http_status_code) &&
+         dpinternal_cache_add_string(root, "finish_reason", response->finish_reason) &&
+         cJSON_AddNumberToObject(root, "input_tokens", (double)response->usage.input_tokens) &&
+         cJSON_AddNumberToObject(root, "output_tokens", (double)response->usage.output_tokens) &&
+         cJSON_AddNumberToObject(root, "cache_creation_input_tokens", (double)response->usage.cache_creation_input_tokens) &&
+         cJSON_AddNumberToObject(root, "cache_read_input_tokens", (double)response->usage.cache_read_input_tokens);
+    cJSON* parts = ok && response->num_parts > 0 ? cJSON_AddArrayToObject(root, "parts") : NULL;
+    if (response->num_parts > 0 && !parts) ok = false;
+    for (size_t i = 0; ok && i < response->num_parts; ++i) {
+        const dp_response_part_t* part = &response->parts[i];
+        cJSON* item = cJSON_CreateObject();
+        ok = item && cJSON_AddItemToArray(parts, item);
+        if (!ok) {
+            cJSON_Delete(item);
+            break;
+        }
+        ok = cJSON_AddNumberToObject(item, "type", (double)part->type) &&
+             dpinternal_cache_add_string(item, "text", part->text) &&
+             dpinternal_cache_add_string(item, "id", part->tool_call.id) &&
+             dpinternal_cache_add_string(item, "function_name", part->tool_call.function_name) &&
+             dpinternal_cache_add_string(item, "arguments_json", part->tool_call.arguments_json) &&
+             dpinternal_cache_add_string(item, "thinking", part->thinking.thinking) &&
+             dpinternal_cache_add_string(item, "signature", part->thinking.signature);
+    }
+    char* value = ok ? cJSON_PrintUnformatted(root) : NULL;
+    cJSON_Delete(root);
+    return value;
+}
+
+static char* dpinternal_cache_get_string(const cJSON* object, const char* name, bool* ok) {
+    const cJSON* item = cJSON_GetObjectItemCaseSensitive(object, name);
+    if (!cJSON_IsString(item) || !item->valuestring) return NULL;
+    char* copy = dpinternal_strdup(item->valuestring);
+    if (!copy) *ok = false;
+    return copy;
+}
+
+static long dpinternal_cache_get_number(const cJSON* object, const char* name) {
+    const cJSON* item = cJSON_GetObjectItemCaseSensitive(object, name);
+    return cJSON_IsNumber(item) ? (long)item->valuedouble : 0;
+}
+
+static bool dpinternal_cache_fill_response(const cJSON* root, dp_response_t* response) {
+    bool ok = true;
+    response->http_status_code = dpinternal_cache_get_number(root, "status");
+    response->finish_reason = dpinternal_cache_get_string(root, "finish_reason", &ok);
+    response->usage.input_tokens = dpinternal_cache_get_number(root, "input_tokens");
+    response->usage.output_tokens = dpinternal_cache_get_number(root, "output_tokens");
+    response->usage.cache_creation_input_tokens = dpinternal_cache_get_number(root, "cache_creation_input_tokens");
+    response->usage.cache_read_input_tokens = dpinternal_cache_get_number(root, "cache_read_input_tokens");
+    const cJSON* parts = cJSON_GetObjectItemCaseSensitive(root, "parts");
+    int num_parts = cJSON_IsArray(parts) ? cJSON_GetArraySize(parts) : 0;
+    if (num_parts > 0) {
+        response->parts = calloc((size_t)num_parts, sizeof(dp_response_part_t));
+        if (!response->parts) return false;
+        response->num_parts = (size_t)num_parts;
+        for (int i = 0; i < num_parts; ++i) {
+            const cJSON* item = cJSON_GetArrayItem(parts, i);
+            dp_response_part_t* part = &response->parts[i];
+            part->type = (dp_content_part_type_t)dpinternal_cache_get_number(item, "type");
+            part->text = dpinternal_cache_get_string(item, "text", &ok);
+            part->tool_call.id = dpinternal_cache_get_string(item, "id", &ok);
+            part->tool_call.function_name = dpinternal_cache_get_string(item, "function_name", &ok);
+            part->tool_call.arguments_json = dpinternal_cache_get_string(item, "arguments_json", &ok);
+            part->thinking.thinking = dpinternal_cache_get_string(item, "thinking", &ok);
+            part->thinking.signature = dpinternal_cache_get_string(item, "signature", &ok);
+        }
+    }
+    return ok;
+}
+
+// Delivers recorded stream callbacks until the caller asks to stop
+static void dpinternal_cache_replay(dp_transfer_t* t, const cJSON* events) {
+    const cJSON* event;
+    cJSON_ArrayForEach(event, events) {
+        int result;
+        if (t->kind == DP_TRANSFER_STREAM) {
+            const cJSON* token = cJSON_GetObjectItemCaseSensitive(event, "token");
+            bool is_final = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(event, "final"));
+            result = t->user_callback(cJSON_IsString(token) ? token->valuestring : NULL, t->user_data, is_final, NULL);
+        } else {
+            const cJSON* type = cJSON_GetObjectItemCaseSensitive(event, "type");
+            const cJSON* data = cJSON_GetObjectItemCaseSensitive(event, "data");
+            dp_anthropic_stream_event_t detailed = {
+                .event_type = (dp_anthropic_event_type_t)(cJSON_IsNumber(type) ? type->valueint : 0),
+                .raw_json_data = cJSON_IsString(data) ? data->valuestring : NULL
+            };
+            result = t->user_detailed_callback(cJSON_IsNumber(type) ? &detailed : NULL, t->user_data, NULL);
+        }
+        if (result != 0) break;
+    }
+}
+
+// Answers t from the cache and returns true, or keeps its key so that the
+// response can be stored once it has been performed and returns false.
+bool dpinternal_cache_lookup(dp_transfer_t* t) {
+    dp_response_cache_t* cache = dpinternal_cache_for(t);
+    if (!cache) return false;
+    size_t key_length = 0;
+    char* key = dpinternal_cache_key(t, &key_length);
+    if (!key) return false;
+    char* value = dpinternal_cache_get(cache, key, key_length);
+    cJSON* root = value ? cJSON_Parse(value) : NULL;
+    free(value);
+    if (root && dpinternal_cache_fill_response(root, t->response)) {
+        free(key);
+        if (t->kind != DP_TRANSFER_COMPLETION) {
+            dpinternal_cache_replay(t, cJSON_GetObjectItemCaseSensitive(root, "events"));
+        }
+        cJSON_Delete(root);
+        return true;
+    }
+    if (root) {
+        // Unreadable or out of memory: perform the request instead
+        dp_free_response_content(t->response);
+        cJSON_Delete(root);
+    }
+    t->cache_key = key;
+    t->cache_key_length = key_length;
+    return false;
+}
+
+static void dpinternal_cache_append(dp_cache_recording_t* recording, cJSON* event) {
+    if (!event || !cJSON_AddItemToArray(recording->events, event)) {
+        cJSON_Delete(event);
+        recording->incomplete = true;
+    }
+}
+
+static int dpinternal_cache_stream_relay(const char* token, void* user_data, bool is_final, const char* error) {
+    dp_transfer_t* t = (dp_transfer_t*)user_data;
+    dp_cache_recording_t* recording = t->cache_recording;
+    if (error) {
+        recording->incomplete = true;
+    } else if (!recording->incomplete) {
+        cJSON* event = cJSON_CreateObject();
+        if (event && ((token && !cJSON_AddStringToObject(event, "token", token)) ||
+                      (is_final && !cJSON_AddTrueToObject(event, "final")))) {
+            cJSON_Delete(event);
+            event = NULL;
+        }
+        dpinternal_cache_append(recording, event);
+    }
+    int result = recording->callback(token, recording->user_data, is_final, error);
+    if (result != 0) recording->incomplete = true;
+    return result;
+}
+
+static int dpinternal_cache_event_relay(const dp_anthropic_stream_event_t* event, void* user_data, const char* error) {
+    dp_transfer_t* t = (dp_transfer_t*)user_data;
+    dp_cache_recording_t* recording = t->cache_recording;
+    if (error) {
+        recording->incomplete = true;
+    } else if (!recording->incomplete) {
+        cJSON* recorded = cJSON_CreateObject();
+        if (recorded && event && (!cJSON_AddNumberToObject(recorded, "type", (double)event->event_type) ||
+                                  !dpinternal_cache_add_string(recorded, "data", event->raw_json_data))) {
+            cJSON_Delete(recorded);
+            recorded = NULL;
+        }
+        dpinternal_cache_append(recording, recorded);
+    }
+    int result = recording->detailed_callback(event, recording->user_data, error);
+    if (result != 0) recording->incomplete = true;
+    return result;
+}
+
+// Wraps the stream callback of a transfer that missed the cache so that what
+// it delivers can be stored and replayed.
+void dpinternal_cache_record(dp_transfer_t* t) {
+    if (!t->cache_key || t->kind == DP_TRANSFER_COMPLETION) return;
+    dp_cache_recording_t* recording = calloc(1, sizeof(dp_cache_recording_t));
+    if (recording) recording->events = cJSON_CreateArray();
+    if (!recording || !recording->events) {
+        // A stream that cannot be replayed is not stored
+        free(recording);
+        dpinternal_cache_discard(t);
+        return;
+    }
+    recording->callback = t->user_callback;
+    recording->detailed_callback = t->user_detailed_callback;
+    recording->user_data = t->user_data;
+    if (t->kind == DP_TRANSFER_STREAM) {
+        t->user_callback = dpinternal_cache_stream_relay;
+    } else {
+        t->user_detailed_callback = dpinternal_cache_event_relay;
+    }
+    t->user_data = t;
+    t->cache_recording = recording;
+}
+
+// Stores a performed transfer's response if it succeeded and its whole
+// stream was delivered, and unwraps its stream callback.
+void dpinternal_cache_store(dp_transfer_t* t) {
+    dp_cache_recording_t* recording = t->cache_recording;
+    cJSON* events = NULL;
+    bool complete = true;
+    if (recording) {
+        t->user_callback = recording->callback;
+        t->user_detailed_callback = recording->detailed_callback;
+        t->user_data = recording->user_data;
+        events = recording->events;
+        complete = !recording->incomplete;
+        free(recording);
+        t->cache_recording = NULL;
+    }
+    const dp_response_t* response = t->response;
+    dp_response_cache_t* cache = t->context->response_cache;
+    if (t->cache_key && cache && complete && !response->error_message &&
+        response->http_status_code >= 200 && response->http_status_code < 300) {
+        char* value = dpinternal_cache_serialize(response, events);
+        events = NULL;
+        if (value) {
+            dpinternal_cache_put(cache, t->cache_key, t->cache_key_length, value, strlen(value));
+            free(value);
+        }
+    }
+    cJSON_Delete(events);
+    dpinternal_cache_discard(t);
+}
+
+void dpinternal_cache_discard(dp_transfer_t* t) {
+    if (t->cache_recording) {
+        cJSON_Delete(t->cache_recording->events);
+        free(t->cache_recording);
+        t->cache_recording = NULL;
+    }
+    free(t->cache_key);
+    t->cache_key = NULL;
+    t->cache_key_length = 0;
+}
@@ -0,0 +1,152 @@
+#define _GNU_SOURCE
+#include "dp_private.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+// Gemini explicit context caching: a cachedContents resource holds a system
+// instruction, tools and leading contents that generateContent requests then
+// reference by name instead of resending.
+
+void dp_free_cached_content(dp_cached_content_t* cached_content) {
+    if (!cached_content) return;
+    free(cached_content->name);
+    free(cached_content->model);
+    free(cached_content->expire_time);
+    free(cached_content->error_message);
+    free(cached_content);
+}
+
+// Sends one cachedContents request, a POST of payload or a DELETE when payload
+// is NULL. Returns 0 on a 2xx reply; otherwise -1 with *error_out set. A
+// create that may have reached the server is not retried, since each one
+// makes a new billed resource; a DELETE is safe to repeat.
+static int dpinternal_cached_content_send(dp_context_t* context, const char* url, const char* payload,
+                                          memory_struct_t* body, long* http_status_out, char** error_out) {
+    CURL* curl = dpinternal_pool_acquire(context);
+    if (!curl) {
+        *error_out = dpinternal_strdup("Failed to acquire a cURL handle for cached content.");
+        return -1;
+    }
+    body->memory = malloc(1);
+    body->size = 0;
+    if (!body->memory) {
+        *error_out = dpinternal_strdup("Memory allocation for the cached content response failed.");
+        dpinternal_pool_release(context, curl);
+        return -1;
+    }
+    body->memory[0] = '\0';
+
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    if (payload) {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload);
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, context->json_headers);
+    } else {
+        curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
+    }
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, dpinternal_write_memory_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*)body);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, context->user_agent);
+    dp_deadline_watch_t deadline;
+    dpinternal_deadline_arm(&deadline, curl, context, NULL);
+
+    CURLcode res = dpinternal_retry_perform_buffered(context, curl, body, &deadline, payload == NULL, http_status_out);
+    dp_deadline_kind_t missed = dpinternal_deadline_missed(&deadline, res);
+    dpinternal_pool_release(context, curl);
+
+    if (missed != DP_DEADLINE_NONE) {
+        *error_out = dpinternal_deadline_message(&deadline, missed);
+        return -1;
+    }
+    if (res != CURLE_OK) {
+        dpinternal_safe_asprintf(error_out, "curl_easy_perform() failed for cached content: %s", curl_easy_strerror(res));
+        return -1;
+    }
+    if (*http_status_out < 200 || *http_status_out >= 300) {
+        dpinternal_safe_asprintf(error_out, "Cached content HTTP error %ld. Body: %.500s", *http_status_out, body->memory);
+        return -1;
+    }
+    return 0;
+}
+
+static char* dpinternal_cached_content_string(const cJSON* root, const char* name) {
+    const cJSON* item = cJSON_GetObjectItemCaseSensitive(root, name);
+    return cJSON_IsString(item) && item->valuestring ? dpinternal_strdup(item->valuestring) : NULL;
+}
+
+int dp_create_cached_content(dp_context_t* context, const dp_request_config_t* request_config, long ttl_seconds,
+                             dp_cached_content_t** cached_content_out) {
+    if (!cached_content_out) return -1;
+    *cached_content_out = NULL;
+    if (!context || !request_config || !request_config->model || ttl_seconds < 0) return -1;
+
+    dp_cached_content_t* cached = calloc(1, sizeof(dp_cached_content_t));
+    if (!cached) return -1;
+    *cached_content_out = cached;
+    if (context->provider != DP_PROVIDER_GOOGLE_GEMINI) {
+        cached->error_message = dpinternal_strdup("Cached content is only supported for the Gemini provider.");
+        return -1;
+    }
+
+    // The resource holds the system prompt and tools itself, so build the
+    // contents as if no resource were referenced yet
+    dp_request_config_t contents_config = *request_config;
+    contents_config.cached_content = NULL;
+    cJSON* root = dpinternal_build_gemini_contents_with_cjson(&contents_config);
+    char* model = NULL;
+    char* ttl = NULL;
+    bool ok = root && dpinternal_safe_asprintf(&model, "models/%s", request_config->model) >= 0 &&
+              cJSON_AddStringToObject(root, "model", model) &&
+              (ttl_seconds == 0 || (dpinternal_safe_asprintf(&ttl, "%lds", ttl_seconds) >= 0 &&
+                                    cJSON_AddStringToObject(root, "ttl", ttl)));
+    char* payload = ok ? cJSON_PrintUnformatted(root) : NULL;
+    cJSON_Delete(root);
+    free(model);
+    free(ttl);
+    char* url = NULL;
+    if (!payload || dpinternal_safe_asprintf(&url, "%s/cachedContents?%s", context->api_base_url, context->key_query) < 0) {
+        free(payload);
+        cached->error_message = dpinternal_strdup("Failed to build the cached content request.");
+        return -1;
+    }
+
+    memory_struct_t body = { .memory = NULL, .size = 0 };
+    int result = dpinternal_cached_content_send(context, url, payload, &body, &cached->http_status_code, &cached->error_message);
+    free(payload);
+    free(url);
+    if (result == 0) {
+        cJSON* reply = cJSON_Parse(body.memory);
+        if (reply) {
+            cached->name = dpinternal_cached_content_string(reply, "name");
+            cached->model = dpinternal_cached_content_string(reply, "model");
+            cached->expire_time = dpinternal_cached_content_string(reply, "expireTime");
+            const cJSON* tokens = cJSON_GetObjectItemCaseSensitive(cJSON_GetObjectItemCaseSensitive(reply, "usageMetadata"), "totalTokenCount");
+            if (cJSON_IsNumber(tokens)) cached->total_token_count = (long)tokens->valuedouble;
+            cJSON_Delete(reply);
+        }
+        if (!cached->name) {
+            dpinternal_safe_asprintf(&cached->error_message, "Cached content response has no name. Body: %.200s", body.memory);
+            result = -1;
+        }
+    }
+    free(body.memory);
+    return result;
+}
+
+int dp_delete_cached_content(dp_context_t* context, const char* name) {
+    if (!context || !name || context->provider != DP_PROVIDER_GOOGLE_GEMINI) return -1;
+    char* url = NULL;
+    if (dpinternal_safe_asprintf(&url, "%s/%s?%s", context->api_base_url, name, context->key_query) < 0) return -1;
+
+    memory_struct_t body = { .memory = NULL, .size = 0 };
+    long http_status_code = 0;
+    char* error_message = NULL;
+    int result = dpinternal_cached_content_send(context, url, NULL, &body, &http_status_code, &error_message);
+    if (result != 0) {
+        fprintf(stderr, "dp_delete_cached_content: %s\n", error_message ? error_message : "Request failed.");
+    }
+    free(error_message);
+    free(body.memory);
+    free(url);
+    return result;
+}
@@ -5,6 +5,65 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <sys/un.h>
+
+static bool dpinternal_context_append_header(struct curl_slist** list, const char* header) {
+    struct curl_slist* appended = curl_slist_append(*list, header);
+    if (!appended) return false;
+    *list = appended;
+    return true;
+}
+
+// Builds the endpoints and header lists every request reuses. Sized to fit,
+// so long base URLs and keys are never truncated.
+static bool dpinternal_context_build_endpoints(dp_context_t* context) {
+    const char* base = context->api_base_url;
+    char* auth_header = NULL;
+    bool ok = false;
+    switch (context->provider) {
+        case DP_PROVIDER_OPENAI_COMPATIBLE:
+            ok = dpinternal_safe_asprintf(&auth_header, "Authorization: Bearer %s", context->api_key) >= 0 &&
+                 dpinternal_context_append_header(&context->auth_headers, auth_header) &&
+                 dpinternal_safe_asprintf(&context->completions_url, "%s/chat/completions", base) >= 0 &&
+                 dpinternal_safe_asprintf(&context->models_url, "%s/models", base) >= 0;
+            break;
+        case DP_PROVIDER_GOOGLE_GEMINI:
+            // Gemini authenticates with a query parameter instead of a header
+            ok = dpinternal_safe_asprintf(&context->model_url_prefix, "%s/models/", base) >= 0 &&
+                 dpinternal_safe_asprintf(&context->key_query, "key=%s", context->api_key) >= 0 &&
+                 dpinternal_safe_asprintf(&context->models_url, "%s/models?key=%s", base, context->api_key) >= 0;
+            break;
+        case DP_PROVIDER_ANTHROPIC:
+            ok = dpinternal_safe_asprintf(&auth_header, "x-api-key: %s", context->api_key) >= 0 &&
+                 dpinternal_context_append_header(&context->auth_headers, auth_header) &&
+                 dpinternal_context_append_header(&context->auth_headers, "anthropic-version: 2023-06-01") &&
+                 dpinternal_safe_asprintf(&context->completions_url, "%s/messages", base) >= 0 &&
+                 dpinternal_safe_asprintf(&context->models_url, "%s/models", base) >= 0 &&
+                 dpinternal_safe_asprintf(&context->count_tokens_url, "%s/messages/count_tokens", base) >= 0;
+            break;
+        default:
+            ok = true;
+            break;
+    }
+    free(auth_header);
+    if (!ok) return false;
+
+    ok = dpinternal_context_append_header(&context->json_headers, "Content-Type: application/json");
+    for (const struct curl_slist* header = context->auth_headers; ok && header; header = header->next) {
+        ok = dpinternal_context_append_header(&context->json_headers, header->data);
+    }
+    return ok;
+}
+
+static void dpinternal_context_free_endpoints(dp_context_t* context) {
+    curl_slist_free_all(context->json_headers);
+    curl_slist_free_all(context->auth_headers);
+    free(context->completions_url);
+    free(context->models_url);
+    free(context->count_tokens_url);
+    free(context->model_url_prefix);
+    free(context->key_query);
+}
 
 dp_context_t* dp_init_context(dp_provider_type_t provider, const char* api_key, const char* api_base_url) {
     return dp_init_context_with_app_info(provider, api_key, api_base_url, NULL, NULL);
@@ -66,9 +125,36 @@ dp_context_t* dp_init_context_with_app_info(dp_provider_type_t provider,
     // Initialize token parameter preference (optimistically use modern parameter)
     context->token_param_preference = DP_TOKEN_PARAM_MAX_COMPLETION_TOKENS;
     context->features = 0;
+    context->stall_threshold_ms = DP_DEFAULT_STALL_THRESHOLD_MS;
+    context->max_stream_event_bytes = DP_DEFAULT_MAX_STREAM_EVENT_BYTES;
 
-    if (!context->api_key || !context->api_base_url || !context->user_agent) {
-        perror("Failed to allocate API key, base URL, or user-agent in Disaster Party context");
+    if (!context->api_key || !context->api_base_url || !context->user_agent ||
+        !dpinternal_context_build_endpoints(context) || !dpinternal_pool_init(&context->pool)) {
+        perror("Failed to allocate API key, base URL, user-agent, endpoints or connection pool in Disaster Party context");
+        dpinternal_context_free_endpoints(context);
+        free(context->api_key);
+        free(context->api_base_url);
+        free(context->user_agent);
+        free(context);
+        return NULL;
+    }
+    if (!dpinternal_warmup_init(&context->warmup)) {
+        perror("Failed to initialize warm-up state in Disaster Party context");
+        dpinternal_pool_destroy(&context->pool);
+        dpinternal_context_free_endpoints(context);
+        free(context->api_key);
+        free(context->api_base_url);
+        free(context->user_agent);
+        free(context);
+        return NULL;
+    }
+    bool breaker_ok = dpinternal_breaker_init(&context->breaker);
+    if (!breaker_ok || !dpinternal_flight_init(&context->flights)) {
+        perror("Failed to initialize circuit breaker or request deduplication in Disaster Party context");
+        if (breaker_ok) dpinternal_breaker_destroy(&context->breaker);
+        dpinternal_warmup_destroy(&context->warmup);
+        dpinternal_pool_destroy(&context->pool);
+        dpinternal_context_free_endpoints(context);
         free(context->api_key);
         free(context->api_base_url);
         free(context->user_agent);
@@ -84,15 +170,137 @@ void dp_enable_advanced_features(dp_context_t* context, ...) {
     va_start(args, context);
     int feature;
     while ((feature = va_arg(args, int)) != 0) {
-        context->features |= (1ULL << (feature - 1));
+        // One bit per feature; anything else would shift out of range
+        if (feature < 1 || feature > 64) continue;
+        atomic_fetch_or(&context->features, 1ULL << (feature - 1));
     }
     va_end(args);
 }
 
+int dp_set_stall_threshold(dp_context_t* context, long threshold_ms) {
+    if (!context || threshold_ms <= 0) return -1;
+    atomic_store(&context->stall_threshold_ms, threshold_ms);
+    return 0;
+}
+
+int dp_set_max_stream_event_size(dp_context_t* context, size_t max_bytes) {
+    if (!context || max_bytes == 0) return -1;
+    atomic_store(&context->max_stream_event_bytes, max_bytes);
+    return 0;
+}
+
+int dp_set_ca_bundle(dp_context_t* context, const char* ca_bundle_path) {
+    if (!context) return -1;
+    char* copy = NULL;
+    if (ca_bundle_path) {
+        copy = dpinternal_strdup(ca_bundle_path);
+        if (!copy) return -1;
+    }
+    free(context->ca_bundle_path);
+    context->ca_bundle_path = copy;
+    return 0;
+}
+
+int dp_set_unix_socket(dp_context_t* context, const char* socket_path) {
+    if (!context) return -1;
+    char* copy = NULL;
+    if (socket_path) {
+        struct sockaddr_un address;
+        if (socket_path[0] == '\0' || strlen(socket_path) >= sizeof(address.sun_path)) return -1;
+        copy = dpinternal_strdup(socket_path);
+        if (!copy) return -1;
+    }
+    free(context->unix_socket_path);
+    context->unix_socket_path = copy;
+    return 0;
+}
+
+int dp_set_resolve(dp_context_t* context, const char* const* entries, size_t num_entries) {
+    if (!context || (num_entries > 0 && !entries)) return -1;
+    struct curl_slist* list = NULL;
+    for (size_t i = 0; i < num_entries; ++i) {
+        if (!entries[i] || !strchr(entries[i], ':') || !dpinternal_context_append_header(&list, entries[i])) {
+            curl_slist_free_all(list);
+            return -1;
+        }
+    }
+    curl_slist_free_all(context->resolve);
+    context->resolve = list;
+    return 0;
+}
+
+int dp_set_default_deadlines(dp_context_t* context, const dp_deadlines_t* deadlines) {
+    if (!context) return -1;
+    if (!deadlines) {
+        memset(&context->default_deadlines, 0, sizeof(context->default_deadlines));
+        return 0;
+    }
+    if (deadlines->total_ms < 0 || deadlines->connect_ms < 0 ||
+        deadlines->first_byte_ms < 0 || deadlines->stream_idle_ms < 0) {
+        return -1;
+    }
+    context->default_deadlines = *deadlines;
+    return 0;
+}
+
+int dp_set_retry_policy(dp_context_t* context, const dp_retry_policy_t* policy) {
+    if (!context) return -1;
+    if (!policy) {
+        memset(&context->retry_policy, 0, sizeof(context->retry_policy));
+        atomic_store(&context->retry_budget, 0);
+        return 0;
+    }
+    if (policy->base_delay_ms < 0 || policy->max_delay_ms < 0 || policy->budget_ratio < 0 || policy->budget_burst < 0) {
+        return -1;
+    }
+    context->retry_policy = *policy;
+    atomic_store(&context->retry_budget, (long)policy->budget_burst * DP_RETRY_BUDGET_SCALE);
+    return 0;
+}
+
+int dp_set_hedge_policy(dp_context_t* context, const dp_hedge_policy_t* policy) {
+    if (!context) return -1;
+    if (!policy) {
+        memset(&context->hedge_policy, 0, sizeof(context->hedge_policy));
+        return 0;
+    }
+    if (policy->delay_ms < 0 || policy->min_delay_ms < 0 || policy->percentile < 0 || policy->percentile > 100) {
+        return -1;
+    }
+    context->hedge_policy = *policy;
+    return 0;
+}
+
+int dp_get_request_stats(const dp_context_t* context, dp_request_stats_t* stats_out) {
+    if (!context || !stats_out) return -1;
+    memset(stats_out, 0, sizeof(*stats_out));
+    stats_out->requests = atomic_load_explicit(&context->stat_requests, memory_order_relaxed);
+    stats_out->retries = atomic_load_explicit(&context->stat_retries, memory_order_relaxed);
+    stats_out->retries_denied = atomic_load_explicit(&context->stat_retries_denied, memory_order_relaxed);
+    stats_out->hedges = atomic_load_explicit(&context->stat_hedges, memory_order_relaxed);
+    stats_out->hedge_wins = atomic_load_explicit(&context->stat_hedge_wins, memory_order_relaxed);
+    stats_out->body_bytes_wire = atomic_load_explicit(&context->stat_body_bytes_wire, memory_order_relaxed);
+    stats_out->body_bytes_decoded = atomic_load_explicit(&context->stat_body_bytes_decoded, memory_order_relaxed);
+    stats_out->coalesced = atomic_load_explicit(&context->stat_coalesced, memory_order_relaxed);
+    return 0;
+}
+
 void dp_destroy_context(dp_context_t* context) {
     if (!context) return;
+    // The refresh thread uses the pool, so it stops first
+    dpinternal_warmup_destroy(&context->warmup);
+    dpinternal_pool_destroy(&context->pool);
+    dpinternal_share_release(context->share);
+    dpinternal_rate_limiter_release(context->rate_limiter);
+    dpinternal_breaker_destroy(&context->breaker);
+    dpinternal_flight_destroy(&context->flights);
+    dpinternal_response_cache_release(context->response_cache);
+    dpinternal_context_free_endpoints(context);
     free(context->api_key);
     free(context->api_base_url);
     free(context->user_agent);
+    free(context->ca_bundle_path);
+    free(context->unix_socket_path);
+    curl_slist_free_all(context->resolve);
     free(context);
 }
\ No newline at end of file
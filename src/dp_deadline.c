@@ -0,0 +1,127 @@
+#define _GNU_SOURCE
+#include "dp_private.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Deadlines bound how long one request may pin a thread or an engine slot.
+// The total and connect limits are plain libcurl timeouts; a retried request
+// gives each attempt only what is left of the total. libcurl has no
+// notion of "first byte" or "idle between chunks" below whole seconds, so
+// those two are checked from the progress callback, which libcurl invokes
+// whenever data arrives and otherwise at least once a second.
+
+#define DP_DEADLINE_SLACK_MS 5
+
+static int dpinternal_deadline_progress(void* clientp, curl_off_t dltotal, curl_off_t dlnow, curl_off_t ultotal, curl_off_t ulnow) {
+    (void)dltotal; (void)ultotal; (void)ulnow;
+    dp_deadline_watch_t* watch = (dp_deadline_watch_t*)clientp;
+    uint64_t now = dpinternal_monotonic_ms();
+
+    // Data that arrives after its limit has passed still counts as a miss, so
+    // the outcome does not depend on when libcurl happened to call us.
+    if (watch->last_byte_ms == 0) {
+        if (watch->limits.first_byte_ms > 0 && now - watch->started_ms > (uint64_t)watch->limits.first_byte_ms) {
+            watch->missed = DP_DEADLINE_FIRST_BYTE;
+            return 1;
+        }
+    } else if (watch->limits.stream_idle_ms > 0 && now - watch->last_byte_ms > (uint64_t)watch->limits.stream_idle_ms) {
+        watch->missed = DP_DEADLINE_STREAM_IDLE;
+        return 1;
+    }
+    if (dlnow > watch->received) {
+        watch->received = dlnow;
+        watch->last_byte_ms = now;
+    }
+    return 0;
+}
+
+void dpinternal_deadline_arm(dp_deadline_watch_t* watch, CURL* curl, const dp_context_t* context, const dp_deadlines_t* request_deadlines) {
+    memset(watch, 0, sizeof(*watch));
+    watch->limits = context->default_deadlines;
+    if (request_deadlines) {
+        if (request_deadlines->total_ms > 0) watch->limits.total_ms = request_deadlines->total_ms;
+        if (request_deadlines->connect_ms > 0) watch->limits.connect_ms = request_deadlines->connect_ms;
+        if (request_deadlines->first_byte_ms > 0) watch->limits.first_byte_ms = request_deadlines->first_byte_ms;
+        if (request_deadlines->stream_idle_ms > 0) watch->limits.stream_idle_ms = request_deadlines->stream_idle_ms;
+    }
+    watch->started_ms = watch->request_started_ms = dpinternal_monotonic_ms();
+
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, watch->limits.total_ms);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, watch->limits.connect_ms);
+    if (watch->limits.first_byte_ms > 0 || watch->limits.stream_idle_ms > 0) {
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, dpinternal_deadline_progress);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, (void*)watch);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        // A low-speed limit without a low-speed time never fails the transfer,
+        // but makes libcurl revisit it every second even when no data arrives.
+        // Without this, a silent transfer driven through dp_engine_socket_action()
+        // would never reach the progress callback.
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 0L);
+    } else {
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1L);
+    }
+}
+
+// Prepares another attempt at the same request: per-attempt limits start
+// afresh, the total limit only has what the earlier attempts left.
+void dpinternal_deadline_next_attempt(dp_deadline_watch_t* watch, CURL* curl) {
+    watch->started_ms = dpinternal_monotonic_ms();
+    watch->last_byte_ms = 0;
+    watch->received = 0;
+    watch->missed = DP_DEADLINE_NONE;
+    long remaining_ms = dpinternal_deadline_remaining_ms(watch);
+    // 0 would mean no limit to libcurl; a spent budget times out at once instead
+    if (remaining_ms == 0) remaining_ms = 1;
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, remaining_ms < 0 ? 0L : remaining_ms);
+}
+
+// What is left of the total limit, or -1 if the request has none.
+long dpinternal_deadline_remaining_ms(const dp_deadline_watch_t* watch) {
+    if (watch->limits.total_ms <= 0) return -1;
+    uint64_t elapsed = dpinternal_monotonic_ms() - watch->request_started_ms;
+    return elapsed >= (uint64_t)watch->limits.total_ms ? 0 : watch->limits.total_ms - (long)elapsed;
+}
+
+dp_deadline_kind_t dpinternal_deadline_missed(const dp_deadline_watch_t* watch, CURLcode res) {
+    if (res == CURLE_ABORTED_BY_CALLBACK) {
+        return watch->missed;
+    }
+    if (res != CURLE_OPERATION_TIMEDOUT) {
+        return DP_DEADLINE_NONE;
+    }
+    // We never set a low-speed time, so a timeout is either the overall limit
+    // or the connect limit (libcurl's own default when connect_ms is 0).
+    // libcurl rounds elapsed time up to whole milliseconds and may fire the
+    // overall timeout slightly before our own clock reaches it.
+    uint64_t elapsed = dpinternal_monotonic_ms() - watch->request_started_ms;
+    if (watch->limits.total_ms > 0 && elapsed + DP_DEADLINE_SLACK_MS >= (uint64_t)watch->limits.total_ms) {
+        return DP_DEADLINE_TOTAL;
+    }
+    return DP_DEADLINE_CONNECT;
+}
+
+char* dpinternal_deadline_message(const dp_deadline_watch_t* watch, dp_deadline_kind_t kind) {
+    char* message = NULL;
+    switch (kind) {
+        case DP_DEADLINE_TOTAL:
+            dpinternal_safe_asprintf(&message, "Deadline exceeded: request did not complete within %ld ms.", watch->limits.total_ms);
+            break;
+        case DP_DEADLINE_CONNECT:
+            if (watch->limits.connect_ms > 0) {
+                dpinternal_safe_asprintf(&message, "Deadline exceeded: connection not established within %ld ms.", watch->limits.connect_ms);
+            } else {
+                message = dpinternal_strdup("Deadline exceeded: connection not established within libcurl's connect timeout.");
+            }
+            break;
+        case DP_DEADLINE_FIRST_BYTE:
+            dpinternal_safe_asprintf(&message, "Deadline exceeded: no response data within %ld ms.", watch->limits.first_byte_ms);
+            break;
+        case DP_DEADLINE_STREAM_IDLE:
+            dpinternal_safe_asprintf(&message, "Deadline exceeded: no data received for more than %ld ms.", watch->limits.stream_idle_ms);
+            break;
+        default:
+            break;
+    }
+    return message;
+}
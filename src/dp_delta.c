@@ -0,0 +1,511 @@
+#define _GNU_SOURCE
+#include "dp_private.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Fast path for the chunks of OpenAI-compatible and Gemini streams. Each chunk
+// is scanned once, validating it as JSON while picking out the few members the
+// stream callback reads; strings are decoded into a reused scratch buffer and
+// nothing is allocated once it has grown. The scanner gives up, and the caller
+// parses the chunk with cJSON instead, whenever cJSON might read it
+// differently: a duplicate or differently cased member name, an escaped member
+// name, an array where an object is looked up, \u0000, a control character, a
+// non-integer token count, deep nesting or anything that is not strict JSON.
+
+#define DP_DELTA_MAX_DEPTH 64
+#define DP_DELTA_MAX_NUMBER_LENGTH 32
+#define DP_DELTA_MAX_COUNT_DIGITS 15    // Exact as a double, as cJSON stores it
+
+typedef struct {
+    const char* p;
+    const char* end;
+    dp_delta_scanner_t* scanner;
+    int depth;
+    dp_usage_t usage;                   // Merged into the caller's only on success
+    bool block_reason_seen;             // promptFeedback.blockReason present, whatever its type
+    const char* block_reason;
+    const char* feedback_finish_reason;
+} dp_delta_cursor_t;
+
+typedef bool (*dp_delta_member_fn)(dp_delta_cursor_t* c, int index);
+
+static bool dpinternal_delta_value(dp_delta_cursor_t* c);
+
+static void dpinternal_delta_whitespace(dp_delta_cursor_t* c) {
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\n' || *c->p == '\r' || *c->p == '\t')) c->p++;
+}
+
+static int dpinternal_delta_hex4(const char* p, const char* end, unsigned* out) {
+    if (end - p < 4) return 0;
+    unsigned value = 0;
+    for (int i = 0; i < 4; ++i) {
+        char h = p[i];
+        value <<= 4;
+        if (h >= '0' && h <= '9') value |= (unsigned)(h - '0');
+        else if (h >= 'a' && h <= 'f') value |= (unsigned)(h - 'a' + 10);
+        else if (h >= 'A' && h <= 'F') value |= (unsigned)(h - 'A' + 10);
+        else return 0;
+    }
+    *out = value;
+    return 1;
+}
+
+// Scans the string at c->p. With decoded_out, its decoded value is appended to
+// the scratch buffer, which dpinternal_delta_scan() sized for the whole chunk:
+// a decoded string and its NUL never outgrow the quoted original.
+static bool dpinternal_delta_string(dp_delta_cursor_t* c, const char** decoded_out) {
+    const char* p = c->p + 1;
+    char* out = decoded_out ? c->scanner->scratch + c->scanner->scratch_used : NULL;
+    size_t n = 0;
+    for (;;) {
+        if (p >= c->end) return false;
+        unsigned char ch = (unsigned char)*p;
+        if (ch == '"') break;
+        if (ch < 0x20) return false;
+        if (ch != '\\') {
+            if (out) out[n] = (char)ch;
+            n++;
+            p++;
+            continue;
+        }
+        if (c->end - p < 2) return false;
+        char decoded;
+        switch (p[1]) {
+            case '"': case '\\': case '/': decoded = p[1]; break;
+            case 'b': decoded = '\b'; break;
+            case 'f': decoded = '\f'; break;
+            case 'n': decoded = '\n'; break;
+            case 'r': decoded = '\r'; break;
+            case 't': decoded = '\t'; break;
+            case 'u': {
+                unsigned code;
+                if (!dpinternal_delta_hex4(p + 2, c->end, &code) || code == 0 || (code >= 0xDC00 && code <= 0xDFFF)) return false;
+                p += 6;
+                if (code >= 0xD800 && code <= 0xDBFF) {
+                    unsigned low;
+                    if (c->end - p < 6 || p[0] != '\\' || p[1] != 'u' || !dpinternal_delta_hex4(p + 2, c->end, &low) ||
+                        low < 0xDC00 || low > 0xDFFF) {
+                        return false;
+                    }
+                    p += 6;
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                char utf8[4];
+                size_t utf8_length;
+                if (code < 0x80) {
+                    utf8[0] = (char)code;
+                    utf8_length = 1;
+                } else if (code < 0x800) {
+                    utf8[0] = (char)(0xC0 | (code >> 6));
+                    utf8[1] = (char)(0x80 | (code & 0x3F));
+                    utf8_length = 2;
+                } else if (code < 0x10000) {
+                    utf8[0] = (char)(0xE0 | (code >> 12));
+                    utf8[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+                    utf8[2] = (char)(0x80 | (code & 0x3F));
+                    utf8_length = 3;
+                } else {
+                    utf8[0] = (char)(0xF0 | (code >> 18));
+                    utf8[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+                    utf8[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+                    utf8[3] = (char)(0x80 | (code & 0x3F));
+                    utf8_length = 4;
+                }
+                if (out) memcpy(out + n, utf8, utf8_length);
+                n += utf8_length;
+                continue;
+            }
+            default:
+                return false;
+        }
+        if (out) out[n] = decoded;
+        n++;
+        p += 2;
+    }
+    c->p = p + 1;
+    if (out) {
+        out[n] = '\0';
+        c->scanner->scratch_used += n + 1;
+        *decoded_out = out;
+    }
+    return true;
+}
+
+// Scans a number. With count_out, it must be an integer that fits a token count.
+static bool dpinternal_delta_number(dp_delta_cursor_t* c, long* count_out) {
+    const char* p = c->p;
+    bool negative = p < c->end && *p == '-';
+    if (negative) p++;
+    const char* digits = p;
+    if (p < c->end && *p == '0') {
+        p++;
+    } else if (p < c->end && *p >= '1' && *p <= '9') {
+        while (p < c->end && *p >= '0' && *p <= '9') p++;
+    } else {
+        return false;
+    }
+    size_t num_digits = (size_t)(p - digits);
+    bool integer = true;
+    if (p < c->end && *p == '.') {
+        integer = false;
+        p++;
+        if (p >= c->end || *p < '0' || *p > '9') return false;
+        while (p < c->end && *p >= '0' && *p <= '9') p++;
+    }
+    if (p < c->end && (*p == 'e' || *p == 'E')) {
+        integer = false;
+        p++;
+        if (p < c->end && (*p == '+' || *p == '-')) p++;
+        if (p >= c->end || *p < '0' || *p > '9') return false;
+        while (p < c->end && *p >= '0' && *p <= '9') p++;
+    }
+    if (p - c->p > DP_DELTA_MAX_NUMBER_LENGTH) return false;
+    if (count_out) {
+        if (!integer || num_digits > DP_DELTA_MAX_COUNT_DIGITS) return false;
+        long value = 0;
+        for (const char* d = digits; d < digits + num_digits; ++d) value = value * 10 + (*d - '0');
+        *count_out = negative ? -value : value;
+    }
+    c->p = p;
+    return true;
+}
+
+static bool dpinternal_delta_literal(dp_delta_cursor_t* c, const char* literal, size_t length) {
+    if ((size_t)(c->end - c->p) < length || memcmp(c->p, literal, length) != 0) return false;
+    c->p += length;
+    return true;
+}
+
+// Index of the member name among names, -1 for another member, or -2 when
+// the name differs from one of them only in case, which cJSON may match
+static int dpinternal_delta_lookup(const char* const names[], int num_names, const char* key, size_t key_length) {
+    for (int i = 0; i < num_names; ++i) {
+        if (strlen(names[i]) != key_length) continue;
+        if (memcmp(names[i], key, key_length) == 0) return i;
+        if (strncasecmp(names[i], key, key_length) == 0) return -2;
+    }
+    return -1;
+}
+
+// Scans the object at c->p, handing the members named in names to member and
+// skipping the others
+static bool dpinternal_delta_object(dp_delta_cursor_t* c, const char* const names[], int num_names, dp_delta_member_fn member) {
+    if (++c->depth > DP_DELTA_MAX_DEPTH) return false;
+    c->p++;
+    dpinternal_delta_whitespace(c);
+    if (c->p < c->end && *c->p == '}') {
+        c->p++;
+        c->depth--;
+        return true;
+    }
+    unsigned seen = 0;
+    for (;;) {
+        dpinternal_delta_whitespace(c);
+        if (c->p >= c->end || *c->p != '"') return false;
+        const char* key = ++c->p;
+        while (c->p < c->end && *c->p != '"' && *c->p != '\\' && (unsigned char)*c->p >= 0x20) c->p++;
+        if (c->p >= c->end || *c->p != '"') return false;
+        size_t key_length = (size_t)(c->p - key);
+        c->p++;
+        dpinternal_delta_whitespace(c);
+        if (c->p >= c->end || *c->p != ':') return false;
+        c->p++;
+        dpinternal_delta_whitespace(c);
+        if (c->p >= c->end) return false;
+
+        int index = member ? dpinternal_delta_lookup(names, num_names, key, key_length) : -1;
+        if (index == -2) return false;
+        if (index >= 0) {
+            // cJSON would read the first of two members with the same name
+            if (seen & (1u << index)) return false;
+            seen |= 1u << index;
+            if (!member(c, index)) return false;
+        } else if (!dpinternal_delta_value(c)) {
+            return false;
+        }
+
+        dpinternal_delta_whitespace(c);
+        if (c->p >= c->end) return false;
+        if (*c->p == ',') {
+            c->p++;
+            continue;
+        }
+        if (*c->p != '}') return false;
+        c->p++;
+        c->depth--;
+        return true;
+    }
+}
+
+// Scans the array at c->p, handing each element to element, or skipping it
+static bool dpinternal_delta_array(dp_delta_cursor_t* c, bool (*element)(dp_delta_cursor_t* c, size_t index)) {
+    if (++c->depth > DP_DELTA_MAX_DEPTH) return false;
+    c->p++;
+    dpinternal_delta_whitespace(c);
+    if (c->p < c->end && *c->p == ']') {
+        c->p++;
+        c->depth--;
+        return true;
+    }
+    for (size_t index = 0;; ++index) {
+        dpinternal_delta_whitespace(c);
+        if (c->p >= c->end) return false;
+        if (!(element ? element(c, index) : dpinternal_delta_value(c))) return false;
+        dpinternal_delta_whitespace(c);
+        if (c->p >= c->end) return false;
+        if (*c->p == ',') {
+            c->p++;
+            continue;
+        }
+        if (*c->p != ']') return false;
+        c->p++;
+        c->depth--;
+        return true;
+    }
+}
+
+// Skips any value
+static bool dpinternal_delta_value(dp_delta_cursor_t* c) {
+    switch (*c->p) {
+        case '"': return dpinternal_delta_string(c, NULL);
+        case '{': return dpinternal_delta_object(c, NULL, 0, NULL);
+        case '[': return dpinternal_delta_array(c, NULL);
+        case 't': return dpinternal_delta_literal(c, "true", 4);
+        case 'f': return dpinternal_delta_literal(c, "false", 5);
+        case 'n': return dpinternal_delta_literal(c, "null", 4);
+        default: return dpinternal_delta_number(c, NULL);
+    }
+}
+
+// A string member; any other value reads as absent
+static bool dpinternal_delta_string_member(dp_delta_cursor_t* c, const char** out) {
+    return *c->p == '"' ? dpinternal_delta_string(c, out) : dpinternal_delta_value(c);
+}
+
+// A member looked up as an object. Anything else reads as absent, except an
+// array, whose elements cJSON versions disagree on.
+static bool dpinternal_delta_object_member(dp_delta_cursor_t* c, const char* const names[], int num_names, dp_delta_member_fn member) {
+    if (*c->p == '[') return false;
+    return *c->p == '{' ? dpinternal_delta_object(c, names, num_names, member) : dpinternal_delta_value(c);
+}
+
+// A token count: a positive number overwrites it, anything else is ignored
+static bool dpinternal_delta_count_member(dp_delta_cursor_t* c, long* out) {
+    if (*c->p != '-' && (*c->p < '0' || *c->p > '9')) return dpinternal_delta_value(c);
+    long value = 0;
+    if (!dpinternal_delta_number(c, &value)) return false;
+    if (value > 0) *out = value;
+    return true;
+}
+
+// OpenAI: {"choices": [{"delta": {"content", "reasoning_content"}, "finish_reason"}], "usage": {...}}
+
+static const char* const openai_delta_names[] = { "content", "reasoning_content" };
+
+static bool dpinternal_delta_openai_delta(dp_delta_cursor_t* c, int index) {
+    dp_stream_delta_t* delta = &c->scanner->delta;
+    return dpinternal_delta_string_member(c, index == 0 ? &delta->content : &delta->reasoning_content);
+}
+
+static const char* const openai_choice_names[] = { "delta", "finish_reason" };
+
+static bool dpinternal_delta_openai_choice(dp_delta_cursor_t* c, int index) {
+    if (index == 0) return dpinternal_delta_object_member(c, openai_delta_names, 2, dpinternal_delta_openai_delta);
+    return dpinternal_delta_string_member(c, &c->scanner->delta.finish_reason);
+}
+
+static bool dpinternal_delta_openai_choices(dp_delta_cursor_t* c, size_t index) {
+    if (index > 0) return dpinternal_delta_value(c);
+    return dpinternal_delta_object_member(c, openai_choice_names, 2, dpinternal_delta_openai_choice);
+}
+
+static const char* const openai_details_names[] = { "cached_tokens" };
+
+static bool dpinternal_delta_openai_details(dp_delta_cursor_t* c, int index) {
+    (void)index;
+    return dpinternal_delta_count_member(c, &c->usage.cache_read_input_tokens);
+}
+
+static const char* const openai_usage_names[] = { "prompt_tokens", "completion_tokens", "prompt_tokens_details" };
+
+static bool dpinternal_delta_openai_usage(dp_delta_cursor_t* c, int index) {
+    if (index == 0) return dpinternal_delta_count_member(c, &c->usage.input_tokens);
+    if (index == 1) return dpinternal_delta_count_member(c, &c->usage.output_tokens);
+    return dpinternal_delta_object_member(c, openai_details_names, 1, dpinternal_delta_openai_details);
+}
+
+static const char* const openai_root_names[] = { "choices", "usage" };
+
+static bool dpinternal_delta_openai_root(dp_delta_cursor_t* c, int index) {
+    if (index == 0) return *c->p == '[' ? dpinternal_delta_array(c, dpinternal_delta_openai_choices) : dpinternal_delta_value(c);
+    // Only an object is read as usage, so an array is as good as absent
+    if (*c->p == '{') return dpinternal_delta_object(c, openai_usage_names, 3, dpinternal_delta_openai_usage);
+    return dpinternal_delta_value(c);
+}
+
+// Gemini: {"candidates": [{"content": {"parts": [{"text", "thought"}]}, "finishReason"}],
+//          "promptFeedback": {"blockReason", "finishReason"}, "usageMetadata": {...}}
+
+static const char* const gemini_part_names[] = { "text", "thought" };
+
+static bool dpinternal_delta_gemini_part(dp_delta_cursor_t* c, int index) {
+    dp_delta_part_t* part = &c->scanner->parts[c->scanner->delta.num_parts - 1];
+    if (index == 0) return dpinternal_delta_string_member(c, &part->text);
+    if (*c->p == 't') {
+        part->thought = true;
+        return dpinternal_delta_literal(c, "true", 4);
+    }
+    return dpinternal_delta_value(c);
+}
+
+static bool dpinternal_delta_gemini_parts(dp_delta_cursor_t* c, size_t index) {
+    (void)index;
+    if (*c->p != '{') return dpinternal_delta_object_member(c, NULL, 0, NULL);
+    dp_delta_scanner_t* scanner = c->scanner;
+    if (scanner->delta.num_parts == scanner->parts_capacity) {
+        size_t new_capacity = scanner->parts_capacity ? scanner->parts_capacity * 2 : 4;
+        dp_delta_part_t* new_parts = realloc(scanner->parts, new_capacity * sizeof(dp_delta_part_t));
+        if (!new_parts) return false;
+        scanner->parts = new_parts;
+        scanner->parts_capacity = new_capacity;
+    }
+    scanner->parts[scanner->delta.num_parts++] = (dp_delta_part_t){ .text = NULL, .thought = false };
+    if (!dpinternal_delta_object(c, gemini_part_names, 2, dpinternal_delta_gemini_part)) return false;
+    // A part with neither text nor a thought flag, such as a function call, is not recorded
+    const dp_delta_part_t* part = &scanner->parts[scanner->delta.num_parts - 1];
+    if (!part->text && !part->thought) scanner->delta.num_parts--;
+    return true;
+}
+
+static const char* const gemini_content_names[] = { "parts" };
+
+static bool dpinternal_delta_gemini_content(dp_delta_cursor_t* c, int index) {
+    (void)index;
+    return *c->p == '[' ? dpinternal_delta_array(c, dpinternal_delta_gemini_parts) : dpinternal_delta_value(c);
+}
+
+static const char* const gemini_candidate_names[] = { "content", "finishReason" };
+
+static bool dpinternal_delta_gemini_candidate(dp_delta_cursor_t* c, int index) {
+    if (index == 0) return dpinternal_delta_object_member(c, gemini_content_names, 1, dpinternal_delta_gemini_content);
+    return dpinternal_delta_string_member(c, &c->scanner->delta.finish_reason);
+}
+
+static bool dpinternal_delta_gemini_candidates(dp_delta_cursor_t* c, size_t index) {
+    if (index > 0) return dpinternal_delta_value(c);
+    return dpinternal_delta_object_member(c, gemini_candidate_names, 2, dpinternal_delta_gemini_candidate);
+}
+
+static const char* const gemini_feedback_names[] = { "blockReason", "finishReason" };
+
+static bool dpinternal_delta_gemini_feedback(dp_delta_cursor_t* c, int index) {
+    if (index == 1) return dpinternal_delta_string_member(c, &c->feedback_finish_reason);
+    c->block_reason_seen = true;
+    return dpinternal_delta_string_member(c, &c->block_reason);
+}
+
+static const char* const gemini_usage_names[] = { "promptTokenCount", "candidatesTokenCount", "cachedContentTokenCount" };
+
+static bool dpinternal_delta_gemini_usage(dp_delta_cursor_t* c, int index) {
+    if (index == 0) return dpinternal_delta_count_member(c, &c->usage.input_tokens);
+    if (index == 1) return dpinternal_delta_count_member(c, &c->usage.output_tokens);
+    return dpinternal_delta_count_member(c, &c->usage.cache_read_input_tokens);
+}
+
+static const char* const gemini_root_names[] = { "candidates", "promptFeedback", "usageMetadata" };
+
+static bool dpinternal_delta_gemini_root(dp_delta_cursor_t* c, int index) {
+    if (index == 0) return *c->p == '[' ? dpinternal_delta_array(c, dpinternal_delta_gemini_candidates) : dpinternal_delta_value(c);
+    if (index == 1) return dpinternal_delta_object_member(c, gemini_feedback_names, 2, dpinternal_delta_gemini_feedback);
+    return dpinternal_delta_object_member(c, gemini_usage_names, 3, dpinternal_delta_gemini_usage);
+}
+
+// Reads the chunk's fields into scanner->delta and merges its token counts
+// into usage. Returns false, leaving usage alone, for a chunk the scanner does
+// not read exactly as cJSON would; the caller then parses it with cJSON.
+bool dpinternal_delta_scan(dp_delta_scanner_t* scanner, dp_provider_type_t provider, const char* json, size_t length, dp_usage_t* usage) {
+    if (provider != DP_PROVIDER_OPENAI_COMPATIBLE && provider != DP_PROVIDER_GOOGLE_GEMINI) return false;
+    if (length + 1 > scanner->scratch_capacity) {
+        size_t new_capacity = scanner->scratch_capacity ? scanner->scratch_capacity : 256;
+        while (new_capacity < length + 1) new_capacity *= 2;
+        char* new_scratch = realloc(scanner->scratch, new_capacity);
+        if (!new_scratch) return false;
+        scanner->scratch = new_scratch;
+        scanner->scratch_capacity = new_capacity;
+    }
+    memset(&scanner->delta, 0, sizeof(scanner->delta));
+    scanner->scratch_used = 0;
+
+    dp_delta_cursor_t c = { .p = json, .end = json + length, .scanner = scanner, .usage = *usage };
+    dpinternal_delta_whitespace(&c);
+    if (c.p >= c.end || *c.p != '{') return false;
+    bool scanned = provider == DP_PROVIDER_OPENAI_COMPATIBLE
+        ? dpinternal_delta_object(&c, openai_root_names, 2, dpinternal_delta_openai_root)
+        : dpinternal_delta_object(&c, gemini_root_names, 3, dpinternal_delta_gemini_root);
+    if (!scanned) return false;
+    dpinternal_delta_whitespace(&c);
+    if (c.p != c.end) return false;
+
+    scanner->delta.parts = scanner->parts;
+    scanner->delta.prompt_feedback_reason = c.block_reason_seen ? c.block_reason : c.feedback_finish_reason;
+    *usage = c.usage;
+    return true;
+}
+
+static const char* dpinternal_delta_json_string(const cJSON* item) {
+    return cJSON_IsString(item) ? item->valuestring : NULL;
+}
+
+// Reads the same fields from a chunk cJSON has parsed; strings point into
+// root. Returns NULL only when recording Gemini parts runs out of memory.
+const dp_stream_delta_t* dpinternal_delta_from_json(dp_delta_scanner_t* scanner, dp_provider_type_t provider, const cJSON* root) {
+    dp_stream_delta_t* delta = &scanner->delta;
+    memset(delta, 0, sizeof(*delta));
+    delta->parts = scanner->parts;
+    if (provider == DP_PROVIDER_OPENAI_COMPATIBLE) {
+        const cJSON* choices = cJSON_GetObjectItemCaseSensitive(root, "choices");
+        if (cJSON_IsArray(choices) && cJSON_GetArraySize(choices) > 0) {
+            const cJSON* choice = cJSON_GetArrayItem(choices, 0);
+            const cJSON* choice_delta = cJSON_GetObjectItemCaseSensitive(choice, "delta");
+            delta->content = dpinternal_delta_json_string(cJSON_GetObjectItemCaseSensitive(choice_delta, "content"));
+            delta->reasoning_content = dpinternal_delta_json_string(cJSON_GetObjectItemCaseSensitive(choice_delta, "reasoning_content"));
+            delta->finish_reason = dpinternal_delta_json_string(cJSON_GetObjectItemCaseSensitive(choice, "finish_reason"));
+        }
+    } else if (provider == DP_PROVIDER_GOOGLE_GEMINI) {
+        const cJSON* candidates = cJSON_GetObjectItemCaseSensitive(root, "candidates");
+        if (cJSON_IsArray(candidates) && cJSON_GetArraySize(candidates) > 0) {
+            const cJSON* candidate = cJSON_GetArrayItem(candidates, 0);
+            const cJSON* content = cJSON_GetObjectItemCaseSensitive(candidate, "content");
+            const cJSON* parts = cJSON_GetObjectItemCaseSensitive(content, "parts");
+            if (cJSON_IsArray(parts)) {
+                const cJSON* part = NULL;
+                cJSON_ArrayForEach(part, parts) {
+                    bool thought = cJSON_IsTrue(cJSON_GetObjectItemCaseSensitive(part, "thought"));
+                    const char* text = dpinternal_delta_json_string(cJSON_GetObjectItemCaseSensitive(part, "text"));
+                    if (!text && !thought) continue;
+                    if (delta->num_parts == scanner->parts_capacity) {
+                        size_t new_capacity = scanner->parts_capacity ? scanner->parts_capacity * 2 : 4;
+                        dp_delta_part_t* new_parts = realloc(scanner->parts, new_capacity * sizeof(dp_delta_part_t));
+                        if (!new_parts) return NULL;
+                        scanner->parts = new_parts;
+                        delta->parts = new_parts;
+                        scanner->parts_capacity = new_capacity;
+                    }
+                    scanner->parts[delta->num_parts++] = (dp_delta_part_t){ .text = text, .thought = thought };
+                }
+            }
+            delta->finish_reason = dpinternal_delta_json_string(cJSON_GetObjectItemCaseSensitive(candidate, "finishReason"));
+        }
+        const cJSON* prompt_feedback = cJSON_GetObjectItemCaseSensitive(root, "promptFeedback");
+        const cJSON* reason = cJSON_GetObjectItemCaseSensitive(prompt_feedback, "blockReason");
+        if (!reason) reason = cJSON_GetObjectItemCaseSensitive(prompt_feedback, "finishReason");
+        delta->prompt_feedback_reason = dpinternal_delta_json_string(reason);
+    }
+    return delta;
+}
+
+void dpinternal_delta_free(dp_delta_scanner_t* scanner) {
+    free(scanner->scratch);
+    free(scanner->parts);
+    memset(scanner, 0, sizeof(*scanner));
+}
@@ -0,0 +1,389 @@
+#define _GNU_SOURCE
+#include "disasterparty.h"
+#include "dp_private.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Asynchronous engine: transfers from any number of contexts are added to a
+// single curl_multi handle and driven either by dp_engine_perform() or, for
+// applications with their own event loop, by dp_engine_socket_action() plus
+// the socket/timer hooks. All engine calls must come from one thread.
+//
+// A request that fails transiently under its context's retry policy leaves the
+// multi handle for its backoff and is re-added once retry_at_ms passes; the
+// engine folds those wake-ups into the timer it reports to the application.
+// A request whose context's rate limiter has no capacity waits the same way
+// before it is first added; one whose circuit breaker is open is refused at
+// submission.
+
+static int dpinternal_engine_socket_cb(CURL* easy, curl_socket_t s, int what, void* userp, void* socketp) {
+    (void)easy; (void)socketp;
+    dp_engine_t* engine = (dp_engine_t*)userp;
+    if (!engine->socket_cb) return 0;
+
+    int dp_what = 0;
+    switch (what) {
+        case CURL_POLL_IN: dp_what = DP_ENGINE_POLL_IN; break;
+        case CURL_POLL_OUT: dp_what = DP_ENGINE_POLL_OUT; break;
+        case CURL_POLL_INOUT: dp_what = DP_ENGINE_POLL_IN | DP_ENGINE_POLL_OUT; break;
+        case CURL_POLL_REMOVE: dp_what = DP_ENGINE_POLL_REMOVE; break;
+        default: return 0;
+    }
+    return engine->socket_cb((int)s, dp_what, engine->hooks_user_data) == 0 ? 0 : -1;
+}
+
+// Milliseconds until the earliest retry is due, or -1 if none is waiting.
+static long dpinternal_engine_retry_timeout(const dp_engine_t* engine, uint64_t now) {
+    if (engine->num_waiting == 0) return -1;
+    uint64_t earliest = UINT64_MAX;
+    for (const dp_engine_request_t* req = engine->requests; req; req = req->next) {
+        if (req->retry_at_ms != 0 && req->retry_at_ms < earliest) earliest = req->retry_at_ms;
+    }
+    return earliest <= now ? 0 : (long)(earliest - now);
+}
+
+// Reports the earlier of libcurl's own timeout and the next retry to the application's timer hook.
+static int dpinternal_engine_update_timer(dp_engine_t* engine) {
+    if (!engine->timer_cb) return 0;
+    uint64_t now = dpinternal_monotonic_ms();
+    long timeout_ms = dpinternal_engine_retry_timeout(engine, now);
+    if (engine->curl_timer_due_ms != 0) {
+        long curl_ms = engine->curl_timer_due_ms <= now ? 0 : (long)(engine->curl_timer_due_ms - now);
+        if (timeout_ms < 0 || curl_ms < timeout_ms) timeout_ms = curl_ms;
+    }
+    return engine->timer_cb(timeout_ms, engine->hooks_user_data) == 0 ? 0 : -1;
+}
+
+static int dpinternal_engine_timer_cb(CURLM* multi, long timeout_ms, void* userp) {
+    (void)multi;
+    dp_engine_t* engine = (dp_engine_t*)userp;
+    engine->curl_timer_due_ms = timeout_ms < 0 ? 0 : dpinternal_monotonic_ms() + (uint64_t)timeout_ms;
+    return dpinternal_engine_update_timer(engine);
+}
+
+dp_engine_t* dp_engine_create(void) {
+    dp_engine_t* engine = calloc(1, sizeof(dp_engine_t));
+    if (!engine) return NULL;
+    engine->multi = curl_multi_init();
+    if (!engine->multi) {
+        free(engine);
+        return NULL;
+    }
+    // Lets HTTP/2 requests to the same host share a connection
+    curl_multi_setopt(engine->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    return engine;
+}
+
+// An engine on a multi handle from context's pool, for callers inside the
+// library that finish with it before returning. The multi goes back to the
+// pool on destruction, keeping its connections for the next such engine.
+// Such an engine must not get event hooks or a host connection limit.
+dp_engine_t* dpinternal_engine_create_pooled(dp_context_t* context) {
+    dp_engine_t* engine = calloc(1, sizeof(dp_engine_t));
+    if (!engine) return NULL;
+    engine->multi = dpinternal_pool_acquire_multi(context);
+    if (!engine->multi) {
+        free(engine);
+        return NULL;
+    }
+    engine->multi_pool = context;
+    return engine;
+}
+
+static void dpinternal_engine_unlink(dp_engine_t* engine, dp_engine_request_t* req) {
+    if (req->prev) req->prev->next = req->next; else engine->requests = req->next;
+    if (req->next) req->next->prev = req->prev;
+    engine->num_in_flight--;
+}
+
+void dp_engine_destroy(dp_engine_t* engine) {
+    if (!engine) return;
+    // Outstanding requests are cancelled; their callbacks still run so callers can release resources.
+    while (engine->requests) {
+        dp_engine_request_t* req = engine->requests;
+        dpinternal_engine_unlink(engine, req);
+        if (req->retry_at_ms == 0) curl_multi_remove_handle(engine->multi, req->transfer.curl);
+
+        dp_response_t* response = req->transfer.response;
+        dp_completion_callback_t on_done = req->on_done;
+        void* user_data = req->user_data;
+        dpinternal_transfer_cleanup(&req->transfer);
+        free(req);
+
+        free(response->error_message);
+        response->error_message = dpinternal_strdup("Request cancelled: engine destroyed before completion.");
+        response->error_class = DP_ERROR_CANCELLED;
+        if (on_done) on_done(response, -1, user_data);
+    }
+    if (engine->multi_pool) {
+        dpinternal_pool_release_multi(engine->multi_pool, engine->multi);
+    } else {
+        curl_multi_cleanup(engine->multi);
+    }
+    free(engine);
+}
+
+int dp_engine_set_event_hooks(dp_engine_t* engine,
+                              dp_engine_socket_callback_t socket_callback,
+                              dp_engine_timer_callback_t timer_callback,
+                              void* user_data) {
+    if (!engine) return -1;
+    engine->socket_cb = socket_callback;
+    engine->timer_cb = timer_callback;
+    engine->hooks_user_data = user_data;
+    curl_multi_setopt(engine->multi, CURLMOPT_SOCKETFUNCTION, socket_callback ? dpinternal_engine_socket_cb : NULL);
+    curl_multi_setopt(engine->multi, CURLMOPT_SOCKETDATA, engine);
+    curl_multi_setopt(engine->multi, CURLMOPT_TIMERFUNCTION, timer_callback ? dpinternal_engine_timer_cb : NULL);
+    curl_multi_setopt(engine->multi, CURLMOPT_TIMERDATA, engine);
+    return 0;
+}
+
+int dp_engine_set_max_host_connections(dp_engine_t* engine, long max_connections) {
+    if (!engine || max_connections < 0) return -1;
+    return curl_multi_setopt(engine->multi, CURLMOPT_MAX_HOST_CONNECTIONS, max_connections) == CURLM_OK ? 0 : -1;
+}
+
+static int dpinternal_engine_submit(dp_engine_t* engine,
+                                    dp_context_t* context,
+                                    const dp_request_config_t* request_config,
+                                    dp_transfer_kind_t kind,
+                                    dp_stream_callback_t callback,
+                                    dp_response_t* response,
+                                    dp_completion_callback_t on_done,
+                                    void* user_data) {
+    dp_engine_request_t* req = calloc(1, sizeof(dp_engine_request_t));
+    if (!req) {
+        response->error_message = dpinternal_strdup("Failed to allocate engine request.");
+        response->error_class = DP_ERROR_OTHER;
+        return -1;
+    }
+    if (dpinternal_transfer_init(&req->transfer, context, request_config, kind, callback, NULL, user_data, response) != 0) {
+        free(req);
+        return -1;
+    }
+    req->engine = engine;
+    req->on_done = on_done;
+    req->user_data = user_data;
+
+    if (dpinternal_breaker_admit(&req->transfer) != 0) {
+        dpinternal_transfer_cleanup(&req->transfer);
+        free(req);
+        return -1;
+    }
+    long wait_ms = dpinternal_rate_limit_try(&req->transfer);
+    if (wait_ms > 0 && !dpinternal_rate_limit_wait_fits(&req->transfer, wait_ms)) {
+        // Capacity would come after the total deadline
+        dpinternal_rate_limit_refuse(&req->transfer, wait_ms);
+        dpinternal_transfer_cleanup(&req->transfer);
+        free(req);
+        return -1;
+    } else if (wait_ms > 0) {
+        // Queue outside the multi handle until the limiter has capacity
+        req->awaiting_rate_limit = true;
+        req->retry_at_ms = dpinternal_monotonic_ms() + (uint64_t)wait_ms;
+        engine->num_waiting++;
+    } else if (curl_multi_add_handle(engine->multi, req->transfer.curl) != CURLM_OK) {
+        dpinternal_transfer_cleanup(&req->transfer);
+        free(req);
+        response->error_message = dpinternal_strdup("curl_multi_add_handle() failed.");
+        response->error_class = DP_ERROR_OTHER;
+        return -1;
+    }
+    req->next = engine->requests;
+    if (engine->requests) engine->requests->prev = req;
+    engine->requests = req;
+    engine->num_in_flight++;
+    dpinternal_retry_note_request(context);
+    if (req->awaiting_rate_limit) dpinternal_engine_update_timer(engine);
+    return 0;
+}
+
+int dp_submit_completion(dp_engine_t* engine,
+                         dp_context_t* context,
+                         const dp_request_config_t* request_config,
+                         dp_response_t* response,
+                         dp_completion_callback_t on_done,
+                         void* user_data) {
+    if (!engine || !context || !request_config || !response) {
+        if (response) {
+            response->error_message = dpinternal_strdup("Invalid arguments to dp_submit_completion.");
+            response->error_class = DP_ERROR_OTHER;
+        }
+        return -1;
+    }
+    if (request_config->stream) {
+        response->error_message = dpinternal_strdup("dp_submit_completion called with stream=true. Use dp_submit_streaming_completion instead.");
+        response->error_class = DP_ERROR_OTHER;
+        return -1;
+    }
+    return dpinternal_engine_submit(engine, context, request_config, DP_TRANSFER_COMPLETION, NULL, response, on_done, user_data);
+}
+
+int dp_submit_streaming_completion(dp_engine_t* engine,
+                                   dp_context_t* context,
+                                   const dp_request_config_t* request_config,
+                                   dp_stream_callback_t callback,
+                                   dp_response_t* response,
+                                   dp_completion_callback_t on_done,
+                                   void* user_data) {
+    if (!engine || !context || !request_config || !callback || !response) {
+        if (response) {
+            response->error_message = dpinternal_strdup("Invalid arguments to dp_submit_streaming_completion.");
+            response->error_class = DP_ERROR_OTHER;
+        }
+        return -1;
+    }
+    return dpinternal_engine_submit(engine, context, request_config, DP_TRANSFER_STREAM, callback, response, on_done, user_data);
+}
+
+static void dpinternal_engine_complete(dp_engine_t* engine, dp_engine_request_t* req) {
+    dpinternal_engine_unlink(engine, req);
+    dp_response_t* response = req->transfer.response;
+    dp_completion_callback_t on_done = req->on_done;
+    void* user_data = req->user_data;
+    dpinternal_transfer_cleanup(&req->transfer);
+    free(req);
+
+    // Called last, with the handle back in the pool, so the callback may submit follow-up requests
+    if (on_done) on_done(response, response->error_message ? -1 : 0, user_data);
+}
+
+// Puts requests whose retry backoff has elapsed, or whose rate limiter now has
+// capacity, into the multi handle. Both need the limiter: a first attempt for
+// its full charge, a retry for one request.
+static void dpinternal_engine_resume_retries(dp_engine_t* engine) {
+    if (engine->num_waiting == 0) return;
+    uint64_t now = dpinternal_monotonic_ms();
+    dp_engine_request_t* req = engine->requests;
+    while (req) {
+        dp_engine_request_t* next = req->next;
+        if (req->retry_at_ms != 0 && req->retry_at_ms <= now) {
+            if (req->awaiting_rate_limit) {
+                // Queue time counts towards the total deadline; give up once capacity would come too late
+                long wait_ms = dpinternal_rate_limit_try(&req->transfer);
+                if (wait_ms > 0) {
+                    if (dpinternal_rate_limit_wait_fits(&req->transfer, wait_ms)) {
+                        req->retry_at_ms = now + (uint64_t)wait_ms;
+                    } else {
+                        req->retry_at_ms = 0;
+                        engine->num_waiting--;
+                        dpinternal_rate_limit_refuse(&req->transfer, wait_ms);
+                        dpinternal_engine_complete(engine, req);
+                    }
+                    req = next;
+                    continue;
+                }
+                req->awaiting_rate_limit = false;
+                dpinternal_deadline_next_attempt(&req->transfer.deadline, req->transfer.curl);
+            } else {
+                // A retry needs a request token of its own; wait for it unless it
+                // would come after the deadline, which ends the request with its last error
+                long wait_ms = dpinternal_rate_limit_try_attempt(&req->transfer);
+                if (wait_ms > 0) {
+                    if (dpinternal_rate_limit_wait_fits(&req->transfer, wait_ms)) {
+                        req->retry_at_ms = now + (uint64_t)wait_ms;
+                    } else {
+                        req->retry_at_ms = 0;
+                        engine->num_waiting--;
+                        dpinternal_engine_complete(engine, req);
+                    }
+                    req = next;
+                    continue;
+                }
+                dpinternal_transfer_reset_for_retry(&req->transfer);
+            }
+            req->retry_at_ms = 0;
+            engine->num_waiting--;
+            if (curl_multi_add_handle(engine->multi, req->transfer.curl) != CURLM_OK) {
+                req->transfer.response->error_message = dpinternal_strdup("curl_multi_add_handle() failed.");
+                req->transfer.response->error_class = DP_ERROR_OTHER;
+                dpinternal_engine_complete(engine, req);
+            }
+        }
+        req = next;
+    }
+}
+
+static void dpinternal_engine_process_messages(dp_engine_t* engine) {
+    CURLMsg* msg;
+    int msgs_left;
+    while ((msg = curl_multi_info_read(engine->multi, &msgs_left))) {
+        if (msg->msg != CURLMSG_DONE) continue;
+        CURL* easy = msg->easy_handle;
+        CURLcode res = msg->data.result;
+        dp_engine_request_t* req = NULL;
+        curl_easy_getinfo(easy, CURLINFO_PRIVATE, (char**)&req);
+        curl_multi_remove_handle(engine->multi, easy);
+
+        // OpenAI token parameter fallback: resubmit the same handle with the
+        // legacy payload. It needs a request token like a retry; without one at
+        // hand the rejection is finished and the new payload waits for a token
+        // as a retry does, returning the rejection if none comes in time.
+        long delay = -1;
+        if (dpinternal_transfer_needs_fallback(&req->transfer, res)) {
+            long wait_ms = dpinternal_rate_limit_try_attempt(&req->transfer);
+            if (wait_ms == 0 && dpinternal_transfer_prepare_fallback(&req->transfer)) {
+                req->transfer.attempts++;
+                if (curl_multi_add_handle(engine->multi, easy) == CURLM_OK) continue;
+            } else if (wait_ms > 0 && dpinternal_rate_limit_wait_fits(&req->transfer, wait_ms)) {
+                delay = wait_ms;
+            }
+        }
+
+        dpinternal_transfer_finish(&req->transfer, res);
+        if (delay >= 0 && !dpinternal_transfer_use_max_tokens(&req->transfer)) delay = -1;
+        if (delay < 0) delay = dpinternal_transfer_retry_delay(&req->transfer, res);
+        if (delay >= 0) {
+            // Park outside the multi handle; the response is reset when the retry starts
+            req->retry_at_ms = dpinternal_monotonic_ms() + (uint64_t)delay;
+            if (req->retry_at_ms == 0) req->retry_at_ms = 1;
+            engine->num_waiting++;
+            dpinternal_engine_update_timer(engine);
+            continue;
+        }
+        dpinternal_engine_complete(engine, req);
+    }
+}
+
+int dp_engine_perform(dp_engine_t* engine, int timeout_ms, size_t* in_flight_out) {
+    if (!engine) return -1;
+    int running = 0;
+    dpinternal_engine_resume_retries(engine);
+    CURLMcode mc = curl_multi_perform(engine->multi, &running);
+    dpinternal_engine_process_messages(engine);
+
+    if (mc == CURLM_OK && engine->num_in_flight > 0 && timeout_ms > 0) {
+        // Wake in time for the next retry even if no socket becomes ready
+        long retry_ms = dpinternal_engine_retry_timeout(engine, dpinternal_monotonic_ms());
+        if (retry_ms >= 0 && retry_ms < timeout_ms) timeout_ms = (int)retry_ms;
+        if (engine->num_waiting == engine->num_in_flight) {
+            // Everything is backing off; curl_multi_wait() would return at once with no sockets
+            dpinternal_sleep_ms(timeout_ms);
+        } else {
+            mc = curl_multi_wait(engine->multi, NULL, 0, timeout_ms, NULL);
+        }
+        if (mc == CURLM_OK) {
+            dpinternal_engine_resume_retries(engine);
+            mc = curl_multi_perform(engine->multi, &running);
+            dpinternal_engine_process_messages(engine);
+        }
+    }
+    if (in_flight_out) *in_flight_out = engine->num_in_flight;
+    return mc == CURLM_OK ? 0 : -1;
+}
+
+int dp_engine_socket_action(dp_engine_t* engine, int fd, int events, size_t* in_flight_out) {
+    if (!engine) return -1;
+    int mask = 0;
+    if (events & DP_ENGINE_EVENT_IN) mask |= CURL_CSELECT_IN;
+    if (events & DP_ENGINE_EVENT_OUT) mask |= CURL_CSELECT_OUT;
+    if (events & DP_ENGINE_EVENT_ERR) mask |= CURL_CSELECT_ERR;
+
+    int running = 0;
+    dpinternal_engine_resume_retries(engine);
+    curl_socket_t s = fd == DP_ENGINE_SOCKET_TIMEOUT ? CURL_SOCKET_TIMEOUT : (curl_socket_t)fd;
+    CURLMcode mc = curl_multi_socket_action(engine->multi, s, fd == DP_ENGINE_SOCKET_TIMEOUT ? 0 : mask, &running);
+    dpinternal_engine_process_messages(engine);
+    if (in_flight_out) *in_flight_out = engine->num_in_flight;
+    return mc == CURLM_OK ? 0 : -1;
+}
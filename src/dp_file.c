@@ -276,7 +276,7 @@ int dp_upload_file(dp_context_t* context, const char* file_path, const char* mim
     fclose(fp);
 
     // Initialize CURL for file upload
-    CURL* curl = curl_easy_init();
+    CURL* curl = dpinternal_pool_acquire(context);
     if (!curl) {
         free(file_content);
         (*file_out)->http_status_code = 0;
@@ -285,14 +285,21 @@ int dp_upload_file(dp_context_t* context, const char* file_path, const char* mim
     }
 
     // Prepare URL for Gemini file upload
-    char url[1024];
-    snprintf(url, sizeof(url), "%s/v1/files:upload?key=%s", context->api_base_url, context->api_key);
+    char* url = NULL;
+    if (dpinternal_safe_asprintf(&url, "%s/v1/files:upload?%s", context->api_base_url, context->key_query) < 0) {
+        free(file_content);
+        dpinternal_pool_release(context, curl);
+        (*file_out)->http_status_code = 0;
+        (*file_out)->error_message = dpinternal_strdup("Failed to allocate upload URL.");
+        return -1;
+    }
 
     // Prepare response buffer
     memory_struct_t chunk_mem = { .memory = malloc(1), .size = 0 };
     if (!chunk_mem.memory) {
         free(file_content);
-        curl_easy_cleanup(curl);
+        free(url);
+        dpinternal_pool_release(context, curl);
         (*file_out)->http_status_code = 0;
         (*file_out)->error_message = dpinternal_strdup("Failed to allocate response buffer.");
         return -1;
@@ -315,17 +322,27 @@ int dp_upload_file(dp_context_t* context, const char* file_path, const char* mim
     headers = curl_slist_append(headers, content_type_header);
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
 
+    dp_deadline_watch_t deadline;
+    dpinternal_deadline_arm(&deadline, curl, context, NULL);
+
     // Perform the request
     CURLcode res = curl_easy_perform(curl);
     long http_code = 0;
     curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
     (*file_out)->http_status_code = http_code;
+    dp_deadline_kind_t missed = dpinternal_deadline_missed(&deadline, res);
 
     // Cleanup CURL
     curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+    dpinternal_pool_release(context, curl);
+    free(url);
     free(file_content);
 
+    if (missed != DP_DEADLINE_NONE) {
+        (*file_out)->error_message = dpinternal_deadline_message(&deadline, missed);
+        free(chunk_mem.memory);
+        return -1;
+    }
     if (res != CURLE_OK) {
         (*file_out)->error_message = dpinternal_strdup("CURL request failed.");
         free(chunk_mem.memory);
@@ -0,0 +1,308 @@
+#define _GNU_SOURCE
+#include "disasterparty.h"
+#include "dp_private.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Single-flight deduplication (DP_FEATURE_SINGLE_FLIGHT). The first blocking
+// request for a payload leads a flight and performs the transfer; identical
+// requests made on the same context while it is in flight attach as
+// followers instead of sending their own. Requests are identical when kind,
+// model and the built JSON payload match; the payload is printed by cJSON in
+// a fixed order, so equal configurations give equal bytes.
+//
+// The leader logs every stream callback it delivers. Each follower replays the
+// log on its own thread, from the first event however late it attached, and
+// waiting for more until the leader lands; then it takes a copy of the
+// leader's response. Followers that ask to stop only stop their own replay.
+
+typedef struct {
+    char* token;                            // Simple streams
+    bool is_final;
+    bool has_event;                         // Detailed streams
+    dp_anthropic_event_type_t event_type;
+    char* raw_json_data;
+    char* error;
+} dp_flight_event_t;
+
+typedef struct dp_flight_s {
+    struct dp_flight_s* next;               // In the registry while joinable
+    bool registered;
+    uint64_t hash;
+    dp_transfer_kind_t kind;
+    char* model;
+    char* payload;
+    int refcount;                           // The leader plus attached followers
+    pthread_cond_t changed;                 // New events, or landed
+    dp_flight_event_t* events;
+    size_t num_events;
+    size_t events_capacity;
+    bool log_failed;                        // An event could not be logged; followers fail
+    bool landed;
+    dp_response_t response;                 // Copy of the leader's result once landed
+    // The leader's own callback, wrapped by the logging relays below
+    dp_stream_callback_t leader_callback;
+    dp_detailed_stream_callback_t leader_detailed_callback;
+    void* leader_data;
+    bool leader_stopped;
+} dp_flight_t;
+
+bool dpinternal_flight_init(dp_flight_registry_t* registry) {
+    registry->flights = NULL;
+    return pthread_mutex_init(&registry->lock, NULL) == 0;
+}
+
+void dpinternal_flight_destroy(dp_flight_registry_t* registry) {
+    pthread_mutex_destroy(&registry->lock);
+}
+
+static uint64_t dpinternal_flight_key(const dp_transfer_t* t) {
+    unsigned char kind = (unsigned char)t->kind;
+    uint64_t hash = dpinternal_hash_bytes(DP_HASH_SEED, &kind, 1);
+    const char* model = t->request_config->model ? t->request_config->model : "";
+    hash = dpinternal_hash_bytes(hash, model, strlen(model) + 1);
+    return dpinternal_hash_bytes(hash, t->json_payload, strlen(t->json_payload));
+}
+
+static void dpinternal_flight_unregister(dp_flight_registry_t* registry, dp_flight_t* flight) {
+    if (!flight->registered) return;
+    for (dp_flight_t** link = &registry->flights; *link; link = &(*link)->next) {
+        if (*link == flight) {
+            *link = flight->next;
+            break;
+        }
+    }
+    flight->registered = false;
+}
+
+// Call with the registry lock held
+static void dpinternal_flight_release(dp_flight_t* flight) {
+    if (--flight->refcount > 0) return;
+    for (size_t i = 0; i < flight->num_events; ++i) {
+        free(flight->events[i].token);
+        free(flight->events[i].error);
+        free(flight->events[i].raw_json_data);
+    }
+    free(flight->events);
+    free(flight->model);
+    free(flight->payload);
+    dp_free_response_content(&flight->response);
+    pthread_cond_destroy(&flight->changed);
+    free(flight);
+}
+
+static char* dpinternal_flight_strdup(const char* s, bool* ok) {
+    if (!s) return NULL;
+    char* copy = dpinternal_strdup(s);
+    if (!copy) *ok = false;
+    return copy;
+}
+
+static bool dpinternal_flight_copy_response(dp_response_t* dst, const dp_response_t* src) {
+    *dst = *src;
+    dst->parts = NULL;
+    dst->num_parts = 0;
+    bool ok = true;
+    dst->error_message = dpinternal_flight_strdup(src->error_message, &ok);
+    dst->finish_reason = dpinternal_flight_strdup(src->finish_reason, &ok);
+    if (src->num_parts > 0) {
+        dst->parts = calloc(src->num_parts, sizeof(dp_response_part_t));
+        if (!dst->parts) return false;
+        dst->num_parts = src->num_parts;
+        for (size_t i = 0; i < src->num_parts; ++i) {
+            const dp_response_part_t* from = &src->parts[i];
+            dp_response_part_t* to = &dst->parts[i];
+            to->type = from->type;
+            to->text = dpinternal_flight_strdup(from->text, &ok);
+            if (from->type == DP_CONTENT_PART_TOOL_CALL) {
+                to->tool_call.id = dpinternal_flight_strdup(from->tool_call.id, &ok);
+                to->tool_call.function_name = dpinternal_flight_strdup(from->tool_call.function_name, &ok);
+                to->tool_call.arguments_json = dpinternal_flight_strdup(from->tool_call.arguments_json, &ok);
+            } else if (from->type == DP_CONTENT_PART_THINKING) {
+                to->thinking.thinking = dpinternal_flight_strdup(from->thinking.thinking, &ok);
+                to->thinking.signature = dpinternal_flight_strdup(from->thinking.signature, &ok);
+            }
+        }
+    }
+    return ok;
+}
+
+// Appends an event (taking its strings) to the log and wakes the followers,
+// then reports whether the leader still wants its own callback called.
+static bool dpinternal_flight_log(dp_flight_t* flight, dp_flight_registry_t* registry, dp_flight_event_t* event, bool copied) {
+    pthread_mutex_lock(&registry->lock);
+    if (copied && flight->num_events == flight->events_capacity) {
+        size_t capacity = flight->events_capacity ? flight->events_capacity * 2 : 64;
+        dp_flight_event_t* events = realloc(flight->events, capacity * sizeof(dp_flight_event_t));
+        if (events) {
+            flight->events = events;
+            flight->events_capacity = capacity;
+        } else {
+            copied = false;
+        }
+    }
+    if (copied) {
+        flight->events[flight->num_events++] = *event;
+        pthread_cond_broadcast(&flight->changed);
+    } else {
+        flight->log_failed = true;
+        free(event->token);
+        free(event->raw_json_data);
+        free(event->error);
+    }
+    bool deliver = !flight->leader_stopped;
+    pthread_mutex_unlock(&registry->lock);
+    return deliver;
+}
+
+// A leader that asks to stop only stops the stream if nobody follows it;
+// otherwise the transfer goes on for the followers.
+static int dpinternal_flight_leader_result(dp_flight_t* flight, dp_flight_registry_t* registry, int result) {
+    if (result == 0) return 0;
+    pthread_mutex_lock(&registry->lock);
+    flight->leader_stopped = true;
+    bool alone = flight->refcount == 1;
+    if (alone) dpinternal_flight_unregister(registry, flight);
+    pthread_mutex_unlock(&registry->lock);
+    return alone ? result : 0;
+}
+
+static int dpinternal_flight_stream_relay(const char* token, void* user_data, bool is_final, const char* error) {
+    dp_transfer_t* t = (dp_transfer_t*)user_data;
+    dp_flight_t* flight = t->flight;
+    dp_flight_registry_t* registry = &t->context->flights;
+    bool copied = true;
+    dp_flight_event_t event = { .is_final = is_final };
+    event.token = dpinternal_flight_strdup(token, &copied);
+    event.error = dpinternal_flight_strdup(error, &copied);
+    if (!dpinternal_flight_log(flight, registry, &event, copied)) return 0;
+    return dpinternal_flight_leader_result(flight, registry, flight->leader_callback(token, flight->leader_data, is_final, error));
+}
+
+static int dpinternal_flight_event_relay(const dp_anthropic_stream_event_t* event, void* user_data, const char* error) {
+    dp_transfer_t* t = (dp_transfer_t*)user_data;
+    dp_flight_t* flight = t->flight;
+    dp_flight_registry_t* registry = &t->context->flights;
+    bool copied = true;
+    dp_flight_event_t logged = { .has_event = event != NULL };
+    if (event) {
+        logged.event_type = event->event_type;
+        logged.raw_json_data = dpinternal_flight_strdup(event->raw_json_data, &copied);
+    }
+    logged.error = dpinternal_flight_strdup(error, &copied);
+    if (!dpinternal_flight_log(flight, registry, &logged, copied)) return 0;
+    return dpinternal_flight_leader_result(flight, registry, flight->leader_detailed_callback(event, flight->leader_data, error));
+}
+
+// Replays the leader's stream to a follower and copies its result. Called and
+// returns with the registry lock held; the lock is dropped around callbacks.
+static void dpinternal_flight_follow(dp_transfer_t* t, dp_flight_t* flight, dp_flight_registry_t* registry) {
+    size_t next = 0;
+    bool stopped = false;
+    for (;;) {
+        while (next < flight->num_events) {
+            dp_flight_event_t event = flight->events[next++];  // The strings stay put while we hold a reference
+            if (stopped) continue;
+            pthread_mutex_unlock(&registry->lock);
+            int result;
+            if (t->kind == DP_TRANSFER_STREAM) {
+                result = t->user_callback(event.token, t->user_data, event.is_final, event.error);
+            } else {
+                dp_anthropic_stream_event_t detailed = { .event_type = event.event_type, .raw_json_data = event.raw_json_data };
+                result = t->user_detailed_callback(event.has_event ? &detailed : NULL, t->user_data, event.error);
+            }
+            pthread_mutex_lock(&registry->lock);
+            if (result != 0) stopped = true;
+        }
+        if (flight->landed) break;
+        pthread_cond_wait(&flight->changed, &registry->lock);
+    }
+    dp_free_response_content(t->response);
+    if (flight->log_failed || !dpinternal_flight_copy_response(t->response, &flight->response)) {
+        dp_free_response_content(t->response);
+        t->response->error_message = dpinternal_strdup("Memory allocation failed while sharing an identical request's response.");
+        t->response->error_class = DP_ERROR_OTHER;
+    }
+}
+
+// Attaches t to an identical request in flight and returns true once it has
+// that request's result, or makes t the leader of a new flight and returns
+// false so the caller performs it.
+bool dpinternal_flight_join(dp_transfer_t* t) {
+    dp_context_t* context = t->context;
+    if (!(atomic_load_explicit(&context->features, memory_order_relaxed) & (1ULL << (DP_FEATURE_SINGLE_FLIGHT - 1)))) {
+        return false;
+    }
+    uint64_t hash = dpinternal_flight_key(t);
+    const char* model = t->request_config->model ? t->request_config->model : "";
+    dp_flight_registry_t* registry = &context->flights;
+    pthread_mutex_lock(&registry->lock);
+    for (dp_flight_t* flight = registry->flights; flight; flight = flight->next) {
+        if (flight->hash == hash && flight->kind == t->kind && strcmp(flight->model, model) == 0 &&
+            strcmp(flight->payload, t->json_payload) == 0) {
+            flight->refcount++;
+            atomic_fetch_add_explicit(&context->stat_coalesced, 1, memory_order_relaxed);
+            dpinternal_flight_follow(t, flight, registry);
+            dpinternal_flight_release(flight);
+            pthread_mutex_unlock(&registry->lock);
+            return true;
+        }
+    }
+
+    // The payload is copied: the OpenAI token parameter fallback may rebuild the leader's
+    dp_flight_t* flight = calloc(1, sizeof(dp_flight_t));
+    if (flight) {
+        flight->model = dpinternal_strdup(model);
+        flight->payload = dpinternal_strdup(t->json_payload);
+    }
+    if (!flight || !flight->model || !flight->payload || pthread_cond_init(&flight->changed, NULL) != 0) {
+        // Deduplication is an optimization; without memory for it the request just goes alone
+        if (flight) {
+            free(flight->model);
+            free(flight->payload);
+        }
+        free(flight);
+        pthread_mutex_unlock(&registry->lock);
+        return false;
+    }
+    flight->hash = hash;
+    flight->kind = t->kind;
+    flight->refcount = 1;
+    flight->registered = true;
+    flight->next = registry->flights;
+    registry->flights = flight;
+    pthread_mutex_unlock(&registry->lock);
+
+    flight->leader_callback = t->user_callback;
+    flight->leader_detailed_callback = t->user_detailed_callback;
+    flight->leader_data = t->user_data;
+    if (t->kind == DP_TRANSFER_STREAM) {
+        t->user_callback = dpinternal_flight_stream_relay;
+        t->user_data = t;
+    } else if (t->kind == DP_TRANSFER_DETAILED_STREAM) {
+        t->user_detailed_callback = dpinternal_flight_event_relay;
+        t->user_data = t;
+    }
+    t->flight = flight;
+    return false;
+}
+
+// Publishes the leader's result to its followers and retires the flight.
+void dpinternal_flight_land(dp_transfer_t* t) {
+    dp_flight_t* flight = t->flight;
+    if (!flight) return;
+    t->flight = NULL;
+    t->user_callback = flight->leader_callback;
+    t->user_detailed_callback = flight->leader_detailed_callback;
+    t->user_data = flight->leader_data;
+    dp_flight_registry_t* registry = &t->context->flights;
+    pthread_mutex_lock(&registry->lock);
+    dpinternal_flight_unregister(registry, flight);
+    if (flight->refcount > 1 && !dpinternal_flight_copy_response(&flight->response, t->response)) {
+        flight->log_failed = true;
+    }
+    flight->landed = true;
+    pthread_cond_broadcast(&flight->changed);
+    dpinternal_flight_release(flight);
+    pthread_mutex_unlock(&registry->lock);
+}
@@ -0,0 +1,118 @@
+#define _GNU_SOURCE
+#include "dp_private.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Process-wide setup. Without dp_global_init() libcurl initializes itself
+// inside the first curl_easy_init(), which older releases do not make
+// thread-safe, and every new TLS connection parses the whole CA bundle again
+// (with OpenSSL 3 that dominates a local handshake).
+//
+// libcurl can keep a parsed CA store for reuse, but only for a bundle file
+// and only when no CA directory is configured, and it never caches a CA blob.
+// So the bundle path is resolved once here and each pooled handle is pointed
+// at it alone: a handle parses the bundle on its first connection and every
+// later connection, on any reused handle or engine, skips both the parse and
+// the filesystem.
+
+static pthread_mutex_t dp_global_lock = PTHREAD_MUTEX_INITIALIZER;
+static int dp_global_refcount = 0;
+static dp_global_config_t dp_global_config;
+static atomic_bool dp_global_ready = false;
+
+const dp_global_config_t* dpinternal_global_config(void) {
+    return atomic_load_explicit(&dp_global_ready, memory_order_acquire) ? &dp_global_config : NULL;
+}
+
+// The bundle libcurl was built to use, if any
+static const char* dpinternal_global_default_bundle(void) {
+    const curl_version_info_data* info = curl_version_info(CURLVERSION_NOW);
+#if LIBCURL_VERSION_NUM >= 0x074600
+    if (info && info->age >= CURLVERSION_SEVENTH) return info->cainfo;
+#endif
+    (void)info;
+    return NULL;
+}
+
+int dp_global_init(const dp_global_options_t* options) {
+    dp_global_options_t defaults = {0};
+    if (!options) options = &defaults;
+    if (options->ca_cache_seconds < -1) return -1;
+
+    pthread_mutex_lock(&dp_global_lock);
+    if (dp_global_refcount > 0) {
+        // Already initialized; the first caller's options stay in effect
+        dp_global_refcount++;
+        pthread_mutex_unlock(&dp_global_lock);
+        return 0;
+    }
+
+    const char* bundle = options->ca_bundle_path ? options->ca_bundle_path : dpinternal_global_default_bundle();
+    char* bundle_copy = NULL;
+    if (bundle) {
+        // Fail now rather than on every handshake
+        FILE* fp = fopen(bundle, "rb");
+        if (!fp) {
+            pthread_mutex_unlock(&dp_global_lock);
+            return -1;
+        }
+        fclose(fp);
+        bundle_copy = dpinternal_strdup(bundle);
+        if (!bundle_copy) {
+            pthread_mutex_unlock(&dp_global_lock);
+            return -1;
+        }
+    }
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        free(bundle_copy);
+        pthread_mutex_unlock(&dp_global_lock);
+        return -1;
+    }
+
+    dp_global_config.ca_bundle_path = bundle_copy;
+    dp_global_config.ca_cache_seconds = options->ca_cache_seconds == 0 ? DP_GLOBAL_DEFAULT_CA_CACHE_SECONDS : options->ca_cache_seconds;
+    dp_global_config.session_reuse = !options->disable_session_reuse;
+    dp_global_config.alpn = !options->disable_alpn;
+    dp_global_refcount = 1;
+    atomic_store_explicit(&dp_global_ready, true, memory_order_release);
+    pthread_mutex_unlock(&dp_global_lock);
+    return 0;
+}
+
+void dp_global_cleanup(void) {
+    pthread_mutex_lock(&dp_global_lock);
+    if (dp_global_refcount > 0 && --dp_global_refcount == 0) {
+        atomic_store_explicit(&dp_global_ready, false, memory_order_release);
+        free(dp_global_config.ca_bundle_path);
+        memset(&dp_global_config, 0, sizeof(dp_global_config));
+        // Handles parked in thread slots outlive their contexts; release them
+        // while libcurl can still tear them down.
+        dpinternal_pool_flush_thread_slots();
+        curl_global_cleanup();
+    }
+    pthread_mutex_unlock(&dp_global_lock);
+}
+
+void dpinternal_global_apply_tls(const dp_context_t* context, CURL* curl) {
+    const dp_global_config_t* global = dpinternal_global_config();
+    if (!global) {
+        if (context->ca_bundle_path) curl_easy_setopt(curl, CURLOPT_CAINFO, context->ca_bundle_path);
+        return;
+    }
+    const char* bundle = context->ca_bundle_path ? context->ca_bundle_path : global->ca_bundle_path;
+    if (bundle) {
+        curl_easy_setopt(curl, CURLOPT_CAINFO, bundle);
+#if LIBCURL_VERSION_NUM >= 0x075700
+        if (global->ca_cache_seconds > 0) {
+            // A configured CA directory disables libcurl's store cache
+            curl_easy_setopt(curl, CURLOPT_CAPATH, NULL);
+            curl_easy_setopt(curl, CURLOPT_CA_CACHE_TIMEOUT, global->ca_cache_seconds);
+        } else {
+            curl_easy_setopt(curl, CURLOPT_CA_CACHE_TIMEOUT, 0L);
+        }
+#endif
+    }
+    if (!global->session_reuse) curl_easy_setopt(curl, CURLOPT_SSL_SESSIONID_CACHE, 0L);
+    if (!global->alpn) curl_easy_setopt(curl, CURLOPT_SSL_ENABLE_ALPN, 0L);
+}
@@ -0,0 +1,182 @@
+#define _GNU_SOURCE
+#include "dp_private.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Hedged completions. A slow replica usually shows up as a late status line,
+// so when the first attempt has no response headers after the hedge delay a
+// duplicate goes out on another pooled handle (and so another connection).
+// Both run on a multi handle from the context's pool, whose connection cache
+// outlives the request; the first to succeed is kept and the other is removed
+// mid-flight, which closes its connection. The delay is fixed or a percentile
+// of recently observed times to headers.
+
+static int dpinternal_hedge_compare(const void* a, const void* b) {
+    long x = *(const long*)a;
+    long y = *(const long*)b;
+    return (x > y) - (x < y);
+}
+
+// How long to wait for headers before hedging, or -1 to not hedge this request.
+static long dpinternal_hedge_delay(dp_context_t* context) {
+    const dp_hedge_policy_t* policy = &context->hedge_policy;
+    long delay = policy->delay_ms > 0 ? policy->delay_ms : -1;
+    if (policy->percentile <= 0) return delay;
+
+    uint64_t count = atomic_load_explicit(&context->hedge_sample_count, memory_order_relaxed);
+    if (count < DP_HEDGE_MIN_SAMPLES) return delay;
+    size_t n = count < DP_HEDGE_SAMPLES ? (size_t)count : DP_HEDGE_SAMPLES;
+    long samples[DP_HEDGE_SAMPLES];
+    for (size_t i = 0; i < n; ++i) {
+        samples[i] = atomic_load_explicit(&context->hedge_samples[i], memory_order_relaxed);
+    }
+    qsort(samples, n, sizeof(long), dpinternal_hedge_compare);
+    double exact_rank = policy->percentile * (double)n / 100.0;
+    size_t rank = (size_t)exact_rank;
+    if ((double)rank < exact_rank) rank++;
+    if (rank == 0) rank = 1;
+    delay = samples[rank - 1];
+    return delay < policy->min_delay_ms ? policy->min_delay_ms : delay;
+}
+
+static void dpinternal_hedge_record(dp_context_t* context, CURL* curl) {
+    curl_off_t headers_us = 0;
+    if (curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &headers_us) != CURLE_OK) return;
+    uint64_t slot = atomic_fetch_add_explicit(&context->hedge_sample_count, 1, memory_order_relaxed);
+    atomic_store_explicit(&context->hedge_samples[slot % DP_HEDGE_SAMPLES], (long)(headers_us / 1000), memory_order_relaxed);
+}
+
+static bool dpinternal_hedge_succeeded(CURL* curl, CURLcode res) {
+    long http_status_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_status_code);
+    return res == CURLE_OK && http_status_code >= 200 && http_status_code < 300;
+}
+
+// Moves the winning hedge's handle and everything it points at into t, and
+// t's cancelled handle into the hedge for cleanup.
+static void dpinternal_hedge_adopt(dp_transfer_t* t, dp_transfer_t* hedge) {
+#define DP_SWAP(type, field) do { type tmp = t->field; t->field = hedge->field; hedge->field = tmp; } while (0)
+    DP_SWAP(CURL*, curl);
+    DP_SWAP(char*, json_payload);
+    DP_SWAP(memory_struct_t, body);
+    DP_SWAP(dp_deadline_watch_t, deadline);
+    DP_SWAP(dp_retry_hints_t, retry_hints);
+    DP_SWAP(dp_transport_stats_t, response->transport);
+#undef DP_SWAP
+    // The handle's callbacks address the transfer that owns it
+    t->body_write_data = &t->body;
+    curl_easy_setopt(t->curl, CURLOPT_PRIVATE, (void*)t);
+    curl_easy_setopt(t->curl, CURLOPT_WRITEDATA, (void*)t);
+    curl_easy_setopt(t->curl, CURLOPT_HEADERDATA, (void*)&t->retry_hints);
+    curl_easy_setopt(t->curl, CURLOPT_XFERINFODATA, (void*)&t->deadline);
+}
+
+CURLcode dpinternal_hedge_perform(dp_transfer_t* t) {
+    dp_context_t* context = t->context;
+    const dp_hedge_policy_t* policy = &context->hedge_policy;
+    if (policy->delay_ms <= 0 && policy->percentile <= 0) {
+        return curl_easy_perform(t->curl);
+    }
+
+    long delay = dpinternal_hedge_delay(context);
+    CURLM* multi = delay >= 0 ? dpinternal_pool_acquire_multi(context) : NULL;
+    if (!multi || curl_multi_add_handle(multi, t->curl) != CURLM_OK) {
+        // Still learning the percentile, or no multi handle: a plain request that feeds the samples
+        if (multi) dpinternal_pool_release_multi(context, multi);
+        CURLcode res = curl_easy_perform(t->curl);
+        if (dpinternal_hedge_succeeded(t->curl, res)) dpinternal_hedge_record(context, t->curl);
+        return res;
+    }
+
+    dp_transfer_t hedge;
+    dp_response_t hedge_response;
+    bool hedged = false;
+    bool primary_done = false, hedge_done = false;
+    CURLcode primary_res = CURLE_OK, hedge_res = CURLE_OK;
+    dp_transfer_t* winner = NULL;
+    bool multi_failed = false;
+    uint64_t started_ms = dpinternal_monotonic_ms();
+
+    while (!winner) {
+        int running = 0;
+        if (curl_multi_perform(multi, &running) != CURLM_OK) {
+            primary_res = CURLE_FAILED_INIT;
+            winner = t;
+            multi_failed = true;
+            break;
+        }
+        CURLMsg* msg;
+        int msgs_left;
+        while ((msg = curl_multi_info_read(multi, &msgs_left))) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            if (msg->easy_handle == t->curl) {
+                primary_done = true;
+                primary_res = msg->data.result;
+            } else {
+                hedge_done = true;
+                hedge_res = msg->data.result;
+            }
+        }
+
+        // A failure only ends the race once the other request has finished too
+        if (primary_done && (!hedged || hedge_done || dpinternal_hedge_succeeded(t->curl, primary_res))) {
+            winner = t;
+        } else if (hedge_done && (primary_done || dpinternal_hedge_succeeded(hedge.curl, hedge_res))) {
+            winner = &hedge;
+        }
+        if (winner) break;
+
+        long wait_ms = 1000;
+        if (!hedged && delay >= 0) {
+            long http_status_code = 0;
+            curl_easy_getinfo(t->curl, CURLINFO_RESPONSE_CODE, &http_status_code);
+            uint64_t elapsed = dpinternal_monotonic_ms() - started_ms;
+            if (http_status_code != 0) {
+                delay = -1;     // Headers arrived in time; this request is not slow
+            } else if (elapsed >= (uint64_t)delay && dpinternal_rate_limit_try_attempt(t) != 0) {
+                delay = -1;     // The rate limiter has no request to spare for a duplicate
+            } else if (elapsed >= (uint64_t)delay) {
+                bool ready = dpinternal_transfer_init(&hedge, context, t->request_config, DP_TRANSFER_COMPLETION, NULL, NULL, NULL, &hedge_response) == 0;
+                if (ready) {
+                    // The duplicate gets what is left of the request's total deadline, not a fresh one
+                    hedge.deadline.request_started_ms = t->deadline.request_started_ms;
+                    dpinternal_deadline_next_attempt(&hedge.deadline, hedge.curl);
+                }
+                if (ready && curl_multi_add_handle(multi, hedge.curl) == CURLM_OK) {
+                    hedged = true;
+                    atomic_fetch_add_explicit(&context->stat_hedges, 1, memory_order_relaxed);
+                } else {
+                    if (hedge.curl) dpinternal_transfer_cleanup(&hedge);
+                    dp_free_response_content(&hedge_response);
+                    delay = -1;
+                }
+            } else if ((uint64_t)delay - elapsed < (uint64_t)wait_ms) {
+                wait_ms = (long)((uint64_t)delay - elapsed);
+            }
+        }
+        curl_multi_wait(multi, NULL, 0, (int)wait_ms, NULL);
+    }
+
+    curl_multi_remove_handle(multi, t->curl);
+    if (hedged) curl_multi_remove_handle(multi, hedge.curl);
+    if (multi_failed) {
+        curl_multi_cleanup(multi);
+    } else {
+        dpinternal_pool_release_multi(context, multi);
+    }
+
+    CURLcode res = primary_res;
+    if (winner == &hedge) {
+        res = hedge_res;
+        dpinternal_hedge_adopt(t, &hedge);
+        if (dpinternal_hedge_succeeded(t->curl, res)) {
+            atomic_fetch_add_explicit(&context->stat_hedge_wins, 1, memory_order_relaxed);
+        }
+    }
+    if (dpinternal_hedge_succeeded(t->curl, res)) dpinternal_hedge_record(context, t->curl);
+    if (hedged) {
+        dpinternal_transfer_cleanup(&hedge);
+        dp_free_response_content(&hedge_response);
+    }
+    return res;
+}
@@ -19,55 +19,45 @@ int dp_list_models(dp_context_t* context, dp_model_list_t** model_list_out) {
     (*model_list_out)->error_message = NULL;
     (*model_list_out)->http_status_code = 0;
 
-    CURL* curl = curl_easy_init();
+    CURL* curl = dpinternal_pool_acquire(context);
     if (!curl) {
-        (*model_list_out)->error_message = dpinternal_strdup("curl_easy_init() failed for list_models.");
+        (*model_list_out)->error_message = dpinternal_strdup("Failed to acquire a cURL handle for list_models.");
         return -1;
     }
 
-    char url[1024];
-    struct curl_slist* headers = NULL;
     memory_struct_t chunk_mem = { .memory = malloc(1), .size = 0 };
     if (!chunk_mem.memory) {
         (*model_list_out)->error_message = dpinternal_strdup("Memory allocation for list_models response chunk failed.");
-        curl_easy_cleanup(curl);
+        dpinternal_pool_release(context, curl);
         return -1;
     }
     chunk_mem.memory[0] = '\0';
 
-    if (context->provider == DP_PROVIDER_OPENAI_COMPATIBLE) {
-        snprintf(url, sizeof(url), "%s/models", context->api_base_url);
-        char auth_header[512];
-        snprintf(auth_header, sizeof(auth_header), "Authorization: Bearer %s", context->api_key);
-        headers = curl_slist_append(headers, auth_header);
-    } else if (context->provider == DP_PROVIDER_GOOGLE_GEMINI) {
-        snprintf(url, sizeof(url), "%s/models?key=%s", context->api_base_url, context->api_key);
-    } else if (context->provider == DP_PROVIDER_ANTHROPIC) {
-        snprintf(url, sizeof(url), "%s/models", context->api_base_url); 
-        char api_key_header[512];
-        snprintf(api_key_header, sizeof(api_key_header), "x-api-key: %s", context->api_key);
-        headers = curl_slist_append(headers, api_key_header);
-        headers = curl_slist_append(headers, "anthropic-version: 2023-06-01");
-    } else {
+    if (!context->models_url) {
         (*model_list_out)->error_message = dpinternal_strdup("Unsupported provider for list_models.");
         free(chunk_mem.memory);
-        curl_easy_cleanup(curl);
+        dpinternal_pool_release(context, curl);
         return -1;
     }
 
-    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_URL, context->models_url);
     curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L); 
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, context->auth_headers);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, dpinternal_write_memory_callback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*)&chunk_mem);
     curl_easy_setopt(curl, CURLOPT_USERAGENT, context->user_agent);
+    dp_deadline_watch_t deadline;
+    dpinternal_deadline_arm(&deadline, curl, context, NULL);
 
-    CURLcode res = curl_easy_perform(curl);
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &(*model_list_out)->http_status_code);
+    CURLcode res = dpinternal_retry_perform_buffered(context, curl, &chunk_mem, &deadline, true, &(*model_list_out)->http_status_code);
 
     int return_code = 0;
+    dp_deadline_kind_t missed = dpinternal_deadline_missed(&deadline, res);
 
-    if (res != CURLE_OK) {
+    if (missed != DP_DEADLINE_NONE) {
+        (*model_list_out)->error_message = dpinternal_deadline_message(&deadline, missed);
+        return_code = -1;
+    } else if (res != CURLE_OK) {
         dpinternal_safe_asprintf(&(*model_list_out)->error_message, "curl_easy_perform() failed for list_models: %s (HTTP status: %ld)",
                  curl_easy_strerror(res), (*model_list_out)->http_status_code);
         return_code = -1;
@@ -156,8 +146,7 @@ int dp_list_models(dp_context_t* context, dp_model_list_t** model_list_out) {
     }
 
     free(chunk_mem.memory);
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+    dpinternal_pool_release(context, curl);
 
     if (return_code == -1 && (*model_list_out)->models == NULL && (*model_list_out)->error_message == NULL) {
          (*model_list_out)->error_message = dpinternal_strdup("Unknown error in dp_list_models before HTTP response processing.");
@@ -0,0 +1,386 @@
+#define _GNU_SOURCE
+#include "dp_private.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Reusable easy handles. curl_easy_reset() clears per-request options but keeps
+// the handle's connection cache, DNS cache and TLS session cache, so a handle
+// taken back out of the pool can reuse a kept-alive connection to the provider.
+//
+// In front of each context's shared stack sits a one-slot cache per thread,
+// holding the handle that thread released last together with the id of the
+// context it belongs to. A parked handle references nothing of its context,
+// but it does hold a kept-alive connection, so slots are also linked into a
+// process-wide list: destroying a context or disabling its pool takes that
+// context's handles out of every thread's slot, and the last
+// dp_global_cleanup() takes all of them. The owning thread uses its slot
+// without a lock; other threads only ever swap a parked handle out of it.
+// Otherwise a handle is cleaned up once it has been idle too long or when
+// its thread exits.
+
+typedef struct dp_thread_slot {
+    _Atomic uint64_t pool_id;
+    _Atomic(CURL*) handle;
+    uint64_t expires_at_ms;     // 0 = no idle limit; only read by the owning thread
+    struct dp_thread_slot* prev;
+    struct dp_thread_slot* next;
+} dp_thread_slot_t;
+
+static pthread_key_t dp_thread_slot_key;
+static pthread_once_t dp_thread_slot_once = PTHREAD_ONCE_INIT;
+static bool dp_thread_slot_available = false;
+static atomic_uint_fast64_t dp_next_pool_id = 1;
+
+static pthread_mutex_t dp_thread_slots_lock = PTHREAD_MUTEX_INITIALIZER;
+static dp_thread_slot_t* dp_thread_slots = NULL;
+
+static void dpinternal_thread_slot_destroy(void* value) {
+    dp_thread_slot_t* slot = (dp_thread_slot_t*)value;
+    pthread_mutex_lock(&dp_thread_slots_lock);
+    if (slot->prev) slot->prev->next = slot->next;
+    else dp_thread_slots = slot->next;
+    if (slot->next) slot->next->prev = slot->prev;
+    pthread_mutex_unlock(&dp_thread_slots_lock);
+    CURL* handle = atomic_exchange(&slot->handle, NULL);
+    if (handle) curl_easy_cleanup(handle);
+    free(slot);
+}
+
+static void dpinternal_thread_slot_key_init(void) {
+    dp_thread_slot_available = pthread_key_create(&dp_thread_slot_key, dpinternal_thread_slot_destroy) == 0;
+}
+
+static dp_thread_slot_t* dpinternal_thread_slot(bool create) {
+    pthread_once(&dp_thread_slot_once, dpinternal_thread_slot_key_init);
+    if (!dp_thread_slot_available) return NULL;
+    dp_thread_slot_t* slot = pthread_getspecific(dp_thread_slot_key);
+    if (!slot && create) {
+        slot = calloc(1, sizeof(dp_thread_slot_t));
+        if (slot && pthread_setspecific(dp_thread_slot_key, slot) != 0) {
+            free(slot);
+            slot = NULL;
+        }
+        if (slot) {
+            pthread_mutex_lock(&dp_thread_slots_lock);
+            slot->next = dp_thread_slots;
+            if (dp_thread_slots) dp_thread_slots->prev = slot;
+            dp_thread_slots = slot;
+            pthread_mutex_unlock(&dp_thread_slots_lock);
+        }
+    }
+    return slot;
+}
+
+// Cleans up the handles of pool_id (0 = any pool) parked in any thread's slot.
+// If the owner re-parks a handle of another pool in between, that one may be
+// taken too; it was idle, so this only costs the owner a cache miss.
+static void dpinternal_thread_slots_flush(uint64_t pool_id) {
+    pthread_mutex_lock(&dp_thread_slots_lock);
+    for (dp_thread_slot_t* slot = dp_thread_slots; slot; slot = slot->next) {
+        if (!atomic_load(&slot->handle)) continue;
+        if (pool_id != 0 && atomic_load(&slot->pool_id) != pool_id) continue;
+        CURL* handle = atomic_exchange(&slot->handle, NULL);
+        if (handle) curl_easy_cleanup(handle);
+    }
+    pthread_mutex_unlock(&dp_thread_slots_lock);
+}
+
+void dpinternal_pool_flush_thread_slots(void) {
+    dpinternal_thread_slots_flush(0);
+}
+
+// Takes the slot's handle if it belongs to pool_id. NULL if another thread flushed it first.
+static CURL* dpinternal_thread_slot_take(dp_thread_slot_t* slot, uint64_t pool_id) {
+    if (!atomic_load(&slot->handle) || atomic_load(&slot->pool_id) != pool_id) return NULL;
+    return atomic_exchange(&slot->handle, NULL);
+}
+
+// Drops a slot's handle once it has been idle too long, whichever context it came from.
+static void dpinternal_thread_slot_expire(dp_thread_slot_t* slot, uint64_t now) {
+    if (slot->expires_at_ms != 0 && now >= slot->expires_at_ms && atomic_load(&slot->handle)) {
+        CURL* handle = atomic_exchange(&slot->handle, NULL);
+        if (handle) curl_easy_cleanup(handle);
+    }
+}
+
+bool dpinternal_pool_thread_cached(const dp_context_t* context) {
+    dp_thread_slot_t* slot = dpinternal_thread_slot(false);
+    return slot && atomic_load(&slot->handle) && atomic_load(&slot->pool_id) == context->pool.id;
+}
+
+bool dpinternal_pool_init(dp_handle_pool_t* pool) {
+    memset(pool, 0, sizeof(*pool));
+    if (pthread_mutex_init(&pool->lock, NULL) != 0) {
+        return false;
+    }
+    pool->id = atomic_fetch_add(&dp_next_pool_id, 1);
+    pool->max_idle = DP_POOL_DEFAULT_MAX_IDLE;
+    pool->max_idle_seconds = DP_POOL_DEFAULT_MAX_IDLE_SECONDS;
+    pool->max_lifetime_seconds = 0;
+    pool->idle = calloc(pool->max_idle, sizeof(dp_pooled_handle_t));
+    if (!pool->idle) {
+        pthread_mutex_destroy(&pool->lock);
+        return false;
+    }
+    return true;
+}
+
+void dpinternal_pool_destroy(dp_handle_pool_t* pool) {
+    dpinternal_thread_slots_flush(pool->id);
+    for (size_t i = 0; i < pool->idle_count; ++i) {
+        curl_easy_cleanup(pool->idle[i].handle);
+    }
+    for (size_t i = 0; i < pool->idle_multi_count; ++i) {
+        curl_multi_cleanup(pool->idle_multis[i].multi);
+    }
+    free(pool->idle);
+    pool->idle = NULL;
+    pool->idle_count = 0;
+    pool->idle_multi_count = 0;
+    pthread_mutex_destroy(&pool->lock);
+}
+
+// Connections are only reused by handles asking for the same HTTP version, so
+// every request to the context's API gets the version here. Without
+// DP_FEATURE_HTTP2 libcurl's own default applies.
+static void dpinternal_pool_apply_http_version(const dp_context_t* context, CURL* curl) {
+    if (!(context->features & (1ULL << (DP_FEATURE_HTTP2 - 1))) || !context->api_base_url) return;
+    // Cleartext endpoints (local gateways, test servers) cannot negotiate via ALPN
+    bool cleartext = strncmp(context->api_base_url, "http://", 7) == 0;
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, cleartext ? (long)CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE : (long)CURL_HTTP_VERSION_2TLS);
+}
+
+static void dpinternal_pool_apply_defaults(const dp_context_t* context, dp_share_t* share, CURL* curl) {
+    const dp_handle_pool_t* pool = &context->pool;
+    // Required for safe use of easy handles from multiple threads.
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    if (share) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, share->curl_share);
+    }
+    dpinternal_global_apply_tls(context, curl);
+    // The URL, and so the Host header and TLS name, stay as configured; only
+    // where the connection goes changes
+    if (context->unix_socket_path) {
+        curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, context->unix_socket_path);
+    }
+    if (context->resolve) {
+        curl_easy_setopt(curl, CURLOPT_RESOLVE, context->resolve);
+    }
+    dpinternal_pool_apply_http_version(context, curl);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    // Offer every content encoding this libcurl can decode (gzip, deflate, and
+    // brotli/zstd when built in); bodies reach the write callbacks decoded.
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+#if LIBCURL_VERSION_NUM >= 0x074100
+    if (pool->max_idle_seconds > 0) {
+        curl_easy_setopt(curl, CURLOPT_MAXAGE_CONN, pool->max_idle_seconds);
+    }
+#endif
+#if LIBCURL_VERSION_NUM >= 0x075000
+    if (pool->max_lifetime_seconds > 0) {
+        curl_easy_setopt(curl, CURLOPT_MAXLIFETIME_CONN, pool->max_lifetime_seconds);
+    }
+#endif
+}
+
+CURL* dpinternal_pool_acquire(dp_context_t* context) {
+    dp_handle_pool_t* pool = &context->pool;
+    CURL* curl = NULL;
+    CURL* expired[DP_POOL_EXPIRE_BATCH];
+    size_t num_expired = 0;
+    uint64_t now = dpinternal_monotonic_ms();
+
+    // Fast path: this thread's own last handle, without touching the lock.
+    dp_thread_slot_t* slot = dpinternal_thread_slot(false);
+    if (slot) {
+        dpinternal_thread_slot_expire(slot, now);
+        curl = dpinternal_thread_slot_take(slot, pool->id);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    dp_share_t* share = context->share;
+    // Most recently released handle first: it is the most likely to hold a live connection.
+    while (!curl && pool->idle_count > 0) {
+        dp_pooled_handle_t* entry = &pool->idle[--pool->idle_count];
+        if (pool->max_idle_seconds > 0 &&
+            now - entry->idle_since_ms > (uint64_t)pool->max_idle_seconds * 1000) {
+            if (num_expired < DP_POOL_EXPIRE_BATCH) {
+                expired[num_expired++] = entry->handle;
+                continue;
+            }
+            // Too many to clean up in one go; leave the rest for the next caller.
+            pool->idle_count++;
+            break;
+        }
+        curl = entry->handle;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    // Stale handles are torn down outside the lock since closing connections may block.
+    for (size_t i = 0; i < num_expired; ++i) {
+        curl_easy_cleanup(expired[i]);
+    }
+
+    if (!curl) {
+        curl = curl_easy_init();
+        if (!curl) return NULL;
+    }
+    dpinternal_pool_apply_defaults(context, share, curl);
+    return curl;
+}
+
+// Parks a handle in the shared stack, or in the calling thread's slot when
+// use_thread_slot is set and the slot is free.
+static void dpinternal_pool_put(dp_context_t* context, CURL* curl, bool use_thread_slot) {
+    if (!curl) return;
+    dp_handle_pool_t* pool = &context->pool;
+
+    // Drop references to the caller's stack buffers, header lists and callbacks.
+    // curl_easy_reset() leaves a share attached, so detach it explicitly; the
+    // next acquire attaches whatever share the context uses by then.
+    curl_easy_setopt(curl, CURLOPT_SHARE, NULL);
+    curl_easy_reset(curl);
+
+    size_t max_idle = pool->max_idle;
+    if (max_idle == 0) {
+        curl_easy_cleanup(curl);
+        return;
+    }
+    uint64_t now = dpinternal_monotonic_ms();
+    dp_thread_slot_t* slot = use_thread_slot ? dpinternal_thread_slot(true) : NULL;
+    if (slot) {
+        dpinternal_thread_slot_expire(slot, now);
+        if (!atomic_load(&slot->handle)) {
+            long max_idle_seconds = pool->max_idle_seconds;
+            atomic_store(&slot->pool_id, pool->id);
+            slot->expires_at_ms = max_idle_seconds > 0 ? now + (uint64_t)max_idle_seconds * 1000 : 0;
+            // Published last: a flushing thread that sees the handle sees its pool id
+            atomic_store(&slot->handle, curl);
+            return;
+        }
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    if (pool->idle_count < pool->max_idle) {
+        pool->idle[pool->idle_count].handle = curl;
+        pool->idle[pool->idle_count].idle_since_ms = now;
+        pool->idle_count++;
+        curl = NULL;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (curl) {
+        curl_easy_cleanup(curl);
+    }
+}
+
+void dpinternal_pool_release(dp_context_t* context, CURL* curl) {
+    dpinternal_pool_put(context, curl, true);
+}
+
+// For handles released by threads that will not make the next request, such
+// as warm-up threads: their thread slot would keep the handle out of reach.
+void dpinternal_pool_park(dp_context_t* context, CURL* curl) {
+    dpinternal_pool_put(context, curl, false);
+}
+
+// Multi handles for requests driven through the multi interface inside a
+// blocking call. Destroying a multi closes every connection in its cache, so
+// finished ones are parked here, at most DP_POOL_MAX_IDLE_MULTIS and never
+// more than max_idle_handles, and the next such call reuses their connections.
+CURLM* dpinternal_pool_acquire_multi(dp_context_t* context) {
+    dp_handle_pool_t* pool = &context->pool;
+    CURLM* multi = NULL;
+    CURLM* expired[DP_POOL_MAX_IDLE_MULTIS];
+    size_t num_expired = 0;
+    uint64_t now = dpinternal_monotonic_ms();
+
+    pthread_mutex_lock(&pool->lock);
+    while (!multi && pool->idle_multi_count > 0) {
+        dp_pooled_multi_t* entry = &pool->idle_multis[--pool->idle_multi_count];
+        if (pool->max_idle_seconds > 0 &&
+            now - entry->idle_since_ms > (uint64_t)pool->max_idle_seconds * 1000) {
+            expired[num_expired++] = entry->multi;
+            continue;
+        }
+        multi = entry->multi;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < num_expired; ++i) {
+        curl_multi_cleanup(expired[i]);
+    }
+    if (!multi) {
+        multi = curl_multi_init();
+        // Lets HTTP/2 requests to the same host share a connection
+        if (multi) curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    }
+    return multi;
+}
+
+// Parks a multi handle with no easy handles left in it.
+void dpinternal_pool_release_multi(dp_context_t* context, CURLM* multi) {
+    if (!multi) return;
+    dp_handle_pool_t* pool = &context->pool;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->idle_multi_count < DP_POOL_MAX_IDLE_MULTIS && pool->idle_multi_count < pool->max_idle) {
+        pool->idle_multis[pool->idle_multi_count].multi = multi;
+        pool->idle_multis[pool->idle_multi_count].idle_since_ms = dpinternal_monotonic_ms();
+        pool->idle_multi_count++;
+        multi = NULL;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (multi) {
+        curl_multi_cleanup(multi);
+    }
+}
+
+int dp_set_connection_pool_limits(dp_context_t* context,
+                                  size_t max_idle_handles,
+                                  long max_idle_seconds,
+                                  long max_lifetime_seconds) {
+    if (!context || max_idle_seconds < 0 || max_lifetime_seconds < 0) {
+        return -1;
+    }
+    dp_handle_pool_t* pool = &context->pool;
+
+    dp_pooled_handle_t* new_idle = NULL;
+    if (max_idle_handles > 0) {
+        new_idle = calloc(max_idle_handles, sizeof(dp_pooled_handle_t));
+        if (!new_idle) return -1;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    size_t keep = pool->idle_count < max_idle_handles ? pool->idle_count : max_idle_handles;
+    size_t surplus = pool->idle_count - keep;
+    // Keep the most recently released handles; hand the oldest back for cleanup.
+    if (keep > 0) {
+        memcpy(new_idle, &pool->idle[surplus], keep * sizeof(dp_pooled_handle_t));
+    }
+    dp_pooled_handle_t* old_idle = pool->idle;
+    pool->idle = new_idle;
+    pool->idle_count = keep;
+    size_t keep_multis = pool->idle_multi_count < max_idle_handles ? pool->idle_multi_count : max_idle_handles;
+    size_t surplus_multis = pool->idle_multi_count - keep_multis;
+    dp_pooled_multi_t old_multis[DP_POOL_MAX_IDLE_MULTIS];
+    memcpy(old_multis, pool->idle_multis, surplus_multis * sizeof(dp_pooled_multi_t));
+    memmove(pool->idle_multis, &pool->idle_multis[surplus_multis], keep_multis * sizeof(dp_pooled_multi_t));
+    pool->idle_multi_count = keep_multis;
+    pool->max_idle = max_idle_handles;
+    pool->max_idle_seconds = max_idle_seconds;
+    pool->max_lifetime_seconds = max_lifetime_seconds;
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < surplus; ++i) {
+        curl_easy_cleanup(old_idle[i].handle);
+    }
+    for (size_t i = 0; i < surplus_multis; ++i) {
+        curl_multi_cleanup(old_multis[i].multi);
+    }
+    free(old_idle);
+    if (max_idle_handles == 0) {
+        dpinternal_thread_slots_flush(pool->id);
+    }
+    return 0;
+}
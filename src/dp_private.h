@@ -6,19 +6,202 @@
 #include <curl/curl.h>
 #include <cjson/cJSON.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
 // Default base URLs - declared as extern, defined in dp_constants.c
 extern const char* DEFAULT_OPENAI_API_BASE_URL;
 extern const char* DEFAULT_GEMINI_API_BASE_URL;
 extern const char* DEFAULT_ANTHROPIC_API_BASE_URL;
 
+// Connection pool defaults (dp_pool.c)
+#define DP_POOL_DEFAULT_MAX_IDLE 8
+#define DP_POOL_DEFAULT_MAX_IDLE_SECONDS 118  // Matches libcurl's own CURLOPT_MAXAGE_CONN default
+#define DP_POOL_EXPIRE_BATCH 16
+#define DP_POOL_MAX_IDLE_MULTIS 4
+
+// Gap between received chunks reported as a stall (dp_transfer.c)
+#define DP_DEFAULT_STALL_THRESHOLD_MS 200
+
+// Stream receive buffer size, and the default limit on one SSE event (dp_sse.c)
+#define DP_SSE_BUFFER_BYTES (64 * 1024)
+#define DP_DEFAULT_MAX_STREAM_EVENT_BYTES (16 * 1024 * 1024)
+
+// Retry budget bookkeeping is in thousandths of a retry (dp_retry.c)
+#define DP_RETRY_BUDGET_SCALE 1000
+
+// Recent times to headers kept for the learned hedge delay, and how many are
+// needed before the percentile replaces delay_ms (dp_hedge.c)
+#define DP_HEDGE_SAMPLES 64
+#define DP_HEDGE_MIN_SAMPLES 16
+
+// Bound on a warm-up request when the context has no total deadline (dp_warmup.c)
+#define DP_WARMUP_TIMEOUT_MS 10000
+
+// How long a pooled handle reuses its parsed CA store after dp_global_init()
+// (dp_global.c); matches libcurl's own default
+#define DP_GLOBAL_DEFAULT_CA_CACHE_SECONDS 86400
+
+// Input token estimate for rate limiting: characters per token of message
+// text, and a flat charge per image or file part (dp_rate_limit.c)
+#define DP_RATE_LIMIT_CHARS_PER_TOKEN 4
+#define DP_RATE_LIMIT_ATTACHMENT_TOKENS 1000
+
+// Circuit breaker limits and defaults (dp_breaker.c)
+#define DP_BREAKER_MAX_WINDOW 256
+#define DP_BREAKER_DEFAULT_WINDOW 20
+#define DP_BREAKER_DEFAULT_OPEN_MS 30000
+
+// Router smoothing: weight of the newest latency and error samples, and the
+// floor on a backend's health so a failing one is still probed now and then (dp_router.c)
+#define DP_ROUTER_LATENCY_ALPHA 0.3
+#define DP_ROUTER_ERROR_ALPHA 0.2
+#define DP_ROUTER_MIN_HEALTH 0.02
+
+// Batch defaults (dp_batch.c)
+#define DP_BATCH_DEFAULT_MAX_CONCURRENCY 16
+#define DP_BATCH_POLL_TIMEOUT_MS 1000
+
+typedef struct {
+    CURL* handle;
+    uint64_t idle_since_ms;
+} dp_pooled_handle_t;
+
+typedef struct {
+    CURLM* multi;
+    uint64_t idle_since_ms;
+} dp_pooled_multi_t;
+
+// Each thread also keeps its most recently released handle in a one-slot cache
+// (dp_pool.c), so a thread issuing sequential requests never takes the lock.
+// Limits are atomic because that fast path reads them without it.
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t id;                // Identifies the owning context in thread caches; never reused
+    dp_pooled_handle_t* idle;   // LIFO stack of parked handles
+    size_t idle_count;
+    // Multi handles of finished hedged requests and batches. An easy handle
+    // added to a multi uses the multi's connection cache, so these hold the
+    // connections those requests opened.
+    dp_pooled_multi_t idle_multis[DP_POOL_MAX_IDLE_MULTIS];
+    size_t idle_multi_count;
+    _Atomic size_t max_idle;
+    _Atomic long max_idle_seconds;
+    _Atomic long max_lifetime_seconds;
+} dp_handle_pool_t;
+
+// Settings from dp_global_init(), fixed until the matching dp_global_cleanup() (dp_global.c)
+typedef struct {
+    char* ca_bundle_path;       // Resolved once: the caller's bundle or libcurl's built-in one
+    long ca_cache_seconds;      // -1 = parse the bundle for every connection
+    bool session_reuse;
+    bool alpn;
+} dp_global_config_t;
+
+// Background refresh of warmed connections (dp_warmup.c)
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;        // Signalled to stop the refresh thread early
+    pthread_t thread;
+    bool running;
+    bool stop;
+    size_t num_connections;
+    long interval_seconds;
+} dp_warmup_refresh_t;
+
+// Circuit breaker of a context (dp_breaker.c). The policy is fixed before the
+// context is first used; everything else is guarded by the lock.
+typedef struct {
+    pthread_mutex_t lock;
+    bool enabled;
+    dp_circuit_breaker_policy_t policy;     // With defaults filled in
+    dp_circuit_state_t state;
+    uint64_t opened_at_ms;
+    int consecutive_failures;
+    bool outcomes[DP_BREAKER_MAX_WINDOW];   // Ring of recent attempts, true = failed
+    int outcome_next;
+    int outcome_count;
+    int window_failures;
+    bool probe_in_flight;                   // Half-open: a probe has been let through
+    int probe_successes;
+    uint64_t times_opened;
+    uint64_t rejected;
+} dp_breaker_t;
+
+// Identical requests in flight on a context that others can attach to (dp_flight.c)
+typedef struct {
+    pthread_mutex_t lock;           // Guards the list and every flight on it
+    struct dp_flight_s* flights;    // Few at a time, so a list searched by hash
+} dp_flight_registry_t;
+
+// Token buckets of a rate limiter, in the order of dp_rate_limits_t (dp_rate_limit.c)
+enum { DP_RATE_BUCKET_REQUESTS, DP_RATE_BUCKET_INPUT, DP_RATE_BUCKET_OUTPUT, DP_RATE_BUCKET_COUNT };
+
+typedef struct {
+    double capacity;            // One minute's quota; 0 = unlimited
+    double level;               // May go negative when usage exceeds the estimate
+    double per_ms;              // Refill rate
+} dp_rate_bucket_t;
+
+struct dp_rate_limiter_s {
+    pthread_mutex_t lock;       // Guards the buckets and refcount
+    dp_rate_bucket_t buckets[DP_RATE_BUCKET_COUNT];
+    uint64_t refilled_ms;
+    int refcount;               // One for the creator plus one per attached context
+};
+
+struct dp_share_s {
+    CURLSH* curl_share;
+    pthread_mutex_t locks[CURL_LOCK_DATA_LAST];
+    pthread_mutex_t ref_lock;
+    int refcount;   // One for the creator plus one per attached context
+};
+
+// Thread-safety contract: provider, credentials, URLs, user agent, CA bundle,
+// transport route, default deadlines, retry, hedge and breaker policies, share and response cache are fixed before the context is first used; afterwards only atomic
+// members and the mutex-guarded pool change, so requests may run concurrently.
 struct dp_context_s {
     dp_provider_type_t provider;
     char* api_key;
     char* api_base_url;
     char* user_agent;
-    dp_token_param_type_t token_param_preference;
-    uint64_t features;
+    // Derived from provider, base URL and key at creation and shared read-only by every request
+    struct curl_slist* json_headers;    // Content-Type plus authentication
+    struct curl_slist* auth_headers;    // Authentication only, for GET requests (NULL for Gemini)
+    char* completions_url;              // OpenAI and Anthropic
+    char* models_url;
+    char* count_tokens_url;             // Anthropic
+    char* model_url_prefix;             // Gemini: "<base>/models/", then "<model>:<method>?<key_query>"
+    char* key_query;                    // Gemini: "key=<api key>"
+    _Atomic dp_token_param_type_t token_param_preference;  // Learned from the endpoint's replies
+    _Atomic uint64_t features;
+    _Atomic long stall_threshold_ms;
+    _Atomic size_t max_stream_event_bytes;
+    char* ca_bundle_path;   // Overrides libcurl's default CA bundle when set
+    char* unix_socket_path;             // Connect here instead of the URL's host when set
+    struct curl_slist* resolve;         // Pinned "host:port:address" entries
+    dp_deadlines_t default_deadlines;
+    dp_retry_policy_t retry_policy;
+    _Atomic long retry_budget;          // Available retries, scaled by DP_RETRY_BUDGET_SCALE
+    _Atomic uint64_t stat_requests;
+    _Atomic uint64_t stat_retries;
+    _Atomic uint64_t stat_retries_denied;
+    dp_hedge_policy_t hedge_policy;
+    _Atomic long hedge_samples[DP_HEDGE_SAMPLES];  // Ring of recent times to headers, ms
+    _Atomic uint64_t hedge_sample_count;
+    _Atomic uint64_t stat_hedges;
+    _Atomic uint64_t stat_hedge_wins;
+    _Atomic uint64_t stat_body_bytes_wire;
+    _Atomic uint64_t stat_body_bytes_decoded;
+    dp_handle_pool_t pool;
+    dp_warmup_refresh_t warmup;
+    dp_share_t* share;
+    dp_rate_limiter_t* rate_limiter;
+    dp_rate_limit_mode_t rate_limit_mode;
+    dp_breaker_t breaker;
+    dp_flight_registry_t flights;
+    _Atomic uint64_t stat_coalesced;
+    dp_response_cache_t* response_cache;
 };
 
 typedef struct {
@@ -28,59 +211,215 @@ typedef struct {
 
 typedef dp_anthropic_stream_callback_t dp_detailed_stream_callback_t;
 
+// Incremental Server-Sent Events framing (dp_sse.c). Received bytes are
+// appended and complete events taken out one at a time; each byte is examined
+// once however the stream is sliced. Lines may end in LF, CR or CRLF; a bare
+// CR is rewritten to LF, so an event's lines are split on '\n'.
+typedef struct {
+    char* buffer;               // NUL-terminated at size
+    size_t size;
+    size_t capacity;
+    size_t start;               // First byte of the event being scanned
+    size_t scan;                // Next byte to examine
+    size_t line_start;          // First byte of the line being scanned
+    size_t event_end;           // Terminator of the event's last non-empty line so far
+    bool pending_cr;            // The byte before scan was a CR that a LF may complete
+    size_t base_capacity;       // Capacity kept when no oversized event is buffered
+    size_t max_event_size;      // Longest event accepted; 0 for no limit
+    bool oversized;             // An event exceeded max_event_size; nothing more is framed
+    char* scratch;              // Joined data of events with several data lines, reused
+    size_t scratch_capacity;
+} dp_sse_tokenizer_t;
+
+// The fields of one event as views into the receive buffer, or into the
+// tokenizer's scratch buffer when several data lines are joined with '\n'.
+// Both are NUL-terminated and valid until the next append.
+typedef struct {
+    const char* name;           // Last "event" field; NULL when absent
+    size_t name_length;
+    const char* data;           // "data" fields joined; NULL when absent
+    size_t data_length;
+} dp_sse_event_t;
+
+// What the simple stream callback reads from an OpenAI-compatible or Gemini
+// chunk (dp_delta.c). Strings are NULL when absent or not strings.
+typedef struct {
+    const char* text;
+    bool thought;               // "thought": true
+} dp_delta_part_t;
+
+typedef struct {
+    const char* content;                // OpenAI choices[0].delta
+    const char* reasoning_content;
+    const char* finish_reason;          // OpenAI choices[0], Gemini candidates[0].finishReason
+    const dp_delta_part_t* parts;       // Gemini candidates[0].content.parts
+    size_t num_parts;
+    const char* prompt_feedback_reason; // Gemini promptFeedback.blockReason, or its finishReason
+} dp_stream_delta_t;
+
+// Reads dp_stream_delta_t from a chunk without building a cJSON tree. Strings
+// are decoded into the scratch buffer, reused from one chunk to the next.
+typedef struct {
+    dp_stream_delta_t delta;
+    char* scratch;
+    size_t scratch_capacity;
+    size_t scratch_used;
+    dp_delta_part_t* parts;
+    size_t parts_capacity;
+} dp_delta_scanner_t;
+
 typedef struct {
     dp_stream_callback_t user_callback;
     dp_detailed_stream_callback_t detailed_callback;
     void* user_data;
-    char* buffer;
-    size_t buffer_size;
-    size_t buffer_capacity;
+    dp_sse_tokenizer_t sse;
+    dp_delta_scanner_t delta;
     dp_provider_type_t provider;
     char* finish_reason_capture;
     bool stop_streaming_signal;
     char* accumulated_error_during_stream;
     uint64_t features;
+    dp_usage_t usage;                   // Collected from usage objects in the events
 } stream_processor_t;
 
 typedef struct {
     dp_anthropic_stream_callback_t anthropic_user_callback;
     void* user_data;
-    char* buffer;
-    size_t buffer_size;
-    size_t buffer_capacity;
+    dp_sse_tokenizer_t sse;
+    dp_delta_scanner_t delta;
     char* finish_reason_capture;
     bool stop_streaming_signal;
     char* accumulated_error_during_stream;
     bool is_thinking;
+    dp_usage_t usage;
 } anthropic_stream_processor_t;
 
+// Enforces dp_deadlines_t on one easy handle (dp_deadline.c). Total and connect
+// limits map onto libcurl timeouts; first-byte and idle limits are checked from
+// the progress callback. The total limit spans all attempts of a request, the
+// others apply to each attempt.
+typedef struct {
+    dp_deadlines_t limits;      // Request limits merged over the context defaults
+    uint64_t request_started_ms;    // Start of the first attempt
+    uint64_t started_ms;        // Start of the current attempt
+    uint64_t last_byte_ms;      // Arrival of the latest body data, 0 before the first
+    curl_off_t received;        // Body bytes seen so far
+    dp_deadline_kind_t missed;  // Set by the progress callback when it aborts
+} dp_deadline_watch_t;
+
+// Server hints on when to try again, collected from response headers (dp_retry.c)
+typedef struct {
+    long retry_after_ms;        // Retry-After / retry-after-ms, -1 if absent
+    long requests_reset_ms;     // Time until the request-count limit resets, -1 if unknown
+    long tokens_reset_ms;       // Time until the token limit resets, -1 if unknown
+    bool requests_exhausted;    // The provider reported no requests remaining
+    bool tokens_exhausted;      // The provider reported no tokens remaining
+} dp_retry_hints_t;
+
+typedef size_t (*dp_write_fn_t)(void* contents, size_t size, size_t nmemb, void* userp);
+
+typedef enum {
+    DP_TRANSFER_COMPLETION,
+    DP_TRANSFER_STREAM,
+    DP_TRANSFER_DETAILED_STREAM
+} dp_transfer_kind_t;
+
+// One completion request bound to a pooled easy handle (dp_transfer.c)
+typedef struct {
+    dp_context_t* context;
+    const dp_request_config_t* request_config;
+    dp_response_t* response;
+    dp_transfer_kind_t kind;
+    CURL* curl;
+    const char* url;                     // The context's endpoint, or owned_url
+    char* owned_url;                     // Per-model URL (Gemini)
+    char* json_payload;
+    dp_token_param_type_t token_param;  // Token parameter the payload was built with
+    memory_struct_t body;                // Buffered body (DP_TRANSFER_COMPLETION)
+    stream_processor_t processor;        // SSE state (streaming kinds)
+    anthropic_stream_processor_t anthro_processor;  // Anthropic detailed events
+    dp_write_fn_t body_write;            // Decoder the timing wrapper forwards to
+    void* body_write_data;
+    uint64_t last_chunk_ms;              // Arrival of the previous chunk, 0 before the first
+    dp_deadline_watch_t deadline;
+    dp_retry_hints_t retry_hints;        // From the latest attempt's headers
+    int attempts;
+    bool delivered;                      // Something reached the user's stream callback; no more retries
+    bool rate_charged;                   // The estimates below are charged to the context's rate limiter
+    long rate_input_estimate;
+    long rate_output_estimate;
+    bool breaker_probe;                  // Let through as the half-open circuit breaker's probe
+    struct dp_flight_s* flight;          // Leading a single-flight group
+    char* cache_key;                     // Missed the response cache; stored under this key on success
+    size_t cache_key_length;
+    struct dp_cache_recording_s* cache_recording;  // Stream events to store with the response
+    dp_stream_callback_t user_callback;  // Wrapped by relays that record delivery
+    dp_detailed_stream_callback_t user_detailed_callback;
+    void* user_data;
+} dp_transfer_t;
+
+// A transfer in flight on an engine (dp_engine.c). The transfer must stay the
+// first member: CURLOPT_PRIVATE points at it.
+typedef struct dp_engine_request_s {
+    dp_transfer_t transfer;
+    dp_engine_t* engine;
+    uint64_t retry_at_ms;               // Waiting out a retry backoff or for rate limit capacity until then; 0 while in the multi handle
+    bool awaiting_rate_limit;           // Not yet sent: waiting for capacity rather than a retry
+    dp_completion_callback_t on_done;
+    void* user_data;
+    struct dp_engine_request_s* prev;
+    struct dp_engine_request_s* next;
+} dp_engine_request_t;
+
+struct dp_engine_s {
+    CURLM* multi;
+    dp_context_t* multi_pool;       // Context whose pool takes the multi back, NULL = owned
+    dp_engine_request_t* requests;  // In-flight requests, including those waiting to retry
+    size_t num_in_flight;
+    size_t num_waiting;             // Requests in a retry backoff, outside the multi handle
+    uint64_t curl_timer_due_ms;     // When libcurl last asked to be woken, 0 for never
+    dp_engine_socket_callback_t socket_cb;
+    dp_engine_timer_callback_t timer_cb;
+    void* hooks_user_data;
+};
+
+// One backend of a router (dp_router.c). Everything below the mappings is
+// guarded by the router's lock.
+typedef struct {
+    dp_context_t* context;          // Not owned
+    double weight;
+    dp_model_mapping_t* models;     // Owned copies; none = pass every model through
+    size_t num_models;
+    double latency_ms;              // EWMA of successful request latency
+    bool has_latency;
+    double error_rate;              // EWMA of failures, 0..1
+    long in_flight;
+    uint64_t requests;
+    uint64_t failures;
+} dp_router_backend_state_t;
+
+struct dp_router_s {
+    pthread_mutex_t lock;
+    dp_router_backend_state_t* backends;
+    size_t num_backends;
+    uint64_t rng_state;             // xorshift64* for weighted picks
+};
+
 // --- Shared Internal Function Prototypes ---
 
 // Payload Builders (disasterparty.c)
-char* dpinternal_build_openai_json_payload_with_cjson(const dp_request_config_t* request_config, const dp_context_t* context);
+char* dpinternal_build_openai_json_payload_with_cjson(const dp_request_config_t* request_config, dp_token_param_type_t token_param);
 char* dpinternal_build_gemini_json_payload_with_cjson(const dp_request_config_t* request_config);
+cJSON* dpinternal_build_gemini_contents_with_cjson(const dp_request_config_t* request_config);
 char* dpinternal_build_anthropic_json_payload_with_cjson(const dp_request_config_t* request_config);
 char* dpinternal_build_gemini_count_tokens_json_payload_with_cjson(const dp_request_config_t* request_config);
 char* dpinternal_build_anthropic_count_tokens_json_payload_with_cjson(const dp_request_config_t* request_config);
 
 // Response processing (disasterparty.c)
-bool dpinternal_parse_response_content(const dp_context_t* context, const char* json_response_str, dp_response_part_t** parts_out, size_t* num_parts_out, char** finish_reason_out);
+bool dpinternal_parse_response_content(const dp_context_t* context, const char* json_response_str, dp_response_part_t** parts_out, size_t* num_parts_out, char** finish_reason_out, dp_usage_t* usage_out);
+void dpinternal_parse_usage(dp_provider_type_t provider, const cJSON* root, dp_usage_t* usage);
 bool dpinternal_is_token_parameter_error(const char* error_response, long http_status);
 
-// OpenAI Fallback logic (disasterparty.c)
-CURLcode dpinternal_perform_openai_request_with_fallback(CURL* curl, dp_context_t* context, 
-                                                                const dp_request_config_t* request_config,
-                                                                memory_struct_t* chunk_mem,
-                                                                long* http_status_code);
-CURLcode dpinternal_perform_openai_streaming_request_with_fallback(CURL* curl, dp_context_t* context, 
-                                                                        const dp_request_config_t* request_config,
-                                                                        stream_processor_t* processor,
-                                                                        long* http_status_code);
-CURLcode dpinternal_perform_openai_detailed_streaming_request_with_fallback(CURL* curl, dp_context_t* context, 
-                                                                        const dp_request_config_t* request_config,
-                                                                        anthropic_stream_processor_t* processor,
-                                                                        long* http_status_code);
-
 // Image Generation Payload Builders
 char* dpinternal_build_openai_image_generation_payload_with_cjson(const dp_image_generation_config_t* config);
 char* dpinternal_build_google_image_generation_payload_with_cjson(const dp_image_generation_config_t* config, const dp_context_t* context);
@@ -91,9 +430,128 @@ size_t dpinternal_streaming_write_callback(void* contents, size_t size, size_t n
 size_t dpinternal_anthropic_detailed_stream_write_callback(void* contents, size_t size, size_t nmemb, void* userp);
 size_t dpinternal_openai_detailed_stream_write_callback(void* contents, size_t size, size_t nmemb, void* userp);
 
+// SSE framing (dp_sse.c)
+bool dpinternal_sse_init(dp_sse_tokenizer_t* sse, size_t capacity, size_t max_event_size);
+bool dpinternal_sse_append(dp_sse_tokenizer_t* sse, const char* data, size_t length);
+char* dpinternal_sse_next_event(dp_sse_tokenizer_t* sse);
+bool dpinternal_sse_parse(dp_sse_tokenizer_t* sse, char* raw_event, dp_sse_event_t* event_out);
+const char* dpinternal_sse_pending(const dp_sse_tokenizer_t* sse);
+void dpinternal_sse_reset(dp_sse_tokenizer_t* sse);
+void dpinternal_sse_free(dp_sse_tokenizer_t* sse);
+
+// Stream chunk fields (dp_delta.c)
+bool dpinternal_delta_scan(dp_delta_scanner_t* scanner, dp_provider_type_t provider, const char* json, size_t length, dp_usage_t* usage);
+const dp_stream_delta_t* dpinternal_delta_from_json(dp_delta_scanner_t* scanner, dp_provider_type_t provider, const cJSON* root);
+void dpinternal_delta_free(dp_delta_scanner_t* scanner);
+
 // Utilities (dp_utils.c)
 char* dpinternal_strdup(const char* s);
 int dpinternal_safe_asprintf(char** strp, const char* fmt, ...);
+uint64_t dpinternal_monotonic_ms(void);
+#define DP_HASH_SEED 0xCBF29CE484222325ULL
+uint64_t dpinternal_hash_bytes(uint64_t hash, const void* data, size_t length);
+
+// Request transfers (dp_transfer.c)
+int dpinternal_transfer_init(dp_transfer_t* t,
+                             dp_context_t* context,
+                             const dp_request_config_t* request_config,
+                             dp_transfer_kind_t kind,
+                             dp_stream_callback_t callback,
+                             dp_detailed_stream_callback_t detailed_callback,
+                             void* user_data,
+                             dp_response_t* response);
+bool dpinternal_transfer_needs_fallback(const dp_transfer_t* t, CURLcode res);
+bool dpinternal_transfer_use_max_tokens(dp_transfer_t* t);
+bool dpinternal_transfer_prepare_fallback(dp_transfer_t* t);
+void dpinternal_transfer_finish(dp_transfer_t* t, CURLcode res);
+long dpinternal_transfer_retry_delay(dp_transfer_t* t, CURLcode res);
+void dpinternal_transfer_reset_for_retry(dp_transfer_t* t);
+int dpinternal_transfer_perform(dp_transfer_t* t);
+void dpinternal_transfer_count_body(dp_context_t* context, CURL* curl, uint64_t decoded_bytes, dp_transport_stats_t* stats);
+void dpinternal_transfer_cleanup(dp_transfer_t* t);
+
+// Engines (dp_engine.c)
+dp_engine_t* dpinternal_engine_create_pooled(dp_context_t* context);
+
+// Connection pool (dp_pool.c)
+bool dpinternal_pool_init(dp_handle_pool_t* pool);
+void dpinternal_pool_destroy(dp_handle_pool_t* pool);
+CURL* dpinternal_pool_acquire(dp_context_t* context);
+void dpinternal_pool_release(dp_context_t* context, CURL* curl);
+void dpinternal_pool_park(dp_context_t* context, CURL* curl);
+CURLM* dpinternal_pool_acquire_multi(dp_context_t* context);
+void dpinternal_pool_release_multi(dp_context_t* context, CURLM* multi);
+bool dpinternal_pool_thread_cached(const dp_context_t* context);
+void dpinternal_pool_flush_thread_slots(void);
+
+// Deadlines (dp_deadline.c)
+void dpinternal_deadline_arm(dp_deadline_watch_t* watch, CURL* curl, const dp_context_t* context, const dp_deadlines_t* request_deadlines);
+void dpinternal_deadline_next_attempt(dp_deadline_watch_t* watch, CURL* curl);
+long dpinternal_deadline_remaining_ms(const dp_deadline_watch_t* watch);
+dp_deadline_kind_t dpinternal_deadline_missed(const dp_deadline_watch_t* watch, CURLcode res);
+char* dpinternal_deadline_message(const dp_deadline_watch_t* watch, dp_deadline_kind_t kind);
+
+// Retries (dp_retry.c)
+void dpinternal_retry_hints_reset(dp_retry_hints_t* hints);
+size_t dpinternal_retry_header_callback(char* buffer, size_t size, size_t nitems, void* userdata);
+bool dpinternal_retry_is_transient(CURLcode res, long http_status, dp_error_class_t error_class, dp_deadline_kind_t deadline_missed);
+void dpinternal_retry_note_request(dp_context_t* context);
+long dpinternal_retry_next_delay(dp_context_t* context, int attempts, const dp_retry_hints_t* hints, const dp_deadline_watch_t* deadline);
+void dpinternal_sleep_ms(long ms);
+CURLcode dpinternal_retry_perform_buffered(dp_context_t* context, CURL* curl, memory_struct_t* body, dp_deadline_watch_t* deadline, bool idempotent, long* http_status_out);
+
+// Hedged requests (dp_hedge.c)
+CURLcode dpinternal_hedge_perform(dp_transfer_t* t);
+
+// Process-wide setup (dp_global.c)
+const dp_global_config_t* dpinternal_global_config(void);
+void dpinternal_global_apply_tls(const dp_context_t* context, CURL* curl);
+
+// Connection warm-up (dp_warmup.c)
+bool dpinternal_warmup_init(dp_warmup_refresh_t* refresh);
+void dpinternal_warmup_destroy(dp_warmup_refresh_t* refresh);
+long dpinternal_warmup_run(dp_context_t* context, size_t num_connections);
+
+// Client-side rate limiting (dp_rate_limit.c)
+long dpinternal_rate_limit_try(dp_transfer_t* t);
+bool dpinternal_rate_limit_wait_fits(const dp_transfer_t* t, long wait_ms);
+void dpinternal_rate_limit_refuse(dp_transfer_t* t, long wait_ms);
+int dpinternal_rate_limit_wait(dp_transfer_t* t);
+long dpinternal_rate_limit_try_attempt(dp_transfer_t* t);
+bool dpinternal_rate_limit_wait_attempt(dp_transfer_t* t);
+void dpinternal_rate_limit_settle(dp_transfer_t* t);
+dp_rate_limiter_t* dpinternal_rate_limiter_retain(dp_rate_limiter_t* limiter);
+void dpinternal_rate_limiter_release(dp_rate_limiter_t* limiter);
+
+// Circuit breaker (dp_breaker.c)
+bool dpinternal_breaker_init(dp_breaker_t* breaker);
+void dpinternal_breaker_destroy(dp_breaker_t* breaker);
+int dpinternal_breaker_admit(dp_transfer_t* t);
+void dpinternal_breaker_record(dp_transfer_t* t, CURLcode res);
+bool dpinternal_breaker_allows_retry(dp_context_t* context);
+void dpinternal_breaker_abandon(dp_transfer_t* t);
+
+// Single-flight deduplication (dp_flight.c)
+bool dpinternal_flight_init(dp_flight_registry_t* registry);
+void dpinternal_flight_destroy(dp_flight_registry_t* registry);
+bool dpinternal_flight_join(dp_transfer_t* t);
+void dpinternal_flight_land(dp_transfer_t* t);
+
+// Response cache (dp_cache.c)
+bool dpinternal_cache_lookup(dp_transfer_t* t);
+void dpinternal_cache_record(dp_transfer_t* t);
+void dpinternal_cache_store(dp_transfer_t* t);
+void dpinternal_cache_discard(dp_transfer_t* t);
+dp_response_cache_t* dpinternal_response_cache_retain(dp_response_cache_t* cache);
+void dpinternal_response_cache_release(dp_response_cache_t* cache);
+
+// Multi-backend routing (dp_router.c)
+size_t dpinternal_router_pick(dp_router_t* router, const char* model, const bool* tried);
+void dpinternal_router_record(dp_router_t* router, size_t index, bool succeeded, bool counts, uint64_t latency_ms);
+
+// Shared caches (dp_share.c)
+dp_share_t* dpinternal_share_retain(dp_share_t* share);
+void dpinternal_share_release(dp_share_t* share);
 
 // File handling helpers
 char* dpinternal_get_mime_type(const char* filename);
@@ -0,0 +1,261 @@
+#define _GNU_SOURCE
+#include "disasterparty.h"
+#include "dp_private.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Client-side rate limiting. A limiter keeps three token buckets (requests,
+// input tokens, output tokens per minute), each holding one minute's quota
+// and refilling continuously, so a burst of up to a full minute's quota goes
+// out at once and the rest is paced.
+//
+// Token counts are not known until the provider answers, so a request is
+// charged an estimate before it is sent (message text at about four
+// characters per token, a flat amount per attachment, and max_tokens for
+// output) and the difference to the reported usage is settled afterwards.
+// Buckets may go into debt when usage exceeds the estimate; later requests
+// then wait for the debt to refill away.
+
+dp_rate_limiter_t* dp_rate_limiter_create(const dp_rate_limits_t* limits) {
+    if (!limits || limits->requests_per_minute < 0 || limits->input_tokens_per_minute < 0 ||
+        limits->output_tokens_per_minute < 0) {
+        return NULL;
+    }
+    dp_rate_limiter_t* limiter = calloc(1, sizeof(dp_rate_limiter_t));
+    if (!limiter) return NULL;
+    if (pthread_mutex_init(&limiter->lock, NULL) != 0) {
+        free(limiter);
+        return NULL;
+    }
+    long per_minute[DP_RATE_BUCKET_COUNT] = {
+        limits->requests_per_minute, limits->input_tokens_per_minute, limits->output_tokens_per_minute
+    };
+    for (int i = 0; i < DP_RATE_BUCKET_COUNT; ++i) {
+        limiter->buckets[i].capacity = (double)per_minute[i];
+        limiter->buckets[i].level = (double)per_minute[i];
+        limiter->buckets[i].per_ms = (double)per_minute[i] / 60000.0;
+    }
+    limiter->refilled_ms = dpinternal_monotonic_ms();
+    limiter->refcount = 1;
+    return limiter;
+}
+
+dp_rate_limiter_t* dpinternal_rate_limiter_retain(dp_rate_limiter_t* limiter) {
+    pthread_mutex_lock(&limiter->lock);
+    limiter->refcount++;
+    pthread_mutex_unlock(&limiter->lock);
+    return limiter;
+}
+
+void dpinternal_rate_limiter_release(dp_rate_limiter_t* limiter) {
+    if (!limiter) return;
+    pthread_mutex_lock(&limiter->lock);
+    int remaining = --limiter->refcount;
+    pthread_mutex_unlock(&limiter->lock);
+    if (remaining > 0) return;
+    pthread_mutex_destroy(&limiter->lock);
+    free(limiter);
+}
+
+void dp_rate_limiter_destroy(dp_rate_limiter_t* limiter) {
+    // Contexts still using the limiter keep it alive until they are destroyed.
+    dpinternal_rate_limiter_release(limiter);
+}
+
+int dp_set_rate_limiter(dp_context_t* context, dp_rate_limiter_t* limiter, dp_rate_limit_mode_t mode) {
+    if (!context) return -1;
+    if (limiter) dpinternal_rate_limiter_retain(limiter);
+    dpinternal_rate_limiter_release(context->rate_limiter);
+    context->rate_limiter = limiter;
+    context->rate_limit_mode = mode;
+    return 0;
+}
+
+// Call with the lock held
+static void dpinternal_rate_limiter_refill(dp_rate_limiter_t* limiter, uint64_t now) {
+    if (now <= limiter->refilled_ms) return;
+    double elapsed = (double)(now - limiter->refilled_ms);
+    for (int i = 0; i < DP_RATE_BUCKET_COUNT; ++i) {
+        dp_rate_bucket_t* bucket = &limiter->buckets[i];
+        if (bucket->capacity <= 0) continue;
+        bucket->level += elapsed * bucket->per_ms;
+        if (bucket->level > bucket->capacity) bucket->level = bucket->capacity;
+    }
+    limiter->refilled_ms = now;
+}
+
+// Charges one request and the estimates if every bucket can take them, and
+// returns 0; otherwise charges nothing and returns the milliseconds until it
+// could. A cost above a bucket's capacity only needs the bucket to be full.
+static long dpinternal_rate_limiter_take(dp_rate_limiter_t* limiter, long input_tokens, long output_tokens) {
+    double cost[DP_RATE_BUCKET_COUNT] = { 1.0, (double)input_tokens, (double)output_tokens };
+    pthread_mutex_lock(&limiter->lock);
+    dpinternal_rate_limiter_refill(limiter, dpinternal_monotonic_ms());
+    double wait_ms = 0;
+    for (int i = 0; i < DP_RATE_BUCKET_COUNT; ++i) {
+        const dp_rate_bucket_t* bucket = &limiter->buckets[i];
+        if (bucket->capacity <= 0) continue;
+        double needed = (cost[i] < bucket->capacity ? cost[i] : bucket->capacity) - bucket->level;
+        if (needed > 0 && needed / bucket->per_ms > wait_ms) wait_ms = needed / bucket->per_ms;
+    }
+    if (wait_ms <= 0) {
+        for (int i = 0; i < DP_RATE_BUCKET_COUNT; ++i) {
+            if (limiter->buckets[i].capacity > 0) limiter->buckets[i].level -= cost[i];
+        }
+    }
+    pthread_mutex_unlock(&limiter->lock);
+    return wait_ms <= 0 ? 0 : (long)wait_ms + 1;
+}
+
+long dp_rate_limiter_acquire(dp_rate_limiter_t* limiter, long input_tokens, long output_tokens, bool wait) {
+    if (!limiter || input_tokens < 0 || output_tokens < 0) return -1;
+    for (;;) {
+        long wait_ms = dpinternal_rate_limiter_take(limiter, input_tokens, output_tokens);
+        if (wait_ms == 0 || !wait) return wait_ms;
+        dpinternal_sleep_ms(wait_ms);
+    }
+}
+
+void dp_rate_limiter_settle(dp_rate_limiter_t* limiter,
+                            long estimated_input_tokens, long estimated_output_tokens,
+                            long actual_input_tokens, long actual_output_tokens) {
+    if (!limiter) return;
+    double correction[DP_RATE_BUCKET_COUNT] = {
+        0, (double)(estimated_input_tokens - actual_input_tokens), (double)(estimated_output_tokens - actual_output_tokens)
+    };
+    pthread_mutex_lock(&limiter->lock);
+    dpinternal_rate_limiter_refill(limiter, dpinternal_monotonic_ms());
+    for (int i = 0; i < DP_RATE_BUCKET_COUNT; ++i) {
+        dp_rate_bucket_t* bucket = &limiter->buckets[i];
+        if (bucket->capacity <= 0) continue;
+        bucket->level += correction[i];
+        if (bucket->level > bucket->capacity) bucket->level = bucket->capacity;
+    }
+    pthread_mutex_unlock(&limiter->lock);
+}
+
+static size_t dpinternal_rate_limit_strlen(const char* s) {
+    return s ? strlen(s) : 0;
+}
+
+static long dpinternal_rate_limit_estimate_input(const dp_request_config_t* config) {
+    size_t chars = dpinternal_rate_limit_strlen(config->system_prompt);
+    long attachments = 0;
+    for (size_t i = 0; i < config->num_messages; ++i) {
+        const dp_message_t* message = &config->messages[i];
+        for (size_t j = 0; j < message->num_parts; ++j) {
+            const dp_content_part_t* part = &message->parts[j];
+            switch (part->type) {
+                case DP_CONTENT_PART_TEXT:
+                    chars += dpinternal_rate_limit_strlen(part->text);
+                    break;
+                case DP_CONTENT_PART_TOOL_CALL:
+                    chars += dpinternal_rate_limit_strlen(part->tool_call.function_name) +
+                             dpinternal_rate_limit_strlen(part->tool_call.arguments_json);
+                    break;
+                case DP_CONTENT_PART_TOOL_RESULT:
+                    chars += dpinternal_rate_limit_strlen(part->tool_result.content);
+                    break;
+                case DP_CONTENT_PART_THINKING:
+                    chars += dpinternal_rate_limit_strlen(part->thinking.thinking);
+                    break;
+                default:
+                    attachments++;
+                    break;
+            }
+        }
+    }
+    for (size_t i = 0; i < config->num_tools; ++i) {
+        const dp_tool_function_t* function = &config->tools[i].function;
+        chars += dpinternal_rate_limit_strlen(function->name) + dpinternal_rate_limit_strlen(function->description) +
+                 dpinternal_rate_limit_strlen(function->parameters_json_schema);
+    }
+    return (long)((chars + DP_RATE_LIMIT_CHARS_PER_TOKEN - 1) / DP_RATE_LIMIT_CHARS_PER_TOKEN) +
+           attachments * DP_RATE_LIMIT_ATTACHMENT_TOKENS;
+}
+
+long dpinternal_rate_limit_try(dp_transfer_t* t) {
+    dp_rate_limiter_t* limiter = t->context->rate_limiter;
+    if (!limiter || t->rate_charged) return 0;
+    long input = dpinternal_rate_limit_estimate_input(t->request_config);
+    long output = t->request_config->max_tokens > 0 ? t->request_config->max_tokens : 0;
+    long wait_ms = dpinternal_rate_limiter_take(limiter, input, output);
+    if (wait_ms == 0) {
+        t->rate_charged = true;
+        t->rate_input_estimate = input;
+        t->rate_output_estimate = output;
+    }
+    return wait_ms;
+}
+
+// Time queued for capacity counts towards the request's total deadline, so a
+// wait is only worth starting if capacity comes before the deadline does.
+bool dpinternal_rate_limit_wait_fits(const dp_transfer_t* t, long wait_ms) {
+    long remaining_ms = dpinternal_deadline_remaining_ms(&t->deadline);
+    return remaining_ms < 0 || wait_ms < remaining_ms;
+}
+
+void dpinternal_rate_limit_refuse(dp_transfer_t* t, long wait_ms) {
+    free(t->response->error_message);
+    dpinternal_safe_asprintf(&t->response->error_message,
+                             "Client-side rate limit reached; capacity is available again in %ld ms.", wait_ms);
+    t->response->error_class = DP_ERROR_RATE_LIMITED;
+}
+
+int dpinternal_rate_limit_wait(dp_transfer_t* t) {
+    bool waited = false;
+    for (;;) {
+        long wait_ms = dpinternal_rate_limit_try(t);
+        if (wait_ms == 0) break;
+        if (t->context->rate_limit_mode == DP_RATE_LIMIT_FAIL_FAST || !dpinternal_rate_limit_wait_fits(t, wait_ms)) {
+            dpinternal_rate_limit_refuse(t, wait_ms);
+            return -1;
+        }
+        dpinternal_sleep_ms(wait_ms);
+        waited = true;
+    }
+    // The attempt gets what is left of the total deadline
+    if (waited) dpinternal_deadline_next_attempt(&t->deadline, t->curl);
+    return 0;
+}
+
+// Every retry and hedge is another request to the provider, so it takes a
+// request token of its own; the token estimates were charged once for the
+// whole call. Returns 0 once taken, otherwise the milliseconds until it could be.
+long dpinternal_rate_limit_try_attempt(dp_transfer_t* t) {
+    dp_rate_limiter_t* limiter = t->context->rate_limiter;
+    if (!limiter) return 0;
+    return dpinternal_rate_limiter_take(limiter, 0, 0);
+}
+
+// Waits for a blocking retry's request token. Returns false, and the retry is
+// not made, in fail-fast mode or when the token would come after the deadline.
+bool dpinternal_rate_limit_wait_attempt(dp_transfer_t* t) {
+    for (;;) {
+        long wait_ms = dpinternal_rate_limit_try_attempt(t);
+        if (wait_ms == 0) return true;
+        if (t->context->rate_limit_mode == DP_RATE_LIMIT_FAIL_FAST || !dpinternal_rate_limit_wait_fits(t, wait_ms)) {
+            return false;
+        }
+        dpinternal_sleep_ms(wait_ms);
+    }
+}
+
+// Settles a transfer's charge from the usage its response reported. A failed
+// request that reported no usage is assumed to have consumed no tokens; a
+// successful one without usage (OpenAI-compatible streams) keeps the estimate.
+// Prompt cache writes count as input; Anthropic reports them apart from
+// input_tokens, and cache reads do not count towards its input limit.
+void dpinternal_rate_limit_settle(dp_transfer_t* t) {
+    if (!t->rate_charged) return;
+    t->rate_charged = false;
+    const dp_response_t* response = t->response;
+    long input = response->usage.input_tokens + response->usage.cache_creation_input_tokens;
+    long output = response->usage.output_tokens;
+    if (!response->error_message) {
+        if (input == 0) input = t->rate_input_estimate;
+        if (output == 0) output = t->rate_output_estimate;
+    }
+    dp_rate_limiter_settle(t->context->rate_limiter, t->rate_input_estimate, t->rate_output_estimate, input, output);
+}
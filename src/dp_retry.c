@@ -0,0 +1,286 @@
+#define _GNU_SOURCE
+#include "dp_private.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <time.h>
+
+// Retries of transient failures. Waits follow exponential backoff with full
+// jitter (a uniform draw between 0 and min(cap, base * 2^n)) so clients that
+// failed together do not retry together, unless the provider said when to
+// come back. A per-context token bucket bounds retries to a share of traffic:
+// every request deposits budget_ratio tokens, every retry spends one, so an
+// outage does not multiply load by max_attempts.
+
+static _Thread_local uint64_t dp_retry_rng_state;
+
+static uint64_t dpinternal_retry_random(void) {
+    if (dp_retry_rng_state == 0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        dp_retry_rng_state = ((uint64_t)ts.tv_nsec << 32) ^ (uint64_t)ts.tv_sec ^ (uint64_t)(uintptr_t)&dp_retry_rng_state;
+        if (dp_retry_rng_state == 0) dp_retry_rng_state = 0x9E3779B97F4A7C15ULL;
+    }
+    // xorshift64*
+    dp_retry_rng_state ^= dp_retry_rng_state >> 12;
+    dp_retry_rng_state ^= dp_retry_rng_state << 25;
+    dp_retry_rng_state ^= dp_retry_rng_state >> 27;
+    return dp_retry_rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static long dpinternal_retry_jitter(long ceiling_ms) {
+    if (ceiling_ms <= 0) return 0;
+    return (long)(dpinternal_retry_random() % (uint64_t)(ceiling_ms + 1));
+}
+
+void dpinternal_retry_hints_reset(dp_retry_hints_t* hints) {
+    hints->retry_after_ms = -1;
+    hints->requests_reset_ms = -1;
+    hints->tokens_reset_ms = -1;
+    hints->requests_exhausted = false;
+    hints->tokens_exhausted = false;
+}
+
+// OpenAI reset headers are Go-style durations: "1s", "6m0s", "1h2m3.5s", "120ms".
+static long dpinternal_retry_parse_duration(const char* value) {
+    double total_ms = 0;
+    const char* p = value;
+    bool any = false;
+    while (*p) {
+        char* end = NULL;
+        double amount = strtod(p, &end);
+        if (end == p) break;
+        p = end;
+        if (strncmp(p, "ms", 2) == 0) { total_ms += amount; p += 2; }
+        else if (*p == 'h') { total_ms += amount * 3600000.0; p++; }
+        else if (*p == 'm') { total_ms += amount * 60000.0; p++; }
+        else if (*p == 's') { total_ms += amount * 1000.0; p++; }
+        else break;
+        any = true;
+    }
+    return any ? (long)(total_ms + 0.5) : -1;
+}
+
+// Anthropic reset headers are RFC 3339 timestamps in UTC.
+static long dpinternal_retry_parse_timestamp(const char* value) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    if (sscanf(value, "%d-%d-%dT%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+               &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6) {
+        return -1;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    time_t reset = timegm(&tm);
+    time_t now = time(NULL);
+    return reset > now ? (long)(reset - now) * 1000 : 0;
+}
+
+// Retry-After is either delay-seconds or an HTTP-date.
+static long dpinternal_retry_parse_retry_after(const char* value) {
+    char* end = NULL;
+    long seconds = strtol(value, &end, 10);
+    if (end != value && *end == '\0') {
+        return seconds >= 0 ? seconds * 1000 : -1;
+    }
+    time_t when = curl_getdate(value, NULL);
+    if (when == (time_t)-1) return -1;
+    time_t now = time(NULL);
+    return when > now ? (long)(when - now) * 1000 : 0;
+}
+
+size_t dpinternal_retry_header_callback(char* buffer, size_t size, size_t nitems, void* userdata) {
+    size_t length = size * nitems;
+    dp_retry_hints_t* hints = (dp_retry_hints_t*)userdata;
+    const char* colon = memchr(buffer, ':', length);
+    if (!colon) return length;
+
+    size_t name_length = (size_t)(colon - buffer);
+    const char* value_start = colon + 1;
+    size_t value_length = length - name_length - 1;
+    while (value_length > 0 && (*value_start == ' ' || *value_start == '\t')) { value_start++; value_length--; }
+    while (value_length > 0 && (value_start[value_length - 1] == '\r' || value_start[value_length - 1] == '\n' ||
+                                value_start[value_length - 1] == ' ')) {
+        value_length--;
+    }
+    char value[128];
+    if (value_length == 0 || value_length >= sizeof(value)) return length;
+    memcpy(value, value_start, value_length);
+    value[value_length] = '\0';
+
+#define DP_HEADER_IS(literal) (name_length == sizeof(literal) - 1 && strncasecmp(buffer, literal, name_length) == 0)
+    if (DP_HEADER_IS("retry-after-ms")) {
+        char* end = NULL;
+        long ms = strtol(value, &end, 10);
+        if (end != value && ms >= 0) hints->retry_after_ms = ms;
+    } else if (DP_HEADER_IS("retry-after")) {
+        // retry-after-ms is more precise; keep it if it came first
+        if (hints->retry_after_ms < 0) hints->retry_after_ms = dpinternal_retry_parse_retry_after(value);
+    } else if (DP_HEADER_IS("x-ratelimit-remaining-requests") || DP_HEADER_IS("anthropic-ratelimit-requests-remaining")) {
+        hints->requests_exhausted = strcmp(value, "0") == 0;
+    } else if (DP_HEADER_IS("x-ratelimit-remaining-tokens") || DP_HEADER_IS("anthropic-ratelimit-tokens-remaining") ||
+               DP_HEADER_IS("anthropic-ratelimit-input-tokens-remaining") || DP_HEADER_IS("anthropic-ratelimit-output-tokens-remaining")) {
+        if (strcmp(value, "0") == 0) hints->tokens_exhausted = true;
+    } else if (DP_HEADER_IS("x-ratelimit-reset-requests")) {
+        hints->requests_reset_ms = dpinternal_retry_parse_duration(value);
+    } else if (DP_HEADER_IS("x-ratelimit-reset-tokens")) {
+        hints->tokens_reset_ms = dpinternal_retry_parse_duration(value);
+    } else if (DP_HEADER_IS("anthropic-ratelimit-requests-reset")) {
+        hints->requests_reset_ms = dpinternal_retry_parse_timestamp(value);
+    } else if (DP_HEADER_IS("anthropic-ratelimit-tokens-reset") || DP_HEADER_IS("anthropic-ratelimit-input-tokens-reset") ||
+               DP_HEADER_IS("anthropic-ratelimit-output-tokens-reset")) {
+        long reset_ms = dpinternal_retry_parse_timestamp(value);
+        if (reset_ms > hints->tokens_reset_ms) hints->tokens_reset_ms = reset_ms;
+    }
+#undef DP_HEADER_IS
+    return length;
+}
+
+// The provider's own estimate of when a retry can succeed, or -1.
+static long dpinternal_retry_hint_ms(const dp_retry_hints_t* hints) {
+    if (hints->retry_after_ms >= 0) return hints->retry_after_ms;
+    long hint = -1;
+    if (hints->requests_exhausted && hints->requests_reset_ms > hint) hint = hints->requests_reset_ms;
+    if (hints->tokens_exhausted && hints->tokens_reset_ms > hint) hint = hints->tokens_reset_ms;
+    return hint;
+}
+
+bool dpinternal_retry_is_transient(CURLcode res, long http_status, dp_error_class_t error_class, dp_deadline_kind_t deadline_missed) {
+    switch (error_class) {
+        case DP_ERROR_DEADLINE:
+            // The caller's overall limit is spent; the others just mean this attempt hit a bad replica
+            return deadline_missed != DP_DEADLINE_TOTAL;
+        case DP_ERROR_TRANSPORT:
+            switch (res) {
+                case CURLE_COULDNT_RESOLVE_HOST:
+                case CURLE_COULDNT_CONNECT:
+                case CURLE_SEND_ERROR:
+                case CURLE_RECV_ERROR:
+                case CURLE_GOT_NOTHING:
+                case CURLE_PARTIAL_FILE:
+                case CURLE_HTTP2:
+                case CURLE_HTTP2_STREAM:
+                case CURLE_SSL_CONNECT_ERROR:
+                    return true;
+                default:
+                    return false;
+            }
+        case DP_ERROR_API:
+            switch (http_status) {
+                case 408: case 425: case 429:
+                case 500: case 502: case 503: case 504:
+                case 529:   // Anthropic: overloaded
+                    return true;
+                default:
+                    return false;
+            }
+        default:
+            return false;
+    }
+}
+
+void dpinternal_retry_note_request(dp_context_t* context) {
+    atomic_fetch_add_explicit(&context->stat_requests, 1, memory_order_relaxed);
+    const dp_retry_policy_t* policy = &context->retry_policy;
+    if (policy->max_attempts <= 1 || policy->budget_burst <= 0 || policy->budget_ratio <= 0) return;
+
+    long deposit = (long)(policy->budget_ratio * DP_RETRY_BUDGET_SCALE);
+    long cap = (long)policy->budget_burst * DP_RETRY_BUDGET_SCALE;
+    long balance = atomic_load_explicit(&context->retry_budget, memory_order_relaxed);
+    long updated;
+    do {
+        if (balance >= cap) return;
+        updated = balance + deposit > cap ? cap : balance + deposit;
+    } while (!atomic_compare_exchange_weak_explicit(&context->retry_budget, &balance, updated,
+                                                    memory_order_relaxed, memory_order_relaxed));
+}
+
+static bool dpinternal_retry_take_budget(dp_context_t* context) {
+    if (context->retry_policy.budget_burst <= 0) return true;
+    long balance = atomic_load_explicit(&context->retry_budget, memory_order_relaxed);
+    do {
+        if (balance < DP_RETRY_BUDGET_SCALE) return false;
+    } while (!atomic_compare_exchange_weak_explicit(&context->retry_budget, &balance, balance - DP_RETRY_BUDGET_SCALE,
+                                                    memory_order_relaxed, memory_order_relaxed));
+    return true;
+}
+
+long dpinternal_retry_next_delay(dp_context_t* context, int attempts, const dp_retry_hints_t* hints, const dp_deadline_watch_t* deadline) {
+    const dp_retry_policy_t* policy = &context->retry_policy;
+    if (attempts >= policy->max_attempts) return -1;
+
+    long delay;
+    long hint = dpinternal_retry_hint_ms(hints);
+    if (hint >= 0) {
+        // Not worth waiting for; let the caller decide what to do instead
+        if (policy->max_delay_ms > 0 && hint > policy->max_delay_ms) return -1;
+        // A little jitter on top so clients told the same time do not return in lockstep
+        delay = hint + dpinternal_retry_jitter(policy->base_delay_ms / 4);
+    } else {
+        long ceiling = policy->base_delay_ms;
+        for (int i = 1; i < attempts && (policy->max_delay_ms <= 0 || ceiling < policy->max_delay_ms); ++i) {
+            ceiling *= 2;
+        }
+        if (policy->max_delay_ms > 0 && ceiling > policy->max_delay_ms) ceiling = policy->max_delay_ms;
+        delay = dpinternal_retry_jitter(ceiling);
+    }
+    // The next attempt would start with the total deadline already spent
+    long remaining_ms = dpinternal_deadline_remaining_ms(deadline);
+    if (remaining_ms >= 0 && delay >= remaining_ms) return -1;
+
+    if (!dpinternal_retry_take_budget(context)) {
+        atomic_fetch_add_explicit(&context->stat_retries_denied, 1, memory_order_relaxed);
+        return -1;
+    }
+    atomic_fetch_add_explicit(&context->stat_retries, 1, memory_order_relaxed);
+    return delay;
+}
+
+void dpinternal_sleep_ms(long ms) {
+    if (ms <= 0) return;
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0) {
+        // Interrupted by a signal: sleep for the remainder
+    }
+}
+
+// Whether a failed attempt never reached the server, so sending it again
+// cannot repeat its effect.
+static bool dpinternal_retry_before_send(CURLcode res, dp_deadline_kind_t missed) {
+    return res == CURLE_COULDNT_RESOLVE_HOST || res == CURLE_COULDNT_CONNECT || missed == DP_DEADLINE_CONNECT;
+}
+
+// Performs a request whose body is buffered in memory (model listing, token
+// counting, cached content), retrying transient failures under the context's
+// policy. A request that is not idempotent is only retried when the failed
+// attempt never reached the server.
+CURLcode dpinternal_retry_perform_buffered(dp_context_t* context, CURL* curl, memory_struct_t* body, dp_deadline_watch_t* deadline, bool idempotent, long* http_status_out) {
+    dp_retry_hints_t hints;
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, dpinternal_retry_header_callback);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void*)&hints);
+    dpinternal_retry_note_request(context);
+
+    for (int attempts = 1; ; ++attempts) {
+        dpinternal_retry_hints_reset(&hints);
+        CURLcode res = curl_easy_perform(curl);
+        dpinternal_transfer_count_body(context, curl, body->size, NULL);
+        *http_status_out = 0;
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, http_status_out);
+
+        dp_deadline_kind_t missed = dpinternal_deadline_missed(deadline, res);
+        dp_error_class_t error_class = DP_ERROR_NONE;
+        if (missed != DP_DEADLINE_NONE) error_class = DP_ERROR_DEADLINE;
+        else if (res != CURLE_OK) error_class = DP_ERROR_TRANSPORT;
+        else if (*http_status_out < 200 || *http_status_out >= 300) error_class = DP_ERROR_API;
+        if (!dpinternal_retry_is_transient(res, *http_status_out, error_class, missed)) return res;
+        if (!idempotent && !dpinternal_retry_before_send(res, missed)) return res;
+
+        long delay = dpinternal_retry_next_delay(context, attempts, &hints, deadline);
+        if (delay < 0) return res;
+        dpinternal_sleep_ms(delay);
+        body->size = 0;
+        if (body->memory) body->memory[0] = '\0';
+        dpinternal_deadline_next_attempt(deadline, curl);
+    }
+}
@@ -0,0 +1,333 @@
+#define _GNU_SOURCE
+#include "disasterparty.h"
+#include "dp_private.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Multi-backend routing. Each request goes to a backend drawn at random with
+// probability proportional to
+//
+//     weight * health / ((latency_ms + 1) * (in_flight + 1))
+//
+// where latency and health (1 - error rate) are EWMAs of what the router has
+// observed. Drawing rather than always taking the best backend keeps every
+// backend sampled now and then, so one that was slow or failing is noticed
+// once it recovers. A backend with no successful sample yet is assumed to be
+// as fast as the fastest one, so it is tried early.
+//
+// When an attempt fails because of the backend (transport errors, missed
+// deadlines, 408, 429 and 5xx) the request moves on to a backend it has not
+// tried, unless a stream already delivered output (trying again would replay
+// it). A request the provider rejected, or an invalid or cancelled one, would
+// fare no better elsewhere; it neither fails over nor counts against the
+// backend's health. Retries within one backend are still governed by that
+// context's own retry policy.
+
+typedef enum {
+    DP_ROUTER_COMPLETION,
+    DP_ROUTER_STREAM,
+    DP_ROUTER_DETAILED_STREAM
+} dp_router_kind_t;
+
+// Stands between a backend and the caller's stream callback for one attempt.
+// An error before any output is held back, since another backend may still
+// succeed; it reaches the caller only if none does.
+typedef struct {
+    dp_stream_callback_t callback;
+    dp_detailed_stream_callback_t detailed_callback;
+    void* user_data;
+    bool delivered;
+    bool error_withheld;
+    uint64_t first_output_ms;
+} dp_router_relay_t;
+
+static int dpinternal_router_stream_relay(const char* token, void* user_data, bool is_final, const char* error) {
+    dp_router_relay_t* relay = (dp_router_relay_t*)user_data;
+    if (error && !relay->delivered) {
+        relay->error_withheld = true;
+        return 0;
+    }
+    if (!relay->delivered) relay->first_output_ms = dpinternal_monotonic_ms();
+    relay->delivered = true;
+    return relay->callback(token, relay->user_data, is_final, error);
+}
+
+static int dpinternal_router_event_relay(const dp_anthropic_stream_event_t* event, void* user_data, const char* error) {
+    dp_router_relay_t* relay = (dp_router_relay_t*)user_data;
+    if ((error || (event && event->event_type == DP_EVENT_ERROR)) && !relay->delivered) {
+        relay->error_withheld = true;
+        return 0;
+    }
+    if (!relay->delivered) relay->first_output_ms = dpinternal_monotonic_ms();
+    relay->delivered = true;
+    return relay->detailed_callback(event, relay->user_data, error);
+}
+
+static void dpinternal_router_free_backends(dp_router_backend_state_t* backends, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < backends[i].num_models; ++j) {
+            free((char*)backends[i].models[j].requested);
+            free((char*)backends[i].models[j].model);
+        }
+        free(backends[i].models);
+    }
+    free(backends);
+}
+
+dp_router_t* dp_router_create(const dp_router_backend_t* backends, size_t n) {
+    if (!backends || n == 0) return NULL;
+    for (size_t i = 0; i < n; ++i) {
+        if (!backends[i].context || backends[i].weight < 0 || (backends[i].num_models > 0 && !backends[i].models)) return NULL;
+        for (size_t j = 0; j < backends[i].num_models; ++j) {
+            if (!backends[i].models[j].model) return NULL;
+        }
+    }
+
+    dp_router_t* router = calloc(1, sizeof(dp_router_t));
+    if (!router) return NULL;
+    router->backends = calloc(n, sizeof(dp_router_backend_state_t));
+    if (!router->backends || pthread_mutex_init(&router->lock, NULL) != 0) {
+        free(router->backends);
+        free(router);
+        return NULL;
+    }
+    router->num_backends = n;
+    router->rng_state = (dpinternal_monotonic_ms() ^ (uint64_t)(uintptr_t)router) | 1;
+
+    for (size_t i = 0; i < n; ++i) {
+        dp_router_backend_state_t* state = &router->backends[i];
+        state->context = backends[i].context;
+        state->weight = backends[i].weight > 0 ? backends[i].weight : 1.0;
+        if (backends[i].num_models == 0) continue;
+        state->models = calloc(backends[i].num_models, sizeof(dp_model_mapping_t));
+        if (!state->models) goto fail;
+        state->num_models = backends[i].num_models;
+        for (size_t j = 0; j < state->num_models; ++j) {
+            const dp_model_mapping_t* mapping = &backends[i].models[j];
+            state->models[j].model = dpinternal_strdup(mapping->model);
+            state->models[j].requested = mapping->requested ? dpinternal_strdup(mapping->requested) : NULL;
+            if (!state->models[j].model || (mapping->requested && !state->models[j].requested)) goto fail;
+        }
+    }
+    return router;
+
+fail:
+    dpinternal_router_free_backends(router->backends, n);
+    pthread_mutex_destroy(&router->lock);
+    free(router);
+    return NULL;
+}
+
+void dp_router_destroy(dp_router_t* router) {
+    if (!router) return;
+    dpinternal_router_free_backends(router->backends, router->num_backends);
+    pthread_mutex_destroy(&router->lock);
+    free(router);
+}
+
+// The name backend state knows the requested model by, or NULL if its
+// mappings do not cover it.
+static const char* dpinternal_router_map_model(const dp_router_backend_state_t* state, const char* requested) {
+    if (state->num_models == 0) return requested;
+    for (size_t i = 0; i < state->num_models; ++i) {
+        const dp_model_mapping_t* mapping = &state->models[i];
+        if (!mapping->requested || (requested && strcmp(mapping->requested, requested) == 0)) return mapping->model;
+    }
+    return NULL;
+}
+
+// Uniform in [0, 1); call with the lock held
+static double dpinternal_router_random(dp_router_t* router) {
+    uint64_t x = router->rng_state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    router->rng_state = x;
+    return (double)((x * 0x2545F4914F6CDD1DULL) >> 11) / 9007199254740992.0;
+}
+
+// Draws an untried backend that serves the model and marks it in flight.
+// Returns num_backends if there is none.
+size_t dpinternal_router_pick(dp_router_t* router, const char* model, const bool* tried) {
+    size_t n = router->num_backends;
+    pthread_mutex_lock(&router->lock);
+    double assumed_latency = -1;
+    for (size_t i = 0; i < n; ++i) {
+        const dp_router_backend_state_t* state = &router->backends[i];
+        if (state->has_latency && (assumed_latency < 0 || state->latency_ms < assumed_latency)) assumed_latency = state->latency_ms;
+    }
+    if (assumed_latency < 0) assumed_latency = 0;
+
+    double scores[n];
+    double total = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const dp_router_backend_state_t* state = &router->backends[i];
+        scores[i] = 0;
+        if (tried[i] || !dpinternal_router_map_model(state, model)) continue;
+        double latency = state->has_latency ? state->latency_ms : assumed_latency;
+        double health = 1.0 - state->error_rate;
+        if (health < DP_ROUTER_MIN_HEALTH) health = DP_ROUTER_MIN_HEALTH;
+        scores[i] = state->weight * health / ((latency + 1.0) * (double)(state->in_flight + 1));
+        total += scores[i];
+    }
+
+    size_t chosen = n;
+    if (total > 0) {
+        double target = dpinternal_router_random(router) * total;
+        for (size_t i = 0; i < n; ++i) {
+            if (scores[i] <= 0) continue;
+            chosen = i;
+            if (target < scores[i]) break;
+            target -= scores[i];
+        }
+        router->backends[chosen].in_flight++;
+        router->backends[chosen].requests++;
+    }
+    pthread_mutex_unlock(&router->lock);
+    return chosen;
+}
+
+void dpinternal_router_record(dp_router_t* router, size_t index, bool succeeded, bool counts, uint64_t latency_ms) {
+    pthread_mutex_lock(&router->lock);
+    dp_router_backend_state_t* state = &router->backends[index];
+    state->in_flight--;
+    if (counts) {
+        state->error_rate += DP_ROUTER_ERROR_ALPHA * ((succeeded ? 0.0 : 1.0) - state->error_rate);
+        if (!succeeded) state->failures++;
+    }
+    // Failures often return quickly, so only successes say how fast a backend is
+    if (succeeded) {
+        if (state->has_latency) {
+            state->latency_ms += DP_ROUTER_LATENCY_ALPHA * ((double)latency_ms - state->latency_ms);
+        } else {
+            state->latency_ms = (double)latency_ms;
+            state->has_latency = true;
+        }
+    }
+    pthread_mutex_unlock(&router->lock);
+}
+
+// Whether a failed attempt reflects on the backend rather than on the request.
+static bool dpinternal_router_backend_failed(const dp_response_t* response) {
+    switch (response->error_class) {
+        case DP_ERROR_TRANSPORT:
+        case DP_ERROR_DEADLINE:
+        case DP_ERROR_RATE_LIMITED:
+        case DP_ERROR_CIRCUIT_OPEN:
+            return true;
+        case DP_ERROR_API: {
+            // Errors reported inside a 200 stream are the provider's, like 5xx
+            long status = response->http_status_code;
+            return status < 400 || status >= 500 || status == 408 || status == 429;
+        }
+        default:
+            return false;
+    }
+}
+
+static int dpinternal_router_perform(dp_router_t* router,
+                                     const dp_request_config_t* request_config,
+                                     dp_router_kind_t kind,
+                                     dp_stream_callback_t callback,
+                                     dp_detailed_stream_callback_t detailed_callback,
+                                     void* user_data,
+                                     dp_response_t* response) {
+    bool streaming = kind != DP_ROUTER_COMPLETION;
+    if (!router || !request_config || !response || (kind == DP_ROUTER_STREAM && !callback) ||
+        (kind == DP_ROUTER_DETAILED_STREAM && !detailed_callback)) {
+        if (response) {
+            memset(response, 0, sizeof(*response));
+            response->error_message = dpinternal_strdup("Invalid arguments to dp_router_perform_completion.");
+            response->error_class = DP_ERROR_OTHER;
+        }
+        return -1;
+    }
+    memset(response, 0, sizeof(*response));
+
+    bool tried[router->num_backends];
+    memset(tried, 0, sizeof(tried));
+    dp_router_relay_t relay = { .callback = callback, .detailed_callback = detailed_callback, .user_data = user_data };
+    bool attempted = false;
+    int ret = -1;
+    for (;;) {
+        size_t index = dpinternal_router_pick(router, request_config->model, tried);
+        if (index == router->num_backends) break;
+        tried[index] = true;
+        dp_router_backend_state_t* state = &router->backends[index];
+
+        // The mappings are fixed at creation, so reading them unlocked is safe
+        dp_request_config_t attempt = *request_config;
+        attempt.model = dpinternal_router_map_model(state, request_config->model);
+        if (attempted) dp_free_response_content(response);
+        attempted = true;
+        relay.delivered = false;
+        relay.error_withheld = false;
+        relay.first_output_ms = 0;
+
+        uint64_t start_ms = dpinternal_monotonic_ms();
+        if (kind == DP_ROUTER_COMPLETION) {
+            ret = dp_perform_completion(state->context, &attempt, response);
+        } else if (kind == DP_ROUTER_STREAM) {
+            ret = dp_perform_streaming_completion(state->context, &attempt, dpinternal_router_stream_relay, &relay, response);
+        } else {
+            ret = dp_perform_detailed_streaming_completion(state->context, &attempt, dpinternal_router_event_relay, &relay, response);
+        }
+        uint64_t end_ms = streaming && relay.first_output_ms ? relay.first_output_ms : dpinternal_monotonic_ms();
+        bool backend_failed = ret != 0 && dpinternal_router_backend_failed(response);
+        dpinternal_router_record(router, index, ret == 0, ret == 0 || backend_failed, end_ms - start_ms);
+
+        if (!backend_failed || relay.delivered) break;
+    }
+
+    if (!attempted) {
+        dpinternal_safe_asprintf(&response->error_message, "No router backend serves model '%s'.",
+                                 request_config->model ? request_config->model : "(null)");
+        response->error_class = DP_ERROR_OTHER;
+        return -1;
+    }
+    // Every backend failed before any output: report the last error the way a single context would have
+    if (ret != 0 && relay.error_withheld && !relay.delivered) {
+        if (kind == DP_ROUTER_STREAM) {
+            callback(NULL, user_data, true, response->error_message);
+        } else if (kind == DP_ROUTER_DETAILED_STREAM) {
+            detailed_callback(NULL, user_data, response->error_message);
+        }
+    }
+    return ret;
+}
+
+int dp_router_perform_completion(dp_router_t* router,
+                                 const dp_request_config_t* request_config,
+                                 dp_response_t* response) {
+    return dpinternal_router_perform(router, request_config, DP_ROUTER_COMPLETION, NULL, NULL, NULL, response);
+}
+
+int dp_router_perform_streaming_completion(dp_router_t* router,
+                                           const dp_request_config_t* request_config,
+                                           dp_stream_callback_t callback,
+                                           void* user_data,
+                                           dp_response_t* response) {
+    return dpinternal_router_perform(router, request_config, DP_ROUTER_STREAM, callback, NULL, user_data, response);
+}
+
+int dp_router_perform_detailed_streaming_completion(dp_router_t* router,
+                                                    const dp_request_config_t* request_config,
+                                                    dp_anthropic_stream_callback_t callback,
+                                                    void* user_data,
+                                                    dp_response_t* response) {
+    return dpinternal_router_perform(router, request_config, DP_ROUTER_DETAILED_STREAM, NULL, callback, user_data, response);
+}
+
+int dp_router_get_backend_stats(dp_router_t* router, size_t index, dp_router_backend_stats_t* stats_out) {
+    if (!router || !stats_out || index >= router->num_backends) return -1;
+    pthread_mutex_lock(&router->lock);
+    const dp_router_backend_state_t* state = &router->backends[index];
+    stats_out->latency_ms = state->has_latency ? state->latency_ms : 0;
+    stats_out->error_rate = state->error_rate;
+    stats_out->in_flight = state->in_flight;
+    stats_out->requests = state->requests;
+    stats_out->failures = state->failures;
+    pthread_mutex_unlock(&router->lock);
+    return 0;
+}
@@ -0,0 +1,96 @@
+#define _GNU_SOURCE
+#include "dp_private.h"
+#include <stdlib.h>
+#include <string.h>
+
+// A share wraps a CURLSH so that several contexts (and all of their pooled
+// handles) see one DNS cache and one TLS session cache. libcurl serializes
+// access through the lock callbacks below, one mutex per kind of shared data.
+// Connections are not shared: libcurl does not support one connection cache
+// used by transfers on several threads, and pooled handles and the engine's
+// multi handle keep their own connections alive anyway.
+
+static void dpinternal_share_lock(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr) {
+    (void)handle; (void)access;
+    dp_share_t* share = (dp_share_t*)userptr;
+    if (data >= 0 && data < CURL_LOCK_DATA_LAST) {
+        pthread_mutex_lock(&share->locks[data]);
+    }
+}
+
+static void dpinternal_share_unlock(CURL* handle, curl_lock_data data, void* userptr) {
+    (void)handle;
+    dp_share_t* share = (dp_share_t*)userptr;
+    if (data >= 0 && data < CURL_LOCK_DATA_LAST) {
+        pthread_mutex_unlock(&share->locks[data]);
+    }
+}
+
+dp_share_t* dp_share_create(void) {
+    dp_share_t* share = calloc(1, sizeof(dp_share_t));
+    if (!share) return NULL;
+
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; ++i) {
+        pthread_mutex_init(&share->locks[i], NULL);
+    }
+    pthread_mutex_init(&share->ref_lock, NULL);
+    share->refcount = 1;
+
+    share->curl_share = curl_share_init();
+    if (!share->curl_share) {
+        dpinternal_share_release(share);
+        return NULL;
+    }
+    curl_share_setopt(share->curl_share, CURLSHOPT_LOCKFUNC, dpinternal_share_lock);
+    curl_share_setopt(share->curl_share, CURLSHOPT_UNLOCKFUNC, dpinternal_share_unlock);
+    curl_share_setopt(share->curl_share, CURLSHOPT_USERDATA, share);
+    curl_share_setopt(share->curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share->curl_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    return share;
+}
+
+dp_share_t* dpinternal_share_retain(dp_share_t* share) {
+    pthread_mutex_lock(&share->ref_lock);
+    share->refcount++;
+    pthread_mutex_unlock(&share->ref_lock);
+    return share;
+}
+
+void dpinternal_share_release(dp_share_t* share) {
+    if (!share) return;
+    pthread_mutex_lock(&share->ref_lock);
+    int remaining = --share->refcount;
+    pthread_mutex_unlock(&share->ref_lock);
+    if (remaining > 0) return;
+
+    if (share->curl_share) {
+        curl_share_cleanup(share->curl_share);
+    }
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; ++i) {
+        pthread_mutex_destroy(&share->locks[i]);
+    }
+    pthread_mutex_destroy(&share->ref_lock);
+    free(share);
+}
+
+void dp_share_destroy(dp_share_t* share) {
+    // Contexts still using the share keep it alive until they are destroyed.
+    dpinternal_share_release(share);
+}
+
+int dp_set_share(dp_context_t* context, dp_share_t* share) {
+    if (!context) return -1;
+    dp_handle_pool_t* pool = &context->pool;
+
+    if (share) dpinternal_share_retain(share);
+
+    // Pooled handles are detached from any share while parked and pick up the
+    // context's current share each time they are acquired.
+    pthread_mutex_lock(&pool->lock);
+    dp_share_t* old_share = context->share;
+    context->share = share;
+    pthread_mutex_unlock(&pool->lock);
+
+    dpinternal_share_release(old_share);
+    return 0;
+}
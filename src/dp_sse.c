@@ -0,0 +1,197 @@
+#define _GNU_SOURCE
+#include "dp_private.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Server-Sent Events framing. An event is a run of non-empty lines ended by an
+// empty one; lines end in LF, CR or CRLF, and a CRLF may be split across two
+// writes. The scan position survives between writes, so an event arriving in
+// many small reads is still examined one byte at a time, once. Events and
+// their fields are handed out in place, so the steady state allocates nothing.
+
+static const char dp_sse_empty[] = "";
+
+// The receive buffer keeps capacity bytes, DP_SSE_BUFFER_BYTES for a
+// transfer. Data is appended behind the event in progress until the end is
+// reached; only then is that event moved back to the front, like the second
+// region of a bipartite buffer, since events are handed out in place and must
+// stay contiguous. An event too large for half the buffer makes it grow, and
+// it shrinks back once such events are gone. max_event_size (0 for no limit)
+// bounds the growth.
+bool dpinternal_sse_init(dp_sse_tokenizer_t* sse, size_t capacity, size_t max_event_size) {
+    memset(sse, 0, sizeof(*sse));
+    sse->base_capacity = capacity > 0 ? capacity : 1024;
+    sse->max_event_size = max_event_size;
+    if (capacity == 0) return true;
+    sse->buffer = malloc(capacity);
+    if (!sse->buffer) return false;
+    sse->buffer[0] = '\0';
+    sse->capacity = capacity;
+    return true;
+}
+
+// Moves the event in progress to the front of a buffer of new_capacity bytes
+static bool dpinternal_sse_rebase(dp_sse_tokenizer_t* sse, size_t new_capacity) {
+    size_t kept = sse->size - sse->start;
+    if (sse->start > 0) {
+        memmove(sse->buffer, sse->buffer + sse->start, kept);
+        sse->scan -= sse->start;
+        sse->line_start -= sse->start;
+        sse->event_end -= sse->start;
+        sse->size = kept;
+        sse->start = 0;
+        sse->buffer[sse->size] = '\0';
+    }
+    if (new_capacity != sse->capacity) {
+        char* new_buffer = realloc(sse->buffer, new_capacity);
+        if (!new_buffer) return new_capacity < sse->capacity;   // Failing to shrink is harmless
+        if (!sse->buffer) new_buffer[0] = '\0';
+        sse->buffer = new_buffer;
+        sse->capacity = new_capacity;
+    }
+    return true;
+}
+
+bool dpinternal_sse_append(dp_sse_tokenizer_t* sse, const char* data, size_t length) {
+    if (sse->start == sse->size) {
+        // Everything was consumed: start over at the front without moving anything
+        sse->size = sse->start = sse->scan = sse->line_start = sse->event_end = 0;
+        if (sse->capacity > sse->base_capacity && length + 1 <= sse->base_capacity / 2) {
+            dpinternal_sse_rebase(sse, sse->base_capacity);
+        }
+    }
+    if (sse->size + length + 1 > sse->capacity) {
+        size_t needed = sse->size - sse->start + length + 1;
+        size_t new_capacity = sse->capacity > 0 ? sse->capacity : sse->base_capacity;
+        while (new_capacity / 2 < needed) new_capacity *= 2;
+        if (new_capacity == sse->capacity && sse->capacity > sse->base_capacity && needed <= sse->base_capacity / 2) {
+            new_capacity = sse->base_capacity;
+        }
+        if (!dpinternal_sse_rebase(sse, new_capacity)) return false;
+    }
+    memcpy(sse->buffer + sse->size, data, length);
+    sse->size += length;
+    sse->buffer[sse->size] = '\0';
+    return true;
+}
+
+char* dpinternal_sse_next_event(dp_sse_tokenizer_t* sse) {
+    if (sse->oversized) return NULL;
+    while (sse->scan < sse->size) {
+        size_t at = sse->scan++;
+        char c = sse->buffer[at];
+        if (sse->pending_cr) {
+            sse->pending_cr = false;
+            if (c == '\n') {
+                // The LF of a CRLF; the line already ended at the CR
+                if (sse->line_start == at) sse->line_start = at + 1;
+                if (sse->event_end == at) sse->event_end = at + 1;
+                if (sse->start == at) sse->start = at + 1;
+                continue;
+            }
+            if (at > sse->start) sse->buffer[at - 1] = '\n';
+        }
+        if (c != '\n' && c != '\r') continue;
+        sse->pending_cr = c == '\r';
+
+        if (at > sse->line_start) {
+            sse->event_end = at;
+            sse->line_start = at + 1;
+            continue;
+        }
+
+        // An empty line dispatches the event; a run of them dispatches nothing
+        size_t event_start = sse->start;
+        size_t event_end = sse->event_end;
+        sse->start = sse->line_start = sse->event_end = at + 1;
+        if (sse->max_event_size > 0 && event_end - event_start > sse->max_event_size) {
+            sse->oversized = true;
+            return NULL;
+        }
+        if (event_end > event_start) {
+            sse->buffer[event_end] = '\0';
+            return sse->buffer + event_start;
+        }
+    }
+    // Whatever remains belongs to one event that has not ended yet
+    if (sse->max_event_size > 0 && sse->size - sse->start > sse->max_event_size) sse->oversized = true;
+    return NULL;
+}
+
+// Appends one more data value to the scratch buffer after a '\n'
+static bool dpinternal_sse_join_data(dp_sse_tokenizer_t* sse, dp_sse_event_t* event, const char* value, size_t value_length) {
+    size_t needed = event->data_length + 1 + value_length + 1;
+    if (needed > sse->scratch_capacity) {
+        size_t new_capacity = sse->scratch_capacity * 2 > needed ? sse->scratch_capacity * 2 : needed;
+        if (new_capacity < 256) new_capacity = 256;
+        char* new_scratch = realloc(sse->scratch, new_capacity);
+        if (!new_scratch) return false;
+        sse->scratch = new_scratch;
+        sse->scratch_capacity = new_capacity;
+    }
+    if (event->data != sse->scratch) {
+        // The first value is still in place; a second one makes it move
+        memcpy(sse->scratch, event->data, event->data_length);
+        event->data = sse->scratch;
+    }
+    sse->scratch[event->data_length] = '\n';
+    memcpy(sse->scratch + event->data_length + 1, value, value_length);
+    event->data_length += 1 + value_length;
+    sse->scratch[event->data_length] = '\0';
+    return true;
+}
+
+// Splits an event from dpinternal_sse_next_event() into its fields, in place.
+// Comment lines are skipped, one space after a field's colon is dropped and a
+// line without a colon is a field with an empty value. Returns false only when
+// joining data lines runs out of memory.
+bool dpinternal_sse_parse(dp_sse_tokenizer_t* sse, char* raw_event, dp_sse_event_t* event_out) {
+    memset(event_out, 0, sizeof(*event_out));
+    char* line = raw_event;
+    while (line) {
+        char* line_end = strchr(line, '\n');
+        size_t length = line_end ? (size_t)(line_end - line) : strlen(line);
+        if (length > 0 && line[length - 1] == '\r') length--;
+        line[length] = '\0';
+        char* next_line = line_end ? line_end + 1 : NULL;
+
+        if (length > 0 && line[0] != ':') {
+            char* colon = memchr(line, ':', length);
+            size_t field_length = colon ? (size_t)(colon - line) : length;
+            char* value = colon ? colon + 1 : line + length;
+            if (colon && *value == ' ') value++;
+            size_t value_length = (size_t)(line + length - value);
+
+            if (field_length == 5 && memcmp(line, "event", 5) == 0) {
+                event_out->name = value;
+                event_out->name_length = value_length;
+            } else if (field_length == 4 && memcmp(line, "data", 4) == 0) {
+                if (!event_out->data) {
+                    event_out->data = value;
+                    event_out->data_length = value_length;
+                } else if (!dpinternal_sse_join_data(sse, event_out, value, value_length)) {
+                    return false;
+                }
+            }
+        }
+        line = next_line;
+    }
+    return true;
+}
+
+const char* dpinternal_sse_pending(const dp_sse_tokenizer_t* sse) {
+    return sse->buffer ? sse->buffer + sse->start : dp_sse_empty;
+}
+
+void dpinternal_sse_reset(dp_sse_tokenizer_t* sse) {
+    sse->size = sse->start = sse->scan = sse->line_start = sse->event_end = 0;
+    sse->pending_cr = false;
+    sse->oversized = false;
+    if (sse->buffer) sse->buffer[0] = '\0';
+}
+
+void dpinternal_sse_free(dp_sse_tokenizer_t* sse) {
+    free(sse->buffer);
+    free(sse->scratch);
+    memset(sse, 0, sizeof(*sse));
+}
@@ -0,0 +1,496 @@
+#define _GNU_SOURCE
+#include "disasterparty.h"
+#include "dp_private.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+// A transfer is one completion request bound to a pooled easy handle. The
+// blocking entry points in dp_request.c and the asynchronous engine in
+// dp_engine.c share it, so both build requests and interpret responses the
+// same way; they only differ in how curl is driven.
+
+static char* dpinternal_transfer_build_payload(const dp_transfer_t* t) {
+    switch (t->context->provider) {
+        case DP_PROVIDER_OPENAI_COMPATIBLE:
+            return dpinternal_build_openai_json_payload_with_cjson(t->request_config, t->token_param);
+        case DP_PROVIDER_GOOGLE_GEMINI:
+            return dpinternal_build_gemini_json_payload_with_cjson(t->request_config);
+        case DP_PROVIDER_ANTHROPIC:
+            return dpinternal_build_anthropic_json_payload_with_cjson(t->request_config);
+        default:
+            return NULL;
+    }
+}
+
+static const char* dpinternal_transfer_kind_name(dp_transfer_kind_t kind) {
+    switch (kind) {
+        case DP_TRANSFER_STREAM: return "streaming";
+        case DP_TRANSFER_DETAILED_STREAM: return "detailed streaming";
+        default: return "completion";
+    }
+}
+
+static bool dpinternal_transfer_uses_anthropic_events(const dp_transfer_t* t) {
+    return t->kind == DP_TRANSFER_DETAILED_STREAM && t->context->provider == DP_PROVIDER_ANTHROPIC;
+}
+
+// Records gaps between received chunks before handing the data to the decoder.
+// On HTTP/2 a stream whose flow-control window is exhausted, or that loses out
+// to other streams on the same connection, shows up here as a stall.
+static size_t dpinternal_transfer_write_callback(void* contents, size_t size, size_t nmemb, void* userp) {
+    dp_transfer_t* t = (dp_transfer_t*)userp;
+    uint64_t now = dpinternal_monotonic_ms();
+    if (t->last_chunk_ms != 0) {
+        long gap = (long)(now - t->last_chunk_ms);
+        if (gap >= atomic_load_explicit(&t->context->stall_threshold_ms, memory_order_relaxed)) {
+            dp_transport_stats_t* stats = &t->response->transport;
+            stats->stall_count++;
+            stats->stall_ms_total += gap;
+            if (gap > stats->longest_stall_ms) stats->longest_stall_ms = gap;
+        }
+    }
+    t->last_chunk_ms = now;
+    t->response->transport.body_bytes_decoded += size * nmemb;
+    return t->body_write(contents, size, nmemb, t->body_write_data);
+}
+
+// The user's stream callbacks are reached through these relays so a retry can
+// tell whether anything was already delivered: once it was, retrying would
+// replay tokens the caller has seen.
+static int dpinternal_transfer_stream_relay(const char* token, void* user_data, bool is_final, const char* error) {
+    dp_transfer_t* t = (dp_transfer_t*)user_data;
+    t->delivered = true;
+    return t->user_callback(token, t->user_data, is_final, error);
+}
+
+static int dpinternal_transfer_event_relay(const dp_anthropic_stream_event_t* event, void* user_data, const char* error) {
+    dp_transfer_t* t = (dp_transfer_t*)user_data;
+    t->delivered = true;
+    return t->user_detailed_callback(event, t->user_data, error);
+}
+
+int dpinternal_transfer_init(dp_transfer_t* t,
+                             dp_context_t* context,
+                             const dp_request_config_t* request_config,
+                             dp_transfer_kind_t kind,
+                             dp_stream_callback_t callback,
+                             dp_detailed_stream_callback_t detailed_callback,
+                             void* user_data,
+                             dp_response_t* response) {
+    memset(t, 0, sizeof(*t));
+    memset(response, 0, sizeof(dp_response_t));
+    t->context = context;
+    t->request_config = request_config;
+    t->response = response;
+    t->kind = kind;
+
+    t->curl = dpinternal_pool_acquire(context);
+    if (!t->curl) {
+        dpinternal_safe_asprintf(&response->error_message, "Failed to acquire a cURL handle for Disaster Party %s.", dpinternal_transfer_kind_name(kind));
+        response->error_class = DP_ERROR_OTHER;
+        return -1;
+    }
+
+    if (kind == DP_TRANSFER_COMPLETION) {
+        t->body.memory = malloc(1);
+        if (!t->body.memory) {
+            response->error_message = dpinternal_strdup("Memory allocation for response chunk failed.");
+            response->error_class = DP_ERROR_OTHER;
+            dpinternal_transfer_cleanup(t);
+            return -1;
+        }
+        t->body.memory[0] = '\0';
+    } else {
+        t->user_callback = callback;
+        t->user_detailed_callback = detailed_callback;
+        t->user_data = user_data;
+        t->processor.user_callback = callback ? dpinternal_transfer_stream_relay : NULL;
+        t->processor.detailed_callback = detailed_callback ? dpinternal_transfer_event_relay : NULL;
+        t->processor.user_data = t;
+        t->processor.provider = context->provider;
+        t->processor.features = context->features;
+        size_t max_event_size = atomic_load_explicit(&context->max_stream_event_bytes, memory_order_relaxed);
+        if (!dpinternal_sse_init(&t->processor.sse, DP_SSE_BUFFER_BYTES, max_event_size)) {
+            response->error_message = dpinternal_strdup("Stream processor buffer alloc failed.");
+            response->error_class = DP_ERROR_OTHER;
+            dpinternal_transfer_cleanup(t);
+            return -1;
+        }
+
+        // For Anthropic, detailed streaming uses the specialized SSE parser because it has unique events
+        if (dpinternal_transfer_uses_anthropic_events(t)) {
+            t->anthro_processor.anthropic_user_callback = detailed_callback ? dpinternal_transfer_event_relay : NULL;
+            t->anthro_processor.user_data = t;
+            if (!dpinternal_sse_init(&t->anthro_processor.sse, DP_SSE_BUFFER_BYTES, max_event_size)) {
+                response->error_message = dpinternal_strdup("Anthro processor buffer alloc failed.");
+                response->error_class = DP_ERROR_OTHER;
+                dpinternal_transfer_cleanup(t);
+                return -1;
+            }
+        }
+    }
+
+    t->token_param = atomic_load_explicit(&context->token_param_preference, memory_order_relaxed);
+    t->json_payload = dpinternal_transfer_build_payload(t);
+    if (!t->json_payload) {
+        dpinternal_safe_asprintf(&response->error_message, "Failed to build JSON payload for Disaster Party %s.", dpinternal_transfer_kind_name(kind));
+        response->error_class = DP_ERROR_OTHER;
+        dpinternal_transfer_cleanup(t);
+        return -1;
+    }
+
+    // Headers and endpoints were built with the context; only Gemini puts the model in the URL
+    if (context->provider == DP_PROVIDER_GOOGLE_GEMINI) {
+        const char* method = kind == DP_TRANSFER_COMPLETION ? "generateContent" : "streamGenerateContent";
+        const char* sse = kind == DP_TRANSFER_COMPLETION ? "" : "&alt=sse";
+        if (dpinternal_safe_asprintf(&t->owned_url, "%s%s:%s?%s%s", context->model_url_prefix,
+                                     request_config->model, method, context->key_query, sse) < 0) {
+            response->error_message = dpinternal_strdup("Failed to allocate request URL.");
+            response->error_class = DP_ERROR_OTHER;
+            dpinternal_transfer_cleanup(t);
+            return -1;
+        }
+        t->url = t->owned_url;
+    } else {
+        t->url = context->completions_url;
+    }
+
+    curl_easy_setopt(t->curl, CURLOPT_URL, t->url);
+    curl_easy_setopt(t->curl, CURLOPT_HTTPHEADER, context->json_headers);
+    curl_easy_setopt(t->curl, CURLOPT_USERAGENT, context->user_agent);
+    curl_easy_setopt(t->curl, CURLOPT_POSTFIELDS, t->json_payload);
+    curl_easy_setopt(t->curl, CURLOPT_PRIVATE, (void*)t);
+    if (kind == DP_TRANSFER_COMPLETION) {
+        t->body_write = dpinternal_write_memory_callback;
+        t->body_write_data = &t->body;
+    } else if (dpinternal_transfer_uses_anthropic_events(t)) {
+        t->body_write = dpinternal_anthropic_detailed_stream_write_callback;
+        t->body_write_data = &t->anthro_processor;
+    } else {
+        t->body_write = dpinternal_streaming_write_callback;
+        t->body_write_data = &t->processor;
+    }
+    curl_easy_setopt(t->curl, CURLOPT_WRITEFUNCTION, dpinternal_transfer_write_callback);
+    curl_easy_setopt(t->curl, CURLOPT_WRITEDATA, (void*)t);
+    dpinternal_deadline_arm(&t->deadline, t->curl, context, &request_config->deadlines);
+    dpinternal_retry_hints_reset(&t->retry_hints);
+    curl_easy_setopt(t->curl, CURLOPT_HEADERFUNCTION, dpinternal_retry_header_callback);
+    curl_easy_setopt(t->curl, CURLOPT_HEADERDATA, (void*)&t->retry_hints);
+    t->attempts = 1;
+
+    if (context->features & (1ULL << (DP_FEATURE_HTTP2 - 1))) {
+        // Wait for an existing connection to the host to confirm multiplexing rather than opening another.
+        // libcurl 7.x fails transfers that wait on a prior-knowledge connection, so those connect directly.
+        bool pipewait = true;
+#if LIBCURL_VERSION_NUM < 0x080000
+        pipewait = strncmp(t->url, "http://", 7) != 0;
+#endif
+        if (pipewait) curl_easy_setopt(t->curl, CURLOPT_PIPEWAIT, 1L);
+    }
+    return 0;
+}
+
+// Whether the attempt failed only because the endpoint rejected
+// max_completion_tokens, so the request should be sent again with max_tokens.
+bool dpinternal_transfer_needs_fallback(const dp_transfer_t* t, CURLcode res) {
+    if (res != CURLE_OK || t->context->provider != DP_PROVIDER_OPENAI_COMPATIBLE ||
+        t->token_param != DP_TOKEN_PARAM_MAX_COMPLETION_TOKENS) {
+        return false;
+    }
+    long http_status_code = 0;
+    curl_easy_getinfo(t->curl, CURLINFO_RESPONSE_CODE, &http_status_code);
+
+    // A plain JSON error reply to a streaming request has no SSE framing, so it is left unconsumed in the stream buffer
+    const char* error_body = t->body.memory;
+    if (t->kind != DP_TRANSFER_COMPLETION) {
+        error_body = t->processor.accumulated_error_during_stream;
+        if (!error_body && *dpinternal_sse_pending(&t->processor.sse)) error_body = dpinternal_sse_pending(&t->processor.sse);
+    }
+    return dpinternal_is_token_parameter_error(error_body, http_status_code);
+}
+
+// Switches the transfer's payload to max_tokens.
+bool dpinternal_transfer_use_max_tokens(dp_transfer_t* t) {
+    // Remember that this endpoint only understands the legacy parameter and rebuild the payload with it
+    // Other threads may learn the same thing concurrently; the store is idempotent.
+    atomic_store_explicit(&t->context->token_param_preference, DP_TOKEN_PARAM_MAX_TOKENS, memory_order_relaxed);
+    char* json_payload = dpinternal_build_openai_json_payload_with_cjson(t->request_config, DP_TOKEN_PARAM_MAX_TOKENS);
+    if (!json_payload) {
+        return false;
+    }
+    free(t->json_payload);
+    t->json_payload = json_payload;
+    t->token_param = DP_TOKEN_PARAM_MAX_TOKENS;
+    curl_easy_setopt(t->curl, CURLOPT_POSTFIELDS, t->json_payload);
+    return true;
+}
+
+// Readies the transfer to be sent again with max_tokens, without finishing the
+// rejected attempt. The caller has checked dpinternal_transfer_needs_fallback()
+// and taken a request token for the new attempt, which it counts in t->attempts.
+bool dpinternal_transfer_prepare_fallback(dp_transfer_t* t) {
+    if (!dpinternal_transfer_use_max_tokens(t)) return false;
+
+    // Reset response buffers for the retry
+    if (t->kind == DP_TRANSFER_COMPLETION) {
+        t->body.size = 0;
+        t->body.memory[0] = '\0';
+    } else {
+        free(t->processor.accumulated_error_during_stream);
+        t->processor.accumulated_error_during_stream = NULL;
+        dpinternal_sse_reset(&t->processor.sse);
+    }
+    t->last_chunk_ms = 0;
+    dpinternal_transfer_count_body(t->context, t->curl, t->response->transport.body_bytes_decoded, NULL);
+    memset(&t->response->transport, 0, sizeof(t->response->transport));
+    dpinternal_deadline_next_attempt(&t->deadline, t->curl);
+    dpinternal_retry_hints_reset(&t->retry_hints);
+    return true;
+}
+
+// Describes a non-2xx reply from the JSON error object in its body, if any.
+static void dpinternal_transfer_http_error(dp_response_t* response, const char* body) {
+    cJSON* error_root = cJSON_Parse(body);
+    char* api_err_detail = NULL;
+    if (error_root) {
+        cJSON* error_obj = cJSON_GetObjectItemCaseSensitive(error_root, "error");
+        if (error_obj) {
+            cJSON* msg_item = cJSON_GetObjectItemCaseSensitive(error_obj, "message");
+            if (cJSON_IsString(msg_item) && msg_item->valuestring) {
+                api_err_detail = msg_item->valuestring;
+            }
+        } else {
+            cJSON* msg_item_anthropic = cJSON_GetObjectItemCaseSensitive(error_root, "message");
+            if (cJSON_IsString(msg_item_anthropic) && msg_item_anthropic->valuestring) {
+                api_err_detail = msg_item_anthropic->valuestring;
+            }
+        }
+    }
+    if (api_err_detail) {
+        dpinternal_safe_asprintf(&response->error_message, "API returned error (HTTP %ld): %s", response->http_status_code, api_err_detail);
+    } else {
+        dpinternal_safe_asprintf(&response->error_message, "API request failed with HTTP status %ld. Body: %.200s...", response->http_status_code, body ? body : "(empty)");
+    }
+    if (error_root) cJSON_Delete(error_root);
+}
+
+static void dpinternal_transfer_finish_completion(dp_transfer_t* t) {
+    dp_response_t* response = t->response;
+    const char* body = t->body.memory;
+
+    if (response->http_status_code >= 200 && response->http_status_code < 300) {
+        bool parse_success = dpinternal_parse_response_content(t->context, body, &response->parts, &response->num_parts, &response->finish_reason, &response->usage);
+        if (parse_success && response->num_parts > 0) {
+            return;
+        }
+        cJSON* error_root = cJSON_Parse(body);
+        if (error_root) {
+            cJSON* error_obj = cJSON_GetObjectItemCaseSensitive(error_root, "error");
+            if (error_obj) {
+                cJSON* msg_item = cJSON_GetObjectItemCaseSensitive(error_obj, "message");
+                if (cJSON_IsString(msg_item) && msg_item->valuestring) {
+                    dpinternal_safe_asprintf(&response->error_message, "API error (HTTP %ld): %s", response->http_status_code, msg_item->valuestring);
+                    response->error_class = DP_ERROR_API;
+                }
+            } else {
+                cJSON* type_item_anthropic = cJSON_GetObjectItemCaseSensitive(error_root, "type");
+                cJSON* msg_item_anthropic = cJSON_GetObjectItemCaseSensitive(error_root, "message");
+                if (cJSON_IsString(type_item_anthropic) && strcmp(type_item_anthropic->valuestring, "error") == 0 &&
+                    cJSON_IsString(msg_item_anthropic) && msg_item_anthropic->valuestring) {
+                    dpinternal_safe_asprintf(&response->error_message, "API error (HTTP %ld): %s", response->http_status_code, msg_item_anthropic->valuestring);
+                    response->error_class = DP_ERROR_API;
+                }
+            }
+            cJSON_Delete(error_root);
+        }
+        if (!response->error_message && body) {
+            dpinternal_safe_asprintf(&response->error_message, "Failed to parse successful response or extract text (HTTP %ld). Body: %.200s...", response->http_status_code, body);
+        } else if (!response->error_message) {
+            dpinternal_safe_asprintf(&response->error_message, "Failed to parse successful response or extract text (HTTP %ld). Empty response body.", response->http_status_code);
+        }
+        return;
+    }
+    dpinternal_transfer_http_error(response, body);
+}
+// Records the wire and decoded size of a response body, in stats when given and
+// in the context's totals. libcurl counts the body as received, before decoding.
+void dpinternal_transfer_count_body(dp_context_t* context, CURL* curl, uint64_t decoded_bytes, dp_transport_stats_t* stats) {
+    curl_off_t wire_bytes = 0;
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &wire_bytes);
+    if (stats) {
+        stats->body_bytes_wire = (uint64_t)wire_bytes;
+        stats->body_bytes_decoded = decoded_bytes;
+    }
+    atomic_fetch_add_explicit(&context->stat_body_bytes_wire, (uint64_t)wire_bytes, memory_order_relaxed);
+    atomic_fetch_add_explicit(&context->stat_body_bytes_decoded, decoded_bytes, memory_order_relaxed);
+}
+
+static void dpinternal_transfer_fill_transport(dp_transfer_t* t) {
+    dp_transport_stats_t* stats = &t->response->transport;
+    long version = CURL_HTTP_VERSION_NONE;
+    curl_easy_getinfo(t->curl, CURLINFO_HTTP_VERSION, &version);
+    switch (version) {
+        case CURL_HTTP_VERSION_1_0: stats->http_version = 10; break;
+        case CURL_HTTP_VERSION_1_1: stats->http_version = 11; break;
+        case CURL_HTTP_VERSION_2_0: stats->http_version = 20; break;
+#if LIBCURL_VERSION_NUM >= 0x074200
+        case CURL_HTTP_VERSION_3: stats->http_version = 30; break;
+#endif
+        default: stats->http_version = 0; break;
+    }
+    curl_easy_getinfo(t->curl, CURLINFO_NUM_CONNECTS, &stats->num_connects);
+    dpinternal_transfer_count_body(t->context, t->curl, stats->body_bytes_decoded, stats);
+}
+
+void dpinternal_transfer_finish(dp_transfer_t* t, CURLcode res) {
+    dp_response_t* response = t->response;
+    curl_easy_getinfo(t->curl, CURLINFO_RESPONSE_CODE, &response->http_status_code);
+    dpinternal_transfer_fill_transport(t);
+    response->attempts = t->attempts;
+
+    dp_deadline_kind_t missed = dpinternal_deadline_missed(&t->deadline, res);
+    if (missed != DP_DEADLINE_NONE) {
+        // Whatever partial error the decoder collected is a symptom; the deadline is the cause
+        free(response->error_message);
+        response->error_message = dpinternal_deadline_message(&t->deadline, missed);
+        response->error_class = DP_ERROR_DEADLINE;
+        response->deadline_missed = missed;
+    } else if (t->kind == DP_TRANSFER_COMPLETION) {
+        if (res != CURLE_OK) {
+            dpinternal_safe_asprintf(&response->error_message, "curl_easy_perform() failed: %s (HTTP status: %ld)",
+                     curl_easy_strerror(res), response->http_status_code);
+        } else {
+            dpinternal_transfer_finish_completion(t);
+        }
+    }
+
+    if (t->kind != DP_TRANSFER_COMPLETION) {
+        // Ownership of the captured finish reason passes to the response
+        if (dpinternal_transfer_uses_anthropic_events(t)) {
+            response->finish_reason = t->anthro_processor.finish_reason_capture;
+            t->anthro_processor.finish_reason_capture = NULL;
+            response->usage = t->anthro_processor.usage;
+        } else {
+            response->finish_reason = t->processor.finish_reason_capture;
+            t->processor.finish_reason_capture = NULL;
+            response->usage = t->processor.usage;
+        }
+        const dp_sse_tokenizer_t* sse = dpinternal_transfer_uses_anthropic_events(t) ? &t->anthro_processor.sse : &t->processor.sse;
+        if (sse->oversized && !response->error_message) {
+            dpinternal_safe_asprintf(&response->error_message, "Stream event exceeded the maximum event size of %zu bytes.", sse->max_event_size);
+            response->error_class = DP_ERROR_API;
+        }
+        if (res != CURLE_OK && !response->error_message) response->error_message = dpinternal_strdup(curl_easy_strerror(res));
+        // A plain JSON error reply has no SSE framing and is left undecoded in the stream buffer
+        if (res == CURLE_OK && !response->error_message &&
+            (response->http_status_code < 200 || response->http_status_code >= 300)) {
+            const char* leftover = dpinternal_sse_pending(sse);
+            dpinternal_transfer_http_error(response, leftover);
+        }
+    }
+
+    if (response->error_message && response->error_class == DP_ERROR_NONE) {
+        if (res != CURLE_OK) {
+            response->error_class = DP_ERROR_TRANSPORT;
+        } else if (t->kind != DP_TRANSFER_COMPLETION || response->http_status_code < 200 || response->http_status_code >= 300) {
+            response->error_class = DP_ERROR_API;
+        } else {
+            response->error_class = DP_ERROR_OTHER;
+        }
+    }
+    dpinternal_breaker_record(t, res);
+}
+
+long dpinternal_transfer_retry_delay(dp_transfer_t* t, CURLcode res) {
+    const dp_response_t* response = t->response;
+    if (!response->error_message || t->delivered) return -1;
+    if (!dpinternal_retry_is_transient(res, response->http_status_code, response->error_class, response->deadline_missed)) return -1;
+    if (!dpinternal_breaker_allows_retry(t->context)) return -1;
+    return dpinternal_retry_next_delay(t->context, t->attempts, &t->retry_hints, &t->deadline);
+}
+
+// Returns a finished transfer to its pre-perform state on the same handle; the
+// payload and the learned token parameter are kept.
+void dpinternal_transfer_reset_for_retry(dp_transfer_t* t) {
+    dp_free_response_content(t->response);
+    if (t->kind == DP_TRANSFER_COMPLETION) {
+        t->body.size = 0;
+        t->body.memory[0] = '\0';
+    } else {
+        dpinternal_sse_reset(&t->processor.sse);
+        t->processor.stop_streaming_signal = false;
+        free(t->processor.finish_reason_capture);
+        t->processor.finish_reason_capture = NULL;
+        free(t->processor.accumulated_error_during_stream);
+        t->processor.accumulated_error_during_stream = NULL;
+        memset(&t->processor.usage, 0, sizeof(t->processor.usage));
+        if (dpinternal_transfer_uses_anthropic_events(t)) {
+            dpinternal_sse_reset(&t->anthro_processor.sse);
+            t->anthro_processor.stop_streaming_signal = false;
+            t->anthro_processor.is_thinking = false;
+            free(t->anthro_processor.finish_reason_capture);
+            t->anthro_processor.finish_reason_capture = NULL;
+            free(t->anthro_processor.accumulated_error_during_stream);
+            t->anthro_processor.accumulated_error_during_stream = NULL;
+            memset(&t->anthro_processor.usage, 0, sizeof(t->anthro_processor.usage));
+        }
+    }
+    t->last_chunk_ms = 0;
+    t->attempts++;
+    dpinternal_deadline_next_attempt(&t->deadline, t->curl);
+    dpinternal_retry_hints_reset(&t->retry_hints);
+}
+
+static void dpinternal_transfer_perform_attempts(dp_transfer_t* t) {
+    if (dpinternal_breaker_admit(t) != 0 || dpinternal_rate_limit_wait(t) != 0) return;
+    dpinternal_retry_note_request(t->context);
+    for (;;) {
+        CURLcode res = t->kind == DP_TRANSFER_COMPLETION ? dpinternal_hedge_perform(t) : curl_easy_perform(t->curl);
+        // The legacy-parameter request is another request to the provider; without
+        // a request token for it the rejection is returned as is
+        if (dpinternal_transfer_needs_fallback(t, res) && dpinternal_rate_limit_wait_attempt(t) &&
+            dpinternal_transfer_prepare_fallback(t)) {
+            t->attempts++;
+            res = curl_easy_perform(t->curl);
+        }
+        dpinternal_transfer_finish(t, res);
+        long delay = dpinternal_transfer_retry_delay(t, res);
+        if (delay < 0) break;
+        dpinternal_sleep_ms(delay);
+        if (!dpinternal_rate_limit_wait_attempt(t)) break;
+        dpinternal_transfer_reset_for_retry(t);
+    }
+}
+
+int dpinternal_transfer_perform(dp_transfer_t* t) {
+    // A cached response, or an identical request already in flight, answers this one
+    if (!dpinternal_cache_lookup(t) && !dpinternal_flight_join(t)) {
+        dpinternal_cache_record(t);
+        dpinternal_transfer_perform_attempts(t);
+        dpinternal_cache_store(t);
+        dpinternal_flight_land(t);
+    }
+    return t->response->error_message ? -1 : 0;
+}
+
+void dpinternal_transfer_cleanup(dp_transfer_t* t) {
+    dpinternal_rate_limit_settle(t);
+    dpinternal_breaker_abandon(t);
+    dpinternal_cache_discard(t);
+    free(t->json_payload);
+    free(t->body.memory);
+    dpinternal_sse_free(&t->processor.sse);
+    dpinternal_delta_free(&t->processor.delta);
+    free(t->processor.finish_reason_capture);
+    free(t->processor.accumulated_error_during_stream);
+    dpinternal_sse_free(&t->anthro_processor.sse);
+    dpinternal_delta_free(&t->anthro_processor.delta);
+    free(t->anthro_processor.finish_reason_capture);
+    free(t->anthro_processor.accumulated_error_during_stream);
+    free(t->owned_url);
+    if (t->curl) {
+        dpinternal_pool_release(t->context, t->curl);
+    }
+    memset(t, 0, sizeof(*t));
+}
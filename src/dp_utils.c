@@ -1,8 +1,10 @@
+#define _GNU_SOURCE
 #include "dp_private.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <time.h>
 
 // String duplication utility
 char* dpinternal_strdup(const char* s) {
@@ -26,6 +28,23 @@ int dpinternal_safe_asprintf(char** strp, const char* fmt, ...) {
     return result;
 }
 
+// Monotonic clock in milliseconds, for pool ageing and request timing
+uint64_t dpinternal_monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+// FNV-1a, 64-bit; start from DP_HASH_SEED and chain calls to hash several fields
+uint64_t dpinternal_hash_bytes(uint64_t hash, const void* data, size_t length) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
 
 
 // Token counting function
@@ -37,21 +56,19 @@ int dp_count_tokens(dp_context_t* context,
     }
     *token_count_out = 0;
 
-    CURL* curl = curl_easy_init();
+    CURL* curl = dpinternal_pool_acquire(context);
     if (!curl) {
-        fprintf(stderr, "curl_easy_init() failed for dp_count_tokens.\n");
+        fprintf(stderr, "Failed to acquire a cURL handle for dp_count_tokens.\n");
         return -1;
     }
 
     char* json_payload_str = NULL;
-    char url[1024];
-    struct curl_slist* headers = NULL;
+    char* owned_url = NULL;
+    const char* url = NULL;
     int return_code = -1;
     long http_status_code = 0;
     memory_struct_t chunk_mem = { .memory = NULL, .size = 0 };
 
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-
     switch (context->provider) {
         case DP_PROVIDER_OPENAI_COMPATIBLE:
             fprintf(stderr, "dp_count_tokens is not supported for the OpenAI provider.\n");
@@ -63,8 +80,12 @@ int dp_count_tokens(dp_context_t* context,
                 fprintf(stderr, "Failed to build JSON payload for dp_count_tokens (Gemini).\n");
                 goto cleanup;
             }
-            snprintf(url, sizeof(url), "%s/models/%s:countTokens?key=%s",
-                     context->api_base_url, request_config->model, context->api_key);
+            if (dpinternal_safe_asprintf(&owned_url, "%s%s:countTokens?%s", context->model_url_prefix,
+                                         request_config->model, context->key_query) < 0) {
+                fprintf(stderr, "Failed to allocate URL for dp_count_tokens (Gemini).\n");
+                goto cleanup;
+            }
+            url = owned_url;
             break;
         case DP_PROVIDER_ANTHROPIC:
             json_payload_str = dpinternal_build_anthropic_count_tokens_json_payload_with_cjson(request_config);
@@ -72,11 +93,7 @@ int dp_count_tokens(dp_context_t* context,
                 fprintf(stderr, "Failed to build JSON payload for dp_count_tokens (Anthropic).\n");
                 goto cleanup;
             }
-            snprintf(url, sizeof(url), "%s/messages/count_tokens", context->api_base_url);
-            char api_key_header[512];
-            snprintf(api_key_header, sizeof(api_key_header), "x-api-key: %s", context->api_key);
-            headers = curl_slist_append(headers, api_key_header);
-            headers = curl_slist_append(headers, "anthropic-version: 2023-06-01");
+            url = context->count_tokens_url;
             break;
         default:
             fprintf(stderr, "Unsupported provider for dp_count_tokens.\n");
@@ -92,13 +109,20 @@ int dp_count_tokens(dp_context_t* context,
 
     curl_easy_setopt(curl, CURLOPT_URL, url);
     curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_payload_str);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, context->json_headers);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, dpinternal_write_memory_callback);
     curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*)&chunk_mem);
     curl_easy_setopt(curl, CURLOPT_USERAGENT, context->user_agent);
-
-    CURLcode res = curl_easy_perform(curl);
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_status_code);
+    dp_deadline_watch_t deadline;
+    dpinternal_deadline_arm(&deadline, curl, context, &request_config->deadlines);
+
+    CURLcode res = dpinternal_retry_perform_buffered(context, curl, &chunk_mem, &deadline, true, &http_status_code);
+    dp_deadline_kind_t missed = dpinternal_deadline_missed(&deadline, res);
+    if (missed != DP_DEADLINE_NONE) {
+        char* message = dpinternal_deadline_message(&deadline, missed);
+        fprintf(stderr, "dp_count_tokens: %s\n", message ? message : "Deadline exceeded.");
+        free(message);
+    }
 
     if (res == CURLE_OK && http_status_code >= 200 && http_status_code < 300) {
         cJSON *root = cJSON_Parse(chunk_mem.memory);
@@ -128,8 +152,8 @@ int dp_count_tokens(dp_context_t* context,
 cleanup:
     free(json_payload_str);
     if (chunk_mem.memory) free(chunk_mem.memory);
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+    free(owned_url);
+    dpinternal_pool_release(context, curl);
 
     return return_code;
 }
\ No newline at end of file
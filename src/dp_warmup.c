@@ -0,0 +1,155 @@
+#define _GNU_SOURCE
+#include "dp_private.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Connection pre-warming. Each connection is opened by a HEAD request to the
+// model list endpoint on its own pooled handle, all in parallel on short-lived
+// threads, and the handles are parked in the pool's shared stack where any
+// thread's next request picks them up. Whatever the server answers, the
+// connection (and the handle's DNS and TLS session caches) stays behind.
+//
+// Refreshing repeats the same warm-up on a background thread. The most
+// recently parked handles are taken first, so a refresh reuses the warmed
+// connections rather than opening new ones, and marks them as fresh.
+
+typedef struct {
+    dp_context_t* context;
+    CURL* curl;
+    CURLcode res;
+} dp_warmup_slot_t;
+
+static size_t dpinternal_warmup_discard(void* contents, size_t size, size_t nmemb, void* userp) {
+    (void)contents; (void)userp;
+    return size * nmemb;
+}
+
+static void* dpinternal_warmup_connect(void* arg) {
+    dp_warmup_slot_t* slot = (dp_warmup_slot_t*)arg;
+    dp_context_t* context = slot->context;
+    slot->res = CURLE_FAILED_INIT;
+    slot->curl = dpinternal_pool_acquire(context);
+    if (!slot->curl) return NULL;
+
+    long total_ms = context->default_deadlines.total_ms > 0 ? context->default_deadlines.total_ms : DP_WARMUP_TIMEOUT_MS;
+    curl_easy_setopt(slot->curl, CURLOPT_URL, context->models_url);
+    curl_easy_setopt(slot->curl, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(slot->curl, CURLOPT_HTTPHEADER, context->auth_headers);
+    curl_easy_setopt(slot->curl, CURLOPT_USERAGENT, context->user_agent);
+    curl_easy_setopt(slot->curl, CURLOPT_WRITEFUNCTION, dpinternal_warmup_discard);
+    curl_easy_setopt(slot->curl, CURLOPT_TIMEOUT_MS, total_ms);
+    curl_easy_setopt(slot->curl, CURLOPT_CONNECTTIMEOUT_MS, context->default_deadlines.connect_ms);
+    slot->res = curl_easy_perform(slot->curl);
+    return NULL;
+}
+
+long dpinternal_warmup_run(dp_context_t* context, size_t num_connections) {
+    size_t max_idle = atomic_load(&context->pool.max_idle);
+    if (num_connections > max_idle) num_connections = max_idle;
+    if (num_connections == 0 || !context->models_url) return -1;
+
+    dp_warmup_slot_t* slots = calloc(num_connections, sizeof(dp_warmup_slot_t));
+    pthread_t* threads = calloc(num_connections, sizeof(pthread_t));
+    bool* started = calloc(num_connections, sizeof(bool));
+    if (!slots || !threads || !started) {
+        free(slots);
+        free(threads);
+        free(started);
+        return -1;
+    }
+
+    uint64_t started_ms = dpinternal_monotonic_ms();
+    for (size_t i = 0; i < num_connections; ++i) {
+        slots[i].context = context;
+        started[i] = pthread_create(&threads[i], NULL, dpinternal_warmup_connect, &slots[i]) == 0;
+    }
+    // Connections whose thread could not be started are opened one by one here
+    for (size_t i = 0; i < num_connections; ++i) {
+        if (!started[i]) dpinternal_warmup_connect(&slots[i]);
+    }
+    size_t opened = 0;
+    for (size_t i = 0; i < num_connections; ++i) {
+        if (started[i]) pthread_join(threads[i], NULL);
+        if (slots[i].res == CURLE_OK) opened++;
+        dpinternal_pool_park(context, slots[i].curl);
+    }
+    uint64_t elapsed = dpinternal_monotonic_ms() - started_ms;
+
+    free(slots);
+    free(threads);
+    free(started);
+    return opened > 0 ? (long)elapsed : -1;
+}
+
+long dp_context_warmup(dp_context_t* context, size_t num_connections) {
+    if (!context) return -1;
+    return dpinternal_warmup_run(context, num_connections);
+}
+
+bool dpinternal_warmup_init(dp_warmup_refresh_t* refresh) {
+    memset(refresh, 0, sizeof(*refresh));
+    pthread_condattr_t attr;
+    if (pthread_condattr_init(&attr) != 0) return false;
+    // Timed waits must not stretch or shrink when the wall clock is adjusted
+    bool ok = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC) == 0 && pthread_cond_init(&refresh->wake, &attr) == 0;
+    pthread_condattr_destroy(&attr);
+    if (!ok) return false;
+    if (pthread_mutex_init(&refresh->lock, NULL) != 0) {
+        pthread_cond_destroy(&refresh->wake);
+        return false;
+    }
+    return true;
+}
+
+static void* dpinternal_warmup_refresh_thread(void* arg) {
+    dp_context_t* context = (dp_context_t*)arg;
+    dp_warmup_refresh_t* refresh = &context->warmup;
+
+    pthread_mutex_lock(&refresh->lock);
+    while (!refresh->stop) {
+        struct timespec due;
+        clock_gettime(CLOCK_MONOTONIC, &due);
+        due.tv_sec += refresh->interval_seconds;
+        while (!refresh->stop && pthread_cond_timedwait(&refresh->wake, &refresh->lock, &due) == 0) {
+            // Woken early without a stop request; keep waiting for the deadline
+        }
+        if (refresh->stop) break;
+        size_t num_connections = refresh->num_connections;
+        pthread_mutex_unlock(&refresh->lock);
+        dpinternal_warmup_run(context, num_connections);
+        pthread_mutex_lock(&refresh->lock);
+    }
+    pthread_mutex_unlock(&refresh->lock);
+    return NULL;
+}
+
+static void dpinternal_warmup_stop(dp_warmup_refresh_t* refresh) {
+    if (!refresh->running) return;
+    pthread_mutex_lock(&refresh->lock);
+    refresh->stop = true;
+    pthread_cond_signal(&refresh->wake);
+    pthread_mutex_unlock(&refresh->lock);
+    pthread_join(refresh->thread, NULL);
+    refresh->running = false;
+    refresh->stop = false;
+}
+
+void dpinternal_warmup_destroy(dp_warmup_refresh_t* refresh) {
+    dpinternal_warmup_stop(refresh);
+    pthread_cond_destroy(&refresh->wake);
+    pthread_mutex_destroy(&refresh->lock);
+}
+
+int dp_set_warmup_refresh(dp_context_t* context, size_t num_connections, long interval_seconds) {
+    if (!context || interval_seconds < 0 || (interval_seconds > 0 && num_connections == 0)) return -1;
+    dp_warmup_refresh_t* refresh = &context->warmup;
+    dpinternal_warmup_stop(refresh);
+    if (interval_seconds == 0) return 0;
+
+    refresh->num_connections = num_connections;
+    refresh->interval_seconds = interval_seconds;
+    if (pthread_create(&refresh->thread, NULL, dpinternal_warmup_refresh_thread, context) != 0) return -1;
+    refresh->running = true;
+    return 0;
+}
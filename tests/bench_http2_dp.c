@@ -0,0 +1,100 @@
+#include "disasterparty.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Fans out concurrent streaming completions over HTTP/1.1 and over
+// multiplexed HTTP/2 against the stand-in server (tests/mock-server/h2_server.py)
+// and compares wall time, connections opened and receive stalls.
+//
+// Usage: DP_H2_MOCK_SERVER=https://127.0.0.1:8443 DP_H2_MOCK_CA=cert.pem ./bench_http2_dp [streams] [max_host_connections]
+
+typedef struct {
+    size_t tokens;
+    int failed;
+} bench_stream_t;
+
+static int on_token(const char* token, void* user_data, bool is_final, const char* error) {
+    bench_stream_t* stream = (bench_stream_t*)user_data;
+    (void)is_final;
+    if (error) return 1;
+    if (token) stream->tokens++;
+    return 0;
+}
+
+static void on_done(dp_response_t* response, int status, void* user_data) {
+    (void)response;
+    if (status != 0) ((bench_stream_t*)user_data)->failed = 1;
+}
+
+static int run(const char* label, const char* base_url, const char* ca_bundle, bool http2, size_t num_streams, long max_host_connections) {
+    dp_context_t* context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "bench-key", base_url);
+    dp_engine_t* engine = dp_engine_create();
+    if (!context || !engine) return -1;
+    if (ca_bundle) dp_set_ca_bundle(context, ca_bundle);
+    if (http2) {
+        dp_enable_advanced_features(context, DP_FEATURE_HTTP2, 0);
+        dp_engine_set_max_host_connections(engine, max_host_connections);
+    }
+
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Hello?");
+    dp_request_config_t config = { .model = "mock-model", .messages = &message, .num_messages = 1, .temperature = -1.0, .stream = true };
+
+    dp_response_t* responses = calloc(num_streams, sizeof(dp_response_t));
+    bench_stream_t* streams = calloc(num_streams, sizeof(bench_stream_t));
+    if (!responses || !streams) return -1;
+
+    double start = now_seconds();
+    for (size_t i = 0; i < num_streams; ++i) {
+        dp_submit_streaming_completion(engine, context, &config, on_token, &responses[i], on_done, &streams[i]);
+    }
+    size_t in_flight = 0;
+    do {
+        dp_engine_perform(engine, 100, &in_flight);
+    } while (in_flight > 0);
+    double elapsed = now_seconds() - start;
+
+    long connects = 0, longest_stall = 0;
+    size_t stalls = 0, tokens = 0;
+    int failed = 0;
+    for (size_t i = 0; i < num_streams; ++i) {
+        connects += responses[i].transport.num_connects;
+        stalls += responses[i].transport.stall_count;
+        if (responses[i].transport.longest_stall_ms > longest_stall) longest_stall = responses[i].transport.longest_stall_ms;
+        tokens += streams[i].tokens;
+        failed += streams[i].failed;
+        dp_free_response_content(&responses[i]);
+    }
+    printf("%-10s %8zu %10.3f %12ld %8zu %14ld %8zu %7d\n",
+           label, num_streams, elapsed, connects, stalls, longest_stall, tokens, failed);
+
+    free(responses);
+    free(streams);
+    dp_free_messages(&message, 1);
+    dp_engine_destroy(engine);
+    dp_destroy_context(context);
+    return failed ? -1 : 0;
+}
+
+int main(int argc, char** argv) {
+    load_env_file();
+    const char* server_url = getenv("DP_H2_MOCK_SERVER");
+    if (!server_url) {
+        fprintf(stderr, "Set DP_H2_MOCK_SERVER (and DP_H2_MOCK_CA for HTTPS) to the h2_server.py stand-in.\n");
+        return 77;
+    }
+    size_t num_streams = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 50;
+    long max_host_connections = argc > 2 ? strtol(argv[2], NULL, 10) : 2;
+    char base_url[512];
+    snprintf(base_url, sizeof(base_url), "%s/v1", server_url);
+    const char* ca_bundle = getenv("DP_H2_MOCK_CA");
+
+    printf("%-10s %8s %10s %12s %8s %14s %8s %7s\n",
+           "mode", "streams", "seconds", "connections", "stalls", "longest_stall", "tokens", "failed");
+    int rc = 0;
+    rc |= run("http/1.1", base_url, ca_bundle, false, num_streams, 0);
+    rc |= run("http/2", base_url, ca_bundle, true, num_streams, max_host_connections);
+    return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
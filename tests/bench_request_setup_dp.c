@@ -0,0 +1,59 @@
+#include "disasterparty.h"
+#include "dp_private.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Measures the per-call cost of preparing a completion request (handle from
+// the pool, URL, headers, JSON payload, callbacks) and tearing it down again,
+// without any network traffic.
+//
+// Usage: ./bench_request_setup_dp [iterations]
+
+static int run(const char* label, dp_provider_type_t provider, dp_transfer_kind_t kind, long iterations) {
+    dp_context_t* context = dp_init_context(provider, "bench-key-0123456789abcdef0123456789abcdef", "https://api.example.invalid/v1");
+    if (!context) {
+        fprintf(stderr, "Failed to initialize context.\n");
+        return 1;
+    }
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Hello?");
+    dp_request_config_t config = { .model = "bench-model", .messages = &message, .num_messages = 1,
+                                   .temperature = -1.0, .max_tokens = 64, .stream = kind != DP_TRANSFER_COMPLETION };
+
+    int failures = 0;
+    double start = now_seconds();
+    for (long i = 0; i < iterations; ++i) {
+        dp_transfer_t transfer;
+        dp_response_t response;
+        if (dpinternal_transfer_init(&transfer, context, &config, kind, NULL, NULL, NULL, &response) != 0) {
+            failures++;
+            dp_free_response_content(&response);
+            continue;
+        }
+        dpinternal_transfer_cleanup(&transfer);
+    }
+    double elapsed = now_seconds() - start;
+    printf("%-22s %8.0f ns/request\n", label, elapsed * 1e9 / (double)iterations);
+
+    dp_free_messages(&message, 1);
+    dp_destroy_context(context);
+    if (failures > 0) fprintf(stderr, "%s: %d setups failed.\n", label, failures);
+    return failures > 0;
+}
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 200000;
+    if (iterations <= 0) iterations = 200000;
+
+    printf("Request setup and teardown, %ld iterations each:\n", iterations);
+    int failed = 0;
+    failed |= run("openai completion", DP_PROVIDER_OPENAI_COMPATIBLE, DP_TRANSFER_COMPLETION, iterations);
+    failed |= run("openai stream", DP_PROVIDER_OPENAI_COMPATIBLE, DP_TRANSFER_STREAM, iterations);
+    failed |= run("gemini completion", DP_PROVIDER_GOOGLE_GEMINI, DP_TRANSFER_COMPLETION, iterations);
+    failed |= run("gemini stream", DP_PROVIDER_GOOGLE_GEMINI, DP_TRANSFER_STREAM, iterations);
+    failed |= run("anthropic completion", DP_PROVIDER_ANTHROPIC, DP_TRANSFER_COMPLETION, iterations);
+    failed |= run("anthropic stream", DP_PROVIDER_ANTHROPIC, DP_TRANSFER_STREAM, iterations);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+#include "disasterparty.h"
+#include "dp_private.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Feeds one multi-megabyte SSE event, followed by a short final one, to the
+// stream write callbacks in fixed-size slices, as libcurl would from many small
+// reads. Framing cost should grow with the event size, not with its square.
+//
+// Usage: ./bench_sse_scan_dp [event_megabytes]
+
+typedef struct {
+    size_t token_bytes;
+    size_t events;
+} bench_capture_t;
+
+static int count_tokens(const char* token, void* user_data, bool is_final, const char* error) {
+    (void)is_final;
+    (void)error;
+    if (token) ((bench_capture_t*)user_data)->token_bytes += strlen(token);
+    return 0;
+}
+
+static int count_events(const dp_anthropic_stream_event_t* event, void* user_data, const char* error) {
+    (void)event;
+    (void)error;
+    ((bench_capture_t*)user_data)->events++;
+    return 0;
+}
+
+// Builds the stream: a large text delta, then an event that ends it
+static char* build_stream(dp_provider_type_t provider, const char* eol, size_t text_bytes, size_t* length_out) {
+    const char* head = provider == DP_PROVIDER_ANTHROPIC
+        ? "event: content_block_delta%sdata: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":{\"type\":\"text_delta\",\"text\":\""
+        : "data: {\"choices\":[{\"index\":0,\"delta\":{\"content\":\"";
+    const char* tail = provider == DP_PROVIDER_ANTHROPIC ? "\"}}%s%s" : "\"}}]}%s%s";
+    const char* last = provider == DP_PROVIDER_ANTHROPIC
+        ? "event: message_stop%sdata: {\"type\":\"message_stop\"}%s%s"
+        : "data: [DONE]%s%s";
+
+    size_t capacity = text_bytes + 512;
+    char* stream = malloc(capacity);
+    if (!stream) return NULL;
+    size_t length = (size_t)snprintf(stream, capacity, head, eol);
+    memset(stream + length, 'x', text_bytes);
+    length += text_bytes;
+    length += (size_t)snprintf(stream + length, capacity - length, tail, eol, eol);
+    if (provider == DP_PROVIDER_ANTHROPIC) {
+        length += (size_t)snprintf(stream + length, capacity - length, last, eol, eol, eol);
+    } else {
+        length += (size_t)snprintf(stream + length, capacity - length, last, eol, eol);
+    }
+    *length_out = length;
+    return stream;
+}
+
+static int run(const char* label, dp_provider_type_t provider, bool detailed, const char* eol, size_t text_bytes, size_t slice) {
+    size_t length = 0;
+    char* stream = build_stream(provider, eol, text_bytes, &length);
+    if (!stream) {
+        fprintf(stderr, "%s: out of memory.\n", label);
+        return 1;
+    }
+
+    bench_capture_t capture = {0};
+    stream_processor_t processor = { .user_callback = count_tokens, .user_data = &capture, .provider = provider };
+    anthropic_stream_processor_t anthro_processor = { .anthropic_user_callback = count_events, .user_data = &capture };
+    dp_sse_tokenizer_t* sse = detailed ? &anthro_processor.sse : &processor.sse;
+    void* userp = detailed ? (void*)&anthro_processor : (void*)&processor;
+    size_t (*write_callback)(void*, size_t, size_t, void*) =
+        detailed ? dpinternal_anthropic_detailed_stream_write_callback : dpinternal_streaming_write_callback;
+
+    int failed = !dpinternal_sse_init(sse, DP_SSE_BUFFER_BYTES, 0);
+    double start = now_seconds();
+    for (size_t offset = 0; !failed && offset < length; offset += slice) {
+        size_t n = length - offset < slice ? length - offset : slice;
+        if (write_callback(stream + offset, 1, n, userp) != n) failed = 1;
+    }
+    double elapsed = now_seconds() - start;
+
+    bool complete = detailed ? capture.events == 2 : capture.token_bytes == text_bytes;
+    printf("%-28s %6zu B slices %9.1f ms %9.1f MB/s\n", label, slice, elapsed * 1e3,
+           (double)length / (1024.0 * 1024.0) / (elapsed > 0 ? elapsed : 1e-9));
+    if (failed || !complete) {
+        fprintf(stderr, "%s: the stream was not decoded completely.\n", label);
+        failed = 1;
+    }
+
+    dpinternal_sse_free(&processor.sse);
+    dpinternal_sse_free(&anthro_processor.sse);
+    dpinternal_delta_free(&processor.delta);
+    dpinternal_delta_free(&anthro_processor.delta);
+    free(processor.finish_reason_capture);
+    free(processor.accumulated_error_during_stream);
+    free(anthro_processor.finish_reason_capture);
+    free(anthro_processor.accumulated_error_during_stream);
+    free(stream);
+    return failed;
+}
+
+int main(int argc, char** argv) {
+    long megabytes = argc > 1 ? atol(argv[1]) : 4;
+    if (megabytes <= 0) megabytes = 4;
+    size_t text_bytes = (size_t)megabytes * 1024 * 1024;
+    const size_t slices[] = { 1, 16384 };
+
+    printf("One %ld MiB SSE event through the stream write callbacks:\n", megabytes);
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(slices) / sizeof(slices[0]); ++i) {
+        failed |= run("openai stream, LF", DP_PROVIDER_OPENAI_COMPATIBLE, false, "\n", text_bytes, slices[i]);
+        failed |= run("openai stream, CRLF", DP_PROVIDER_OPENAI_COMPATIBLE, false, "\r\n", text_bytes, slices[i]);
+        failed |= run("anthropic stream, CR", DP_PROVIDER_ANTHROPIC, false, "\r", text_bytes, slices[i]);
+        failed |= run("anthropic detailed, CRLF", DP_PROVIDER_ANTHROPIC, true, "\r\n", text_bytes, slices[i]);
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
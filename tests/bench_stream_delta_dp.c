@@ -0,0 +1,92 @@
+#include "disasterparty.h"
+#include "dp_private.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Reads typical OpenAI and Gemini stream chunks with the chunk scanner and
+// with cJSON, the path it falls back to, and reports the time per chunk.
+//
+// Usage: ./bench_stream_delta_dp [chunks]
+
+typedef struct {
+    const char* label;
+    dp_provider_type_t provider;
+    const char* json;
+} bench_chunk_t;
+
+static const bench_chunk_t chunks[] = {
+    { "openai content delta", DP_PROVIDER_OPENAI_COMPATIBLE,
+      "{\"id\":\"chatcmpl-AJ3kq9x8Yq2Lr\",\"object\":\"chat.completion.chunk\",\"created\":1729123456,\"model\":\"gpt-4o-2024-08-06\","
+      "\"system_fingerprint\":\"fp_a7d06e42a7\",\"choices\":[{\"index\":0,\"delta\":{\"content\":\" the\"},\"logprobs\":null,"
+      "\"finish_reason\":null}]}" },
+    { "openai escaped delta", DP_PROVIDER_OPENAI_COMPATIBLE,
+      "{\"id\":\"chatcmpl-AJ3kq9x8Yq2Lr\",\"object\":\"chat.completion.chunk\",\"created\":1729123456,\"model\":\"gpt-4o-2024-08-06\","
+      "\"choices\":[{\"index\":0,\"delta\":{\"content\":\"```c\\nint main(void) {\\n    puts(\\\"caf\\u00e9\\\");\\n}\\n```\"},"
+      "\"logprobs\":null,\"finish_reason\":null}]}" },
+    { "openai usage chunk", DP_PROVIDER_OPENAI_COMPATIBLE,
+      "{\"id\":\"chatcmpl-AJ3kq9x8Yq2Lr\",\"object\":\"chat.completion.chunk\",\"created\":1729123456,\"model\":\"gpt-4o-2024-08-06\","
+      "\"choices\":[],\"usage\":{\"prompt_tokens\":1200,\"completion_tokens\":35,\"total_tokens\":1235,"
+      "\"prompt_tokens_details\":{\"cached_tokens\":1024},\"completion_tokens_details\":{\"reasoning_tokens\":0}}}" },
+    { "gemini text chunk", DP_PROVIDER_GOOGLE_GEMINI,
+      "{\"candidates\": [{\"content\": {\"parts\": [{\"text\": \"Sure! Here is a short poem about the sea:\\n\\n\"}],"
+      "\"role\": \"model\"},\"index\": 0,\"safetyRatings\": [{\"category\": \"HARM_CATEGORY_SEXUALLY_EXPLICIT\","
+      "\"probability\": \"NEGLIGIBLE\"},{\"category\": \"HARM_CATEGORY_HATE_SPEECH\",\"probability\": \"NEGLIGIBLE\"},"
+      "{\"category\": \"HARM_CATEGORY_HARASSMENT\",\"probability\": \"NEGLIGIBLE\"},{\"category\": "
+      "\"HARM_CATEGORY_DANGEROUS_CONTENT\",\"probability\": \"NEGLIGIBLE\"}]}],\"usageMetadata\": {\"promptTokenCount\": 9,"
+      "\"candidatesTokenCount\": 12,\"totalTokenCount\": 21},\"modelVersion\": \"gemini-2.5-flash\"}" },
+};
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    if (iterations <= 0) iterations = 1000000;
+
+    printf("%ld chunks each:\n", iterations);
+    int failed = 0;
+    dp_delta_scanner_t scanner = {0};
+    dp_delta_scanner_t json_reader = {0};
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); ++i) {
+        const bench_chunk_t* chunk = &chunks[i];
+        size_t length = strlen(chunk->json);
+        dp_usage_t usage = {0};
+        size_t token_bytes = 0;
+
+        double start = now_seconds();
+        for (long n = 0; n < iterations; ++n) {
+            if (!dpinternal_delta_scan(&scanner, chunk->provider, chunk->json, length, &usage)) {
+                failed = 1;
+                break;
+            }
+            const dp_stream_delta_t* delta = &scanner.delta;
+            if (delta->content) token_bytes += strlen(delta->content);
+            if (delta->num_parts > 0 && delta->parts[0].text) token_bytes += strlen(delta->parts[0].text);
+        }
+        double scan_seconds = now_seconds() - start;
+
+        start = now_seconds();
+        for (long n = 0; n < iterations; ++n) {
+            cJSON* root = cJSON_Parse(chunk->json);
+            if (!root) {
+                failed = 1;
+                break;
+            }
+            dpinternal_parse_usage(chunk->provider, root, &usage);
+            const dp_stream_delta_t* delta = dpinternal_delta_from_json(&json_reader, chunk->provider, root);
+            if (delta->content) token_bytes -= strlen(delta->content);
+            if (delta->num_parts > 0 && delta->parts[0].text) token_bytes -= strlen(delta->parts[0].text);
+            cJSON_Delete(root);
+        }
+        double json_seconds = now_seconds() - start;
+
+        printf("%-22s %4zu B  scanner %7.1f ns  cJSON %7.1f ns  %5.1fx\n", chunk->label, length,
+               scan_seconds * 1e9 / iterations, json_seconds * 1e9 / iterations, json_seconds / (scan_seconds > 0 ? scan_seconds : 1e-9));
+        if (token_bytes != 0) {
+            fprintf(stderr, "%s: the scanner and cJSON read different text.\n", chunk->label);
+            failed = 1;
+        }
+    }
+    dpinternal_delta_free(&scanner);
+    dpinternal_delta_free(&json_reader);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
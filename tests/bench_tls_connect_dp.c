@@ -0,0 +1,85 @@
+#include "disasterparty.h"
+#include "dp_private.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Measures the cost of opening a new TLS connection on a pooled handle, with
+// and without dp_global_init()'s cached CA store and session resumption. Each
+// request asks libcurl to close its connection, so every one is a handshake.
+//
+// Usage: DP_H2_MOCK_SERVER=https://127.0.0.1:8443 DP_H2_MOCK_CA=cert.pem ./bench_tls_connect_dp [connections]
+
+static double cpu_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t discard(void* contents, size_t size, size_t nmemb, void* userp) {
+    (void)contents; (void)userp;
+    return size * nmemb;
+}
+
+static int run(const char* label, const char* server_url, const char* ca_bundle, long connections) {
+    dp_context_t* context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "bench-key", server_url);
+    if (!context) {
+        fprintf(stderr, "Failed to initialize context.\n");
+        return 1;
+    }
+    if (ca_bundle) dp_set_ca_bundle(context, ca_bundle);
+    char url[512];
+    snprintf(url, sizeof(url), "%s/_stats", server_url);
+
+    int failures = 0;
+    double start = now_seconds();
+    double cpu_start = cpu_seconds();
+    for (long i = 0; i < connections; ++i) {
+        CURL* curl = dpinternal_pool_acquire(context);
+        curl_easy_setopt(curl, CURLOPT_URL, url);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, discard);
+        curl_easy_setopt(curl, CURLOPT_FORBID_REUSE, 1L);
+        CURLcode res = curl_easy_perform(curl);
+        if (res != CURLE_OK) {
+            if (failures++ == 0) fprintf(stderr, "%s: %s\n", label, curl_easy_strerror(res));
+        }
+        dpinternal_pool_release(context, curl);
+    }
+    double elapsed = now_seconds() - start;
+    double cpu = cpu_seconds() - cpu_start;
+    printf("%-28s %7.2f ms/connection  %7.2f ms CPU\n", label, elapsed * 1e3 / (double)connections, cpu * 1e3 / (double)connections);
+    dp_destroy_context(context);
+    return failures > 0;
+}
+
+int main(int argc, char** argv) {
+    const char* server_url = getenv("DP_H2_MOCK_SERVER");
+    if (!server_url || strncmp(server_url, "https://", 8) != 0) {
+        printf("SKIP: DP_H2_MOCK_SERVER must name an HTTPS stand-in server.\n");
+        return 77;
+    }
+    const char* ca_bundle = getenv("DP_H2_MOCK_CA");
+    long connections = argc > 1 ? atol(argv[1]) : 100;
+    if (connections <= 0) connections = 100;
+
+    printf("New TLS connections on a pooled handle, %ld each:\n", connections);
+    int failed = 0;
+    failed |= run("lazy libcurl init", server_url, ca_bundle, connections);
+
+    dp_global_options_t no_cache = { .ca_cache_seconds = -1 };
+    dp_global_init(&no_cache);
+    failed |= run("global init, no CA cache", server_url, ca_bundle, connections);
+    dp_global_cleanup();
+
+    dp_global_options_t no_resumption = { .disable_session_reuse = true };
+    dp_global_init(&no_resumption);
+    failed |= run("CA cache, no resumption", server_url, ca_bundle, connections);
+    dp_global_cleanup();
+
+    dp_global_init(NULL);
+    failed |= run("CA cache and resumption", server_url, ca_bundle, connections);
+    dp_global_cleanup();
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,221 @@
+#!/usr/bin/env python3
+"""
+HTTP/2 stand-in for an OpenAI-compatible provider.
+
+Speaks HTTP/2 with prior knowledge (h2c) and plain HTTP/1.1 with keep-alive
+on the same port, so the HTTP/2 multiplexing path and the default HTTP/1.1
+path can be compared against identical response timing. With --tls-cert and
+--tls-key it serves HTTPS instead and negotiates h2 or http/1.1 via ALPN.
+
+POST .../chat/completions streams MOCK_TOKENS as SSE (or returns one JSON
+completion when "stream" is false), pausing --token-delay-ms between tokens.
+The model name "stall-model" adds a --stall-ms pause halfway through the
+stream. GET /_stats reports how many connections the server has accepted.
+
+Requires the 'h2' package.
+"""
+
+import argparse
+import asyncio
+import json
+import ssl
+
+import h2.config
+import h2.connection
+import h2.events
+import h2.exceptions
+
+H2_PREFACE = b"PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+MOCK_TOKENS = ["Hello", " from", " the", " h2", " stand-in", "."]
+
+stats = {"connections": 0, "h2_connections": 0, "http1_connections": 0, "requests": 0}
+options = None
+
+
+def sse_chunks(model):
+    """Yields (payload, delay_seconds) for a streamed completion."""
+    tokens = MOCK_TOKENS * options.repeat
+    for i, token in enumerate(tokens):
+        chunk = {"id": "chatcmpl-h2", "object": "chat.completion.chunk", "model": model,
+                 "choices": [{"index": 0, "delta": {"content": token}, "finish_reason": None}]}
+        delay = options.token_delay_ms / 1000.0
+        if model == "stall-model" and i == len(tokens) // 2:
+            delay += options.stall_ms / 1000.0
+        yield f"data: {json.dumps(chunk)}\n\n".encode(), delay
+    final = {"id": "chatcmpl-h2", "object": "chat.completion.chunk", "model": model,
+             "choices": [{"index": 0, "delta": {}, "finish_reason": "stop"}]}
+    yield f"data: {json.dumps(final)}\n\n".encode(), 0
+    yield b"data: [DONE]\n\n", 0
+
+
+def completion_body(model):
+    text = "".join(MOCK_TOKENS * options.repeat)
+    return json.dumps({
+        "id": "chatcmpl-h2", "object": "chat.completion", "model": model,
+        "choices": [{"index": 0, "message": {"role": "assistant", "content": text}, "finish_reason": "stop"}],
+        "usage": {"prompt_tokens": 5, "completion_tokens": len(MOCK_TOKENS), "total_tokens": 5 + len(MOCK_TOKENS)},
+    }).encode()
+
+
+def route(method, path, body):
+    """Returns (status, content_type, body_bytes or None, chunk generator or None)."""
+    stats["requests"] += 1
+    if method == "GET" and path.startswith("/_stats"):
+        return 200, "application/json", json.dumps(stats).encode(), None
+    if method == "POST" and path.split("?")[0].endswith("/chat/completions"):
+        try:
+            data = json.loads(body or b"{}")
+        except ValueError:
+            return 400, "application/json", b'{"error": {"message": "Invalid JSON"}}', None
+        model = data.get("model", "mock-model")
+        if data.get("stream"):
+            return 200, "text/event-stream", None, sse_chunks(model)
+        return 200, "application/json", completion_body(model), None
+    return 404, "application/json", b'{"error": {"message": "Not found"}}', None
+
+
+class H2Session:
+    def __init__(self, reader, writer):
+        self.reader = reader
+        self.writer = writer
+        self.conn = h2.connection.H2Connection(
+            config=h2.config.H2Configuration(client_side=False, header_encoding="utf-8"))
+        self.requests = {}
+        self.window_open = asyncio.Event()
+
+    def flush(self):
+        data = self.conn.data_to_send()
+        if data:
+            self.writer.write(data)
+
+    async def run(self, initial):
+        self.conn.initiate_connection()
+        self.handle(initial)
+        self.flush()
+        while True:
+            data = await self.reader.read(65535)
+            if not data:
+                break
+            self.handle(data)
+            self.flush()
+
+    def handle(self, data):
+        for event in self.conn.receive_data(data):
+            if isinstance(event, h2.events.RequestReceived):
+                self.requests[event.stream_id] = {"headers": dict(event.headers), "body": b""}
+            elif isinstance(event, h2.events.DataReceived):
+                self.requests[event.stream_id]["body"] += event.data
+                self.conn.acknowledge_received_data(event.flow_controlled_length, event.stream_id)
+            elif isinstance(event, h2.events.StreamEnded):
+                request = self.requests.pop(event.stream_id)
+                asyncio.ensure_future(self.respond(event.stream_id, request))
+            elif isinstance(event, h2.events.WindowUpdated):
+                self.window_open.set()
+
+    async def send(self, stream_id, payload):
+        while payload:
+            window = min(self.conn.local_flow_control_window(stream_id), self.conn.max_outbound_frame_size)
+            if window <= 0:
+                self.window_open.clear()
+                await self.window_open.wait()
+                continue
+            self.conn.send_data(stream_id, payload[:window])
+            payload = payload[window:]
+            self.flush()
+
+    async def respond(self, stream_id, request):
+        headers = request["headers"]
+        status, content_type, body, chunks = route(headers.get(":method"), headers.get(":path", "/"), request["body"])
+        self.conn.send_headers(stream_id, [(":status", str(status)), ("content-type", content_type)])
+        self.flush()
+        if chunks is None:
+            await self.send(stream_id, body)
+        else:
+            for payload, delay in chunks:
+                await self.send(stream_id, payload)
+                await self.writer.drain()
+                if delay:
+                    await asyncio.sleep(delay)
+        self.conn.end_stream(stream_id)
+        self.flush()
+
+
+async def serve_http1(reader, writer, initial):
+    buffer = initial
+    while True:
+        while b"\r\n\r\n" not in buffer:
+            data = await reader.read(65535)
+            if not data:
+                return
+            buffer += data
+        head, buffer = buffer.split(b"\r\n\r\n", 1)
+        lines = head.decode("latin-1").split("\r\n")
+        method, path, _ = lines[0].split(" ", 2)
+        headers = {k.strip().lower(): v.strip() for k, v in (line.split(":", 1) for line in lines[1:] if ":" in line)}
+        length = int(headers.get("content-length", "0"))
+        while len(buffer) < length:
+            data = await reader.read(65535)
+            if not data:
+                return
+            buffer += data
+        body, buffer = buffer[:length], buffer[length:]
+        keep_alive = headers.get("connection", "").lower() != "close"
+
+        status, content_type, payload, chunks = route(method, path, body)
+        response = f"HTTP/1.1 {status} OK\r\nContent-Type: {content_type}\r\n"
+        response += "Connection: keep-alive\r\n" if keep_alive else "Connection: close\r\n"
+        if chunks is None:
+            writer.write((response + f"Content-Length: {len(payload)}\r\n\r\n").encode() + payload)
+        else:
+            writer.write((response + "Transfer-Encoding: chunked\r\n\r\n").encode())
+            for data, delay in chunks:
+                writer.write(f"{len(data):x}\r\n".encode() + data + b"\r\n")
+                await writer.drain()
+                if delay:
+                    await asyncio.sleep(delay)
+            writer.write(b"0\r\n\r\n")
+        await writer.drain()
+        if not keep_alive:
+            return
+
+
+async def handle_client(reader, writer):
+    stats["connections"] += 1
+    try:
+        initial = await reader.read(len(H2_PREFACE))
+        if initial.startswith(b"PRI"):
+            stats["h2_connections"] += 1
+            await H2Session(reader, writer).run(initial)
+        elif initial:
+            stats["http1_connections"] += 1
+            await serve_http1(reader, writer, initial)
+    except (ConnectionResetError, BrokenPipeError, h2.exceptions.ProtocolError):
+        pass
+    finally:
+        writer.close()
+
+
+async def main():
+    tls = None
+    if options.tls_cert:
+        tls = ssl.create_default_context(ssl.Purpose.CLIENT_AUTH)
+        tls.load_cert_chain(options.tls_cert, options.tls_key)
+        tls.set_alpn_protocols(["h2", "http/1.1"])
+    server = await asyncio.start_server(handle_client, options.host, options.port, ssl=tls)
+    scheme = "https" if tls else "http"
+    print(f"h2 stand-in listening on {scheme}://{options.host}:{options.port}", flush=True)
+    async with server:
+        await server.serve_forever()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="HTTP/2 + HTTP/1.1 stand-in OpenAI-compatible server")
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=8081)
+    parser.add_argument("--token-delay-ms", type=int, default=10)
+    parser.add_argument("--stall-ms", type=int, default=400)
+    parser.add_argument("--repeat", type=int, default=1, help="Repeat the token list this many times per response")
+    parser.add_argument("--tls-cert", help="PEM certificate; enables HTTPS with ALPN")
+    parser.add_argument("--tls-key", help="PEM private key for --tls-cert")
+    options = parser.parse_args()
+    asyncio.run(main())
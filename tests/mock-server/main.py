@@ -7,6 +7,7 @@ import signal
 import subprocess
 import threading
 import atexit
+import zlib
 
 app = Flask(__name__)
 
@@ -14,6 +15,81 @@ app = Flask(__name__)
 foreground_mode = False
 server_process = None
 
+MOCK_COMPLETION_TOKENS = ["Hello", " from", " the", " mock", " server."]
+
+def openai_success_response(data):
+    """A well-formed chat completion, streamed as SSE when the request asked for it."""
+    if data and data.get('stream'):
+        def generate_stream():
+            for token in MOCK_COMPLETION_TOKENS:
+                yield "data: " + json.dumps({"id": "chatcmpl-mock", "object": "chat.completion.chunk", "choices": [{"index": 0, "delta": {"content": token}, "finish_reason": None}]}) + "\n\n"
+            yield "data: " + json.dumps({"id": "chatcmpl-mock", "object": "chat.completion.chunk", "choices": [{"index": 0, "delta": {}, "finish_reason": "stop"}]}) + "\n\n"
+            yield "data: [DONE]\n\n"
+        return Response(generate_stream(), mimetype='text/event-stream')
+    body = {
+        "id": "chatcmpl-mock",
+        "object": "chat.completion",
+        "model": data.get('model') if data else None,
+        "choices": [{"index": 0, "message": {"role": "assistant", "content": "".join(MOCK_COMPLETION_TOKENS)}, "finish_reason": "stop"}],
+        "usage": {"prompt_tokens": 5, "completion_tokens": len(MOCK_COMPLETION_TOKENS), "total_tokens": 5 + len(MOCK_COMPLETION_TOKENS)}
+    }
+    return Response(json.dumps(body), mimetype='application/json')
+
+# FLAKY_<n>_<kind>_<tag> fails the first n requests made with that exact key,
+# then succeeds. The tag keeps concurrent test runs from sharing a counter.
+flaky_counts = {}
+flaky_lock = threading.Lock()
+
+def flaky_failure(scenario):
+    """The error response for this FLAKY_ request, or None once it has failed often enough."""
+    parts = scenario.split('_')
+    if len(parts) < 3 or not parts[1].isdigit():
+        return None
+    with flaky_lock:
+        seen = flaky_counts.get(scenario, 0)
+        flaky_counts[scenario] = seen + 1
+    if seen >= int(parts[1]):
+        return None
+    kind = parts[2]
+    if kind == '503':
+        return Response(json.dumps({"error": {"message": "Service unavailable", "type": "server_error", "code": 503}}), status=503, mimetype='application/json')
+    body = json.dumps({"error": {"message": "Rate limit exceeded", "type": "rate_limit_error", "code": 429}})
+    if kind == '429':
+        return Response(body, status=429, mimetype='application/json', headers={"retry-after-ms": "250"})
+    if kind == '429R':
+        return Response(body, status=429, mimetype='application/json',
+                        headers={"x-ratelimit-remaining-requests": "0", "x-ratelimit-reset-requests": "250ms"})
+    if kind == 'LONG':
+        return Response(body, status=429, mimetype='application/json', headers={"Retry-After": "30"})
+    return Response(body, status=429, mimetype='application/json')
+
+def slow_nth(scenario):
+    """SLOW_NTH_<n>_<tag>: True for the n-th request made with that exact key."""
+    parts = scenario.split('_')
+    if len(parts) < 4 or not parts[2].isdigit():
+        return False
+    with flaky_lock:
+        seen = flaky_counts.get(scenario, 0) + 1
+        flaky_counts[scenario] = seen
+    return seen == int(parts[2])
+
+def gzip_response(response):
+    """Re-encodes a response with gzip when the client offered it; streams are flushed chunk by chunk."""
+    if 'gzip' not in request.headers.get('Accept-Encoding', ''):
+        return response
+    compressor = zlib.compressobj(9, zlib.DEFLATED, 31)
+    if response.is_streamed:
+        chunks = response.response
+        def generate_gzip():
+            for chunk in chunks:
+                yield compressor.compress(chunk.encode() if isinstance(chunk, str) else chunk) + compressor.flush(zlib.Z_SYNC_FLUSH)
+            yield compressor.flush()
+        compressed = Response(generate_gzip(), mimetype=response.mimetype)
+    else:
+        compressed = Response(compressor.compress(response.get_data()) + compressor.flush(), mimetype=response.mimetype)
+    compressed.headers['Content-Encoding'] = 'gzip'
+    return compressed
+
 # This single endpoint will simulate different responses based on the prompt.
 @app.route('/v1/chat/completions', methods=['POST'])
 @app.route('/chat/completions', methods=['POST'])
@@ -45,6 +121,60 @@ def completions_openai():
     if scenario == 'RATE_LIMIT_COMPLETION':
         return Response(json.dumps({"error": {"message": "Rate limit exceeded", "type": "rate_limit_error", "code": 429}}), status=429, mimetype='application/json')
 
+    # --- Scenario: Successful completion, optionally delayed to exercise concurrency ---
+    if scenario == 'SUCCESS_COMPLETION':
+        return openai_success_response(data)
+    if scenario == 'SLOW_COMPLETION':
+        time.sleep(0.3)
+        return openai_success_response(data)
+
+    # --- Scenario: Successful completion naming the model it was asked for, to check model mapping ---
+    if scenario == 'ECHO_MODEL':
+        body = {"id": "chatcmpl-mock", "object": "chat.completion", "model": data.get('model'),
+                "choices": [{"index": 0, "message": {"role": "assistant", "content": "model:" + str(data.get('model'))}, "finish_reason": "stop"}]}
+        return Response(json.dumps(body), mimetype='application/json')
+
+    # --- Scenario: Provider that goes quiet, before the response (non-streaming) or mid-stream ---
+    if scenario == 'STALLED_RESPONSE':
+        if data and data.get('stream'):
+            def generate_stalled_stream():
+                for i, token in enumerate(MOCK_COMPLETION_TOKENS):
+                    if i == 2:
+                        time.sleep(2)
+                    yield "data: " + json.dumps({"id": "chatcmpl-mock", "object": "chat.completion.chunk", "choices": [{"index": 0, "delta": {"content": token}, "finish_reason": None}]}) + "\n\n"
+                yield "data: [DONE]\n\n"
+            return Response(generate_stalled_stream(), mimetype='text/event-stream')
+        time.sleep(2)
+        return openai_success_response(data)
+
+    # --- Scenario: A stream carrying one 256 KiB event, for the client's event size limit ---
+    if scenario == 'OVERSIZED_EVENT_STREAM':
+        def generate_oversized_stream():
+            for token in ["Hello", "x" * (256 * 1024), " world"]:
+                yield "data: " + json.dumps({"id": "chatcmpl-mock", "object": "chat.completion.chunk", "choices": [{"index": 0, "delta": {"content": token}, "finish_reason": None}]}) + "\n\n"
+            yield "data: [DONE]\n\n"
+        return Response(generate_oversized_stream(), mimetype='text/event-stream')
+
+    # --- Scenario: Transient failures that succeed on a later attempt ---
+    if scenario and scenario.startswith('FLAKY_'):
+        return flaky_failure(scenario) or openai_success_response(data)
+
+    # --- Scenario: Successful completion, gzip-encoded when the client accepts it ---
+    if scenario == 'COMPRESSED_RESPONSE':
+        return gzip_response(openai_success_response(data))
+
+    # --- Scenario: One slow replica; a single request takes 1.5 seconds ---
+    if scenario and scenario.startswith('SLOW_NTH_'):
+        if slow_nth(scenario):
+            time.sleep(1.5)
+        return openai_success_response(data)
+
+    # --- Scenario: Legacy endpoint that rejects max_completion_tokens (client must fall back to max_tokens) ---
+    if scenario == 'LEGACY_TOKEN_PARAM':
+        if 'max_completion_tokens' in data:
+            return Response(json.dumps({"error": {"message": "Unrecognized request argument supplied: max_completion_tokens", "type": "invalid_request_error", "code": 400}}), status=400, mimetype='application/json')
+        return openai_success_response(data)
+
     # --- Scenario 4: Authentication Failure (401) ---
     if scenario == 'AUTH_FAILURE_OPENAI':
         return Response(json.dumps({"error": {"message": "Invalid Authentication", "type": "invalid_request_error", "code": 401}}), status=401, mimetype='application/json')
@@ -66,9 +196,140 @@ def completions_gemini(model_id):
 
     if scenario == 'AUTH_FAILURE_GEMINI':
         return Response(json.dumps({"error": {"message": "Invalid Authentication", "code": 401}}), status=401, mimetype='application/json')
+    elif scenario == 'CACHED_CONTENT_GEMINI':
+        return gemini_cached_generate(model_id, data)
 
     return Response(json.dumps({"error": "No test scenario triggered for Gemini completions endpoint"}), status=400, mimetype='application/json')
 
+# cachedContents resources created under the CACHED_CONTENT_GEMINI scenario, by name
+cached_contents = {}
+cached_contents_lock = threading.Lock()
+cached_contents_created = 0
+
+def gemini_error(status, message):
+    return Response(json.dumps({"error": {"code": status, "message": message}}), status=status, mimetype='application/json')
+
+def gemini_key():
+    return request.args.get('key')
+
+def gemini_cached_generate(model_id, data):
+    """Answers generateContent like the API does with a cachedContent
+    reference: the cached prefix counts as cachedContentTokenCount, and the
+    request may not repeat the system instruction or tools."""
+    cached_tokens = 0
+    cached_count = 0
+    name = data.get('cachedContent')
+    if name is not None:
+        with cached_contents_lock:
+            cached = cached_contents.get(name)
+        if cached is None:
+            return gemini_error(404, "CachedContent not found: " + name)
+        if any(key in data for key in ('system_instruction', 'systemInstruction', 'tools', 'toolConfig')):
+            return gemini_error(400, "CachedContent can not be used with GenerateContent request setting system_instruction, tools or tool_config.")
+        if cached['model'] != 'models/' + model_id:
+            return gemini_error(400, "Model does not match the cached content's model.")
+        cached_tokens = cached['tokens']
+        cached_count = len(cached['contents'])
+    contents = data.get('contents', [])
+    inline = sum(1 for content in contents for part in content.get('parts', []) if 'inline_data' in part)
+    text = "cached contents: %d, request contents: %d, inline parts: %d" % (cached_count, len(contents), inline)
+    prompt_tokens = cached_tokens + max(1, len(json.dumps(contents)) // 4)
+    usage = {"promptTokenCount": prompt_tokens, "candidatesTokenCount": 5, "totalTokenCount": prompt_tokens + 5}
+    if cached_tokens:
+        usage["cachedContentTokenCount"] = cached_tokens
+    return jsonify({"candidates": [{"content": {"role": "model", "parts": [{"text": text}]}, "finishReason": "STOP"}],
+                    "usageMetadata": usage})
+
+def cached_content_refusal():
+    """The error for a cachedContents request, or None to serve it. FLAKY_
+    keys fail their first requests and then act like CACHED_CONTENT_GEMINI."""
+    key = gemini_key()
+    if key and key.startswith('FLAKY_'):
+        return flaky_failure(key)
+    if key != 'CACHED_CONTENT_GEMINI':
+        return gemini_error(400, "No test scenario triggered for cachedContents endpoint")
+    return None
+
+@app.route('/v1/cachedContents', methods=['POST'])
+@app.route('/cachedContents', methods=['POST'])
+def create_cached_content():
+    refusal = cached_content_refusal()
+    if refusal is not None:
+        return refusal
+    data = request.get_json()
+    model = data.get('model', '')
+    contents = data.get('contents') or []
+    if not model.startswith('models/') or not contents:
+        return gemini_error(400, "A cached content needs a model and contents.")
+    ttl = data.get('ttl', '3600s')
+    if not ttl.endswith('s'):
+        return gemini_error(400, "Invalid ttl: " + ttl)
+    global cached_contents_created
+    now = time.time()
+    with cached_contents_lock:
+        cached_contents_created += 1
+        name = "cachedContents/mock-%d" % cached_contents_created
+        cached_contents[name] = {"model": model, "contents": contents, "tokens": max(1, len(json.dumps(data)) // 4)}
+        tokens = cached_contents[name]["tokens"]
+    stamp = lambda t: time.strftime('%Y-%m-%dT%H:%M:%SZ', time.gmtime(t))
+    return jsonify({"name": name, "model": model, "createTime": stamp(now), "expireTime": stamp(now + float(ttl[:-1])),
+                    "usageMetadata": {"totalTokenCount": tokens}})
+
+@app.route('/v1/cachedContents/<cache_id>', methods=['DELETE'])
+@app.route('/cachedContents/<cache_id>', methods=['DELETE'])
+def delete_cached_content(cache_id):
+    refusal = cached_content_refusal()
+    if refusal is not None:
+        return refusal
+    with cached_contents_lock:
+        if cached_contents.pop("cachedContents/" + cache_id, None) is None:
+            return gemini_error(404, "CachedContent not found: cachedContents/" + cache_id)
+    return jsonify({})
+
+# Prompt prefixes the PROMPT_CACHE_ANTHROPIC scenario has cached, keyed by
+# their JSON, with the token count it reported when writing them
+prompt_cache = {}
+prompt_cache_lock = threading.Lock()
+
+def anthropic_prompt_cache(data):
+    """Finds the cache_control breakpoints of a Messages request, in prefix
+    order, and returns (labels, cache_creation_tokens, cache_read_tokens) as
+    the API would for the prefix up to the last one."""
+    labels = []
+    prefix = []
+    last = None
+    def mark(block, label, part):
+        nonlocal last
+        prefix.append(part)
+        control = block.get('cache_control') if isinstance(block, dict) else None
+        if control:
+            labels.append(label + ('/' + control['ttl'] if 'ttl' in control else ''))
+            last = len(prefix)
+    tools = data.get('tools', [])
+    for i, tool in enumerate(tools):
+        mark(tool, 'tools' if i == len(tools) - 1 else 'tool%d' % i, tool)
+    system = data.get('system')
+    if isinstance(system, list):
+        for block in system:
+            mark(block, 'system', block)
+    elif system is not None:
+        prefix.append(system)
+    for m, message in enumerate(data.get('messages', [])):
+        content = message.get('content')
+        if isinstance(content, list):
+            for p, block in enumerate(content):
+                mark(block, 'message%d.part%d' % (m, p), block)
+        else:
+            prefix.append(content)
+    if last is None:
+        return labels, 0, 0
+    key = json.dumps(prefix[:last], sort_keys=True)
+    with prompt_cache_lock:
+        if key in prompt_cache:
+            return labels, 0, prompt_cache[key]
+        prompt_cache[key] = max(1, len(key) // 4)
+        return labels, prompt_cache[key], 0
+
 @app.route('/v1/messages', methods=['POST'])
 @app.route('/messages', methods=['POST'])
 def completions_anthropic():
@@ -96,6 +357,24 @@ def completions_anthropic():
             yield "event: message_delta\ndata: {\"usage\":{\"output_tokens\":2},\"stop_reason\":\"end_turn\",\"stop_sequence\":null}\n\n"
             yield "event: message_stop\ndata: {}\n\n"
         return Response(generate_ping_stream(), mimetype='text/event-stream')
+    elif scenario == 'PROMPT_CACHE_ANTHROPIC':
+        # Echoes the breakpoints it found and reports cache usage like the API:
+        # a write the first time a prefix is seen, a read afterwards
+        labels, created, read = anthropic_prompt_cache(data)
+        text = "breakpoints: " + (" ".join(labels) if labels else "none")
+        usage = {"input_tokens": 10, "cache_creation_input_tokens": created, "cache_read_input_tokens": read, "output_tokens": 5}
+        if data.get('stream'):
+            def generate_cached_stream():
+                start_usage = dict(usage, output_tokens=1)
+                yield "event: message_start\ndata: " + json.dumps({"type": "message_start", "message": {"id": "msg_cache", "type": "message", "role": "assistant", "content": [], "stop_reason": None, "usage": start_usage}}) + "\n\n"
+                yield "event: content_block_start\ndata: {\"type\":\"content_block_start\",\"index\":0,\"content_block\":{\"type\":\"text\",\"text\":\"\"}}\n\n"
+                yield "event: content_block_delta\ndata: " + json.dumps({"type": "content_block_delta", "index": 0, "delta": {"type": "text_delta", "text": text}}) + "\n\n"
+                yield "event: content_block_stop\ndata: {\"type\":\"content_block_stop\",\"index\":0}\n\n"
+                yield "event: message_delta\ndata: {\"type\":\"message_delta\",\"delta\":{\"stop_reason\":\"end_turn\"},\"usage\":{\"output_tokens\":5}}\n\n"
+                yield "event: message_stop\ndata: {\"type\":\"message_stop\"}\n\n"
+            return Response(generate_cached_stream(), mimetype='text/event-stream')
+        return jsonify({"id": "msg_cache", "type": "message", "role": "assistant", "model": data.get('model'),
+                        "content": [{"type": "text", "text": text}], "stop_reason": "end_turn", "usage": usage})
 
     return Response(json.dumps({"error": "No test scenario triggered for Anthropic completions endpoint"}), status=400, mimetype='application/json')
 
@@ -114,6 +393,15 @@ def list_models():
     if scenario == 'EMPTY_LIST':
         return Response(json.dumps({"object": "list", "data": []}), mimetype='application/json')
 
+    # --- Scenario: A long, repetitive model list, gzip-encoded when the client accepts it ---
+    if scenario == 'COMPRESSED_RESPONSE':
+        models = [{"id": "mock-model-%03d" % i, "object": "model", "created": 1700000000, "owned_by": "mock-organization"} for i in range(300)]
+        return gzip_response(Response(json.dumps({"object": "list", "data": models}), mimetype='application/json'))
+
+    # --- Scenario: Transient failures before an empty list ---
+    if scenario and scenario.startswith('FLAKY_'):
+        return flaky_failure(scenario) or Response(json.dumps({"object": "list", "data": []}), mimetype='application/json')
+
     # --- Scenario: Rate Limit Exceeded ---
     if scenario == 'RATE_LIMIT_LIST_MODELS':
         return Response(json.dumps({"error": {"message": "Rate limit exceeded", "type": "rate_limit_error", "code": 429}}), status=429, mimetype='application/json')
@@ -206,6 +494,9 @@ def count_tokens_anthropic():
 
     if scenario == 'AUTH_FAILURE_ANTHROPIC':
         return Response(json.dumps({"type": "error", "message": "Authentication Error"}), status=401, mimetype='application/json')
+    if scenario == 'STALLED_RESPONSE':
+        time.sleep(2)
+        return Response(json.dumps({"input_tokens": 5}), mimetype='application/json')
 
     return Response(json.dumps({"error": "No test scenario triggered for Anthropic count_tokens endpoint"}), status=400, mimetype='application/json')
 
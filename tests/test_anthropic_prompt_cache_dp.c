@@ -0,0 +1,136 @@
+#include "disasterparty.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Cache breakpoints on the system prompt, tools and content parts reach the
+// Anthropic payload, and cache write and read counts are parsed from
+// responses and from message_start in streams. PROMPT_CACHE_ANTHROPIC answers
+// with the breakpoints it found and reports a cache write the first time it
+// sees a prefix and a read afterwards.
+
+typedef struct {
+    char text[256];
+} stream_capture_t;
+
+static int collect(const char* token, void* user_data, bool is_final, const char* error) {
+    (void)is_final;
+    stream_capture_t* capture = (stream_capture_t*)user_data;
+    if (error) return 1;
+    if (token) strncat(capture->text, token, sizeof(capture->text) - strlen(capture->text) - 1);
+    return 0;
+}
+
+static int collect_events(const dp_anthropic_stream_event_t* event, void* user_data, const char* error) {
+    (void)event;
+    (void)user_data;
+    return error ? 1 : 0;
+}
+
+typedef enum { SEND_COMPLETION, SEND_STREAM, SEND_ANTHROPIC_STREAM } send_mode_t;
+
+// Sends config and checks the breakpoints the mock saw and the cache usage it reported
+static int expect(const char* label, dp_context_t* context, dp_request_config_t* config, send_mode_t mode,
+                  const char* breakpoints, bool written, bool read) {
+    dp_response_t response = {0};
+    stream_capture_t capture = {{0}};
+    int result;
+    config->stream = mode != SEND_COMPLETION;
+    if (mode == SEND_STREAM) {
+        result = dp_perform_streaming_completion(context, config, collect, &capture, &response);
+    } else if (mode == SEND_ANTHROPIC_STREAM) {
+        result = dp_perform_anthropic_streaming_completion(context, config, collect_events, NULL, &response);
+    } else {
+        result = dp_perform_completion(context, config, &response);
+        if (result == 0 && response.num_parts > 0 && response.parts[0].text) {
+            snprintf(capture.text, sizeof(capture.text), "%s", response.parts[0].text);
+        }
+    }
+    const dp_usage_t* usage = &response.usage;
+    printf("%s: '%s', input %ld, output %ld, cache write %ld, cache read %ld\n", label, capture.text, usage->input_tokens,
+           usage->output_tokens, usage->cache_creation_input_tokens, usage->cache_read_input_tokens);
+    int failures = 0;
+    if (result != 0) {
+        fprintf(stderr, "FAILURE: %s: %s\n", label, response.error_message ? response.error_message : "(no error message)");
+        failures++;
+    } else {
+        // The detailed stream leaves the text to the event callback
+        if (mode != SEND_ANTHROPIC_STREAM && strcmp(capture.text, breakpoints) != 0) {
+            fprintf(stderr, "FAILURE: %s: expected '%s'.\n", label, breakpoints);
+            failures++;
+        }
+        if (usage->input_tokens != 10 || usage->output_tokens != 5 || (usage->cache_creation_input_tokens > 0) != written ||
+            (usage->cache_read_input_tokens > 0) != read) {
+            fprintf(stderr, "FAILURE: %s: expected a cache %s.\n", label, written ? "write" : read ? "read" : "miss");
+            failures++;
+        }
+    }
+    dp_free_response_content(&response);
+    return failures;
+}
+
+int main() {
+    load_env_file();
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    if (!mock_server_url) {
+        printf("SKIP: DP_MOCK_SERVER not set.\n");
+        return 77;
+    }
+    printf("Testing Anthropic prompt caching...\n");
+    int failures = 0;
+
+    dp_context_t* context = dp_init_context(DP_PROVIDER_ANTHROPIC, "PROMPT_CACHE_ANTHROPIC", mock_server_url);
+    if (!context) {
+        fprintf(stderr, "FAILURE: could not create an Anthropic context.\n");
+        return EXIT_FAILURE;
+    }
+
+    // The mock keeps its cache across runs, so every run uses a new prefix
+    char system_prompt[128];
+    snprintf(system_prompt, sizeof(system_prompt), "You are a careful assistant (run %ld).", (long)getpid());
+    dp_tool_definition_t tools[2] = {
+        { .type = DP_TOOL_TYPE_FUNCTION, .function = { .name = "get_weather", .description = "Gets the weather.",
+                                                       .parameters_json_schema = "{\"type\":\"object\",\"properties\":{}}" } },
+        { .type = DP_TOOL_TYPE_FUNCTION, .function = { .name = "get_time", .description = "Gets the time.",
+                                                       .parameters_json_schema = "{\"type\":\"object\",\"properties\":{}}" } }
+    };
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Here is a long reference document.");
+    dp_message_add_text_part(&message, "What does it say?");
+    dp_request_config_t config = { .model = "claude-3-haiku-20240307", .messages = &message, .num_messages = 1,
+                                   .system_prompt = system_prompt, .temperature = 0.0, .max_tokens = 100,
+                                   .tools = tools, .num_tools = 2 };
+
+    // No breakpoints: nothing is cached and the system prompt stays a string
+    failures += expect("unmarked", context, &config, SEND_COMPLETION, "breakpoints: none", false, false);
+
+    config.system_prompt_cache_control = DP_CACHE_CONTROL_EPHEMERAL;
+    config.tools_cache_control = DP_CACHE_CONTROL_EPHEMERAL;
+    message.parts[0].cache_control = DP_CACHE_CONTROL_EPHEMERAL_1H;
+    const char* marked = "breakpoints: tools system message0.part0/1h";
+    failures += expect("first marked", context, &config, SEND_COMPLETION, marked, true, false);
+    failures += expect("repeated marked", context, &config, SEND_COMPLETION, marked, false, true);
+    failures += expect("marked stream", context, &config, SEND_STREAM, marked, false, true);
+    failures += expect("marked anthropic stream", context, &config, SEND_ANTHROPIC_STREAM, marked, false, true);
+
+    // A breakpoint on a message part alone, after an unmarked system prompt
+    dp_message_t question = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&question, "Only this part.");
+    question.parts[0].cache_control = DP_CACHE_CONTROL_EPHEMERAL;
+    dp_request_config_t single = { .model = "claude-3-haiku-20240307", .messages = &question, .num_messages = 1,
+                                   .system_prompt = system_prompt, .temperature = 0.0 };
+    failures += expect("single part", context, &single, SEND_COMPLETION, "breakpoints: message0.part0", true, false);
+
+    dp_free_messages(&message, 1);
+    dp_free_messages(&question, 1);
+    dp_destroy_context(context);
+
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d prompt caching checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: cache breakpoints are sent and cache usage is reported.\n");
+    return EXIT_SUCCESS;
+}
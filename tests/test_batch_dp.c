@@ -0,0 +1,146 @@
+#include "disasterparty.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_ITEMS 24
+#define MAX_CONCURRENCY 6
+#define SLOW_SECONDS 0.3  // Server-side delay of the SLOW_COMPLETION scenario
+#define BAD_ITEM 5
+#define EXPECTED_TEXT "Hello from the mock server."
+#define REUSE_ITEMS 4
+
+// The second batch against the keep-alive stand-in (tests/mock-server/h2_server.py,
+// reachable through DP_H2_MOCK_SERVER) must reuse the connections of the first.
+
+typedef struct {
+    int calls[NUM_ITEMS];
+    int succeeded;
+    int failed;
+} batch_progress_t;
+
+static void on_item(size_t index, dp_response_t* response, int status, void* user_data) {
+    batch_progress_t* progress = (batch_progress_t*)user_data;
+    progress->calls[index]++;
+    if (status == 0 && response->num_parts > 0 && response->parts[0].text &&
+        strcmp(response->parts[0].text, EXPECTED_TEXT) == 0) {
+        progress->succeeded++;
+    } else {
+        progress->failed++;
+    }
+}
+
+// Runs one batch of REUSE_ITEMS and returns the connections it opened, or -1 if an item failed.
+static long run_reuse_batch(dp_context_t* context, const dp_request_config_t* config) {
+    dp_request_config_t configs[REUSE_ITEMS];
+    dp_response_t responses[REUSE_ITEMS];
+    for (int i = 0; i < REUSE_ITEMS; ++i) configs[i] = *config;
+    int rc = dp_perform_completions_batch(context, configs, REUSE_ITEMS, REUSE_ITEMS, responses, NULL, NULL);
+    long connects = 0;
+    for (int i = 0; i < REUSE_ITEMS; ++i) {
+        if (rc == 0) connects += responses[i].transport.num_connects;
+        else if (responses[i].error_message) fprintf(stderr, "Item %d failed: %s\n", i, responses[i].error_message);
+        dp_free_response_content(&responses[i]);
+    }
+    return rc == 0 ? connects : -1;
+}
+
+static int check_connection_reuse(const char* h2_server_url, const dp_request_config_t* config) {
+    char base_url[512];
+    snprintf(base_url, sizeof(base_url), "%s/v1", h2_server_url);
+    dp_context_t* context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "h2-key", base_url);
+    if (!context) return 0;
+    const char* ca_bundle = getenv("DP_H2_MOCK_CA");
+    if (ca_bundle) dp_set_ca_bundle(context, ca_bundle);
+    long first = run_reuse_batch(context, config);
+    long second = run_reuse_batch(context, config);
+    dp_destroy_context(context);
+    printf("Back-to-back batches opened %ld and %ld connection(s)\n", first, second);
+    if (first < 0 || second != 0) {
+        fprintf(stderr, "FAILURE: the second batch did not reuse the first batch's connections.\n");
+        return 0;
+    }
+    return 1;
+}
+
+int main() {
+    load_env_file();
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    if (!mock_server_url) {
+        printf("SKIP: DP_MOCK_SERVER environment variable not set.\n");
+        return 77;
+    }
+
+    printf("Testing dp_perform_completions_batch...\n");
+
+    dp_context_t* context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SLOW_COMPLETION", mock_server_url);
+    if (!context) {
+        fprintf(stderr, "Failed to initialize context.\n");
+        return EXIT_FAILURE;
+    }
+
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Classify this.");
+    dp_request_config_t configs[NUM_ITEMS];
+    for (int i = 0; i < NUM_ITEMS; ++i) {
+        configs[i] = (dp_request_config_t){ .model = "mock-model", .messages = &message, .num_messages = 1, .temperature = -1.0 };
+    }
+    // A streaming config is rejected; only that item should fail.
+    configs[BAD_ITEM].stream = true;
+
+    dp_response_t responses[NUM_ITEMS];
+    batch_progress_t progress = {0};
+
+    double start = now_seconds();
+    int rc = dp_perform_completions_batch(context, configs, NUM_ITEMS, MAX_CONCURRENCY, responses, on_item, &progress);
+    double elapsed = now_seconds() - start;
+    printf("%d items finished in %.2fs\n", NUM_ITEMS, elapsed);
+
+    int ok = 1;
+    if (rc != -1) {
+        fprintf(stderr, "FAILURE: expected -1 because one item was invalid, got %d.\n", rc);
+        ok = 0;
+    }
+    for (int i = 0; i < NUM_ITEMS; ++i) {
+        if (progress.calls[i] != 1) {
+            fprintf(stderr, "FAILURE: item %d reported %d times.\n", i, progress.calls[i]);
+            ok = 0;
+        }
+    }
+    if (progress.succeeded != NUM_ITEMS - 1 || progress.failed != 1 || !responses[BAD_ITEM].error_message) {
+        fprintf(stderr, "FAILURE: %d succeeded, %d failed.\n", progress.succeeded, progress.failed);
+        ok = 0;
+    }
+    // The concurrency cap means at least ceil(valid items / cap) server delays;
+    // without concurrency it would take one delay per item.
+    double min_expected = ((NUM_ITEMS - 1 + MAX_CONCURRENCY - 1) / MAX_CONCURRENCY) * SLOW_SECONDS * 0.9;
+    double max_expected = NUM_ITEMS * SLOW_SECONDS * 0.5;
+    if (elapsed < min_expected || elapsed > max_expected) {
+        fprintf(stderr, "FAILURE: elapsed %.2fs outside [%.2f, %.2f].\n", elapsed, min_expected, max_expected);
+        ok = 0;
+    }
+
+    for (int i = 0; i < NUM_ITEMS; ++i) {
+        dp_free_response_content(&responses[i]);
+    }
+
+    if (dp_perform_completions_batch(NULL, configs, NUM_ITEMS, 0, responses, NULL, NULL) != -1 ||
+        dp_perform_completions_batch(context, configs, 0, 0, NULL, NULL, NULL) != 0) {
+        fprintf(stderr, "FAILURE: argument validation.\n");
+        ok = 0;
+    }
+
+    const char* h2_server_url = getenv("DP_H2_MOCK_SERVER");
+    if (h2_server_url) {
+        if (!check_connection_reuse(h2_server_url, &configs[0])) ok = 0;
+    } else {
+        printf("DP_H2_MOCK_SERVER not set; skipping the connection reuse check.\n");
+    }
+
+    dp_free_messages(&message, 1);
+    dp_destroy_context(context);
+    if (!ok) return EXIT_FAILURE;
+    printf("SUCCESS: batch respected the concurrency cap and reported every item.\n");
+    return EXIT_SUCCESS;
+}
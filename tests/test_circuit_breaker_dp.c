@@ -0,0 +1,147 @@
+#include "disasterparty.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// The circuit breaker opens on consecutive failures or a failure ratio, fails
+// requests fast while open, and closes again after a successful probe. The
+// FLAKY_<n>_503_<tag> scenario answers 503 to its first n requests.
+
+#define OPEN_MS 200
+
+static int complete(dp_context_t* context, long first_byte_ms, dp_response_t* response) {
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Hello?");
+    dp_request_config_t config = { .model = "mock-model", .messages = &message, .num_messages = 1, .temperature = -1.0,
+                                   .deadlines = { .first_byte_ms = first_byte_ms } };
+    int ret = dp_perform_completion(context, &config, response);
+    dp_free_messages(&message, 1);
+    return ret;
+}
+
+// Performs one request and checks its error class
+static int expect_class(const char* label, dp_context_t* context, long first_byte_ms, dp_error_class_t expected) {
+    dp_response_t response;
+    double start = now_seconds();
+    complete(context, first_byte_ms, &response);
+    long elapsed = (long)((now_seconds() - start) * 1000);
+    int failed = response.error_class != expected;
+    if (failed) {
+        fprintf(stderr, "FAILURE: %s: error class %d, expected %d (%s)\n", label, (int)response.error_class, (int)expected,
+                response.error_message ? response.error_message : "no error");
+    } else if (expected == DP_ERROR_CIRCUIT_OPEN && elapsed > 50) {
+        fprintf(stderr, "FAILURE: %s: took %ld ms to fail fast.\n", label, elapsed);
+        failed = 1;
+    }
+    dp_free_response_content(&response);
+    return failed;
+}
+
+static int expect_state(const char* label, dp_context_t* context, dp_circuit_state_t expected, uint64_t times_opened) {
+    dp_circuit_breaker_stats_t stats;
+    dp_get_circuit_breaker_stats(context, &stats);
+    printf("%s: state %d, %d consecutive failures, ratio %.2f, opened %llu times, %llu rejected\n", label, (int)stats.state,
+           stats.consecutive_failures, stats.failure_ratio, (unsigned long long)stats.times_opened, (unsigned long long)stats.rejected);
+    if (stats.state != expected || stats.times_opened != times_opened) {
+        fprintf(stderr, "FAILURE: %s: expected state %d after %llu openings.\n", label, (int)expected, (unsigned long long)times_opened);
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    load_env_file();
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    if (!mock_server_url) {
+        printf("SKIP: DP_MOCK_SERVER not set.\n");
+        return 77;
+    }
+    printf("Testing the circuit breaker...\n");
+    int failures = 0;
+
+    // Consecutive failures: 3 failures open it, the first probe fails, the second closes it
+    char key[64];
+    snprintf(key, sizeof(key), "FLAKY_4_503_breaker%ld", (long)getpid());
+    dp_context_t* context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, key, mock_server_url);
+    dp_circuit_breaker_policy_t consecutive = { .failure_threshold = 3, .open_ms = OPEN_MS };
+    if (dp_set_circuit_breaker(context, &consecutive) != 0) {
+        fprintf(stderr, "FAILURE: dp_set_circuit_breaker() rejected a valid policy.\n");
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < 3; ++i) failures += expect_class("failing endpoint", context, 0, DP_ERROR_API);
+    failures += expect_state("after 3 failures", context, DP_CIRCUIT_OPEN, 1);
+    failures += expect_class("while open", context, 0, DP_ERROR_CIRCUIT_OPEN);
+    failures += expect_class("while open", context, 0, DP_ERROR_CIRCUIT_OPEN);
+
+    usleep((OPEN_MS + 50) * 1000);
+    failures += expect_state("after open_ms", context, DP_CIRCUIT_HALF_OPEN, 1);
+    failures += expect_class("failed probe", context, 0, DP_ERROR_API);
+    failures += expect_state("after a failed probe", context, DP_CIRCUIT_OPEN, 2);
+    failures += expect_class("reopened", context, 0, DP_ERROR_CIRCUIT_OPEN);
+
+    usleep((OPEN_MS + 50) * 1000);
+    failures += expect_class("successful probe", context, 0, DP_ERROR_NONE);
+    failures += expect_state("after a successful probe", context, DP_CIRCUIT_CLOSED, 2);
+    failures += expect_class("closed again", context, 0, DP_ERROR_NONE);
+
+    dp_circuit_breaker_stats_t stats;
+    dp_get_circuit_breaker_stats(context, &stats);
+    if (stats.rejected != 3) {
+        fprintf(stderr, "FAILURE: %llu requests rejected, expected 3.\n", (unsigned long long)stats.rejected);
+        failures++;
+    }
+    dp_destroy_context(context);
+
+    // Failure ratio: first-byte deadline misses against a slow endpoint fail,
+    // requests without the deadline succeed; half of a 4-attempt window opens it
+    context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SLOW_COMPLETION", mock_server_url);
+    dp_circuit_breaker_policy_t ratio = { .failure_ratio = 0.5, .window = 4, .open_ms = 60000 };
+    dp_set_circuit_breaker(context, &ratio);
+    failures += expect_class("ratio: success", context, 0, DP_ERROR_NONE);
+    failures += expect_class("ratio: failure", context, 100, DP_ERROR_DEADLINE);
+    failures += expect_class("ratio: success", context, 0, DP_ERROR_NONE);
+    failures += expect_state("1 of 3 failed", context, DP_CIRCUIT_CLOSED, 0);
+    failures += expect_class("ratio: failure", context, 100, DP_ERROR_DEADLINE);
+    failures += expect_state("2 of 4 failed", context, DP_CIRCUIT_OPEN, 1);
+
+    // The engine refuses submissions while open
+    dp_engine_t* engine = dp_engine_create();
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Hello?");
+    dp_request_config_t config = { .model = "mock-model", .messages = &message, .num_messages = 1, .temperature = -1.0 };
+    dp_response_t response = {0};
+    if (dp_submit_completion(engine, context, &config, &response, NULL, NULL) != -1 || response.error_class != DP_ERROR_CIRCUIT_OPEN) {
+        fprintf(stderr, "FAILURE: the engine accepted a request while the breaker was open.\n");
+        failures++;
+    }
+    dp_free_response_content(&response);
+    dp_engine_destroy(engine);
+    dp_free_messages(&message, 1);
+
+    // Client errors say nothing about the endpoint's health
+    dp_context_t* unauthorized = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "AUTH_FAILURE_OPENAI", mock_server_url);
+    dp_set_circuit_breaker(unauthorized, &consecutive);
+    for (int i = 0; i < 4; ++i) failures += expect_class("client error", unauthorized, 0, DP_ERROR_API);
+    failures += expect_state("after 4 client errors", unauthorized, DP_CIRCUIT_CLOSED, 0);
+    dp_destroy_context(unauthorized);
+
+    // Invalid policies
+    dp_circuit_breaker_policy_t no_threshold = { .open_ms = 1000 };
+    dp_circuit_breaker_policy_t bad_ratio = { .failure_ratio = 1.5 };
+    dp_circuit_breaker_policy_t big_window = { .failure_ratio = 0.5, .window = 1000 };
+    if (dp_set_circuit_breaker(context, &no_threshold) != -1 || dp_set_circuit_breaker(context, &bad_ratio) != -1 ||
+        dp_set_circuit_breaker(context, &big_window) != -1 || dp_set_circuit_breaker(NULL, &ratio) != -1) {
+        fprintf(stderr, "FAILURE: an invalid policy was accepted.\n");
+        failures++;
+    }
+    dp_destroy_context(context);
+
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d circuit breaker checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: the circuit breaker opens, fails fast, probes and closes.\n");
+    return EXIT_SUCCESS;
+}
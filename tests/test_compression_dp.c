@@ -0,0 +1,100 @@
+#include "disasterparty.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// COMPRESSED_RESPONSE gzip-encodes replies when the request offers gzip in
+// Accept-Encoding, including SSE streams flushed event by event. Every call
+// must decode them transparently and report both body sizes.
+
+#define EXPECTED_TEXT "Hello from the mock server."
+
+static int stream_callback(const char* token, void* user_data, bool is_final, const char* error) {
+    char* text = (char*)user_data;
+    (void)is_final;
+    if (error) return 1;
+    if (token) strncat(text, token, 255 - strlen(text));
+    return 0;
+}
+
+int main() {
+    load_env_file();
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    if (!mock_server_url) {
+        printf("SKIP: DP_MOCK_SERVER environment variable not set.\n");
+        return 77;
+    }
+
+    printf("Testing compressed responses...\n");
+
+    dp_context_t* ctx = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "COMPRESSED_RESPONSE", mock_server_url);
+    if (!ctx) {
+        fprintf(stderr, "Failed to initialize context.\n");
+        return EXIT_FAILURE;
+    }
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Hello?");
+    dp_request_config_t config = { .model = "mock-model", .messages = &message, .num_messages = 1, .temperature = -1.0 };
+    int failures = 0;
+
+    // Buffered completion
+    dp_response_t response;
+    int ret = dp_perform_completion(ctx, &config, &response);
+    printf("completion: %llu bytes on the wire, %llu decoded\n",
+           (unsigned long long)response.transport.body_bytes_wire, (unsigned long long)response.transport.body_bytes_decoded);
+    if (ret != 0 || response.num_parts == 0 || !response.parts[0].text || strcmp(response.parts[0].text, EXPECTED_TEXT) != 0) {
+        fprintf(stderr, "FAILURE: compressed completion was not decoded: %s\n", response.error_message ? response.error_message : "(unexpected text)");
+        failures++;
+    }
+    if (response.transport.body_bytes_wire == 0 || response.transport.body_bytes_decoded == 0 ||
+        response.transport.body_bytes_wire == response.transport.body_bytes_decoded) {
+        fprintf(stderr, "FAILURE: completion byte counts do not show a compressed body.\n");
+        failures++;
+    }
+    dp_free_response_content(&response);
+
+    // SSE stream, decoded incrementally
+    dp_request_config_t stream_config = config;
+    stream_config.stream = true;
+    char text[256] = "";
+    ret = dp_perform_streaming_completion(ctx, &stream_config, stream_callback, text, &response);
+    printf("stream: '%s', %llu bytes on the wire, %llu decoded\n", text,
+           (unsigned long long)response.transport.body_bytes_wire, (unsigned long long)response.transport.body_bytes_decoded);
+    if (ret != 0 || strcmp(text, EXPECTED_TEXT) != 0) {
+        fprintf(stderr, "FAILURE: compressed stream was not decoded: %s\n", response.error_message ? response.error_message : "(unexpected text)");
+        failures++;
+    }
+    dp_free_response_content(&response);
+
+    // A large model list compresses well
+    dp_request_stats_t before;
+    dp_get_request_stats(ctx, &before);
+    dp_model_list_t* model_list = NULL;
+    ret = dp_list_models(ctx, &model_list);
+    if (ret != 0 || !model_list || model_list->count != 300) {
+        fprintf(stderr, "FAILURE: compressed model list was not decoded: %s\n",
+                model_list && model_list->error_message ? model_list->error_message : "(wrong count)");
+        failures++;
+    }
+    dp_free_model_list(model_list);
+    dp_request_stats_t after;
+    dp_get_request_stats(ctx, &after);
+    uint64_t wire = after.body_bytes_wire - before.body_bytes_wire;
+    uint64_t decoded = after.body_bytes_decoded - before.body_bytes_decoded;
+    printf("model list: %llu bytes on the wire, %llu decoded\n", (unsigned long long)wire, (unsigned long long)decoded);
+    if (wire == 0 || decoded < wire * 4) {
+        fprintf(stderr, "FAILURE: context totals do not show the model list's compression.\n");
+        failures++;
+    }
+
+    dp_free_messages(&message, 1);
+    dp_destroy_context(ctx);
+
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d compression checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: compressed responses are decoded and measured.\n");
+    return EXIT_SUCCESS;
+}
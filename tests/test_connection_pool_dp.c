@@ -0,0 +1,168 @@
+#include "disasterparty.h"
+#include "dp_private.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define NUM_THREADS 8
+#define REQUESTS_PER_THREAD 5
+
+static int list_models_ok(dp_context_t* context) {
+    dp_model_list_t* model_list = NULL;
+    int ret = dp_list_models(context, &model_list);
+    if (ret != 0 && model_list && model_list->error_message) {
+        fprintf(stderr, "dp_list_models failed: %s\n", model_list->error_message);
+    }
+    dp_free_model_list(model_list);
+    return ret == 0;
+}
+
+static void* worker(void* arg) {
+    dp_context_t* context = (dp_context_t*)arg;
+    long failures = 0;
+    for (int i = 0; i < REQUESTS_PER_THREAD; ++i) {
+        if (!list_models_ok(context)) failures++;
+    }
+    return (void*)failures;
+}
+
+// A thread that parks a handle in its own cache, then waits while the main
+// thread disables pooling, and reports whether the handle is still cached.
+typedef struct {
+    dp_context_t* context;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int step;           // 1 = handle parked, 2 = pooling disabled
+    bool parked;
+    bool still_cached;
+} holder_t;
+
+static void holder_advance(holder_t* holder, int step) {
+    pthread_mutex_lock(&holder->lock);
+    holder->step = step;
+    pthread_cond_broadcast(&holder->cond);
+    pthread_mutex_unlock(&holder->lock);
+}
+
+static void holder_wait(holder_t* holder, int step) {
+    pthread_mutex_lock(&holder->lock);
+    while (holder->step < step) pthread_cond_wait(&holder->cond, &holder->lock);
+    pthread_mutex_unlock(&holder->lock);
+}
+
+static void* holder(void* arg) {
+    holder_t* h = (holder_t*)arg;
+    h->parked = list_models_ok(h->context) && dpinternal_pool_thread_cached(h->context);
+    holder_advance(h, 1);
+    holder_wait(h, 2);
+    h->still_cached = dpinternal_pool_thread_cached(h->context);
+    return NULL;
+}
+
+static size_t idle_handles(dp_context_t* context) {
+    pthread_mutex_lock(&context->pool.lock);
+    size_t count = context->pool.idle_count;
+    pthread_mutex_unlock(&context->pool.lock);
+    return count;
+}
+
+// Idle handles reachable from this thread: the shared stack plus this thread's cache slot.
+static size_t cached_handles(dp_context_t* context) {
+    return idle_handles(context) + (dpinternal_pool_thread_cached(context) ? 1 : 0);
+}
+
+int main() {
+    load_env_file();
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    if (!mock_server_url) {
+        printf("SKIP: DP_MOCK_SERVER environment variable not set.\n");
+        return 77;
+    }
+
+    printf("Testing connection pooling...\n");
+
+    dp_context_t* context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "EMPTY_LIST", mock_server_url);
+    if (!context) {
+        fprintf(stderr, "Failed to initialize context for mock server.\n");
+        return EXIT_FAILURE;
+    }
+
+    // A finished request parks its handle, and the next request picks the same one back up.
+    if (!list_models_ok(context) || cached_handles(context) != 1 || !dpinternal_pool_thread_cached(context)) {
+        fprintf(stderr, "FAILURE: handle was not kept in the thread cache (idle=%zu).\n", cached_handles(context));
+        dp_destroy_context(context);
+        return EXIT_FAILURE;
+    }
+    CURL* parked = dpinternal_pool_acquire(context);
+    dpinternal_pool_release(context, parked);
+    if (!list_models_ok(context)) {
+        dp_destroy_context(context);
+        return EXIT_FAILURE;
+    }
+    CURL* reused = dpinternal_pool_acquire(context);
+    dpinternal_pool_release(context, reused);
+    if (parked != reused || cached_handles(context) != 1) {
+        fprintf(stderr, "FAILURE: sequential requests did not reuse the pooled handle.\n");
+        dp_destroy_context(context);
+        return EXIT_FAILURE;
+    }
+
+    // Concurrent checkout from one context.
+    pthread_t threads[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        pthread_create(&threads[i], NULL, worker, context);
+    }
+    long total_failures = 0;
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        void* result = NULL;
+        pthread_join(threads[i], &result);
+        total_failures += (long)result;
+    }
+    if (total_failures != 0 || idle_handles(context) > DP_POOL_DEFAULT_MAX_IDLE) {
+        fprintf(stderr, "FAILURE: %ld concurrent requests failed (idle=%zu).\n", total_failures, idle_handles(context));
+        dp_destroy_context(context);
+        return EXIT_FAILURE;
+    }
+    printf("%d concurrent requests succeeded, %zu handles parked.\n", NUM_THREADS * REQUESTS_PER_THREAD, idle_handles(context));
+
+    // Shrinking the pool trims parked handles; a zero limit disables pooling.
+    if (dp_set_connection_pool_limits(context, 2, 30, 300) != 0 || idle_handles(context) > 2) {
+        fprintf(stderr, "FAILURE: shrinking the pool did not trim idle handles.\n");
+        dp_destroy_context(context);
+        return EXIT_FAILURE;
+    }
+    // Disabling pooling also releases handles cached by other, idle threads
+    holder_t held = { .context = context };
+    pthread_mutex_init(&held.lock, NULL);
+    pthread_cond_init(&held.cond, NULL);
+    pthread_t holder_thread;
+    pthread_create(&holder_thread, NULL, holder, &held);
+    holder_wait(&held, 1);
+    int disabled = dp_set_connection_pool_limits(context, 0, 0, 0);
+    holder_advance(&held, 2);
+    pthread_join(holder_thread, NULL);
+    pthread_cond_destroy(&held.cond);
+    pthread_mutex_destroy(&held.lock);
+    if (disabled != 0 || !held.parked || held.still_cached) {
+        fprintf(stderr, "FAILURE: another thread's cached handle survived disabling the pool (parked=%d).\n", held.parked);
+        dp_destroy_context(context);
+        return EXIT_FAILURE;
+    }
+    if (!list_models_ok(context) || cached_handles(context) != 0) {
+        fprintf(stderr, "FAILURE: handle was pooled with pooling disabled.\n");
+        dp_destroy_context(context);
+        return EXIT_FAILURE;
+    }
+
+    if (dp_set_connection_pool_limits(context, 4, -1, 0) != -1) {
+        fprintf(stderr, "FAILURE: dp_set_connection_pool_limits accepted a negative idle time.\n");
+        dp_destroy_context(context);
+        return EXIT_FAILURE;
+    }
+
+    dp_destroy_context(context);
+    printf("SUCCESS: connection pool behaves as expected.\n");
+    return EXIT_SUCCESS;
+}
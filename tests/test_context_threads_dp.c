@@ -0,0 +1,144 @@
+#include "disasterparty.h"
+#include "dp_private.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// Hammers one shared context from many threads: completions, streams and model
+// listings interleave with runtime setters while the endpoint forces the
+// max_completion_tokens -> max_tokens fallback to be learned concurrently.
+
+#define NUM_THREADS 16
+#define OPS_PER_THREAD 24
+#define EXPECTED_TEXT "Hello from the mock server."
+
+typedef struct {
+    dp_context_t* legacy_context;   // Shared by every thread; rejects max_completion_tokens
+    dp_context_t* models_context;   // Shared by every thread; lists models
+    int thread_index;
+    int failures;
+} worker_t;
+
+static int stream_callback(const char* token, void* user_data, bool is_final, const char* error) {
+    char* text = (char*)user_data;
+    (void)is_final;
+    if (error) return 1;
+    if (token) strncat(text, token, 255 - strlen(text));
+    return 0;
+}
+
+static bool run_completion(dp_context_t* context, const dp_request_config_t* config) {
+    dp_response_t response = {0};
+    int ret = dp_perform_completion(context, config, &response);
+    bool ok = ret == 0 && response.num_parts > 0 && response.parts[0].text &&
+              strcmp(response.parts[0].text, EXPECTED_TEXT) == 0;
+    if (!ok) fprintf(stderr, "Completion failed: %s\n", response.error_message ? response.error_message : "(unexpected text)");
+    dp_free_response_content(&response);
+    return ok;
+}
+
+static bool run_stream(dp_context_t* context, const dp_request_config_t* config) {
+    char text[256] = "";
+    dp_response_t response = {0};
+    int ret = dp_perform_streaming_completion(context, config, stream_callback, text, &response);
+    bool ok = ret == 0 && strcmp(text, EXPECTED_TEXT) == 0;
+    if (!ok) fprintf(stderr, "Stream failed: %s (text '%s')\n", response.error_message ? response.error_message : "(unexpected text)", text);
+    dp_free_response_content(&response);
+    return ok;
+}
+
+static bool run_list_models(dp_context_t* context) {
+    dp_model_list_t* model_list = NULL;
+    int ret = dp_list_models(context, &model_list);
+    if (ret != 0) fprintf(stderr, "dp_list_models failed: %s\n", model_list && model_list->error_message ? model_list->error_message : "(no message)");
+    dp_free_model_list(model_list);
+    return ret == 0;
+}
+
+static void* worker(void* arg) {
+    worker_t* w = (worker_t*)arg;
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Hello?");
+    dp_request_config_t config = { .model = "mock-model", .messages = &message, .num_messages = 1,
+                                   .temperature = -1.0, .max_tokens = 32 };
+    dp_request_config_t stream_config = config;
+    stream_config.stream = true;
+
+    for (int i = 0; i < OPS_PER_THREAD; ++i) {
+        bool ok = true;
+        switch ((w->thread_index + i) % 4) {
+            case 0: ok = run_completion(w->legacy_context, &config); break;
+            case 1: ok = run_stream(w->legacy_context, &stream_config); break;
+            case 2: ok = run_list_models(w->models_context); break;
+            case 3:
+                // Runtime setters documented as safe while other threads issue requests
+                dp_set_stall_threshold(w->legacy_context, 100 + i);
+                dp_enable_advanced_features(w->models_context, DP_FEATURE_THINKING, 0);
+                dp_set_connection_pool_limits(w->models_context, (size_t)(i % 3) * 4, 30, 0);
+                ok = run_completion(w->legacy_context, &config);
+                break;
+        }
+        if (!ok) w->failures++;
+    }
+    dp_free_messages(&message, 1);
+    return NULL;
+}
+
+int main() {
+    load_env_file();
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    if (!mock_server_url) {
+        printf("SKIP: DP_MOCK_SERVER environment variable not set.\n");
+        return 77;
+    }
+
+    printf("Testing one context shared by %d threads...\n", NUM_THREADS);
+
+    dp_context_t* legacy_context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "LEGACY_TOKEN_PARAM", mock_server_url);
+    dp_context_t* models_context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "EMPTY_LIST", mock_server_url);
+    if (!legacy_context || !models_context) {
+        fprintf(stderr, "Failed to initialize contexts.\n");
+        return EXIT_FAILURE;
+    }
+    if (atomic_load(&legacy_context->token_param_preference) != DP_TOKEN_PARAM_MAX_COMPLETION_TOKENS) {
+        fprintf(stderr, "FAILURE: new context should start with max_completion_tokens.\n");
+        return EXIT_FAILURE;
+    }
+
+    pthread_t threads[NUM_THREADS];
+    worker_t workers[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        workers[i] = (worker_t){ .legacy_context = legacy_context, .models_context = models_context, .thread_index = i };
+        if (pthread_create(&threads[i], NULL, worker, &workers[i]) != 0) {
+            fprintf(stderr, "Failed to create thread %d.\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+    int failures = 0;
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+        failures += workers[i].failures;
+    }
+
+    bool learned = atomic_load(&legacy_context->token_param_preference) == DP_TOKEN_PARAM_MAX_TOKENS;
+    bool features_set = (atomic_load(&models_context->features) & DP_FEATURE_THINKING) != 0;
+    dp_destroy_context(legacy_context);
+    dp_destroy_context(models_context);
+
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d of %d operations failed.\n", failures, NUM_THREADS * OPS_PER_THREAD);
+        return EXIT_FAILURE;
+    }
+    if (!learned) {
+        fprintf(stderr, "FAILURE: the context did not learn the legacy max_tokens parameter.\n");
+        return EXIT_FAILURE;
+    }
+    if (!features_set) {
+        fprintf(stderr, "FAILURE: a feature flag set from a worker thread was lost.\n");
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: %d operations across %d threads on shared contexts.\n", NUM_THREADS * OPS_PER_THREAD, NUM_THREADS);
+    return EXIT_SUCCESS;
+}
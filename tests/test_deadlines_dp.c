@@ -0,0 +1,165 @@
+#include "disasterparty.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The STALLED_RESPONSE scenario goes quiet for 2 s, before the body of a
+// completion or after the second token of a stream. Every deadline below is
+// far shorter, so each miss must be reported well before the server resumes.
+
+#define STALL_SECONDS 2.0
+
+static int tokens_seen = 0;
+
+static int stream_callback(const char* token, void* user_data, bool is_final, const char* error) {
+    (void)user_data; (void)is_final; (void)error;
+    if (token) tokens_seen++;
+    return 0;
+}
+
+static int expect_miss(const char* label, int ret, const dp_response_t* response, dp_deadline_kind_t kind, double elapsed) {
+    printf("%s: ret=%d class=%d deadline=%d in %.2fs (%s)\n", label, ret, response->error_class,
+           response->deadline_missed, elapsed, response->error_message ? response->error_message : "no error");
+    if (ret != -1 || response->error_class != DP_ERROR_DEADLINE || response->deadline_missed != kind) {
+        fprintf(stderr, "FAILURE: %s was not reported as the expected deadline miss.\n", label);
+        return 1;
+    }
+    if (elapsed >= STALL_SECONDS - 0.2) {
+        fprintf(stderr, "FAILURE: %s waited for the stalled server instead of giving up.\n", label);
+        return 1;
+    }
+    return 0;
+}
+
+static int engine_status = 0;
+
+static void on_done(dp_response_t* response, int status, void* user_data) {
+    (void)response; (void)user_data;
+    engine_status = status;
+}
+
+int main() {
+    load_env_file();
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    if (!mock_server_url) {
+        printf("SKIP: DP_MOCK_SERVER environment variable not set.\n");
+        return 77;
+    }
+
+    printf("Testing per-request deadlines...\n");
+
+    dp_context_t* stalled = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "STALLED_RESPONSE", mock_server_url);
+    dp_context_t* healthy = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SUCCESS_COMPLETION", mock_server_url);
+    dp_context_t* limited = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "RATE_LIMIT_COMPLETION", mock_server_url);
+    if (!stalled || !healthy || !limited) {
+        fprintf(stderr, "Failed to initialize contexts.\n");
+        return EXIT_FAILURE;
+    }
+
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Hello?");
+    dp_request_config_t base = { .model = "mock-model", .messages = &message, .num_messages = 1, .temperature = -1.0 };
+    int failures = 0;
+    dp_response_t response;
+    double start;
+    int ret;
+
+    // Time to first byte
+    dp_request_config_t config = base;
+    config.deadlines.first_byte_ms = 300;
+    start = now_seconds();
+    ret = dp_perform_completion(stalled, &config, &response);
+    failures += expect_miss("first byte", ret, &response, DP_DEADLINE_FIRST_BYTE, now_seconds() - start);
+    dp_free_response_content(&response);
+
+    // Whole request
+    config = base;
+    config.deadlines.total_ms = 500;
+    start = now_seconds();
+    ret = dp_perform_completion(stalled, &config, &response);
+    failures += expect_miss("total", ret, &response, DP_DEADLINE_TOTAL, now_seconds() - start);
+    dp_free_response_content(&response);
+
+    // Idle gap in the middle of a stream; the tokens before the stall still arrive
+    config = base;
+    config.stream = true;
+    config.deadlines.stream_idle_ms = 400;
+    start = now_seconds();
+    ret = dp_perform_streaming_completion(stalled, &config, stream_callback, NULL, &response);
+    failures += expect_miss("stream idle", ret, &response, DP_DEADLINE_STREAM_IDLE, now_seconds() - start);
+    if (tokens_seen != 2) {
+        fprintf(stderr, "FAILURE: expected the 2 tokens sent before the stall, got %d.\n", tokens_seen);
+        failures++;
+    }
+    dp_free_response_content(&response);
+
+    // Context-wide defaults apply when the request sets nothing
+    dp_deadlines_t defaults = { .first_byte_ms = 300 };
+    dp_set_default_deadlines(stalled, &defaults);
+    start = now_seconds();
+    ret = dp_perform_completion(stalled, &base, &response);
+    failures += expect_miss("context default", ret, &response, DP_DEADLINE_FIRST_BYTE, now_seconds() - start);
+    dp_free_response_content(&response);
+    dp_set_default_deadlines(stalled, NULL);
+
+    // The engine enforces the same limits
+    dp_engine_t* engine = dp_engine_create();
+    config = base;
+    config.deadlines.first_byte_ms = 300;
+    start = now_seconds();
+    if (dp_submit_completion(engine, stalled, &config, &response, on_done, NULL) == 0) {
+        size_t in_flight = 0;
+        do {
+            dp_engine_perform(engine, 100, &in_flight);
+        } while (in_flight > 0);
+    }
+    failures += expect_miss("engine first byte", engine_status, &response, DP_DEADLINE_FIRST_BYTE, now_seconds() - start);
+    dp_free_response_content(&response);
+    dp_engine_destroy(engine);
+
+    // Token counting honours the request's own deadlines
+    dp_context_t* stalled_anthropic = dp_init_context(DP_PROVIDER_ANTHROPIC, "STALLED_RESPONSE", mock_server_url);
+    config = base;
+    config.deadlines.total_ms = 300;
+    size_t token_count = 0;
+    start = now_seconds();
+    ret = dp_count_tokens(stalled_anthropic, &config, &token_count);
+    double count_elapsed = now_seconds() - start;
+    printf("count tokens total: ret=%d in %.2fs\n", ret, count_elapsed);
+    if (ret != -1 || count_elapsed >= STALL_SECONDS - 0.2) {
+        fprintf(stderr, "FAILURE: dp_count_tokens ignored the request's total deadline.\n");
+        failures++;
+    }
+    dp_destroy_context(stalled_anthropic);
+
+    // Generous limits do not disturb a healthy request
+    config = base;
+    config.deadlines = (dp_deadlines_t){ .total_ms = 5000, .connect_ms = 2000, .first_byte_ms = 2000, .stream_idle_ms = 2000 };
+    ret = dp_perform_completion(healthy, &config, &response);
+    if (ret != 0 || response.error_class != DP_ERROR_NONE || response.deadline_missed != DP_DEADLINE_NONE) {
+        fprintf(stderr, "FAILURE: healthy request failed: %s\n", response.error_message ? response.error_message : "(no message)");
+        failures++;
+    }
+    dp_free_response_content(&response);
+
+    // Provider errors are a different class
+    ret = dp_perform_completion(limited, &base, &response);
+    if (ret != -1 || response.error_class != DP_ERROR_API || response.http_status_code != 429) {
+        fprintf(stderr, "FAILURE: HTTP 429 was classified as %d.\n", response.error_class);
+        failures++;
+    }
+    dp_free_response_content(&response);
+
+    dp_free_messages(&message, 1);
+    dp_destroy_context(stalled);
+    dp_destroy_context(healthy);
+    dp_destroy_context(limited);
+
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d deadline checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: deadline misses are detected early and classified.\n");
+    return EXIT_SUCCESS;
+}
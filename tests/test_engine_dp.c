@@ -0,0 +1,164 @@
+#include "disasterparty.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_COMPLETIONS 16
+#define NUM_STREAMS 4
+#define EXPECTED_TEXT "Hello from the mock server."
+
+typedef struct {
+    char text[256];
+    int status;
+    bool done;
+} request_state_t;
+
+static int completed = 0;
+static int chained_done = 0;
+
+static int stream_callback(const char* token, void* user_data, bool is_final, const char* error) {
+    request_state_t* state = (request_state_t*)user_data;
+    (void)is_final;
+    if (error) return 1;
+    if (token) strncat(state->text, token, sizeof(state->text) - strlen(state->text) - 1);
+    return 0;
+}
+
+static void on_done(dp_response_t* response, int status, void* user_data) {
+    request_state_t* state = (request_state_t*)user_data;
+    state->status = status;
+    state->done = true;
+    if (status == 0 && response->num_parts > 0 && response->parts[0].text) {
+        snprintf(state->text, sizeof(state->text), "%s", response->parts[0].text);
+    } else if (status != 0) {
+        fprintf(stderr, "Request failed: %s\n", response->error_message ? response->error_message : "(no message)");
+    }
+    completed++;
+}
+
+typedef struct {
+    dp_engine_t* engine;
+    dp_context_t* context;
+    const dp_request_config_t* config;
+    dp_response_t follow_up_response;
+    request_state_t follow_up_state;
+} chain_t;
+
+static void on_chained_done(dp_response_t* response, int status, void* user_data) {
+    (void)response; (void)user_data;
+    if (status == 0) chained_done++;
+}
+
+// Completion callbacks may submit further work on the same engine.
+static void on_done_then_chain(dp_response_t* response, int status, void* user_data) {
+    chain_t* chain = (chain_t*)user_data;
+    on_done(response, status, &chain->follow_up_state);
+    if (status == 0) {
+        dp_submit_completion(chain->engine, chain->context, chain->config, &chain->follow_up_response, on_chained_done, NULL);
+    }
+}
+
+int main() {
+    load_env_file();
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    if (!mock_server_url) {
+        printf("SKIP: DP_MOCK_SERVER environment variable not set.\n");
+        return 77;
+    }
+
+    printf("Testing the asynchronous engine...\n");
+
+    dp_context_t* slow_context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SLOW_COMPLETION", mock_server_url);
+    dp_context_t* fast_context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SUCCESS_COMPLETION", mock_server_url);
+    dp_engine_t* engine = dp_engine_create();
+    if (!slow_context || !fast_context || !engine) {
+        fprintf(stderr, "Failed to initialize contexts or engine.\n");
+        return EXIT_FAILURE;
+    }
+
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Hello?");
+    dp_request_config_t config = { .model = "mock-model", .messages = &message, .num_messages = 1, .temperature = -1.0 };
+    dp_request_config_t stream_config = config;
+    stream_config.stream = true;
+
+    dp_response_t responses[NUM_COMPLETIONS + NUM_STREAMS];
+    request_state_t states[NUM_COMPLETIONS + NUM_STREAMS];
+    memset(states, 0, sizeof(states));
+
+    double start = now_seconds();
+    for (int i = 0; i < NUM_COMPLETIONS; ++i) {
+        if (dp_submit_completion(engine, slow_context, &config, &responses[i], on_done, &states[i]) != 0) {
+            fprintf(stderr, "FAILURE: dp_submit_completion failed: %s\n", responses[i].error_message);
+            return EXIT_FAILURE;
+        }
+    }
+    for (int i = NUM_COMPLETIONS; i < NUM_COMPLETIONS + NUM_STREAMS; ++i) {
+        if (dp_submit_streaming_completion(engine, fast_context, &stream_config, stream_callback, &responses[i], on_done, &states[i]) != 0) {
+            fprintf(stderr, "FAILURE: dp_submit_streaming_completion failed: %s\n", responses[i].error_message);
+            return EXIT_FAILURE;
+        }
+    }
+
+    size_t in_flight = 0;
+    do {
+        if (dp_engine_perform(engine, 100, &in_flight) != 0) {
+            fprintf(stderr, "FAILURE: dp_engine_perform failed.\n");
+            return EXIT_FAILURE;
+        }
+    } while (in_flight > 0);
+    double elapsed = now_seconds() - start;
+
+    int failures = 0;
+    for (int i = 0; i < NUM_COMPLETIONS + NUM_STREAMS; ++i) {
+        if (!states[i].done || states[i].status != 0 || strcmp(states[i].text, EXPECTED_TEXT) != 0) {
+            fprintf(stderr, "Request %d: done=%d status=%d text='%s'\n", i, states[i].done, states[i].status, states[i].text);
+            failures++;
+        }
+        dp_free_response_content(&responses[i]);
+    }
+    if (failures > 0 || completed != NUM_COMPLETIONS + NUM_STREAMS) {
+        fprintf(stderr, "FAILURE: %d requests did not complete correctly.\n", failures);
+        return EXIT_FAILURE;
+    }
+    // Sequentially the slow requests alone take NUM_COMPLETIONS * 0.3s.
+    printf("%d requests finished in %.2fs\n", NUM_COMPLETIONS + NUM_STREAMS, elapsed);
+    if (elapsed > NUM_COMPLETIONS * 0.3 * 0.6) {
+        fprintf(stderr, "FAILURE: requests did not run concurrently.\n");
+        return EXIT_FAILURE;
+    }
+
+    // Submitting from a completion callback.
+    chain_t chain = { .engine = engine, .context = fast_context, .config = &config };
+    dp_response_t first_response;
+    if (dp_submit_completion(engine, fast_context, &config, &first_response, on_done_then_chain, &chain) != 0) {
+        return EXIT_FAILURE;
+    }
+    do {
+        dp_engine_perform(engine, 100, &in_flight);
+    } while (in_flight > 0);
+    dp_free_response_content(&first_response);
+    dp_free_response_content(&chain.follow_up_response);
+    if (chained_done != 1) {
+        fprintf(stderr, "FAILURE: follow-up request submitted from a callback did not complete.\n");
+        return EXIT_FAILURE;
+    }
+
+    // Destroying the engine cancels outstanding requests and still reports them.
+    request_state_t cancelled = {0};
+    dp_response_t cancelled_response;
+    dp_submit_completion(engine, slow_context, &config, &cancelled_response, on_done, &cancelled);
+    dp_engine_destroy(engine);
+    if (!cancelled.done || cancelled.status != -1 || !cancelled_response.error_message) {
+        fprintf(stderr, "FAILURE: destroying the engine did not cancel the pending request.\n");
+        return EXIT_FAILURE;
+    }
+    dp_free_response_content(&cancelled_response);
+
+    dp_free_messages(&message, 1);
+    dp_destroy_context(slow_context);
+    dp_destroy_context(fast_context);
+    printf("SUCCESS: engine drove concurrent completions and streams.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+#include "disasterparty.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+
+// Drives the engine from an application-owned poll(2) loop through the socket and timer hooks.
+
+#define MAX_WATCHED 16
+#define NUM_REQUESTS 6
+#define EXPECTED_TEXT "Hello from the mock server."
+
+typedef struct {
+    struct pollfd fds[MAX_WATCHED];
+    size_t num_fds;
+    long timeout_ms;
+    int socket_calls;
+    int timer_calls;
+} event_loop_t;
+
+static int on_socket(int fd, int what, void* user_data) {
+    event_loop_t* loop = (event_loop_t*)user_data;
+    loop->socket_calls++;
+    size_t i = 0;
+    while (i < loop->num_fds && loop->fds[i].fd != fd) i++;
+
+    if (what & DP_ENGINE_POLL_REMOVE) {
+        if (i < loop->num_fds) loop->fds[i] = loop->fds[--loop->num_fds];
+        return 0;
+    }
+    if (i == loop->num_fds) {
+        if (loop->num_fds == MAX_WATCHED) return -1;
+        loop->num_fds++;
+        loop->fds[i].fd = fd;
+    }
+    loop->fds[i].events = 0;
+    if (what & DP_ENGINE_POLL_IN) loop->fds[i].events |= POLLIN;
+    if (what & DP_ENGINE_POLL_OUT) loop->fds[i].events |= POLLOUT;
+    return 0;
+}
+
+static int on_timer(long timeout_ms, void* user_data) {
+    event_loop_t* loop = (event_loop_t*)user_data;
+    loop->timer_calls++;
+    loop->timeout_ms = timeout_ms;
+    return 0;
+}
+
+static int succeeded = 0;
+
+static void on_done(dp_response_t* response, int status, void* user_data) {
+    (void)user_data;
+    if (status == 0 && response->num_parts > 0 && response->parts[0].text &&
+        strcmp(response->parts[0].text, EXPECTED_TEXT) == 0) {
+        succeeded++;
+    } else {
+        fprintf(stderr, "Request failed: %s\n", response->error_message ? response->error_message : "(unexpected text)");
+    }
+}
+
+int main() {
+    load_env_file();
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    if (!mock_server_url) {
+        printf("SKIP: DP_MOCK_SERVER environment variable not set.\n");
+        return 77;
+    }
+
+    printf("Testing the engine with an external event loop...\n");
+
+    dp_context_t* context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SLOW_COMPLETION", mock_server_url);
+    dp_engine_t* engine = dp_engine_create();
+    if (!context || !engine) {
+        fprintf(stderr, "Failed to initialize context or engine.\n");
+        return EXIT_FAILURE;
+    }
+
+    event_loop_t loop = { .timeout_ms = -1 };
+    if (dp_engine_set_event_hooks(engine, on_socket, on_timer, &loop) != 0) {
+        fprintf(stderr, "FAILURE: dp_engine_set_event_hooks failed.\n");
+        return EXIT_FAILURE;
+    }
+
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Hello?");
+    dp_request_config_t config = { .model = "mock-model", .messages = &message, .num_messages = 1, .temperature = -1.0 };
+
+    dp_response_t responses[NUM_REQUESTS];
+    for (int i = 0; i < NUM_REQUESTS; ++i) {
+        if (dp_submit_completion(engine, context, &config, &responses[i], on_done, NULL) != 0) {
+            fprintf(stderr, "FAILURE: dp_submit_completion failed: %s\n", responses[i].error_message);
+            return EXIT_FAILURE;
+        }
+    }
+
+    size_t in_flight = NUM_REQUESTS;
+    int iterations = 0;
+    while (in_flight > 0 && iterations++ < 10000) {
+        // Block no longer than the engine's timer asks for; never block forever.
+        int timeout = loop.timeout_ms < 0 ? 1000 : (int)loop.timeout_ms;
+        int ready = poll(loop.fds, loop.num_fds, timeout);
+        if (ready < 0) {
+            perror("poll");
+            return EXIT_FAILURE;
+        }
+        if (ready == 0) {
+            loop.timeout_ms = -1;
+            dp_engine_socket_action(engine, DP_ENGINE_SOCKET_TIMEOUT, 0, &in_flight);
+            continue;
+        }
+        // Snapshot ready descriptors: socket_action may change the watch list.
+        struct pollfd fired[MAX_WATCHED];
+        size_t num_fired = 0;
+        for (size_t i = 0; i < loop.num_fds; ++i) {
+            if (loop.fds[i].revents) fired[num_fired++] = loop.fds[i];
+        }
+        for (size_t i = 0; i < num_fired; ++i) {
+            int events = 0;
+            if (fired[i].revents & POLLIN) events |= DP_ENGINE_EVENT_IN;
+            if (fired[i].revents & POLLOUT) events |= DP_ENGINE_EVENT_OUT;
+            if (fired[i].revents & (POLLERR | POLLHUP)) events |= DP_ENGINE_EVENT_ERR;
+            dp_engine_socket_action(engine, fired[i].fd, events, &in_flight);
+        }
+    }
+
+    for (int i = 0; i < NUM_REQUESTS; ++i) {
+        dp_free_response_content(&responses[i]);
+    }
+    dp_engine_destroy(engine);
+    dp_free_messages(&message, 1);
+    dp_destroy_context(context);
+
+    if (succeeded != NUM_REQUESTS) {
+        fprintf(stderr, "FAILURE: %d of %d requests succeeded.\n", succeeded, NUM_REQUESTS);
+        return EXIT_FAILURE;
+    }
+    if (loop.socket_calls == 0 || loop.timer_calls == 0) {
+        fprintf(stderr, "FAILURE: event hooks were not used (socket=%d, timer=%d).\n", loop.socket_calls, loop.timer_calls);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: %d requests completed via %d socket and %d timer updates.\n",
+           NUM_REQUESTS, loop.socket_calls, loop.timer_calls);
+    return EXIT_SUCCESS;
+}
@@ -61,7 +61,8 @@ int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
 
     // Call the target function
     // We ignore the return value as we are testing for crashes/memory safety
-    dpinternal_parse_response_content(ctx, json_str, &parts, &num_parts, &finish_reason);
+    dp_usage_t usage = {0};
+    dpinternal_parse_response_content(ctx, json_str, &parts, &num_parts, &finish_reason, &usage);
 
     // Cleanup
     dp_destroy_context(ctx);
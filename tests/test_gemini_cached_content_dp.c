@@ -0,0 +1,158 @@
+#include "disasterparty.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// A large inline document is stored once as a Gemini cachedContents resource,
+// then referenced by name: requests no longer carry the document, system
+// prompt or tools, and the response reports the cached tokens. The mock's
+// CACHED_CONTENT_GEMINI scenario answers with the number of contents it got
+// and rejects a request that repeats the system instruction or tools. Under a
+// retry policy a failed create is not sent again, while a failed delete is.
+
+#define DOCUMENT_BYTES (256 * 1024)
+
+// Asks a question and checks the contents the mock saw and the cached tokens it reported
+static int ask(const char* label, dp_context_t* context, const char* cached_content, const char* expected, long cached_tokens) {
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "What does the document say?");
+    dp_tool_definition_t tool = { .type = DP_TOOL_TYPE_FUNCTION,
+                                  .function = { .name = "lookup", .description = "Looks up a term.",
+                                                .parameters_json_schema = "{\"type\":\"object\",\"properties\":{}}" } };
+    dp_request_config_t config = { .model = "gemini-mock", .messages = &message, .num_messages = 1, .temperature = 0.0,
+                                   .system_prompt = "Answer from the document.", .tools = &tool, .num_tools = 1,
+                                   .cached_content = cached_content };
+    dp_response_t response = {0};
+    int result = dp_perform_completion(context, &config, &response);
+    const char* text = result == 0 && response.num_parts > 0 && response.parts[0].text ? response.parts[0].text : "";
+    printf("%s: '%s', prompt %ld, cached %ld\n", label, text, response.usage.input_tokens, response.usage.cache_read_input_tokens);
+    int failures = 0;
+    if (result != 0 || strcmp(text, expected) != 0 || response.usage.cache_read_input_tokens != cached_tokens) {
+        fprintf(stderr, "FAILURE: %s: expected '%s' with %ld cached tokens (%s).\n", label, expected, cached_tokens,
+                response.error_message ? response.error_message : "no error");
+        failures++;
+    }
+    dp_free_response_content(&response);
+    dp_free_messages(&message, 1);
+    return failures;
+}
+
+int main() {
+    load_env_file();
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    if (!mock_server_url) {
+        printf("SKIP: DP_MOCK_SERVER not set.\n");
+        return 77;
+    }
+    printf("Testing Gemini cached content...\n");
+    int failures = 0;
+
+    dp_context_t* context = dp_init_context(DP_PROVIDER_GOOGLE_GEMINI, "CACHED_CONTENT_GEMINI", mock_server_url);
+    if (!context) {
+        fprintf(stderr, "FAILURE: could not create a Gemini context.\n");
+        return EXIT_FAILURE;
+    }
+
+    // The shared prefix: a system prompt, a tool and a large inline document
+    char* document = malloc(DOCUMENT_BYTES + 1);
+    if (!document) return EXIT_FAILURE;
+    memset(document, 'A', DOCUMENT_BYTES);
+    document[DOCUMENT_BYTES] = '\0';
+    dp_message_t prefix = { .role = DP_ROLE_USER };
+    dp_message_add_file_data_part(&prefix, "text/plain", document, "document.txt");
+    free(document);
+    dp_tool_definition_t tool = { .type = DP_TOOL_TYPE_FUNCTION,
+                                  .function = { .name = "lookup", .description = "Looks up a term.",
+                                                .parameters_json_schema = "{\"type\":\"object\",\"properties\":{}}" } };
+    dp_request_config_t cache_config = { .model = "gemini-mock", .messages = &prefix, .num_messages = 1,
+                                         .system_prompt = "Answer from the document.", .tools = &tool, .num_tools = 1 };
+
+    dp_cached_content_t* cached = NULL;
+    if (dp_create_cached_content(context, &cache_config, 600, &cached) != 0 || !cached->name) {
+        fprintf(stderr, "FAILURE: could not create cached content: %s\n",
+                cached && cached->error_message ? cached->error_message : "(no error message)");
+        dp_free_cached_content(cached);
+        dp_free_messages(&prefix, 1);
+        dp_destroy_context(context);
+        return EXIT_FAILURE;
+    }
+    printf("created %s for %s, %ld tokens, expires %s\n", cached->name, cached->model, cached->total_token_count,
+           cached->expire_time ? cached->expire_time : "(unknown)");
+    if (strcmp(cached->model, "models/gemini-mock") != 0 || cached->total_token_count < DOCUMENT_BYTES / 4 || !cached->expire_time) {
+        fprintf(stderr, "FAILURE: the cached content's details were not parsed.\n");
+        failures++;
+    }
+
+    // With the reference only the question is sent, and the mock would reject
+    // a repeated system instruction or tools
+    failures += ask("referenced", context, cached->name, "cached contents: 1, request contents: 1, inline parts: 0",
+                    cached->total_token_count);
+    failures += ask("without cache", context, NULL, "cached contents: 0, request contents: 1, inline parts: 0", 0);
+
+    if (dp_delete_cached_content(context, cached->name) != 0) {
+        fprintf(stderr, "FAILURE: could not delete %s.\n", cached->name);
+        failures++;
+    }
+    printf("Expecting the deleted cache to be rejected...\n");
+    dp_response_t response = {0};
+    dp_message_t question = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&question, "Still there?");
+    dp_request_config_t stale = { .model = "gemini-mock", .messages = &question, .num_messages = 1, .temperature = 0.0,
+                                  .cached_content = cached->name };
+    if (dp_perform_completion(context, &stale, &response) == 0 || response.http_status_code != 404 ||
+        dp_delete_cached_content(context, cached->name) == 0) {
+        fprintf(stderr, "FAILURE: the deleted cached content was still usable.\n");
+        failures++;
+    }
+    dp_free_response_content(&response);
+    dp_free_messages(&question, 1);
+    dp_free_cached_content(cached);
+
+    // FLAKY_1_503 keys fail their first request: the create is returned as it
+    // failed, the delete is retried
+    dp_retry_policy_t policy = { .max_attempts = 3, .base_delay_ms = 10, .max_delay_ms = 100 };
+    char flaky_key[64];
+    snprintf(flaky_key, sizeof(flaky_key), "FLAKY_1_503_cachecreate%ld", (long)getpid());
+    dp_context_t* flaky_create = dp_init_context(DP_PROVIDER_GOOGLE_GEMINI, flaky_key, mock_server_url);
+    snprintf(flaky_key, sizeof(flaky_key), "FLAKY_1_503_cachedelete%ld", (long)getpid());
+    dp_context_t* flaky_delete = dp_init_context(DP_PROVIDER_GOOGLE_GEMINI, flaky_key, mock_server_url);
+    dp_set_retry_policy(flaky_create, &policy);
+    dp_set_retry_policy(flaky_delete, &policy);
+    cached = NULL;
+    if (dp_create_cached_content(flaky_create, &cache_config, 0, &cached) != -1 || !cached || cached->http_status_code != 503) {
+        fprintf(stderr, "FAILURE: a failed create was retried.\n");
+        failures++;
+    }
+    dp_free_cached_content(cached);
+    cached = NULL;
+    if (dp_create_cached_content(flaky_create, &cache_config, 0, &cached) != 0 || !cached->name ||
+        dp_delete_cached_content(flaky_delete, cached->name) != 0) {
+        fprintf(stderr, "FAILURE: a failed delete was not retried.\n");
+        failures++;
+    }
+    dp_free_cached_content(cached);
+    dp_destroy_context(flaky_create);
+    dp_destroy_context(flaky_delete);
+
+    // Other providers have no cachedContents resource
+    dp_context_t* openai = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "CACHED_CONTENT_GEMINI", mock_server_url);
+    cached = NULL;
+    if (dp_create_cached_content(openai, &cache_config, 0, &cached) != -1 || !cached || !cached->error_message) {
+        fprintf(stderr, "FAILURE: cached content was accepted for OpenAI.\n");
+        failures++;
+    }
+    dp_free_cached_content(cached);
+    dp_destroy_context(openai);
+
+    dp_free_messages(&prefix, 1);
+    dp_destroy_context(context);
+
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d cached content checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: requests reference Gemini cached content instead of resending it.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+#include "disasterparty.h"
+#include "dp_private.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// dp_global_init() validates its options, nests with dp_global_cleanup(),
+// keeps the first caller's settings and leaves requests working.
+
+#define EXPECTED_TEXT "Hello from the mock server."
+
+int main() {
+    load_env_file();
+    printf("Testing global initialization...\n");
+    int failures = 0;
+
+    dp_global_options_t missing = { .ca_bundle_path = "/nonexistent/disasterparty/ca.pem" };
+    dp_global_options_t invalid = { .ca_cache_seconds = -2 };
+    if (dp_global_init(&missing) != -1 || dp_global_init(&invalid) != -1 || dpinternal_global_config() != NULL) {
+        fprintf(stderr, "FAILURE: invalid options were accepted.\n");
+        failures++;
+    }
+
+    if (dp_global_init(NULL) != 0) {
+        fprintf(stderr, "FAILURE: dp_global_init(NULL) failed.\n");
+        return EXIT_FAILURE;
+    }
+    const dp_global_config_t* config = dpinternal_global_config();
+    if (!config || config->ca_cache_seconds <= 0 || !config->session_reuse || !config->alpn) {
+        fprintf(stderr, "FAILURE: defaults were not applied.\n");
+        failures++;
+    } else {
+        printf("CA bundle: %s, cached for %ld s\n", config->ca_bundle_path ? config->ca_bundle_path : "(none)", config->ca_cache_seconds);
+    }
+
+    // A nested call succeeds but keeps the first call's settings
+    dp_global_options_t nested = { .disable_alpn = true };
+    if (dp_global_init(&nested) != 0 || !dpinternal_global_config() || !dpinternal_global_config()->alpn) {
+        fprintf(stderr, "FAILURE: a nested call changed the settings.\n");
+        failures++;
+    }
+    dp_global_cleanup();
+    if (!dpinternal_global_config()) {
+        fprintf(stderr, "FAILURE: the first cleanup of two released the global state.\n");
+        failures++;
+    }
+
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    dp_context_t* context = NULL;
+    if (mock_server_url) {
+        context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SUCCESS_COMPLETION", mock_server_url);
+        dp_message_t message = { .role = DP_ROLE_USER };
+        dp_message_add_text_part(&message, "Hello?");
+        dp_request_config_t request = { .model = "mock-model", .messages = &message, .num_messages = 1, .temperature = -1.0 };
+        dp_response_t response;
+        int ret = dp_perform_completion(context, &request, &response);
+        if (ret != 0 || response.num_parts == 0 || !response.parts[0].text || strcmp(response.parts[0].text, EXPECTED_TEXT) != 0) {
+            fprintf(stderr, "FAILURE: completion after dp_global_init() failed: %s\n", response.error_message ? response.error_message : "(unexpected text)");
+            failures++;
+        }
+        dp_free_response_content(&response);
+        dp_free_messages(&message, 1);
+    } else {
+        printf("DP_MOCK_SERVER not set; skipping the request check.\n");
+    }
+
+    dp_global_cleanup();
+    if (dpinternal_global_config()) {
+        fprintf(stderr, "FAILURE: the last cleanup left the global state in place.\n");
+        failures++;
+    }
+    // The handle this thread kept from the request must not outlive libcurl.
+    // The context is idle, so destroying it afterwards frees memory only.
+    if (context) {
+        if (dpinternal_pool_thread_cached(context)) {
+            fprintf(stderr, "FAILURE: the last cleanup left a handle in the thread cache.\n");
+            failures++;
+        }
+        dp_destroy_context(context);
+    }
+    // Unbalanced cleanups are ignored
+    dp_global_cleanup();
+
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d global initialization checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: global initialization behaves as documented.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,163 @@
+#include "disasterparty.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// SLOW_NTH_<n>_<tag> holds the n-th request made with that key for 1.5 s and
+// answers every other one at once, like a pool with one bad replica. A hedge
+// sent while the slow request waits must win well before the 1.5 s are up.
+// With the keep-alive stand-in (tests/mock-server/h2_server.py) reachable
+// through DP_H2_MOCK_SERVER, requests under a hedge policy must also keep
+// reusing their connection.
+
+#define EXPECTED_TEXT "Hello from the mock server."
+#define SLOW_SECONDS 1.5
+
+static dp_context_t* slow_nth_context(const char* mock_server_url, int n, const char* tag) {
+    char key[128];
+    snprintf(key, sizeof(key), "SLOW_NTH_%d_%s%ld", n, tag, (long)getpid());
+    return dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, key, mock_server_url);
+}
+
+static bool run_completion(dp_context_t* context, const dp_request_config_t* config, double* elapsed_out) {
+    dp_response_t response;
+    double start = now_seconds();
+    int ret = dp_perform_completion(context, config, &response);
+    if (elapsed_out) *elapsed_out = now_seconds() - start;
+    bool ok = ret == 0 && response.num_parts > 0 && response.parts[0].text &&
+              strcmp(response.parts[0].text, EXPECTED_TEXT) == 0;
+    if (!ok) fprintf(stderr, "Completion failed: %s\n", response.error_message ? response.error_message : "(unexpected text)");
+    dp_free_response_content(&response);
+    return ok;
+}
+
+static int check_stats(const char* label, dp_context_t* context, uint64_t hedges, uint64_t wins) {
+    dp_request_stats_t stats;
+    dp_get_request_stats(context, &stats);
+    printf("%s: %llu requests, %llu hedges, %llu wins\n", label, (unsigned long long)stats.requests,
+           (unsigned long long)stats.hedges, (unsigned long long)stats.hedge_wins);
+    if (stats.hedges != hedges || stats.hedge_wins != wins) {
+        fprintf(stderr, "FAILURE: %s expected %llu hedges and %llu wins.\n", label,
+                (unsigned long long)hedges, (unsigned long long)wins);
+        return 1;
+    }
+    return 0;
+}
+
+// Runs requests on context and counts those from index first_checked on that
+// opened a connection, or returns -1 if one failed.
+static int count_new_connections(dp_context_t* context, const dp_request_config_t* config, int requests, int first_checked) {
+    int opened = 0;
+    for (int i = 0; i < requests; ++i) {
+        dp_response_t response;
+        int ret = dp_perform_completion(context, config, &response);
+        if (ret != 0) {
+            fprintf(stderr, "Completion failed: %s\n", response.error_message ? response.error_message : "(no message)");
+            dp_free_response_content(&response);
+            return -1;
+        }
+        if (i >= first_checked && response.transport.num_connects != 0) opened++;
+        dp_free_response_content(&response);
+    }
+    return opened;
+}
+
+static int check_connection_reuse(const char* label, const char* h2_server_url, const dp_request_config_t* config,
+                                  const dp_hedge_policy_t* policy, int requests, int first_checked) {
+    char base_url[512];
+    snprintf(base_url, sizeof(base_url), "%s/v1", h2_server_url);
+    dp_context_t* context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "h2-key", base_url);
+    if (!context) return 1;
+    const char* ca_bundle = getenv("DP_H2_MOCK_CA");
+    if (ca_bundle) dp_set_ca_bundle(context, ca_bundle);
+    dp_set_hedge_policy(context, policy);
+    int opened = count_new_connections(context, config, requests, first_checked);
+    dp_destroy_context(context);
+    printf("%s: %d of %d requests opened a connection\n", label, opened, requests - first_checked);
+    if (opened != 0) {
+        fprintf(stderr, "FAILURE: %s did not reuse its connection.\n", label);
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    load_env_file();
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    if (!mock_server_url) {
+        printf("SKIP: DP_MOCK_SERVER environment variable not set.\n");
+        return 77;
+    }
+
+    printf("Testing hedged completions...\n");
+
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Hello?");
+    dp_request_config_t config = { .model = "mock-model", .messages = &message, .num_messages = 1, .temperature = -1.0 };
+    int failures = 0;
+    double elapsed = 0;
+
+    // Fixed delay: the first request is slow, its hedge is not
+    dp_context_t* ctx = slow_nth_context(mock_server_url, 1, "fixed");
+    dp_hedge_policy_t fixed = { .delay_ms = 150 };
+    dp_set_hedge_policy(ctx, &fixed);
+    if (!run_completion(ctx, &config, &elapsed) || elapsed >= SLOW_SECONDS - 0.3) {
+        fprintf(stderr, "FAILURE: hedged request took %.2fs.\n", elapsed);
+        failures++;
+    }
+    failures += check_stats("fixed delay", ctx, 1, 1);
+    // Fast requests never reach the delay
+    for (int i = 0; i < 3; ++i) {
+        if (!run_completion(ctx, &config, NULL)) failures++;
+    }
+    failures += check_stats("fast requests", ctx, 1, 1);
+    dp_destroy_context(ctx);
+
+    // Learned delay: the first requests teach the context what normal looks
+    // like, then the slow 20th is hedged at the 90th percentile (floored at 50 ms)
+    ctx = slow_nth_context(mock_server_url, 20, "learned");
+    dp_hedge_policy_t learned = { .percentile = 90, .min_delay_ms = 50 };
+    dp_set_hedge_policy(ctx, &learned);
+    for (int i = 1; i < 20; ++i) {
+        if (!run_completion(ctx, &config, NULL)) failures++;
+    }
+    failures += check_stats("learning", ctx, 0, 0);
+    if (!run_completion(ctx, &config, &elapsed) || elapsed >= SLOW_SECONDS - 0.3) {
+        fprintf(stderr, "FAILURE: request hedged at the learned delay took %.2fs.\n", elapsed);
+        failures++;
+    }
+    failures += check_stats("learned delay", ctx, 1, 1);
+    dp_destroy_context(ctx);
+
+    // Invalid policies are rejected
+    dp_context_t* healthy = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SUCCESS_COMPLETION", mock_server_url);
+    dp_hedge_policy_t invalid = { .percentile = 150 };
+    if (dp_set_hedge_policy(healthy, &invalid) != -1) {
+        fprintf(stderr, "FAILURE: a percentile above 100 was accepted.\n");
+        failures++;
+    }
+    dp_destroy_context(healthy);
+
+    // A hedge policy must not cost a new connection per request, hedge or not
+    const char* h2_server_url = getenv("DP_H2_MOCK_SERVER");
+    if (h2_server_url) {
+        dp_hedge_policy_t fixed_reuse = { .delay_ms = 5000 };
+        failures += check_connection_reuse("fixed delay reuse", h2_server_url, &config, &fixed_reuse, 6, 1);
+        // The first request after learning moves from a plain transfer to a multi handle
+        dp_hedge_policy_t learned_reuse = { .percentile = 90, .min_delay_ms = 5000 };
+        failures += check_connection_reuse("learned delay reuse", h2_server_url, &config, &learned_reuse, 24, 17);
+    } else {
+        printf("DP_H2_MOCK_SERVER not set; skipping the connection reuse check.\n");
+    }
+
+    dp_free_messages(&message, 1);
+
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d hedging checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: slow requests are hedged and the faster reply wins.\n");
+    return EXIT_SUCCESS;
+}
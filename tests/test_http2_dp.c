@@ -0,0 +1,140 @@
+#include "disasterparty.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <curl/curl.h>
+
+// Requires the HTTP/2 stand-in server (tests/mock-server/h2_server.py) with
+// its default timing, reachable through DP_H2_MOCK_SERVER. For an HTTPS
+// stand-in, DP_H2_MOCK_CA names its certificate.
+
+#define NUM_STREAMS 20
+#define MAX_HOST_CONNECTIONS 2
+#define EXPECTED_TEXT "Hello from the h2 stand-in."
+
+typedef struct {
+    char text[256];
+    int status;
+} stream_state_t;
+
+static int stream_callback(const char* token, void* user_data, bool is_final, const char* error) {
+    stream_state_t* state = (stream_state_t*)user_data;
+    (void)is_final;
+    if (error) return 1;
+    if (token) strncat(state->text, token, sizeof(state->text) - strlen(state->text) - 1);
+    return 0;
+}
+
+static void on_done(dp_response_t* response, int status, void* user_data) {
+    stream_state_t* state = (stream_state_t*)user_data;
+    state->status = status;
+    if (status != 0) fprintf(stderr, "Stream failed: %s\n", response->error_message ? response->error_message : "(no message)");
+}
+
+int main() {
+    load_env_file();
+    const char* h2_server_url = getenv("DP_H2_MOCK_SERVER");
+    if (!h2_server_url) {
+        printf("SKIP: DP_H2_MOCK_SERVER environment variable not set.\n");
+        return 77;
+    }
+
+    printf("Testing HTTP/2 multiplexing and stall reporting...\n");
+    char base_url[512];
+    snprintf(base_url, sizeof(base_url), "%s/v1", h2_server_url);
+
+    dp_context_t* context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "h2-key", base_url);
+    dp_context_t* default_context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "h2-key", base_url);
+    dp_engine_t* engine = dp_engine_create();
+    if (!context || !default_context || !engine) {
+        fprintf(stderr, "Failed to initialize contexts or engine.\n");
+        return EXIT_FAILURE;
+    }
+    const char* ca_bundle = getenv("DP_H2_MOCK_CA");
+    if (ca_bundle) {
+        dp_set_ca_bundle(context, ca_bundle);
+        dp_set_ca_bundle(default_context, ca_bundle);
+    }
+    dp_enable_advanced_features(context, DP_FEATURE_HTTP2, 0);
+    dp_engine_set_max_host_connections(engine, MAX_HOST_CONNECTIONS);
+
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Hello?");
+    dp_request_config_t config = { .model = "mock-model", .messages = &message, .num_messages = 1, .temperature = -1.0, .stream = true };
+
+    dp_response_t responses[NUM_STREAMS];
+    stream_state_t states[NUM_STREAMS];
+    memset(states, 0, sizeof(states));
+    for (int i = 0; i < NUM_STREAMS; ++i) {
+        if (dp_submit_streaming_completion(engine, context, &config, stream_callback, &responses[i], on_done, &states[i]) != 0) {
+            fprintf(stderr, "FAILURE: submit failed: %s\n", responses[i].error_message);
+            return EXIT_FAILURE;
+        }
+    }
+    size_t in_flight = 0;
+    do {
+        dp_engine_perform(engine, 100, &in_flight);
+    } while (in_flight > 0);
+
+    int ok = 1;
+    long total_connects = 0;
+    for (int i = 0; i < NUM_STREAMS; ++i) {
+        if (states[i].status != 0 || strcmp(states[i].text, EXPECTED_TEXT) != 0 || responses[i].transport.http_version != 20) {
+            fprintf(stderr, "FAILURE: stream %d status=%d http=%ld text='%s'\n", i, states[i].status,
+                    responses[i].transport.http_version, states[i].text);
+            ok = 0;
+        }
+        total_connects += responses[i].transport.num_connects;
+        dp_free_response_content(&responses[i]);
+    }
+    printf("%d HTTP/2 streams used %ld connection(s)\n", NUM_STREAMS, total_connects);
+    // libcurl 7.x cannot multiplex over prior-knowledge (cleartext) connections.
+    bool can_multiplex = LIBCURL_VERSION_NUM >= 0x080000 || strncmp(h2_server_url, "https://", 8) == 0;
+    if (total_connects < 1 || (can_multiplex && total_connects > MAX_HOST_CONNECTIONS)) {
+        fprintf(stderr, "FAILURE: expected streams to share at most %d connections.\n", MAX_HOST_CONNECTIONS);
+        ok = 0;
+    }
+
+    // The stand-in pauses "stall-model" streams for 400 ms halfway through.
+    dp_set_stall_threshold(context, 200);
+    stream_state_t stall_state = {0};
+    dp_response_t stall_response;
+    config.model = "stall-model";
+    dp_perform_streaming_completion(context, &config, stream_callback, &stall_state, &stall_response);
+    printf("stall-model: %zu stall(s), longest %ld ms\n", stall_response.transport.stall_count, stall_response.transport.longest_stall_ms);
+    if (stall_response.transport.stall_count != 1 || stall_response.transport.longest_stall_ms < 300 ||
+        stall_response.transport.stall_ms_total < stall_response.transport.longest_stall_ms) {
+        fprintf(stderr, "FAILURE: stall was not reported.\n");
+        ok = 0;
+    }
+    dp_free_response_content(&stall_response);
+
+    // Without the feature libcurl's default applies: HTTP/2 when negotiated over
+    // TLS, HTTP/1.1 over cleartext.
+    long default_version = strncmp(h2_server_url, "https://", 8) == 0 ? 20 : 11;
+    stream_state_t default_state = {0};
+    dp_response_t default_response;
+    config.model = "mock-model";
+    dp_perform_streaming_completion(default_context, &config, stream_callback, &default_state, &default_response);
+    if (default_response.transport.http_version != default_version || default_response.transport.stall_count != 0 ||
+        strcmp(default_state.text, EXPECTED_TEXT) != 0) {
+        fprintf(stderr, "FAILURE: stream without the feature: http=%ld stalls=%zu text='%s'\n",
+                default_response.transport.http_version, default_response.transport.stall_count, default_state.text);
+        ok = 0;
+    }
+    dp_free_response_content(&default_response);
+
+    if (dp_set_stall_threshold(context, 0) != -1 || dp_engine_set_max_host_connections(engine, -1) != -1) {
+        fprintf(stderr, "FAILURE: invalid limits were accepted.\n");
+        ok = 0;
+    }
+
+    dp_engine_destroy(engine);
+    dp_free_messages(&message, 1);
+    dp_destroy_context(context);
+    dp_destroy_context(default_context);
+    if (!ok) return EXIT_FAILURE;
+    printf("SUCCESS: HTTP/2 streams were multiplexed and stalls reported.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,100 @@
+#include "disasterparty.h"
+#include "dp_private.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Request URLs and headers used to be formatted into fixed 1024- and 512-byte
+// buffers, silently cutting off long base URLs, model names and keys. Build
+// requests with oversized values for every provider and check nothing is lost.
+
+#define BASE_URL_LENGTH 1500
+#define API_KEY_LENGTH 700
+#define MODEL_LENGTH 300
+
+static char* repeated(const char* prefix, char fill, size_t length) {
+    char* s = malloc(length + 1);
+    size_t prefix_length = strlen(prefix);
+    memcpy(s, prefix, prefix_length);
+    memset(s + prefix_length, fill, length - prefix_length);
+    s[length] = '\0';
+    return s;
+}
+
+static bool has_header(const struct curl_slist* headers, const char* name, const char* value) {
+    for (; headers; headers = headers->next) {
+        size_t name_length = strlen(name);
+        if (strncmp(headers->data, name, name_length) == 0 && strcmp(headers->data + name_length, value) == 0) return true;
+    }
+    return false;
+}
+
+static int check_provider(const char* label, dp_provider_type_t provider, const char* base_url, const char* api_key,
+                          const char* model, dp_transfer_kind_t kind, const char* header_name) {
+    int failures = 0;
+    dp_context_t* context = dp_init_context(provider, api_key, base_url);
+    if (!context) {
+        fprintf(stderr, "FAILURE: %s: context creation failed.\n", label);
+        return 1;
+    }
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Hello?");
+    dp_request_config_t config = { .model = model, .messages = &message, .num_messages = 1,
+                                   .temperature = -1.0, .stream = kind != DP_TRANSFER_COMPLETION };
+    dp_transfer_t transfer;
+    dp_response_t response;
+    if (dpinternal_transfer_init(&transfer, context, &config, kind, NULL, NULL, NULL, &response) != 0) {
+        fprintf(stderr, "FAILURE: %s: %s\n", label, response.error_message ? response.error_message : "setup failed");
+        dp_free_response_content(&response);
+        failures++;
+    } else {
+        const char* url = transfer.url;
+        printf("%s: URL of %zu bytes\n", label, strlen(url));
+        if (strncmp(url, base_url, strlen(base_url)) != 0) {
+            fprintf(stderr, "FAILURE: %s: the base URL was cut short.\n", label);
+            failures++;
+        }
+        if (provider == DP_PROVIDER_GOOGLE_GEMINI) {
+            if (!strstr(url, model) || !strstr(url, api_key)) {
+                fprintf(stderr, "FAILURE: %s: model or key missing from the URL.\n", label);
+                failures++;
+            }
+            if (kind != DP_TRANSFER_COMPLETION && strcmp(url + strlen(url) - strlen("&alt=sse"), "&alt=sse") != 0) {
+                fprintf(stderr, "FAILURE: %s: the stream URL lost its alt=sse suffix.\n", label);
+                failures++;
+            }
+        } else if (!has_header(context->json_headers, header_name, api_key)) {
+            fprintf(stderr, "FAILURE: %s: the credential header was cut short.\n", label);
+            failures++;
+        }
+        dpinternal_transfer_cleanup(&transfer);
+    }
+    dp_free_messages(&message, 1);
+    dp_destroy_context(context);
+    return failures;
+}
+
+int main() {
+    printf("Testing requests with oversized URLs, keys and model names...\n");
+
+    char* base_url = repeated("https://gateway.example.invalid/", 'p', BASE_URL_LENGTH);
+    char* api_key = repeated("key-", 'k', API_KEY_LENGTH);
+    char* model = repeated("model-", 'm', MODEL_LENGTH);
+    int failures = 0;
+
+    failures += check_provider("openai", DP_PROVIDER_OPENAI_COMPATIBLE, base_url, api_key, model, DP_TRANSFER_COMPLETION, "Authorization: Bearer ");
+    failures += check_provider("anthropic", DP_PROVIDER_ANTHROPIC, base_url, api_key, model, DP_TRANSFER_STREAM, "x-api-key: ");
+    failures += check_provider("gemini", DP_PROVIDER_GOOGLE_GEMINI, base_url, api_key, model, DP_TRANSFER_COMPLETION, NULL);
+    failures += check_provider("gemini stream", DP_PROVIDER_GOOGLE_GEMINI, base_url, api_key, model, DP_TRANSFER_STREAM, NULL);
+
+    free(base_url);
+    free(api_key);
+    free(model);
+
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: long endpoints and credentials are preserved.\n");
+    return EXIT_SUCCESS;
+}
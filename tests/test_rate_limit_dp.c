@@ -0,0 +1,290 @@
+#include "disasterparty.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// The client-side rate limiter paces and refuses requests before they reach
+// the provider, is shared between contexts, corrects its up-front token
+// estimate from the reported usage, charges every retry and max_tokens
+// re-send as another request, and makes batches queue rather than fail.
+
+#define EXPECTED_TEXT "Hello from the mock server."
+#define BATCH_ITEMS 3
+
+// Empties the request bucket so the next request has to wait for a refill
+static void drain_requests(dp_rate_limiter_t* limiter) {
+    while (dp_rate_limiter_acquire(limiter, 0, 0, false) == 0) {}
+}
+
+static int complete(dp_context_t* context, const char* text, dp_response_t* response) {
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, text);
+    dp_request_config_t config = { .model = "mock-model", .messages = &message, .num_messages = 1, .temperature = -1.0 };
+    int ret = dp_perform_completion(context, &config, response);
+    dp_free_messages(&message, 1);
+    return ret;
+}
+
+static int expect_success(const char* label, dp_context_t* context, const char* text) {
+    dp_response_t response;
+    int ret = complete(context, text, &response);
+    int failed = ret != 0 || response.num_parts == 0 || !response.parts[0].text || strcmp(response.parts[0].text, EXPECTED_TEXT) != 0;
+    if (failed) fprintf(stderr, "FAILURE: %s: %s\n", label, response.error_message ? response.error_message : "(unexpected text)");
+    dp_free_response_content(&response);
+    return failed;
+}
+
+static int expect_rate_limited(const char* label, dp_context_t* context) {
+    dp_response_t response;
+    long start = now_ms();
+    int ret = complete(context, "Hello?", &response);
+    long elapsed = now_ms() - start;
+    int failed = ret != -1 || response.error_class != DP_ERROR_RATE_LIMITED || elapsed > 50;
+    if (failed) fprintf(stderr, "FAILURE: %s: was not refused at once (%ld ms, class %d).\n", label, elapsed, (int)response.error_class);
+    dp_free_response_content(&response);
+    return failed;
+}
+
+int main() {
+    load_env_file();
+    printf("Testing the client-side rate limiter...\n");
+    int failures = 0;
+
+    // Direct use: a full bucket allows a minute's quota at once, then reports the wait
+    dp_rate_limits_t rpm_60 = { .requests_per_minute = 60 };
+    dp_rate_limiter_t* limiter = dp_rate_limiter_create(&rpm_60);
+    int granted = 0;
+    while (granted < 100 && dp_rate_limiter_acquire(limiter, 0, 0, false) == 0) granted++;
+    long wait_ms = dp_rate_limiter_acquire(limiter, 0, 0, false);
+    printf("60 RPM: %d granted at once, next in %ld ms\n", granted, wait_ms);
+    if (granted != 60 || wait_ms <= 0 || wait_ms > 1001) {
+        fprintf(stderr, "FAILURE: the request bucket did not hold one minute's quota.\n");
+        failures++;
+    }
+    dp_rate_limiter_destroy(limiter);
+
+    // Settling returns an overestimate to the bucket
+    dp_rate_limits_t tpm = { .input_tokens_per_minute = 1000 };
+    limiter = dp_rate_limiter_create(&tpm);
+    if (dp_rate_limiter_acquire(limiter, 800, 0, false) != 0 || dp_rate_limiter_acquire(limiter, 300, 0, false) <= 0) {
+        fprintf(stderr, "FAILURE: the input token bucket did not limit.\n");
+        failures++;
+    }
+    dp_rate_limiter_settle(limiter, 800, 0, 100, 0);
+    if (dp_rate_limiter_acquire(limiter, 300, 0, false) != 0) {
+        fprintf(stderr, "FAILURE: settling did not return the unused tokens.\n");
+        failures++;
+    }
+    dp_rate_limiter_destroy(limiter);
+
+    dp_rate_limits_t negative = { .requests_per_minute = -1 };
+    if (dp_rate_limiter_create(&negative) || dp_rate_limiter_create(NULL) || dp_rate_limiter_acquire(NULL, 0, 0, false) != -1) {
+        fprintf(stderr, "FAILURE: invalid limits were accepted.\n");
+        failures++;
+    }
+
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    if (!mock_server_url) {
+        printf("DP_MOCK_SERVER not set; skipping the request checks.\n");
+        return failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    // One limiter shared by two contexts, failing fast
+    dp_rate_limits_t rpm_3 = { .requests_per_minute = 3 };
+    limiter = dp_rate_limiter_create(&rpm_3);
+    dp_context_t* first = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SUCCESS_COMPLETION", mock_server_url);
+    dp_context_t* second = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SUCCESS_COMPLETION", mock_server_url);
+    dp_set_rate_limiter(first, limiter, DP_RATE_LIMIT_FAIL_FAST);
+    dp_set_rate_limiter(second, limiter, DP_RATE_LIMIT_FAIL_FAST);
+    dp_rate_limiter_destroy(limiter);  // The contexts keep it alive
+    failures += expect_success("shared quota, request 1", first, "Hello?");
+    failures += expect_success("shared quota, request 2", first, "Hello?");
+    failures += expect_success("shared quota, request 3", second, "Hello?");
+    failures += expect_rate_limited("shared quota exhausted", second);
+    failures += expect_rate_limited("shared quota exhausted", first);
+    dp_destroy_context(first);
+    dp_destroy_context(second);
+
+    // Waiting mode: with the bucket drained, a request waits for the refill
+    dp_rate_limits_t rpm_600 = { .requests_per_minute = 600 };
+    limiter = dp_rate_limiter_create(&rpm_600);
+    dp_context_t* context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SUCCESS_COMPLETION", mock_server_url);
+    dp_set_rate_limiter(context, limiter, DP_RATE_LIMIT_WAIT);
+    drain_requests(limiter);
+    long start = now_ms();
+    failures += expect_success("waiting for capacity", context, "Hello?");
+    long waited = now_ms() - start;
+    printf("waited %ld ms for a 600 RPM slot\n", waited);
+    if (waited < 80) {
+        fprintf(stderr, "FAILURE: the request did not wait for capacity.\n");
+        failures++;
+    }
+
+    // A total deadline shorter than the wait fails instead of waiting
+    drain_requests(limiter);
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Hello?");
+    dp_request_config_t short_deadline = { .model = "mock-model", .messages = &message, .num_messages = 1, .temperature = -1.0,
+                                           .deadlines = { .total_ms = 20 } };
+    dp_response_t response;
+    if (dp_perform_completion(context, &short_deadline, &response) != -1 || response.error_class != DP_ERROR_RATE_LIMITED) {
+        fprintf(stderr, "FAILURE: a wait beyond the total deadline was not refused.\n");
+        failures++;
+    }
+    dp_free_response_content(&response);
+
+    // Time queued for capacity is part of the total deadline, not added to it
+    dp_context_t* stalled = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "STALLED_RESPONSE", mock_server_url);
+    dp_set_rate_limiter(stalled, limiter, DP_RATE_LIMIT_WAIT);
+    drain_requests(limiter);
+    dp_request_config_t queued_deadline = short_deadline;
+    queued_deadline.deadlines.total_ms = 300;
+    start = now_ms();
+    int queued_ret = dp_perform_completion(stalled, &queued_deadline, &response);
+    long queued_ms = now_ms() - start;
+    printf("queued ~100 ms under a 300 ms deadline: failed after %ld ms\n", queued_ms);
+    if (queued_ret != -1 || response.deadline_missed != DP_DEADLINE_TOTAL || queued_ms >= 380) {
+        fprintf(stderr, "FAILURE: the total deadline restarted after the queue wait.\n");
+        failures++;
+    }
+    dp_free_response_content(&response);
+    dp_destroy_context(stalled);
+    dp_free_messages(&message, 1);
+
+    // Batches queue for capacity even in fail-fast mode
+    dp_set_rate_limiter(context, limiter, DP_RATE_LIMIT_FAIL_FAST);
+    drain_requests(limiter);
+    dp_message_t batch_message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&batch_message, "Hello?");
+    dp_request_config_t configs[BATCH_ITEMS];
+    dp_response_t responses[BATCH_ITEMS];
+    for (int i = 0; i < BATCH_ITEMS; ++i) {
+        configs[i] = (dp_request_config_t){ .model = "mock-model", .messages = &batch_message, .num_messages = 1, .temperature = -1.0 };
+    }
+    start = now_ms();
+    int rc = dp_perform_completions_batch(context, configs, BATCH_ITEMS, 0, responses, NULL, NULL);
+    long batch_ms = now_ms() - start;
+    printf("batch of %d at 600 RPM from empty: %ld ms\n", BATCH_ITEMS, batch_ms);
+    if (rc != 0 || batch_ms < 250) {
+        fprintf(stderr, "FAILURE: the batch did not queue for capacity (rc %d, %s).\n", rc,
+                responses[0].error_message ? responses[0].error_message : "no error");
+        failures++;
+    }
+    for (int i = 0; i < BATCH_ITEMS; ++i) dp_free_response_content(&responses[i]);
+
+    // ... but only within their total deadline: one slot arrives in time, the next ones would not
+    drain_requests(limiter);
+    for (int i = 0; i < BATCH_ITEMS; ++i) configs[i].deadlines.total_ms = 150;
+    dp_perform_completions_batch(context, configs, BATCH_ITEMS, 0, responses, NULL, NULL);
+    int in_time = 0, refused = 0;
+    for (int i = 0; i < BATCH_ITEMS; ++i) {
+        if (!responses[i].error_message) in_time++;
+        else if (responses[i].error_class == DP_ERROR_RATE_LIMITED) refused++;
+        dp_free_response_content(&responses[i]);
+    }
+    printf("batch of %d under a 150 ms deadline: %d sent, %d refused\n", BATCH_ITEMS, in_time, refused);
+    if (in_time != 1 || refused != BATCH_ITEMS - 1) {
+        fprintf(stderr, "FAILURE: queued batch items outlived their total deadline.\n");
+        failures++;
+    }
+    dp_destroy_context(context);
+    dp_rate_limiter_destroy(limiter);
+
+    // Each retry takes a request of its own: with two per minute, the second
+    // failure of a request that keeps failing is returned instead of retried
+    dp_rate_limits_t rpm_2 = { .requests_per_minute = 2 };
+    limiter = dp_rate_limiter_create(&rpm_2);
+    char flaky_key[64];
+    snprintf(flaky_key, sizeof(flaky_key), "FLAKY_3_503_ratelimit%ld", (long)getpid());
+    context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, flaky_key, mock_server_url);
+    dp_set_rate_limiter(context, limiter, DP_RATE_LIMIT_FAIL_FAST);
+    dp_retry_policy_t policy = { .max_attempts = 4, .base_delay_ms = 20, .max_delay_ms = 100 };
+    dp_set_retry_policy(context, &policy);
+    int ret = complete(context, "Hello?", &response);
+    printf("retries at 2 RPM: %d attempt(s), status %ld\n", response.attempts, response.http_status_code);
+    if (ret != -1 || response.attempts != 2 || response.http_status_code != 503 ||
+        dp_rate_limiter_acquire(limiter, 0, 0, false) <= 0) {
+        fprintf(stderr, "FAILURE: retries were not charged to the rate limiter.\n");
+        failures++;
+    }
+    dp_free_response_content(&response);
+    dp_destroy_context(context);
+    dp_rate_limiter_destroy(limiter);
+
+    // So does the max_tokens re-send to an endpoint that rejects max_completion_tokens
+    dp_request_config_t legacy_config = configs[0];
+    legacy_config.max_tokens = 16;
+    legacy_config.deadlines.total_ms = 0;
+    limiter = dp_rate_limiter_create(&rpm_2);
+    context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "LEGACY_TOKEN_PARAM", mock_server_url);
+    dp_set_rate_limiter(context, limiter, DP_RATE_LIMIT_FAIL_FAST);
+    ret = dp_perform_completion(context, &legacy_config, &response);
+    printf("max_tokens fallback at 2 RPM: %d attempt(s), status %ld\n", response.attempts, response.http_status_code);
+    if (ret != 0 || response.attempts != 2 || dp_rate_limiter_acquire(limiter, 0, 0, false) <= 0) {
+        fprintf(stderr, "FAILURE: the max_tokens fallback was not charged to the rate limiter.\n");
+        failures++;
+    }
+    dp_free_response_content(&response);
+    dp_destroy_context(context);
+    dp_rate_limiter_destroy(limiter);
+
+    // ... and without capacity for it the rejection is returned
+    dp_rate_limits_t rpm_1 = { .requests_per_minute = 1 };
+    limiter = dp_rate_limiter_create(&rpm_1);
+    context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "LEGACY_TOKEN_PARAM", mock_server_url);
+    dp_set_rate_limiter(context, limiter, DP_RATE_LIMIT_FAIL_FAST);
+    ret = dp_perform_completion(context, &legacy_config, &response);
+    if (ret != -1 || response.attempts != 1 || response.http_status_code != 400) {
+        fprintf(stderr, "FAILURE: the max_tokens fallback was sent without capacity (%d attempt(s), status %ld).\n",
+                response.attempts, response.http_status_code);
+        failures++;
+    }
+    dp_free_response_content(&response);
+    dp_destroy_context(context);
+    dp_rate_limiter_destroy(limiter);
+
+    // A batch item's re-send queues for capacity like its first request
+    limiter = dp_rate_limiter_create(&rpm_600);
+    context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "LEGACY_TOKEN_PARAM", mock_server_url);
+    dp_set_rate_limiter(context, limiter, DP_RATE_LIMIT_FAIL_FAST);
+    drain_requests(limiter);
+    start = now_ms();
+    rc = dp_perform_completions_batch(context, &legacy_config, 1, 0, responses, NULL, NULL);
+    batch_ms = now_ms() - start;
+    printf("batch max_tokens fallback at 600 RPM from empty: %d attempt(s) in %ld ms\n", responses[0].attempts, batch_ms);
+    if (rc != 0 || responses[0].error_message || responses[0].attempts != 2 || batch_ms < 150) {
+        fprintf(stderr, "FAILURE: the batch max_tokens fallback did not queue for capacity (%s).\n",
+                responses[0].error_message ? responses[0].error_message : "no error");
+        failures++;
+    }
+    dp_free_response_content(&responses[0]);
+    dp_free_messages(&batch_message, 1);
+    dp_destroy_context(context);
+    dp_rate_limiter_destroy(limiter);
+
+    // The estimate for a long prompt is corrected from the reported usage
+    dp_rate_limits_t input_tpm = { .input_tokens_per_minute = 1000 };
+    limiter = dp_rate_limiter_create(&input_tpm);
+    context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SUCCESS_COMPLETION", mock_server_url);
+    dp_set_rate_limiter(context, limiter, DP_RATE_LIMIT_FAIL_FAST);
+    char long_prompt[3601];
+    memset(long_prompt, 'a', sizeof(long_prompt) - 1);
+    long_prompt[sizeof(long_prompt) - 1] = '\0';
+    if (complete(context, long_prompt, &response) != 0 || response.usage.input_tokens != 5 || response.usage.output_tokens != 5) {
+        fprintf(stderr, "FAILURE: usage was not reported (%ld in, %ld out).\n", response.usage.input_tokens, response.usage.output_tokens);
+        failures++;
+    }
+    dp_free_response_content(&response);
+    failures += expect_success("after settling a 900-token estimate", context, long_prompt);
+    dp_destroy_context(context);
+    dp_rate_limiter_destroy(limiter);
+
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d rate limiter checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: the rate limiter paces, shares, settles and queues.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,203 @@
+#include "disasterparty.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Repeated deterministic requests are answered from the response cache: the
+// memory tier, the memory-mapped disk tier that outlives the cache object,
+// TTL expiry, LRU eviction and replay of cached streams.
+
+#define EXPECTED_TEXT "Hello from the mock server."
+
+typedef struct {
+    char text[256];
+    int final_calls;
+} stream_capture_t;
+
+static int collect(const char* token, void* user_data, bool is_final, const char* error) {
+    stream_capture_t* capture = (stream_capture_t*)user_data;
+    if (error) return 1;
+    if (token) strncat(capture->text, token, sizeof(capture->text) - strlen(capture->text) - 1);
+    if (is_final) capture->final_calls++;
+    return 0;
+}
+
+// Runs one completion (or stream) and returns how many requests reached the server
+static uint64_t complete(dp_context_t* context, const char* prompt, double temperature, bool stream, char* text_out, size_t text_size) {
+    dp_request_stats_t before, after;
+    dp_get_request_stats(context, &before);
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, prompt);
+    dp_request_config_t config = { .model = "mock-model", .messages = &message, .num_messages = 1, .temperature = temperature,
+                                   .stream = stream };
+    dp_response_t response;
+    text_out[0] = '\0';
+    if (stream) {
+        stream_capture_t capture = {0};
+        if (dp_perform_streaming_completion(context, &config, collect, &capture, &response) == 0 && capture.final_calls == 1) {
+            snprintf(text_out, text_size, "%s", capture.text);
+        }
+    } else if (dp_perform_completion(context, &config, &response) == 0 && response.num_parts > 0 && response.parts[0].text &&
+               response.usage.output_tokens == 5) {
+        snprintf(text_out, text_size, "%s", response.parts[0].text);
+    }
+    dp_free_response_content(&response);
+    dp_free_messages(&message, 1);
+    dp_get_request_stats(context, &after);
+    return after.requests - before.requests;
+}
+
+// Checks that a request got the mock's answer and whether it was sent
+static int expect(const char* label, dp_context_t* context, const char* prompt, double temperature, bool stream, bool sent) {
+    char text[256];
+    uint64_t requests = complete(context, prompt, temperature, stream, text, sizeof(text));
+    printf("%s: %s, '%s'\n", label, requests ? "sent" : "cached", text);
+    if (strcmp(text, EXPECTED_TEXT) != 0 || requests != (sent ? 1u : 0u)) {
+        fprintf(stderr, "FAILURE: %s: expected the request to be %s.\n", label, sent ? "sent" : "answered from cache");
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    load_env_file();
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    if (!mock_server_url) {
+        printf("SKIP: DP_MOCK_SERVER not set.\n");
+        return 77;
+    }
+    printf("Testing the response cache...\n");
+    int failures = 0;
+    dp_response_cache_stats_t stats;
+
+    // Memory tier: completions and streams, temperature 0 only
+    dp_response_cache_t* cache = dp_response_cache_create(NULL);
+    dp_context_t* context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SUCCESS_COMPLETION", mock_server_url);
+    dp_set_response_cache(context, cache);
+    failures += expect("first completion", context, "Hello?", 0.0, false, true);
+    failures += expect("repeated completion", context, "Hello?", 0.0, false, false);
+    failures += expect("other prompt", context, "Hi?", 0.0, false, true);
+    failures += expect("first stream", context, "Hello?", 0.0, true, true);
+    failures += expect("repeated stream", context, "Hello?", 0.0, true, false);
+    failures += expect("sampled completion", context, "Hello?", 0.7, false, true);
+    failures += expect("sampled completion again", context, "Hello?", 0.7, false, true);
+    dp_response_cache_get_stats(cache, &stats);
+    if (stats.memory_hits != 2 || stats.stores != 3 || stats.memory_entries != 3) {
+        fprintf(stderr, "FAILURE: %llu memory hits, %llu stores, %zu entries.\n", (unsigned long long)stats.memory_hits,
+                (unsigned long long)stats.stores, stats.memory_entries);
+        failures++;
+    }
+    dp_destroy_context(context);
+    dp_response_cache_destroy(cache);
+
+    // TTL and LRU eviction
+    dp_response_cache_options_t bounded = { .ttl_ms = 200, .max_memory_bytes = 2048 };
+    cache = dp_response_cache_create(&bounded);
+    context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SUCCESS_COMPLETION", mock_server_url);
+    dp_set_response_cache(context, cache);
+    failures += expect("before expiry", context, "Hello?", 0.0, false, true);
+    failures += expect("within ttl", context, "Hello?", 0.0, false, false);
+    usleep(300 * 1000);
+    failures += expect("after expiry", context, "Hello?", 0.0, false, true);
+    char prompt[32];
+    for (int i = 0; i < 10; ++i) {
+        snprintf(prompt, sizeof(prompt), "Prompt %d?", i);
+        failures += expect("filling", context, prompt, 0.0, false, true);
+    }
+    failures += expect("most recent", context, prompt, 0.0, false, false);
+    failures += expect("evicted", context, "Prompt 0?", 0.0, false, true);
+    dp_response_cache_get_stats(cache, &stats);
+    printf("bounded: %zu entries, %zu bytes, %llu evictions, %llu expirations\n", stats.memory_entries, stats.memory_bytes,
+           (unsigned long long)stats.evictions, (unsigned long long)stats.expirations);
+    if (stats.memory_bytes > bounded.max_memory_bytes || stats.evictions == 0 || stats.expirations != 1) {
+        fprintf(stderr, "FAILURE: the memory tier is not bounded or did not expire.\n");
+        failures++;
+    }
+    dp_destroy_context(context);
+    dp_response_cache_destroy(cache);
+
+    // Disk tier: responses survive the cache, and the file is locked while in use
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/dp_response_cache_%ld.bin", (long)getpid());
+    unlink(path);
+    dp_response_cache_options_t persistent = { .disk_path = path };
+    cache = dp_response_cache_create(&persistent);
+    if (!cache) {
+        fprintf(stderr, "FAILURE: could not create a cache file at %s.\n", path);
+        return EXIT_FAILURE;
+    }
+    if (dp_response_cache_create(&persistent) != NULL) {
+        fprintf(stderr, "FAILURE: a second cache opened a locked file.\n");
+        failures++;
+    }
+    context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SUCCESS_COMPLETION", mock_server_url);
+    dp_set_response_cache(context, cache);
+    failures += expect("stored to disk", context, "Hello?", 0.0, false, true);
+    failures += expect("stream stored to disk", context, "Hello?", 0.0, true, true);
+    dp_destroy_context(context);
+    dp_response_cache_destroy(cache);
+
+    // A torn record at the end of the file is dropped
+    FILE* file = fopen(path, "ab");
+    if (file) {
+        fwrite("DPRCgarbage", 1, 11, file);
+        fclose(file);
+    }
+    cache = dp_response_cache_create(&persistent);
+    context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SUCCESS_COMPLETION", mock_server_url);
+    dp_set_response_cache(context, cache);
+    failures += expect("reopened completion", context, "Hello?", 0.0, false, false);
+    failures += expect("reopened stream", context, "Hello?", 0.0, true, false);
+    failures += expect("promoted to memory", context, "Hello?", 0.0, false, false);
+    failures += expect("appended after reopening", context, "Hi?", 0.0, false, true);
+    dp_response_cache_get_stats(cache, &stats);
+    if (stats.disk_hits != 2 || stats.memory_hits != 1 || stats.disk_entries != 3) {
+        fprintf(stderr, "FAILURE: %llu disk hits, %llu memory hits, %zu records.\n", (unsigned long long)stats.disk_hits,
+                (unsigned long long)stats.memory_hits, stats.disk_entries);
+        failures++;
+    }
+    dp_destroy_context(context);
+    dp_response_cache_destroy(cache);
+
+    // Compaction keeps the file within max_disk_bytes and the newest records
+    unlink(path);
+    dp_response_cache_options_t small = { .disk_path = path, .max_disk_bytes = 4096 };
+    cache = dp_response_cache_create(&small);
+    context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SUCCESS_COMPLETION", mock_server_url);
+    dp_set_response_cache(context, cache);
+    for (int i = 0; i < 20; ++i) {
+        snprintf(prompt, sizeof(prompt), "Prompt %d?", i);
+        failures += expect("compacting", context, prompt, 0.0, false, true);
+    }
+    dp_response_cache_get_stats(cache, &stats);
+    printf("compacted: %zu records, %zu bytes\n", stats.disk_entries, stats.disk_bytes);
+    if (stats.disk_bytes > small.max_disk_bytes || stats.disk_entries == 0 || stats.disk_entries >= 20) {
+        fprintf(stderr, "FAILURE: the cache file was not compacted.\n");
+        failures++;
+    }
+    dp_destroy_context(context);
+    dp_response_cache_destroy(cache);
+    cache = dp_response_cache_create(&small);
+    context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SUCCESS_COMPLETION", mock_server_url);
+    dp_set_response_cache(context, cache);
+    failures += expect("newest kept", context, prompt, 0.0, false, false);
+    failures += expect("oldest dropped", context, "Prompt 0?", 0.0, false, true);
+    dp_destroy_context(context);
+    dp_response_cache_destroy(cache);
+    unlink(path);
+
+    dp_response_cache_options_t negative_ttl = { .ttl_ms = -1 };
+    if (dp_response_cache_create(&negative_ttl) != NULL || dp_set_response_cache(NULL, NULL) != -1) {
+        fprintf(stderr, "FAILURE: invalid arguments were accepted.\n");
+        failures++;
+    }
+
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d response cache checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: repeated requests are answered from the response cache.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,227 @@
+#include "disasterparty.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// The FLAKY_<n>_<kind>_<tag> scenario fails the first n requests made with
+// that exact key and then succeeds. Every key below carries the process id so
+// reruns against a long-lived mock server start from a fresh counter.
+
+#define EXPECTED_TEXT "Hello from the mock server."
+
+static dp_context_t* flaky_context(const char* mock_server_url, int failures, const char* kind, const char* tag) {
+    char key[128];
+    snprintf(key, sizeof(key), "FLAKY_%d_%s_%s%ld", failures, kind, tag, (long)getpid());
+    return dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, key, mock_server_url);
+}
+
+static int check(const char* label, bool ok, const dp_response_t* response) {
+    printf("%s: attempts=%d status=%ld (%s)\n", label, response->attempts, response->http_status_code,
+           response->error_message ? response->error_message : "ok");
+    if (!ok) {
+        fprintf(stderr, "FAILURE: %s\n", label);
+        return 1;
+    }
+    return 0;
+}
+
+static bool has_text(int ret, const dp_response_t* response) {
+    return ret == 0 && response->num_parts > 0 && response->parts[0].text &&
+           strcmp(response->parts[0].text, EXPECTED_TEXT) == 0;
+}
+
+static int stream_callback(const char* token, void* user_data, bool is_final, const char* error) {
+    char* text = (char*)user_data;
+    (void)is_final;
+    if (error) return 1;
+    if (token) strncat(text, token, 255 - strlen(text));
+    return 0;
+}
+
+static int engine_status = -2;
+
+static void on_done(dp_response_t* response, int status, void* user_data) {
+    (void)response; (void)user_data;
+    engine_status = status;
+}
+
+int main() {
+    load_env_file();
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    if (!mock_server_url) {
+        printf("SKIP: DP_MOCK_SERVER environment variable not set.\n");
+        return 77;
+    }
+
+    printf("Testing retries of transient failures...\n");
+
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Hello?");
+    dp_request_config_t config = { .model = "mock-model", .messages = &message, .num_messages = 1, .temperature = -1.0 };
+    dp_retry_policy_t policy = { .max_attempts = 4, .base_delay_ms = 20, .max_delay_ms = 2000 };
+    dp_response_t response;
+    int failures = 0;
+    int ret;
+
+    // Retries are off by default
+    dp_context_t* ctx = flaky_context(mock_server_url, 1, "503", "off");
+    ret = dp_perform_completion(ctx, &config, &response);
+    failures += check("no policy", ret == -1 && response.attempts == 1 && response.http_status_code == 503, &response);
+    dp_free_response_content(&response);
+    dp_destroy_context(ctx);
+
+    // Two 503s, then success on the third attempt
+    ctx = flaky_context(mock_server_url, 2, "503", "basic");
+    dp_set_retry_policy(ctx, &policy);
+    ret = dp_perform_completion(ctx, &config, &response);
+    failures += check("503 twice", has_text(ret, &response) && response.attempts == 3, &response);
+    dp_free_response_content(&response);
+    dp_request_stats_t stats;
+    dp_get_request_stats(ctx, &stats);
+    if (stats.requests != 1 || stats.retries != 2) {
+        fprintf(stderr, "FAILURE: expected 1 request and 2 retries, got %llu and %llu.\n",
+                (unsigned long long)stats.requests, (unsigned long long)stats.retries);
+        failures++;
+    }
+    dp_destroy_context(ctx);
+
+    // retry-after-ms: 250 overrides the 20 ms base delay
+    ctx = flaky_context(mock_server_url, 1, "429", "hint");
+    dp_set_retry_policy(ctx, &policy);
+    double start = now_seconds();
+    ret = dp_perform_completion(ctx, &config, &response);
+    double elapsed = now_seconds() - start;
+    failures += check("retry-after-ms", has_text(ret, &response) && response.attempts == 2 && elapsed >= 0.25, &response);
+    dp_free_response_content(&response);
+    dp_destroy_context(ctx);
+
+    // The total deadline spans all attempts: a retry that would start after it is not made
+    ctx = flaky_context(mock_server_url, 1, "429", "deadline");
+    dp_set_retry_policy(ctx, &policy);
+    dp_request_config_t deadline_config = config;
+    deadline_config.deadlines.total_ms = 200;
+    start = now_seconds();
+    ret = dp_perform_completion(ctx, &deadline_config, &response);
+    elapsed = now_seconds() - start;
+    failures += check("retry past total deadline", ret == -1 && response.attempts == 1 &&
+                      response.http_status_code == 429 && elapsed < 0.25, &response);
+    dp_free_response_content(&response);
+    dp_destroy_context(ctx);
+
+    // An exhausted request bucket waits for its reset time
+    ctx = flaky_context(mock_server_url, 1, "429R", "reset");
+    dp_set_retry_policy(ctx, &policy);
+    start = now_seconds();
+    ret = dp_perform_completion(ctx, &config, &response);
+    elapsed = now_seconds() - start;
+    failures += check("x-ratelimit-reset", has_text(ret, &response) && response.attempts == 2 && elapsed >= 0.25, &response);
+    dp_free_response_content(&response);
+    dp_destroy_context(ctx);
+
+    // Gives up after max_attempts
+    ctx = flaky_context(mock_server_url, 10, "503", "exhaust");
+    dp_set_retry_policy(ctx, &policy);
+    ret = dp_perform_completion(ctx, &config, &response);
+    failures += check("max attempts", ret == -1 && response.attempts == 4 && response.error_class == DP_ERROR_API, &response);
+    dp_free_response_content(&response);
+    dp_destroy_context(ctx);
+
+    // A Retry-After beyond max_delay_ms is returned to the caller at once
+    ctx = flaky_context(mock_server_url, 1, "LONG", "long");
+    dp_set_retry_policy(ctx, &policy);
+    start = now_seconds();
+    ret = dp_perform_completion(ctx, &config, &response);
+    elapsed = now_seconds() - start;
+    failures += check("long Retry-After", ret == -1 && response.attempts == 1 && elapsed < 1.0, &response);
+    dp_free_response_content(&response);
+    dp_destroy_context(ctx);
+
+    // Permanent errors are never retried
+    ctx = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "AUTH_FAILURE_OPENAI", mock_server_url);
+    dp_set_retry_policy(ctx, &policy);
+    ret = dp_perform_completion(ctx, &config, &response);
+    failures += check("401", ret == -1 && response.attempts == 1, &response);
+    dp_free_response_content(&response);
+    dp_destroy_context(ctx);
+
+    // A budget of one retry is spent by the first request; the second is denied
+    ctx = flaky_context(mock_server_url, 3, "503", "budget");
+    dp_retry_policy_t budgeted = policy;
+    budgeted.budget_ratio = 0.0;
+    budgeted.budget_burst = 1;
+    dp_set_retry_policy(ctx, &budgeted);
+    ret = dp_perform_completion(ctx, &config, &response);
+    failures += check("budget first", ret == -1 && response.attempts == 2, &response);
+    dp_free_response_content(&response);
+    ret = dp_perform_completion(ctx, &config, &response);
+    failures += check("budget second", ret == -1 && response.attempts == 1, &response);
+    dp_free_response_content(&response);
+    dp_get_request_stats(ctx, &stats);
+    if (stats.retries != 1 || stats.retries_denied != 2) {
+        fprintf(stderr, "FAILURE: expected 1 retry and 2 denials, got %llu and %llu.\n",
+                (unsigned long long)stats.retries, (unsigned long long)stats.retries_denied);
+        failures++;
+    }
+    dp_destroy_context(ctx);
+
+    // A stream that fails before any token reaches the callback is retried
+    ctx = flaky_context(mock_server_url, 1, "503", "stream");
+    dp_set_retry_policy(ctx, &policy);
+    dp_request_config_t stream_config = config;
+    stream_config.stream = true;
+    char text[256] = "";
+    ret = dp_perform_streaming_completion(ctx, &stream_config, stream_callback, text, &response);
+    failures += check("stream before first byte", ret == 0 && response.attempts == 2 && strcmp(text, EXPECTED_TEXT) == 0, &response);
+    dp_free_response_content(&response);
+    dp_destroy_context(ctx);
+
+    // Once tokens have been delivered a stream is not replayed
+    ctx = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "STALLED_RESPONSE", mock_server_url);
+    dp_set_retry_policy(ctx, &policy);
+    stream_config.deadlines.stream_idle_ms = 300;
+    text[0] = '\0';
+    ret = dp_perform_streaming_completion(ctx, &stream_config, stream_callback, text, &response);
+    failures += check("stream after first byte", ret == -1 && response.attempts == 1 &&
+                      response.deadline_missed == DP_DEADLINE_STREAM_IDLE, &response);
+    dp_free_response_content(&response);
+    dp_destroy_context(ctx);
+
+    // The engine parks a failed request during its backoff and resubmits it
+    ctx = flaky_context(mock_server_url, 2, "429", "engine");
+    dp_set_retry_policy(ctx, &policy);
+    dp_engine_t* engine = dp_engine_create();
+    if (dp_submit_completion(engine, ctx, &config, &response, on_done, NULL) == 0) {
+        size_t in_flight = 0;
+        do {
+            dp_engine_perform(engine, 100, &in_flight);
+        } while (in_flight > 0);
+    }
+    failures += check("engine", engine_status == 0 && has_text(0, &response) && response.attempts == 3, &response);
+    dp_free_response_content(&response);
+    dp_engine_destroy(engine);
+    dp_destroy_context(ctx);
+
+    // Model listings are retried too
+    ctx = flaky_context(mock_server_url, 1, "503", "models");
+    dp_set_retry_policy(ctx, &policy);
+    dp_model_list_t* model_list = NULL;
+    ret = dp_list_models(ctx, &model_list);
+    if (ret != 0 || !model_list || model_list->count != 0) {
+        fprintf(stderr, "FAILURE: dp_list_models was not retried: %s\n",
+                model_list && model_list->error_message ? model_list->error_message : "(no message)");
+        failures++;
+    }
+    dp_free_model_list(model_list);
+    dp_destroy_context(ctx);
+
+    dp_free_messages(&message, 1);
+
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d retry checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: transient failures are retried within the policy and budget.\n");
+    return EXIT_SUCCESS;
+}
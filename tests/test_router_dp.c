@@ -0,0 +1,201 @@
+#include "disasterparty.h"
+#include "dp_private.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A router maps model names per backend, fails over from a backend that
+// errors (before any streamed output) but not from a rejected request, and
+// steers traffic away from a slow one.
+
+#define EXPECTED_TEXT "Hello from the mock server."
+#define LATENCY_REQUESTS 20
+#define ROUTER_SEED 0x9E3779B97F4A7C15ULL
+
+typedef struct {
+    char text[256];
+    int errors;
+} stream_capture_t;
+
+static int capture_token(const char* token, void* user_data, bool is_final, const char* error) {
+    (void)is_final;
+    stream_capture_t* capture = (stream_capture_t*)user_data;
+    if (error) capture->errors++;
+    if (token) strncat(capture->text, token, sizeof(capture->text) - strlen(capture->text) - 1);
+    return 0;
+}
+
+static int run_completion(dp_router_t* router, const char* model, char* text_out, size_t text_size) {
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Hello?");
+    dp_request_config_t config = { .model = model, .messages = &message, .num_messages = 1, .temperature = -1.0 };
+    dp_response_t response;
+    int ret = dp_router_perform_completion(router, &config, &response);
+    text_out[0] = '\0';
+    if (ret == 0 && response.num_parts > 0 && response.parts[0].text) {
+        snprintf(text_out, text_size, "%s", response.parts[0].text);
+    } else if (response.error_message) {
+        snprintf(text_out, text_size, "%s", response.error_message);
+    }
+    dp_free_response_content(&response);
+    dp_free_messages(&message, 1);
+    return ret;
+}
+
+int main() {
+    load_env_file();
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    if (!mock_server_url) {
+        printf("SKIP: DP_MOCK_SERVER not set.\n");
+        return 77;
+    }
+    printf("Testing the multi-backend router...\n");
+    int failures = 0;
+    char text[512];
+
+    // Model mapping: each backend serves only the models it maps
+    dp_context_t* echo_a = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "ECHO_MODEL", mock_server_url);
+    dp_context_t* echo_b = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "ECHO_MODEL", mock_server_url);
+    dp_model_mapping_t models_a[] = { { "fast", "provider-a-fast" } };
+    dp_model_mapping_t models_b[] = { { "large", "provider-b-large" } };
+    dp_router_backend_t mapped[] = {
+        { .context = echo_a, .models = models_a, .num_models = 1 },
+        { .context = echo_b, .models = models_b, .num_models = 1 },
+    };
+    dp_router_t* router = dp_router_create(mapped, 2);
+    if (!router) {
+        fprintf(stderr, "FAILURE: dp_router_create() failed.\n");
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < 4; ++i) {
+        if (run_completion(router, "fast", text, sizeof(text)) != 0 || strcmp(text, "model:provider-a-fast") != 0 ||
+            run_completion(router, "large", text, sizeof(text)) != 0 || strcmp(text, "model:provider-b-large") != 0) {
+            fprintf(stderr, "FAILURE: model mapping: %s\n", text);
+            failures++;
+            break;
+        }
+    }
+    if (run_completion(router, "unmapped", text, sizeof(text)) != -1 || !strstr(text, "No router backend")) {
+        fprintf(stderr, "FAILURE: an unmapped model was not rejected: %s\n", text);
+        failures++;
+    }
+    dp_router_destroy(router);
+
+    // Failover: the heavily weighted backend always answers 429
+    dp_context_t* limited = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "RATE_LIMIT_COMPLETION", mock_server_url);
+    dp_context_t* healthy = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SUCCESS_COMPLETION", mock_server_url);
+    dp_router_backend_t failover[] = { { .context = limited, .weight = 50 }, { .context = healthy } };
+    router = dp_router_create(failover, 2);
+    for (int i = 0; i < 5; ++i) {
+        if (run_completion(router, "mock-model", text, sizeof(text)) != 0 || strcmp(text, EXPECTED_TEXT) != 0) {
+            fprintf(stderr, "FAILURE: completion did not fail over: %s\n", text);
+            failures++;
+            break;
+        }
+    }
+
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Hello?");
+    dp_request_config_t stream_config = { .model = "mock-model", .messages = &message, .num_messages = 1, .temperature = -1.0, .stream = true };
+    for (int i = 0; i < 5; ++i) {
+        stream_capture_t capture = {0};
+        dp_response_t response;
+        int ret = dp_router_perform_streaming_completion(router, &stream_config, capture_token, &capture, &response);
+        if (ret != 0 || strcmp(capture.text, EXPECTED_TEXT) != 0 || capture.errors != 0) {
+            fprintf(stderr, "FAILURE: stream did not fail over cleanly: '%s', %d errors, %s\n", capture.text, capture.errors,
+                    response.error_message ? response.error_message : "");
+            failures++;
+        }
+        dp_free_response_content(&response);
+        if (ret != 0) break;
+    }
+
+    dp_router_backend_stats_t limited_stats, healthy_stats;
+    dp_router_get_backend_stats(router, 0, &limited_stats);
+    dp_router_get_backend_stats(router, 1, &healthy_stats);
+    printf("failover: backend 0 %llu attempts, %llu failures, error rate %.2f; backend 1 %llu attempts\n",
+           (unsigned long long)limited_stats.requests, (unsigned long long)limited_stats.failures, limited_stats.error_rate,
+           (unsigned long long)healthy_stats.requests);
+    if (limited_stats.failures != limited_stats.requests || healthy_stats.requests != 10 || healthy_stats.failures != 0 ||
+        limited_stats.in_flight != 0 || healthy_stats.in_flight != 0) {
+        fprintf(stderr, "FAILURE: backend statistics are inconsistent.\n");
+        failures++;
+    }
+    dp_router_destroy(router);
+
+    // A request the provider rejects is returned as is: no failover, and the
+    // backend's health is untouched
+    dp_context_t* unauthorized = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "AUTH_FAILURE_OPENAI", mock_server_url);
+    dp_router_backend_t rejecting[] = { { .context = unauthorized, .weight = 50 }, { .context = healthy } };
+    router = dp_router_create(rejecting, 2);
+    router->rng_state = ROUTER_SEED;
+    int rejected = 0;
+    for (int i = 0; i < 5; ++i) {
+        if (run_completion(router, "mock-model", text, sizeof(text)) != 0) rejected++;
+    }
+    dp_router_backend_stats_t unauthorized_stats;
+    dp_router_get_backend_stats(router, 0, &unauthorized_stats);
+    dp_router_get_backend_stats(router, 1, &healthy_stats);
+    printf("rejection: backend 0 %llu attempts, %llu failures; backend 1 %llu attempts\n",
+           (unsigned long long)unauthorized_stats.requests, (unsigned long long)unauthorized_stats.failures,
+           (unsigned long long)healthy_stats.requests);
+    if (rejected == 0 || unauthorized_stats.requests != (uint64_t)rejected || healthy_stats.requests != (uint64_t)(5 - rejected) ||
+        unauthorized_stats.failures != 0 || unauthorized_stats.error_rate != 0.0) {
+        fprintf(stderr, "FAILURE: a rejected request failed over or counted against the backend.\n");
+        failures++;
+    }
+    dp_router_destroy(router);
+
+    // Latency: once both are sampled nearly everything goes to the fast backend.
+    // Fixed latencies and a fixed seed keep the draw independent of test load.
+    dp_context_t* slow = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SLOW_COMPLETION", mock_server_url);
+    dp_router_backend_t balanced[] = { { .context = slow }, { .context = healthy } };
+    router = dp_router_create(balanced, 2);
+    router->rng_state = ROUTER_SEED;
+    for (int i = 0; i < LATENCY_REQUESTS; ++i) {
+        bool tried[2] = { false, false };
+        size_t index = dpinternal_router_pick(router, "mock-model", tried);
+        dpinternal_router_record(router, index, true, true, index == 0 ? 300 : 1);
+    }
+    dp_router_backend_stats_t slow_stats, fast_stats;
+    dp_router_get_backend_stats(router, 0, &slow_stats);
+    dp_router_get_backend_stats(router, 1, &fast_stats);
+    printf("latency: slow backend %llu requests (%.0f ms), fast backend %llu requests (%.0f ms)\n",
+           (unsigned long long)slow_stats.requests, slow_stats.latency_ms,
+           (unsigned long long)fast_stats.requests, fast_stats.latency_ms);
+    if (fast_stats.requests < LATENCY_REQUESTS - 4 || slow_stats.latency_ms <= fast_stats.latency_ms) {
+        fprintf(stderr, "FAILURE: the router did not prefer the faster backend.\n");
+        failures++;
+    }
+    dp_router_destroy(router);
+
+    // Invalid arguments
+    dp_router_backend_t negative[] = { { .context = healthy, .weight = -1 } };
+    dp_router_backend_t no_context[] = { { .context = NULL } };
+    if (dp_router_create(NULL, 1) || dp_router_create(negative, 1) || dp_router_create(no_context, 1)) {
+        fprintf(stderr, "FAILURE: invalid backends were accepted.\n");
+        failures++;
+    }
+    router = dp_router_create(balanced, 2);
+    if (dp_router_get_backend_stats(router, 2, &slow_stats) != -1) {
+        fprintf(stderr, "FAILURE: an out-of-range backend index was accepted.\n");
+        failures++;
+    }
+    dp_router_destroy(router);
+
+    dp_free_messages(&message, 1);
+    dp_destroy_context(echo_a);
+    dp_destroy_context(echo_b);
+    dp_destroy_context(limited);
+    dp_destroy_context(unauthorized);
+    dp_destroy_context(healthy);
+    dp_destroy_context(slow);
+
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d router checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: the router maps models, fails over and prefers fast backends.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+#include "disasterparty.h"
+#include "dp_private.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#define NUM_CONTEXTS 3
+#define THREADS_PER_CONTEXT 4
+#define REQUESTS_PER_THREAD 5
+
+static void* worker(void* arg) {
+    dp_context_t* context = (dp_context_t*)arg;
+    long failures = 0;
+    for (int i = 0; i < REQUESTS_PER_THREAD; ++i) {
+        dp_model_list_t* model_list = NULL;
+        if (dp_list_models(context, &model_list) != 0) {
+            fprintf(stderr, "dp_list_models failed: %s\n", model_list && model_list->error_message ? model_list->error_message : "(none)");
+            failures++;
+        }
+        dp_free_model_list(model_list);
+    }
+    return (void*)failures;
+}
+
+static bool list_models_succeeds(dp_context_t* context) {
+    dp_model_list_t* model_list = NULL;
+    int result = dp_list_models(context, &model_list);
+    dp_free_model_list(model_list);
+    return result == 0;
+}
+
+static int share_refcount(dp_share_t* share) {
+    pthread_mutex_lock(&share->ref_lock);
+    int count = share->refcount;
+    pthread_mutex_unlock(&share->ref_lock);
+    return count;
+}
+
+int main() {
+    load_env_file();
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    if (!mock_server_url) {
+        printf("SKIP: DP_MOCK_SERVER environment variable not set.\n");
+        return 77;
+    }
+
+    printf("Testing dp_share_t across contexts...\n");
+
+    dp_share_t* share = dp_share_create();
+    if (!share) {
+        fprintf(stderr, "FAILURE: dp_share_create returned NULL.\n");
+        return EXIT_FAILURE;
+    }
+
+    dp_context_t* contexts[NUM_CONTEXTS];
+    for (int i = 0; i < NUM_CONTEXTS; ++i) {
+        contexts[i] = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "EMPTY_LIST", mock_server_url);
+        if (!contexts[i] || dp_set_share(contexts[i], share) != 0) {
+            fprintf(stderr, "FAILURE: could not create context %d with the share.\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+    if (share_refcount(share) != NUM_CONTEXTS + 1) {
+        fprintf(stderr, "FAILURE: expected %d share references, got %d.\n", NUM_CONTEXTS + 1, share_refcount(share));
+        return EXIT_FAILURE;
+    }
+
+    // The creator's reference can go away while contexts still use the share.
+    dp_share_destroy(share);
+
+    pthread_t threads[NUM_CONTEXTS * THREADS_PER_CONTEXT];
+    for (int i = 0; i < NUM_CONTEXTS * THREADS_PER_CONTEXT; ++i) {
+        pthread_create(&threads[i], NULL, worker, contexts[i % NUM_CONTEXTS]);
+    }
+    long total_failures = 0;
+    for (int i = 0; i < NUM_CONTEXTS * THREADS_PER_CONTEXT; ++i) {
+        void* result = NULL;
+        pthread_join(threads[i], &result);
+        total_failures += (long)result;
+    }
+    if (total_failures != 0) {
+        fprintf(stderr, "FAILURE: %ld requests over the shared cache failed.\n", total_failures);
+        return EXIT_FAILURE;
+    }
+
+    // The DNS cache really is shared: a name pinned with dp_set_resolve() on
+    // one context resolves for another context on the share, and for no other
+    const char* authority = strstr(mock_server_url, "://");
+    authority = authority ? authority + 3 : mock_server_url;
+    const char* port_start = strchr(authority, ':');
+    const char* path = strchr(authority, '/');
+    long port = port_start && (!path || port_start < path) ? strtol(port_start + 1, NULL, 10) : 80;
+    char pinned_url[256];
+    char resolve_entry[128];
+    snprintf(pinned_url, sizeof(pinned_url), "http://dp-share-test.invalid:%ld%s", port, path ? path : "");
+    snprintf(resolve_entry, sizeof(resolve_entry), "dp-share-test.invalid:%ld:127.0.0.1", port);
+    const char* resolve_entries[] = { resolve_entry };
+    dp_context_t* pinned = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "EMPTY_LIST", pinned_url);
+    dp_context_t* sharing = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "EMPTY_LIST", pinned_url);
+    dp_context_t* unshared = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "EMPTY_LIST", pinned_url);
+    if (!pinned || !sharing || !unshared || dp_set_resolve(pinned, resolve_entries, 1) != 0 ||
+        dp_set_share(pinned, share) != 0 || dp_set_share(sharing, share) != 0) {
+        fprintf(stderr, "FAILURE: could not set up the DNS sharing check.\n");
+        return EXIT_FAILURE;
+    }
+    bool pinned_ok = list_models_succeeds(pinned);
+    bool sharing_ok = list_models_succeeds(sharing);
+    bool unshared_ok = list_models_succeeds(unshared);
+    printf("pinned name resolved: by its context %s, through the share %s, without it %s\n",
+           pinned_ok ? "yes" : "no", sharing_ok ? "yes" : "no", unshared_ok ? "yes" : "no");
+    if (!pinned_ok || !sharing_ok || unshared_ok) {
+        fprintf(stderr, "FAILURE: the DNS cache was not shared between contexts.\n");
+        return EXIT_FAILURE;
+    }
+    dp_destroy_context(pinned);
+    dp_destroy_context(sharing);
+    dp_destroy_context(unshared);
+
+    // Detaching drops that context's reference.
+    if (dp_set_share(contexts[0], NULL) != 0 || share_refcount(share) != NUM_CONTEXTS - 1) {
+        fprintf(stderr, "FAILURE: detaching the share did not release its reference.\n");
+        return EXIT_FAILURE;
+    }
+
+    for (int i = 0; i < NUM_CONTEXTS; ++i) {
+        dp_destroy_context(contexts[i]);
+    }
+
+    printf("SUCCESS: %d requests shared one DNS and TLS session cache across %d contexts.\n",
+           NUM_CONTEXTS * THREADS_PER_CONTEXT * REQUESTS_PER_THREAD, NUM_CONTEXTS);
+    return EXIT_SUCCESS;
+}
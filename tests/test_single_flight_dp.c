@@ -0,0 +1,157 @@
+#include "disasterparty.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// With DP_FEATURE_SINGLE_FLIGHT, identical requests made at the same time
+// share one transfer: each caller still gets its own response, and streamed
+// tokens fan out to every caller. SLOW_COMPLETION answers after 300 ms, so
+// threads released together overlap.
+
+#define NUM_THREADS 8
+#define EXPECTED_TEXT "Hello from the mock server."
+
+typedef struct {
+    dp_context_t* context;
+    pthread_barrier_t* start;
+    const char* prompt;
+    bool stream;
+    bool stop_early;        // Stops its stream after the first token
+    char text[256];
+    int status;
+} worker_t;
+
+static int collect(const char* token, void* user_data, bool is_final, const char* error) {
+    (void)is_final;
+    worker_t* worker = (worker_t*)user_data;
+    if (error) return 1;
+    if (token) strncat(worker->text, token, sizeof(worker->text) - strlen(worker->text) - 1);
+    return worker->stop_early && worker->text[0] ? 1 : 0;
+}
+
+static void* run(void* arg) {
+    worker_t* worker = (worker_t*)arg;
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, worker->prompt);
+    dp_request_config_t config = { .model = "mock-model", .messages = &message, .num_messages = 1, .temperature = -1.0,
+                                   .stream = worker->stream };
+    dp_response_t response;
+    pthread_barrier_wait(worker->start);
+    if (worker->stream) {
+        worker->status = dp_perform_streaming_completion(worker->context, &config, collect, worker, &response);
+    } else {
+        worker->status = dp_perform_completion(worker->context, &config, &response);
+        if (worker->status == 0 && response.num_parts > 0 && response.parts[0].text) {
+            snprintf(worker->text, sizeof(worker->text), "%s", response.parts[0].text);
+        }
+    }
+    if (worker->status == 0 && response.usage.output_tokens != (worker->stream ? 0 : 5)) worker->status = -2;
+    dp_free_response_content(&response);
+    dp_free_messages(&message, 1);
+    return NULL;
+}
+
+// Runs NUM_THREADS requests at once and returns how many reached the server
+static uint64_t run_round(dp_context_t* context, worker_t* workers, const char* const* prompts, bool stream) {
+    dp_request_stats_t before, after;
+    dp_get_request_stats(context, &before);
+    pthread_barrier_t start;
+    pthread_barrier_init(&start, NULL, NUM_THREADS);
+    pthread_t threads[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        workers[i] = (worker_t){ .context = context, .start = &start, .prompt = prompts[i], .stream = stream };
+    }
+    if (stream) workers[NUM_THREADS - 1].stop_early = true;
+    for (int i = 0; i < NUM_THREADS; ++i) pthread_create(&threads[i], NULL, run, &workers[i]);
+    for (int i = 0; i < NUM_THREADS; ++i) pthread_join(threads[i], NULL);
+    pthread_barrier_destroy(&start);
+    dp_get_request_stats(context, &after);
+    return after.requests - before.requests;
+}
+
+static int check_texts(const char* label, const worker_t* workers, bool stream) {
+    int failures = 0;
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        const char* expected = stream && workers[i].stop_early ? "Hello" : EXPECTED_TEXT;
+        if (workers[i].status != 0 || strcmp(workers[i].text, expected) != 0) {
+            fprintf(stderr, "FAILURE: %s: caller %d got '%s' (status %d).\n", label, i, workers[i].text, workers[i].status);
+            failures++;
+        }
+    }
+    return failures;
+}
+
+int main() {
+    load_env_file();
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    if (!mock_server_url) {
+        printf("SKIP: DP_MOCK_SERVER not set.\n");
+        return 77;
+    }
+    printf("Testing single-flight deduplication...\n");
+    int failures = 0;
+    worker_t workers[NUM_THREADS];
+    const char* same[NUM_THREADS];
+    const char* distinct[NUM_THREADS];
+    char distinct_text[NUM_THREADS][32];
+    for (int i = 0; i < NUM_THREADS; ++i) {
+        same[i] = "Hello?";
+        snprintf(distinct_text[i], sizeof(distinct_text[i]), "Hello %d?", i);
+        distinct[i] = distinct_text[i];
+    }
+
+    dp_context_t* context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SLOW_COMPLETION", mock_server_url);
+    dp_enable_advanced_features(context, DP_FEATURE_SINGLE_FLIGHT, 0);
+
+    uint64_t sent = run_round(context, workers, same, false);
+    printf("identical completions: %d callers, %llu sent\n", NUM_THREADS, (unsigned long long)sent);
+    failures += check_texts("identical completions", workers, false);
+    if (sent != 1) {
+        fprintf(stderr, "FAILURE: identical completions were not coalesced.\n");
+        failures++;
+    }
+
+    sent = run_round(context, workers, same, true);
+    printf("identical streams: %d callers, %llu sent\n", NUM_THREADS, (unsigned long long)sent);
+    failures += check_texts("identical streams", workers, true);
+    if (sent != 1) {
+        fprintf(stderr, "FAILURE: identical streams were not coalesced.\n");
+        failures++;
+    }
+
+    sent = run_round(context, workers, distinct, false);
+    printf("distinct completions: %d callers, %llu sent\n", NUM_THREADS, (unsigned long long)sent);
+    failures += check_texts("distinct completions", workers, false);
+    if (sent != NUM_THREADS) {
+        fprintf(stderr, "FAILURE: different prompts were coalesced.\n");
+        failures++;
+    }
+
+    dp_request_stats_t stats;
+    dp_get_request_stats(context, &stats);
+    if (stats.coalesced != 2 * (NUM_THREADS - 1)) {
+        fprintf(stderr, "FAILURE: %llu requests reported as coalesced.\n", (unsigned long long)stats.coalesced);
+        failures++;
+    }
+    dp_destroy_context(context);
+
+    // Without the feature every caller sends its own request
+    context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "SLOW_COMPLETION", mock_server_url);
+    sent = run_round(context, workers, same, false);
+    printf("feature off: %d callers, %llu sent\n", NUM_THREADS, (unsigned long long)sent);
+    failures += check_texts("feature off", workers, false);
+    if (sent != NUM_THREADS) {
+        fprintf(stderr, "FAILURE: requests were coalesced without DP_FEATURE_SINGLE_FLIGHT.\n");
+        failures++;
+    }
+    dp_destroy_context(context);
+
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d single-flight checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: identical in-flight requests share one transfer.\n");
+    return EXIT_SUCCESS;
+}
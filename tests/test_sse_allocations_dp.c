@@ -0,0 +1,171 @@
+#include "disasterparty.h"
+#include "dp_private.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Once the receive buffer has grown, framing an SSE event and splitting it into
+// fields allocates nothing: the Anthropic detailed stream passes deltas on
+// without a single allocation, and the OpenAI and Gemini streams read their
+// chunks without building a cJSON tree. Allocations are counted by
+// interposing the allocator, which needs glibc and no sanitizer of its own.
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+#define DP_COUNT_ALLOCATIONS 1
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static long allocations = 0;
+
+void* malloc(size_t size) {
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    allocations++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    allocations++;
+    return __libc_realloc(ptr, size);
+}
+
+#define EVENTS 1000
+
+static const char delta_event[] =
+    "event: content_block_delta\r\n"
+    "data: {\"type\":\"content_block_delta\",\"index\":0,\"delta\":{\"type\":\"text_delta\",\"text\":\"Hello\"}}\r\n\r\n";
+static const char ping_event[] = "event: ping\ndata: {\"type\": \"ping\"}\n\n";
+static const char openai_data[] = "{\"choices\":[{\"index\":0,\"delta\":{\"content\":\"Hel\\u006co\"}}]}";
+static const char gemini_data[] =
+    "{\"candidates\": [{\"content\": {\"parts\": [{\"text\": \"Hello\"}], \"role\": \"model\"}, \"index\": 0}],"
+    " \"usageMetadata\": {\"promptTokenCount\": 5, \"candidatesTokenCount\": 1}}";
+
+static long events_seen = 0;
+
+static int count_event(const dp_anthropic_stream_event_t* event, void* user_data, const char* error) {
+    (void)user_data;
+    if (!error && event->raw_json_data) events_seen++;
+    return 0;
+}
+
+static long tokens_seen = 0;
+
+static int count_token(const char* token, void* user_data, bool is_final, const char* error) {
+    (void)user_data;
+    (void)is_final;
+    if (!error && token && strcmp(token, "Hello") == 0) tokens_seen++;
+    return 0;
+}
+
+// Writes stream in slices of at most slice bytes, as libcurl would
+static void feed(size_t (*write_callback)(void*, size_t, size_t, void*), void* processor, const char* stream, size_t slice) {
+    size_t length = strlen(stream);
+    for (size_t offset = 0; offset < length; offset += slice) {
+        size_t n = length - offset < slice ? length - offset : slice;
+        write_callback((void*)(stream + offset), 1, n, processor);
+    }
+}
+#endif
+
+int main() {
+#ifndef DP_COUNT_ALLOCATIONS
+    printf("SKIP: allocations cannot be counted in this build.\n");
+    return 77;
+#else
+    long before = allocations;
+    free(malloc(16));
+    if (allocations == before) {
+        printf("SKIP: the allocator could not be interposed.\n");
+        return 77;
+    }
+    printf("Testing SSE parsing allocations...\n");
+    int failures = 0;
+
+    // Fields are views into the event; several data lines are joined with '\n'
+    dp_sse_tokenizer_t sse;
+    dpinternal_sse_init(&sse, 0, 0);
+    const char* multi = ": comment\nevent:update\ndata: {\"a\":\ndata\nid: 7\ndata:  1}\n\n";
+    long parse_allocations = 0;
+    for (int round = 0; round < 3; ++round) {
+        before = allocations;
+        dpinternal_sse_append(&sse, multi, strlen(multi));
+        char* raw_event = dpinternal_sse_next_event(&sse);
+        dp_sse_event_t event;
+        if (!raw_event || !dpinternal_sse_parse(&sse, raw_event, &event) || !event.name || strcmp(event.name, "update") != 0 ||
+            event.name_length != 6 || !event.data || strcmp(event.data, "{\"a\":\n\n 1}") != 0 || event.data_length != 10) {
+            fprintf(stderr, "FAILURE: fields of a multi-line event were not parsed (round %d).\n", round);
+            failures++;
+            break;
+        }
+        // The first round grows the buffers; later ones reuse them
+        if (round > 0) parse_allocations += allocations - before;
+    }
+    dpinternal_sse_free(&sse);
+    printf("multi-line event: %ld allocations after the first\n", parse_allocations);
+    if (parse_allocations != 0) {
+        fprintf(stderr, "FAILURE: parsing a multi-line event allocated.\n");
+        failures++;
+    }
+
+    // The Anthropic detailed stream, whole events and one byte at a time
+    anthropic_stream_processor_t anthro_processor = { .anthropic_user_callback = count_event };
+    dpinternal_sse_init(&anthro_processor.sse, DP_SSE_BUFFER_BYTES, 0);
+    feed(dpinternal_anthropic_detailed_stream_write_callback, &anthro_processor, ping_event, sizeof(ping_event));
+    feed(dpinternal_anthropic_detailed_stream_write_callback, &anthro_processor, delta_event, sizeof(delta_event));
+    events_seen = 0;
+    before = allocations;
+    for (int i = 0; i < EVENTS; ++i) {
+        feed(dpinternal_anthropic_detailed_stream_write_callback, &anthro_processor, delta_event, i % 2 ? 1 : sizeof(delta_event));
+        feed(dpinternal_anthropic_detailed_stream_write_callback, &anthro_processor, ping_event, sizeof(ping_event));
+    }
+    long detailed_allocations = allocations - before;
+    dpinternal_sse_free(&anthro_processor.sse);
+    printf("anthropic detailed stream: %ld events, %ld allocations\n", events_seen, detailed_allocations);
+    if (events_seen != 2 * EVENTS || detailed_allocations != 0) {
+        fprintf(stderr, "FAILURE: the detailed stream allocated while passing events on.\n");
+        failures++;
+    }
+
+    // The simple streams scan their chunks in place
+    const struct {
+        const char* label;
+        dp_provider_type_t provider;
+        const char* data;
+    } streams[] = {
+        { "openai", DP_PROVIDER_OPENAI_COMPATIBLE, openai_data },
+        { "gemini", DP_PROVIDER_GOOGLE_GEMINI, gemini_data },
+    };
+    for (size_t s = 0; s < sizeof(streams) / sizeof(streams[0]); ++s) {
+        char stream_event[512];
+        snprintf(stream_event, sizeof(stream_event), "data: %s\n\n", streams[s].data);
+        stream_processor_t processor = { .user_callback = count_token, .provider = streams[s].provider };
+        dpinternal_sse_init(&processor.sse, DP_SSE_BUFFER_BYTES, 0);
+        feed(dpinternal_streaming_write_callback, &processor, stream_event, sizeof(stream_event));
+        tokens_seen = 0;
+        before = allocations;
+        for (int i = 0; i < EVENTS; ++i) {
+            feed(dpinternal_streaming_write_callback, &processor, stream_event, i % 2 ? 7 : sizeof(stream_event));
+        }
+        long stream_allocations = allocations - before;
+        dpinternal_sse_free(&processor.sse);
+        dpinternal_delta_free(&processor.delta);
+        free(processor.finish_reason_capture);
+        printf("%s stream: %ld tokens, %ld allocations\n", streams[s].label, tokens_seen, stream_allocations);
+        if (tokens_seen != EVENTS || stream_allocations != 0) {
+            fprintf(stderr, "FAILURE: the %s stream allocated while reading its chunks.\n", streams[s].label);
+            failures++;
+        }
+    }
+
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d allocation checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: SSE events are parsed in place without allocating.\n");
+    return EXIT_SUCCESS;
+#endif
+}
@@ -0,0 +1,126 @@
+#include "disasterparty.h"
+#include "dp_private.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The SSE tokenizer frames the same events whatever the line endings and
+// however the stream is sliced, including a CRLF split between two writes. Its
+// buffer keeps its size unless an event needs more, and an event longer than
+// the limit is reported.
+
+typedef struct {
+    const char* label;
+    const char* stream;
+    const char* events;     // Expected events, each followed by '|'
+    const char* pending;    // Expected unconsumed bytes
+} framing_case_t;
+
+static const framing_case_t cases[] = {
+    { "LF", "data: a\n\ndata: b\nid: 2\n\n", "data: a|data: b\nid: 2|", "" },
+    { "CRLF", "data: a\r\n\r\ndata: b\r\nid: 2\r\n\r\n", "data: a|data: b\r\nid: 2|", "" },
+    { "CR", "data: a\r\rdata: b\rid: 2\r\r", "data: a|data: b\nid: 2|", "" },
+    { "mixed", "event: x\r\ndata: a\n\r\ndata: b\r\n\ndata: c\r\r\n", "event: x\r\ndata: a|data: b|data: c|", "" },
+    { "blank runs", "\n\r\n\rdata: a\n\n\n\r\n\rdata: b\r\n\r\n", "data: a|data: b|", "" },
+    { "unterminated", "data: a\n\n{\"error\": \"x\"}\n", "data: a|", "{\"error\": \"x\"}\n" },
+};
+
+// Feeds stream in slices of the given size, the first one first_slice long, and
+// collects the events it yields
+static int run(const framing_case_t* c, size_t first_slice, size_t slice) {
+    dp_sse_tokenizer_t sse;
+    if (!dpinternal_sse_init(&sse, slice & 1 ? 0 : 16, 0)) return 1;
+    char collected[256] = "";
+    size_t length = strlen(c->stream);
+    size_t offset = 0;
+    while (offset < length) {
+        size_t n = offset == 0 ? first_slice : slice;
+        if (n > length - offset) n = length - offset;
+        if (!dpinternal_sse_append(&sse, c->stream + offset, n)) {
+            dpinternal_sse_free(&sse);
+            return 1;
+        }
+        offset += n;
+        char* event;
+        while ((event = dpinternal_sse_next_event(&sse)) != NULL) {
+            strncat(collected, event, sizeof(collected) - strlen(collected) - 1);
+            strncat(collected, "|", sizeof(collected) - strlen(collected) - 1);
+        }
+    }
+    int failed = strcmp(collected, c->events) != 0 || strcmp(dpinternal_sse_pending(&sse), c->pending) != 0;
+    if (failed) {
+        fprintf(stderr, "FAILURE: %s in slices of %zu after %zu: got '%s', pending '%s'.\n", c->label, slice, first_slice,
+                collected, dpinternal_sse_pending(&sse));
+    }
+    dpinternal_sse_free(&sse);
+    return failed;
+}
+
+int main() {
+    printf("Testing SSE framing...\n");
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        size_t length = strlen(cases[i].stream);
+        for (size_t slice = 1; slice <= length; ++slice) {
+            for (size_t first = 1; first <= length; ++first) failures += run(&cases[i], first, slice);
+        }
+    }
+
+    // After a reset nothing of the previous stream remains
+    dp_sse_tokenizer_t sse;
+    dpinternal_sse_init(&sse, 0, 0);
+    dpinternal_sse_append(&sse, "data: a\r", 8);
+    dpinternal_sse_reset(&sse);
+    dpinternal_sse_append(&sse, "\ndata: b\n\n", 10);
+    char* event = dpinternal_sse_next_event(&sse);
+    if (!event || strcmp(event, "data: b") != 0) {
+        fprintf(stderr, "FAILURE: a reset kept state of the previous stream.\n");
+        failures++;
+    }
+    dpinternal_sse_free(&sse);
+
+    // Small events never grow the buffer; a large one does, the buffer returns
+    // to its size when its end is next reached, and an event past the limit
+    // stops framing
+    dpinternal_sse_init(&sse, 1024, 8192);
+    char small[] = "data: 0123456789\n\n";
+    for (int i = 0; i < 1000; ++i) {
+        dpinternal_sse_append(&sse, small, sizeof(small) - 1);
+        while (dpinternal_sse_next_event(&sse) != NULL) {}
+    }
+    size_t steady_capacity = sse.capacity;
+    char large[6000];
+    memset(large, 'x', sizeof(large));
+    memcpy(large, "data: ", 6);
+    memcpy(large + sizeof(large) - 2, "\n\n", 2);
+    dpinternal_sse_append(&sse, large, sizeof(large));
+    event = dpinternal_sse_next_event(&sse);
+    size_t grown_capacity = sse.capacity;
+    bool large_framed = event && strlen(event) == sizeof(large) - 2;
+    for (int i = 0; i < 2000; ++i) {
+        dpinternal_sse_append(&sse, small, sizeof(small) - 1);
+        event = dpinternal_sse_next_event(&sse);
+    }
+    printf("capacity: %zu for small events, %zu for a large one, %zu after it\n", steady_capacity, grown_capacity, sse.capacity);
+    if (steady_capacity != 1024 || !large_framed || grown_capacity <= 1024 || sse.capacity != 1024 || !event) {
+        fprintf(stderr, "FAILURE: the buffer did not keep its size around a large event.\n");
+        failures++;
+    }
+    event = NULL;
+    for (int i = 0; i < 3 && !sse.oversized && !event; ++i) {
+        dpinternal_sse_append(&sse, large, sizeof(large) - 2);
+        event = dpinternal_sse_next_event(&sse);
+    }
+    if (event || !sse.oversized || sse.capacity > 4 * 8192) {
+        fprintf(stderr, "FAILURE: an event past the limit was not reported.\n");
+        failures++;
+    }
+    dpinternal_sse_free(&sse);
+
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d framing checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: events are framed the same for every line ending and slicing.\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,236 @@
+#include "disasterparty.h"
+#include "dp_private.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The stream chunk scanner must read every chunk it accepts exactly as the
+// cJSON path would: the same text, reasoning, finish reasons, Gemini parts and
+// token counts. Typical chunks must take the fast path; random mutations of
+// them either match cJSON or are handed back to it untouched.
+//
+// Usage: ./test_stream_delta_fuzz_dp [iterations] [seed]
+
+typedef struct {
+    dp_provider_type_t provider;
+    const char* json;
+} delta_seed_t;
+
+static const delta_seed_t seeds[] = {
+    { DP_PROVIDER_OPENAI_COMPATIBLE,
+      "{\"id\":\"chatcmpl-1\",\"object\":\"chat.completion.chunk\",\"created\":1729123456,\"model\":\"gpt-4o\","
+      "\"choices\":[{\"index\":0,\"delta\":{\"role\":\"assistant\",\"content\":\"\"},\"logprobs\":null,\"finish_reason\":null}]}" },
+    { DP_PROVIDER_OPENAI_COMPATIBLE,
+      "{\"choices\":[{\"index\":0,\"delta\":{\"content\":\"Caf\\u00e9 \\\"quoted\\\"\\n\\ttab \\ud83d\\ude00 \\/ \\\\\"}}]}" },
+    { DP_PROVIDER_OPENAI_COMPATIBLE,
+      "{ \"choices\" : [ { \"delta\" : { \"reasoning_content\" : \"Let me think\", \"content\" : null } } ] }" },
+    { DP_PROVIDER_OPENAI_COMPATIBLE,
+      "{\"choices\":[{\"index\":0,\"delta\":{},\"finish_reason\":\"stop\"},{\"index\":1,\"delta\":{\"content\":\"x\"}}]}" },
+    { DP_PROVIDER_OPENAI_COMPATIBLE,
+      "{\"choices\":[],\"usage\":{\"prompt_tokens\":1200,\"completion_tokens\":35,\"total_tokens\":1235,"
+      "\"prompt_tokens_details\":{\"cached_tokens\":1024,\"audio_tokens\":0},\"completion_tokens_details\":{\"reasoning_tokens\":0}}}" },
+    { DP_PROVIDER_OPENAI_COMPATIBLE,
+      "{\"choices\":[{\"delta\":{\"content\":\"\\u20ac1.5e3 \\u00ff\",\"tool_calls\":[{\"index\":0,\"function\":{\"arguments\":\"{\\\"a\\\":[1,2.5,-3e-2,true,false,null]}\"}}]}}],\"usage\":null}" },
+    { DP_PROVIDER_GOOGLE_GEMINI,
+      "{\"candidates\": [{\"content\": {\"parts\": [{\"text\": \"Hello, \\\"world\\\"\\n\"}],\"role\": \"model\"},\"index\": 0,"
+      "\"safetyRatings\": [{\"category\": \"HARM_CATEGORY_HATE_SPEECH\",\"probability\": \"NEGLIGIBLE\"}]}],"
+      "\"usageMetadata\": {\"promptTokenCount\": 7,\"candidatesTokenCount\": 12,\"totalTokenCount\": 19},\"modelVersion\": \"gemini-2.5-flash\"}" },
+    { DP_PROVIDER_GOOGLE_GEMINI,
+      "{\"candidates\": [{\"content\": {\"parts\": [{\"text\": \"Thinking it over\", \"thought\": true},"
+      " {\"text\": \"First \"}, {\"functionCall\": {\"name\": \"f\", \"args\": {}}}, {\"text\": \"second\"}]}}]}" },
+    { DP_PROVIDER_GOOGLE_GEMINI,
+      "{\"candidates\": [{\"content\": {\"parts\": [{\"text\": \"\"}]},\"finishReason\": \"STOP\"}],"
+      "\"usageMetadata\": {\"promptTokenCount\": 4096,\"candidatesTokenCount\": 3,\"cachedContentTokenCount\": 4000}}" },
+    { DP_PROVIDER_GOOGLE_GEMINI,
+      "{\"promptFeedback\": {\"blockReason\": \"SAFETY\", \"safetyRatings\": []}}" },
+    { DP_PROVIDER_GOOGLE_GEMINI,
+      "{\"promptFeedback\": {\"finishReason\": \"OTHER\"}, \"candidates\": []}" },
+};
+
+// Fragments spliced into chunks, so mutations reach the members and escapes that matter
+static const char* const fragments[] = {
+    "\"content\":\"x\"", "\"Content\":\"y\"", "\"reasoning_content\":\"r\"", "\"finish_reason\":\"length\"",
+    "\"delta\":{\"content\":\"d\"}", "\"delta\":[]", "\"choices\":[{}]", "\"usage\":{\"prompt_tokens\":9}",
+    "\"prompt_tokens\":1.5", "\"completion_tokens\":-4", "\"cached_tokens\":1e2", "\"text\":\"t\"", "\"thought\":true",
+    "\"thought\":1", "{\"text\":\"p\"}", "\"parts\":[\"s\",5,{}]", "\"finishReason\":\"MAX_TOKENS\"",
+    "\"blockReason\":7", "\"promptFeedback\":[]", "\"usageMetadata\":{\"promptTokenCount\":123456789012}",
+    "\\u0000", "\\ud800", "\\udc00", "\\ud83d\\ude00", "\\u00e9", "\\x", "\\\"", "\\", "[[[[[[[[", "]]]]", "{\"a\":",
+    "null", "true", "false", "-0", "01", "1.", ".5", "1e", "\"", ",", ":", "}", "]", " ", "\t", "\f",
+};
+
+static const char alphabet[] = "{}[]\":,\\/ntfrueals0123456789-+.eEuabcdefABCDEF \t\r\n\x01\x7f\xc3\xa9";
+
+static unsigned long long rng_state;
+
+static unsigned long long rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static bool same_string(const char* a, const char* b) {
+    return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+static void print_chunk(const char* json, size_t length) {
+    fprintf(stderr, "  chunk: '");
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char ch = (unsigned char)json[i];
+        if (ch >= 0x20 && ch < 0x7f) fputc(ch, stderr); else fprintf(stderr, "\\x%02x", ch);
+    }
+    fprintf(stderr, "'\n");
+}
+
+static dp_delta_scanner_t scanner;
+static dp_delta_scanner_t json_reader;
+static long fast_path = 0;
+
+// Returns 1 when the scanner read the chunk differently from cJSON
+static int check(dp_provider_type_t provider, const char* json, size_t length) {
+    const dp_usage_t before = { 11, 22, 33, 44 };
+    dp_usage_t scanned_usage = before;
+    if (!dpinternal_delta_scan(&scanner, provider, json, length, &scanned_usage)) {
+        if (memcmp(&scanned_usage, &before, sizeof(before)) != 0) {
+            fprintf(stderr, "FAILURE: a chunk the scanner gave up on changed the usage.\n");
+            print_chunk(json, length);
+            return 1;
+        }
+        return 0;
+    }
+    fast_path++;
+
+    cJSON* root = cJSON_Parse(json);
+    if (!root) {
+        fprintf(stderr, "FAILURE: the scanner accepted a chunk cJSON rejects.\n");
+        print_chunk(json, length);
+        return 1;
+    }
+    dp_usage_t parsed_usage = before;
+    dpinternal_parse_usage(provider, root, &parsed_usage);
+    const dp_stream_delta_t* a = &scanner.delta;
+    const dp_stream_delta_t* b = dpinternal_delta_from_json(&json_reader, provider, root);
+    bool same = b && same_string(a->content, b->content) && same_string(a->reasoning_content, b->reasoning_content) &&
+                same_string(a->finish_reason, b->finish_reason) && same_string(a->prompt_feedback_reason, b->prompt_feedback_reason) &&
+                a->num_parts == b->num_parts && memcmp(&scanned_usage, &parsed_usage, sizeof(parsed_usage)) == 0;
+    for (size_t i = 0; same && i < a->num_parts; ++i) {
+        same = a->parts[i].thought == b->parts[i].thought && same_string(a->parts[i].text, b->parts[i].text);
+    }
+    if (!same) {
+        fprintf(stderr, "FAILURE: the scanner and cJSON read a chunk differently.\n");
+        print_chunk(json, length);
+        fprintf(stderr, "  content '%s'/'%s', finish '%s'/'%s', parts %zu/%zu, input tokens %ld/%ld\n",
+                a->content ? a->content : "(null)", b && b->content ? b->content : "(null)",
+                a->finish_reason ? a->finish_reason : "(null)", b && b->finish_reason ? b->finish_reason : "(null)",
+                a->num_parts, b ? b->num_parts : 0, scanned_usage.input_tokens, parsed_usage.input_tokens);
+    }
+    cJSON_Delete(root);
+    return same ? 0 : 1;
+}
+
+// Applies one random edit to buffer, keeping it below capacity
+static void mutate(char* buffer, size_t* length, size_t capacity) {
+    size_t at = *length ? rng() % (*length + 1) : 0;
+    const char* insert = NULL;
+    size_t insert_length = 0;
+    char ch[1];
+    switch (rng() % 6) {
+        case 0:     // Replace a byte
+            if (at < *length) buffer[at] = alphabet[rng() % (sizeof(alphabet) - 1)];
+            return;
+        case 1:     // Delete a run
+            if (at < *length) {
+                size_t n = 1 + rng() % 4;
+                if (n > *length - at) n = *length - at;
+                memmove(buffer + at, buffer + at + n, *length - at - n);
+                *length -= n;
+            }
+            return;
+        case 2:     // Truncate
+            *length = at;
+            return;
+        case 3:     // Flip the case of a letter
+            if (at < *length && ((buffer[at] >= 'a' && buffer[at] <= 'z') || (buffer[at] >= 'A' && buffer[at] <= 'Z'))) buffer[at] ^= 0x20;
+            return;
+        case 4:     // Insert a byte, sometimes a NUL
+            ch[0] = rng() % 16 == 0 ? '\0' : alphabet[rng() % (sizeof(alphabet) - 1)];
+            insert = ch;
+            insert_length = 1;
+            break;
+        default:    // Insert a fragment
+            insert = fragments[rng() % (sizeof(fragments) / sizeof(fragments[0]))];
+            insert_length = strlen(insert);
+            break;
+    }
+    if (*length + insert_length >= capacity) return;
+    memmove(buffer + at + insert_length, buffer + at, *length - at);
+    memcpy(buffer + at, insert, insert_length);
+    *length += insert_length;
+}
+
+int main(int argc, char** argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 200000;
+    rng_state = argc > 2 ? strtoull(argv[2], NULL, 10) : 0x9E3779B97F4A7C15ULL;
+    if (rng_state == 0) rng_state = 1;
+    printf("Testing the stream chunk scanner against cJSON...\n");
+    int failures = 0;
+
+    // Typical chunks all take the fast path
+    for (size_t i = 0; i < sizeof(seeds) / sizeof(seeds[0]); ++i) {
+        long taken = fast_path;
+        failures += check(seeds[i].provider, seeds[i].json, strlen(seeds[i].json));
+        if (fast_path == taken) {
+            fprintf(stderr, "FAILURE: a typical chunk fell back to cJSON.\n");
+            print_chunk(seeds[i].json, strlen(seeds[i].json));
+            failures++;
+        }
+    }
+
+    // Nesting deeper than the scanner follows is left to cJSON
+    char deep[512] = "{\"choices\":";
+    for (int i = 0; i < 100; ++i) strcat(deep, "[");
+    for (int i = 0; i < 100; ++i) strcat(deep, "]");
+    strcat(deep, "}");
+    long taken = fast_path;
+    failures += check(DP_PROVIDER_OPENAI_COMPATIBLE, deep, strlen(deep));
+    if (fast_path != taken) {
+        fprintf(stderr, "FAILURE: deep nesting was scanned.\n");
+        failures++;
+    }
+
+    // Random mutations either match cJSON or fall back
+    long mutated_fast_path = fast_path;
+    for (long i = 0; i < iterations && failures < 10; ++i) {
+        const delta_seed_t* seed = &seeds[rng() % (sizeof(seeds) / sizeof(seeds[0]))];
+        size_t length = strlen(seed->json);
+        size_t capacity = length + 256;
+        char* buffer = malloc(capacity);
+        if (!buffer) return EXIT_FAILURE;
+        memcpy(buffer, seed->json, length);
+        int edits = 1 + (int)(rng() % 3);
+        for (int e = 0; e < edits; ++e) mutate(buffer, &length, capacity);
+        buffer[length] = '\0';
+        // Exactly sized, so a sanitizer catches any read past the chunk
+        char* chunk = malloc(length + 1);
+        if (!chunk) return EXIT_FAILURE;
+        memcpy(chunk, buffer, length + 1);
+        failures += check(seed->provider, chunk, length);
+        free(chunk);
+        free(buffer);
+    }
+    mutated_fast_path = fast_path - mutated_fast_path;
+    printf("%ld mutated chunks: %ld scanned, %ld left to cJSON\n", iterations, mutated_fast_path, iterations - mutated_fast_path);
+    if (mutated_fast_path < iterations / 10) {
+        fprintf(stderr, "FAILURE: too few mutated chunks took the fast path to compare.\n");
+        failures++;
+    }
+
+    dpinternal_delta_free(&scanner);
+    dpinternal_delta_free(&json_reader);
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d chunks were read differently.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: the scanner reads chunks exactly as cJSON does, or leaves them to it.\n");
+    return EXIT_SUCCESS;
+}
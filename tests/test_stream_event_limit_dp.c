@@ -0,0 +1,93 @@
+#include "disasterparty.h"
+#include "test_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A stream whose event outgrows dp_set_max_stream_event_size() is aborted with
+// an API error after the events before it were delivered; under the default
+// limit the same stream, with its 256 KiB event, arrives whole. The mock's
+// OVERSIZED_EVENT_STREAM scenario sends "Hello", the large token and " world".
+
+#define LARGE_TOKEN_BYTES (256 * 1024)
+
+typedef struct {
+    size_t bytes;
+    bool saw_hello;
+    char* error;
+} capture_t;
+
+static int collect(const char* token, void* user_data, bool is_final, const char* error) {
+    (void)is_final;
+    capture_t* capture = (capture_t*)user_data;
+    if (error && !capture->error) capture->error = strdup(error);
+    if (token) {
+        if (capture->bytes == 0 && strcmp(token, "Hello") == 0) capture->saw_hello = true;
+        capture->bytes += strlen(token);
+    }
+    return 0;
+}
+
+static int run(dp_context_t* context, capture_t* capture, dp_response_t* response) {
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Say something long.");
+    dp_request_config_t config = { .model = "gpt-mock", .messages = &message, .num_messages = 1, .temperature = 0.0, .stream = true };
+    int result = dp_perform_streaming_completion(context, &config, collect, capture, response);
+    dp_free_messages(&message, 1);
+    return result;
+}
+
+int main() {
+    load_env_file();
+    const char* mock_server_url = getenv("DP_MOCK_SERVER");
+    if (!mock_server_url) {
+        printf("SKIP: DP_MOCK_SERVER not set.\n");
+        return 77;
+    }
+    printf("Testing the stream event size limit...\n");
+    int failures = 0;
+
+    dp_context_t* context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "OVERSIZED_EVENT_STREAM", mock_server_url);
+    if (!context) {
+        fprintf(stderr, "FAILURE: could not create a context.\n");
+        return EXIT_FAILURE;
+    }
+    if (dp_set_max_stream_event_size(context, 0) != -1 || dp_set_max_stream_event_size(NULL, 1024) != -1) {
+        fprintf(stderr, "FAILURE: an invalid event size limit was accepted.\n");
+        failures++;
+    }
+
+    // The default limit leaves room for the large event
+    capture_t capture = {0};
+    dp_response_t response = {0};
+    int result = run(context, &capture, &response);
+    printf("default limit: %d, %zu bytes\n", result, capture.bytes);
+    if (result != 0 || capture.bytes != 5 + LARGE_TOKEN_BYTES + 6) {
+        fprintf(stderr, "FAILURE: the stream did not arrive whole (%s).\n", response.error_message ? response.error_message : "no error");
+        failures++;
+    }
+    dp_free_response_content(&response);
+    free(capture.error);
+
+    // Under a 64 KiB limit the large event ends the stream
+    dp_set_max_stream_event_size(context, 64 * 1024);
+    memset(&capture, 0, sizeof(capture));
+    result = run(context, &capture, &response);
+    printf("64 KiB limit: %d, %zu bytes, error '%s', callback error '%s'\n", result, capture.bytes,
+           response.error_message ? response.error_message : "", capture.error ? capture.error : "");
+    if (result == 0 || !capture.saw_hello || capture.bytes != 5 || response.error_class != DP_ERROR_API ||
+        !response.error_message || !strstr(response.error_message, "65536 bytes") || !capture.error) {
+        fprintf(stderr, "FAILURE: the oversized event was not reported.\n");
+        failures++;
+    }
+    dp_free_response_content(&response);
+    free(capture.error);
+    dp_destroy_context(context);
+
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d event size checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: streams stop at an event past the size limit.\n");
+    return EXIT_SUCCESS;
+}
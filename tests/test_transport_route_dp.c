@@ -0,0 +1,197 @@
+#define _GNU_SOURCE
+#include "disasterparty.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Stands in for a local egress sidecar: a minimal HTTP/1.1 server on a Unix
+// domain socket, and the same server on a loopback TCP port for a pinned
+// resolve entry. It answers chat completions only when the request still
+// carries the provider's logical host and path.
+
+#define LOGICAL_HOST "api.sidecar.invalid"
+#define EXPECTED_TEXT "Hello from the sidecar."
+#define COMPLETION_BODY "{\"id\":\"chatcmpl-sidecar\",\"object\":\"chat.completion\",\"created\":1700000000,\"model\":\"mock-model\"," \
+                        "\"choices\":[{\"index\":0,\"message\":{\"role\":\"assistant\",\"content\":\"" EXPECTED_TEXT "\"},\"finish_reason\":\"stop\"}]}"
+
+typedef struct {
+    int listen_fd;
+    atomic_int requests;
+    char last_host[256];
+} sidecar_t;
+
+typedef struct {
+    sidecar_t* sidecar;
+    int fd;
+} connection_t;
+
+static void header_value(const char* headers, const char* name, char* out, size_t out_size) {
+    out[0] = '\0';
+    const char* line = strcasestr(headers, name);
+    if (!line) return;
+    line += strlen(name);
+    while (*line == ' ') line++;
+    size_t length = strcspn(line, "\r\n");
+    if (length >= out_size) length = out_size - 1;
+    memcpy(out, line, length);
+    out[length] = '\0';
+}
+
+static void* serve_connection(void* arg) {
+    connection_t* connection = (connection_t*)arg;
+    sidecar_t* sidecar = connection->sidecar;
+    char buffer[65536];
+    size_t used = 0;
+    for (;;) {
+        ssize_t n = recv(connection->fd, buffer + used, sizeof(buffer) - used - 1, 0);
+        if (n <= 0) break;
+        used += (size_t)n;
+        buffer[used] = '\0';
+        char* end = strstr(buffer, "\r\n\r\n");
+        if (!end) continue;
+        char content_length[32];
+        header_value(buffer, "\r\nContent-Length:", content_length, sizeof(content_length));
+        size_t request_length = (size_t)(end + 4 - buffer) + (size_t)atol(content_length);
+        if (used < request_length) continue;
+
+        char host[256];
+        header_value(buffer, "\r\nHost:", host, sizeof(host));
+        snprintf(sidecar->last_host, sizeof(sidecar->last_host), "%s", host);
+        atomic_fetch_add(&sidecar->requests, 1);
+        bool routed = strncmp(host, LOGICAL_HOST, strlen(LOGICAL_HOST)) == 0 &&
+                      strncmp(buffer, "POST /v1/chat/completions ", 26) == 0;
+        const char* body = routed ? COMPLETION_BODY : "{\"error\":{\"message\":\"wrong host or path\"}}";
+        char reply[1024];
+        int length = snprintf(reply, sizeof(reply), "HTTP/1.1 %s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n\r\n%s",
+                              routed ? "200 OK" : "404 Not Found", strlen(body), body);
+        if (send(connection->fd, reply, (size_t)length, MSG_NOSIGNAL) != length) break;
+        memmove(buffer, buffer + request_length, used - request_length);
+        used -= request_length;
+    }
+    close(connection->fd);
+    free(connection);
+    return NULL;
+}
+
+static void* accept_connections(void* arg) {
+    sidecar_t* sidecar = (sidecar_t*)arg;
+    for (;;) {
+        int fd = accept(sidecar->listen_fd, NULL, NULL);
+        if (fd < 0) break;
+        connection_t* connection = malloc(sizeof(connection_t));
+        connection->sidecar = sidecar;
+        connection->fd = fd;
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, serve_connection, connection) == 0) {
+            pthread_detach(thread);
+        } else {
+            close(fd);
+            free(connection);
+        }
+    }
+    return NULL;
+}
+
+static bool start_sidecar(sidecar_t* sidecar, struct sockaddr* address, socklen_t length) {
+    sidecar->listen_fd = socket(address->sa_family, SOCK_STREAM, 0);
+    if (sidecar->listen_fd < 0 || bind(sidecar->listen_fd, address, length) != 0 || listen(sidecar->listen_fd, 16) != 0) {
+        return false;
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, accept_connections, sidecar) != 0) return false;
+    pthread_detach(thread);
+    return true;
+}
+
+static int check_completion(const char* label, dp_context_t* context, sidecar_t* sidecar) {
+    dp_message_t message = { .role = DP_ROLE_USER };
+    dp_message_add_text_part(&message, "Hello?");
+    dp_request_config_t config = { .model = "mock-model", .messages = &message, .num_messages = 1, .temperature = -1.0 };
+    dp_response_t response;
+    int before = atomic_load(&sidecar->requests);
+    int ret = dp_perform_completion(context, &config, &response);
+    int failures = 0;
+    printf("%s: status %d, Host '%s'\n", label, ret, sidecar->last_host);
+    if (ret != 0 || response.num_parts == 0 || !response.parts[0].text || strcmp(response.parts[0].text, EXPECTED_TEXT) != 0) {
+        fprintf(stderr, "FAILURE: %s: %s\n", label, response.error_message ? response.error_message : "(unexpected text)");
+        failures++;
+    }
+    if (atomic_load(&sidecar->requests) != before + 1) {
+        fprintf(stderr, "FAILURE: %s: the request did not reach the sidecar.\n", label);
+        failures++;
+    }
+    dp_free_response_content(&response);
+    dp_free_messages(&message, 1);
+    return failures;
+}
+
+int main() {
+    printf("Testing Unix socket and pinned resolve routing...\n");
+    int failures = 0;
+
+    // Unix domain socket
+    sidecar_t uds = { .listen_fd = -1 };
+    struct sockaddr_un uds_address = { .sun_family = AF_UNIX };
+    snprintf(uds_address.sun_path, sizeof(uds_address.sun_path), "/tmp/dp_sidecar_%ld.sock", (long)getpid());
+    unlink(uds_address.sun_path);
+    if (!start_sidecar(&uds, (struct sockaddr*)&uds_address, sizeof(uds_address))) {
+        printf("SKIP: cannot listen on a Unix domain socket.\n");
+        return 77;
+    }
+    dp_context_t* context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "sidecar-key", "http://" LOGICAL_HOST "/v1");
+    if (dp_set_unix_socket(context, uds_address.sun_path) != 0) {
+        fprintf(stderr, "FAILURE: dp_set_unix_socket() rejected a valid path.\n");
+        failures++;
+    }
+    failures += check_completion("unix socket", context, &uds);
+    failures += check_completion("unix socket, pooled handle", context, &uds);
+    dp_destroy_context(context);
+
+    // Pinned resolve entry to a loopback TCP port
+    sidecar_t tcp = { .listen_fd = -1 };
+    struct sockaddr_in tcp_address = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t tcp_length = sizeof(tcp_address);
+    if (!start_sidecar(&tcp, (struct sockaddr*)&tcp_address, sizeof(tcp_address)) ||
+        getsockname(tcp.listen_fd, (struct sockaddr*)&tcp_address, &tcp_length) != 0) {
+        fprintf(stderr, "FAILURE: cannot listen on the loopback interface.\n");
+        return EXIT_FAILURE;
+    }
+    int port = ntohs(tcp_address.sin_port);
+    char base_url[128], entry[128];
+    snprintf(base_url, sizeof(base_url), "http://%s:%d/v1", LOGICAL_HOST, port);
+    snprintf(entry, sizeof(entry), "%s:%d:127.0.0.1", LOGICAL_HOST, port);
+    const char* entries[] = { entry };
+    context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "sidecar-key", base_url);
+    if (dp_set_resolve(context, entries, 1) != 0) {
+        fprintf(stderr, "FAILURE: dp_set_resolve() rejected a valid entry.\n");
+        failures++;
+    }
+    failures += check_completion("pinned resolve", context, &tcp);
+
+    // Invalid settings are rejected
+    char long_path[200];
+    memset(long_path, 'x', sizeof(long_path) - 1);
+    long_path[sizeof(long_path) - 1] = '\0';
+    const char* malformed[] = { "no-colon" };
+    if (dp_set_unix_socket(context, long_path) != -1 || dp_set_unix_socket(context, "") != -1 ||
+        dp_set_resolve(context, malformed, 1) != -1 || dp_set_resolve(context, NULL, 1) != -1) {
+        fprintf(stderr, "FAILURE: invalid routes were accepted.\n");
+        failures++;
+    }
+    dp_destroy_context(context);
+
+    unlink(uds_address.sun_path);
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d routing checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: requests reach the sidecar with their logical host.\n");
+    return EXIT_SUCCESS;
+}
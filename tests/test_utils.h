@@ -6,6 +6,7 @@
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include "disasterparty.h"
 
 // Simple helper to load .env file if it exists
@@ -39,6 +40,18 @@ static inline void load_env_file() {
     fclose(fp);
 }
 
+// Monotonic wall-clock time in seconds, for timing requests and benchmarks
+static inline double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The same clock in milliseconds
+static inline long now_ms(void) {
+    return (long)(now_seconds() * 1000);
+}
+
 // Helper to case-insensitive substring search
 static inline const char* stristr(const char* haystack, const char* needle) {
     if (!haystack || !needle) return NULL;
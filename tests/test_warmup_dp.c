@@ -0,0 +1,189 @@
+#include "disasterparty.h"
+#include "dp_private.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+// The mock server closes every connection after one response, so this test
+// brings its own: a loopback HTTP/1.1 server that keeps connections alive and
+// counts how many it accepted and how many HEAD requests it served. Warmed
+// connections must carry the following requests without any new connects.
+
+#define NUM_CONNECTIONS 4
+#define MODELS_BODY "{\"object\":\"list\",\"data\":[{\"id\":\"mock-model\",\"object\":\"model\",\"created\":1700000000,\"owned_by\":\"mock\"}]}"
+
+typedef struct {
+    int listen_fd;
+    int port;
+    atomic_int connections;
+    atomic_int head_requests;
+} keepalive_server_t;
+
+typedef struct {
+    keepalive_server_t* server;
+    int fd;
+} connection_t;
+
+static void* serve_connection(void* arg) {
+    connection_t* connection = (connection_t*)arg;
+    char buffer[8192];
+    size_t used = 0;
+    for (;;) {
+        ssize_t n = recv(connection->fd, buffer + used, sizeof(buffer) - used - 1, 0);
+        if (n <= 0) break;
+        used += (size_t)n;
+        buffer[used] = '\0';
+        char* end;
+        // Requests carry no body, so each one ends at its blank line
+        while ((end = strstr(buffer, "\r\n\r\n"))) {
+            bool head = strncmp(buffer, "HEAD ", 5) == 0;
+            if (head) atomic_fetch_add(&connection->server->head_requests, 1);
+            char reply[512];
+            int length = snprintf(reply, sizeof(reply),
+                                  "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n\r\n%s",
+                                  strlen(MODELS_BODY), head ? "" : MODELS_BODY);
+            if (send(connection->fd, reply, (size_t)length, MSG_NOSIGNAL) != length) goto done;
+            size_t consumed = (size_t)(end + 4 - buffer);
+            memmove(buffer, buffer + consumed, used - consumed + 1);
+            used -= consumed;
+        }
+        if (used == sizeof(buffer) - 1) break;
+    }
+done:
+    close(connection->fd);
+    free(connection);
+    return NULL;
+}
+
+static void* accept_connections(void* arg) {
+    keepalive_server_t* server = (keepalive_server_t*)arg;
+    for (;;) {
+        int fd = accept(server->listen_fd, NULL, NULL);
+        if (fd < 0) break;
+        atomic_fetch_add(&server->connections, 1);
+        connection_t* connection = malloc(sizeof(connection_t));
+        connection->server = server;
+        connection->fd = fd;
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, serve_connection, connection) == 0) {
+            pthread_detach(thread);
+        } else {
+            close(fd);
+            free(connection);
+        }
+    }
+    return NULL;
+}
+
+static bool start_server(keepalive_server_t* server) {
+    struct sockaddr_in address = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t length = sizeof(address);
+    server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server->listen_fd < 0 || bind(server->listen_fd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(server->listen_fd, 16) != 0 || getsockname(server->listen_fd, (struct sockaddr*)&address, &length) != 0) {
+        return false;
+    }
+    server->port = ntohs(address.sin_port);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, accept_connections, server) != 0) return false;
+    pthread_detach(thread);
+    return true;
+}
+
+static void* list_models_worker(void* arg) {
+    dp_context_t* context = (dp_context_t*)arg;
+    dp_model_list_t* model_list = NULL;
+    int ret = dp_list_models(context, &model_list);
+    bool ok = ret == 0 && model_list && model_list->count == 1;
+    if (!ok) fprintf(stderr, "dp_list_models failed: %s\n", model_list && model_list->error_message ? model_list->error_message : "(wrong count)");
+    dp_free_model_list(model_list);
+    return (void*)(intptr_t)ok;
+}
+
+int main() {
+    printf("Testing connection warm-up...\n");
+    keepalive_server_t server = { .listen_fd = -1 };
+    if (!start_server(&server)) {
+        printf("SKIP: cannot listen on the loopback interface.\n");
+        return 77;
+    }
+    char base_url[64];
+    snprintf(base_url, sizeof(base_url), "http://127.0.0.1:%d/v1", server.port);
+    int failures = 0;
+
+    dp_context_t* context = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "warmup-key", base_url);
+    if (!context) {
+        fprintf(stderr, "Failed to initialize context.\n");
+        return EXIT_FAILURE;
+    }
+
+    long elapsed = dp_context_warmup(context, NUM_CONNECTIONS);
+    printf("warm-up: %ld ms, %d connections, %d HEAD requests\n", elapsed, atomic_load(&server.connections), atomic_load(&server.head_requests));
+    if (elapsed < 0 || atomic_load(&server.connections) != NUM_CONNECTIONS || context->pool.idle_count != NUM_CONNECTIONS) {
+        fprintf(stderr, "FAILURE: warm-up did not park %d open connections.\n", NUM_CONNECTIONS);
+        failures++;
+    }
+
+    // Concurrent requests from fresh threads all find a warm connection
+    pthread_t threads[NUM_CONNECTIONS];
+    for (int i = 0; i < NUM_CONNECTIONS; ++i) pthread_create(&threads[i], NULL, list_models_worker, context);
+    for (int i = 0; i < NUM_CONNECTIONS; ++i) {
+        void* ok;
+        pthread_join(threads[i], &ok);
+        if (!ok) failures++;
+    }
+    printf("after requests: %d connections\n", atomic_load(&server.connections));
+    if (atomic_load(&server.connections) != NUM_CONNECTIONS) {
+        fprintf(stderr, "FAILURE: requests opened new connections despite the warm-up.\n");
+        failures++;
+    }
+
+    // Handles released by those threads went with them when they exited, so
+    // warm up again; refreshing must then reuse the parked connections
+    dp_context_warmup(context, 2);
+    int connections_before = atomic_load(&server.connections);
+    int heads_before = atomic_load(&server.head_requests);
+    if (dp_set_warmup_refresh(context, 2, 1) != 0) {
+        fprintf(stderr, "FAILURE: could not start refreshing.\n");
+        failures++;
+    }
+    usleep(2500 * 1000);
+    dp_set_warmup_refresh(context, 0, 0);
+    int refreshes = atomic_load(&server.head_requests) - heads_before;
+    printf("refresh: %d HEAD requests, %d connections\n", refreshes, atomic_load(&server.connections));
+    if (refreshes < 2 || atomic_load(&server.connections) != connections_before) {
+        fprintf(stderr, "FAILURE: refreshing did not reuse the warmed connections.\n");
+        failures++;
+    }
+
+    // Invalid arguments and unreachable providers are reported
+    if (dp_context_warmup(NULL, 1) != -1 || dp_context_warmup(context, 0) != -1 || dp_set_warmup_refresh(context, 0, 5) != -1) {
+        fprintf(stderr, "FAILURE: invalid arguments were accepted.\n");
+        failures++;
+    }
+    dp_destroy_context(context);
+
+    // Shutting the socket down also wakes the blocked accept()
+    shutdown(server.listen_fd, SHUT_RDWR);
+    close(server.listen_fd);
+    dp_context_t* unreachable = dp_init_context(DP_PROVIDER_OPENAI_COMPATIBLE, "warmup-key", base_url);
+    if (dp_context_warmup(unreachable, 2) != -1) {
+        fprintf(stderr, "FAILURE: warming up an unreachable provider succeeded.\n");
+        failures++;
+    }
+    // A context destroyed with refreshing active stops its thread
+    dp_set_warmup_refresh(unreachable, 1, 60);
+    dp_destroy_context(unreachable);
+
+    if (failures > 0) {
+        fprintf(stderr, "FAILURE: %d warm-up checks failed.\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("SUCCESS: warmed connections carry the first requests.\n");
+    return EXIT_SUCCESS;
+}